@@ -21,6 +21,8 @@ class Daemon {
   struct Options {
     bool force_bootstrapping_{false};
     bool disable_privet_{false};
+    bool enable_http2_{false};
+    int http_threads_{0};
     std::string registration_ticket_;
     std::string model_id_{"AAAAA"};
 
@@ -32,7 +34,11 @@ class Daemon {
                  << "\t-b,--bootstrapping           Force WiFi bootstrapping\n"
                  << "\t--registration_ticket=TICKET Register device with the "
                     "given ticket\n"
-                 << "\t--disable_privet             Disable local privet\n";
+                 << "\t--disable_privet             Disable local privet\n"
+                 << "\t--enable_http2               Multiplex cloud requests "
+                    "over HTTP/2\n"
+                 << "\t--http_threads=N             Serve local connections "
+                    "on N threads, 0 for the main loop\n";
     }
 
     bool Parse(int argc, char** argv) {
@@ -44,6 +50,14 @@ class Daemon {
           force_bootstrapping_ = true;
         } else if (arg == "--disable_privet") {
           disable_privet_ = true;
+        } else if (arg == "--enable_http2") {
+          enable_http2_ = true;
+        } else if (arg.find("--http_threads") != std::string::npos) {
+          auto pos = arg.find("=");
+          if (pos == std::string::npos) {
+            return false;
+          }
+          http_threads_ = std::stoi(arg.substr(pos + 1));
         } else if (arg.find("--registration_ticket") != std::string::npos) {
           auto pos = arg.find("=");
           if (pos == std::string::npos) {
@@ -69,7 +83,8 @@ class Daemon {
         config_store_{
             new weave::examples::FileConfigStore(opts.model_id_,
                                                  task_runner_.get())},
-        http_client_{new weave::examples::CurlHttpClient(task_runner_.get())},
+        http_client_{new weave::examples::CurlHttpClient(task_runner_.get(),
+                                                         opts.enable_http2_)},
         network_{new weave::examples::EventNetworkImpl(task_runner_.get())},
         bluetooth_{new weave::examples::BluetoothImpl} {
     if (!opts.disable_privet_) {
@@ -77,7 +92,8 @@ class Daemon {
 
       dns_sd_.reset(new weave::examples::AvahiClient);
       http_server_.reset(
-          new weave::examples::HttpServerImpl{task_runner_.get()});
+          new weave::examples::HttpServerImpl{task_runner_.get(),
+                                              opts.http_threads_});
       if (weave::examples::WifiImpl::HasWifiCapability())
         wifi_.reset(
             new weave::examples::WifiImpl{task_runner_.get(), network_.get()});
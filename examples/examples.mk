@@ -80,5 +80,33 @@ out/$(BUILD_MODE)/weave_daemon_speaker : out/$(BUILD_MODE)/examples/daemon/speak
 
 all-examples : out/$(BUILD_MODE)/weave_daemon_ledflasher out/$(BUILD_MODE)/weave_daemon_light out/$(BUILD_MODE)/weave_daemon_lock out/$(BUILD_MODE)/weave_daemon_oven out/$(BUILD_MODE)/weave_daemon_sample out/$(BUILD_MODE)/weave_daemon_speaker
 
-.PHONY : all-examples
+###
+# examples provider tests
+
+examples_provider_unittest_obj_files := $(EXAMPLES_PROVIDER_UNITTEST_SRC_FILES:%.cc=out/$(BUILD_MODE)/%.o)
+
+ifeq (1, $(USE_INTERNAL_LIBEVHTP))
+$(examples_provider_unittest_obj_files) : third_party/include/evhtp.h
+endif
+
+$(examples_provider_unittest_obj_files) : out/$(BUILD_MODE)/%.o : %.cc third_party/include/gtest/gtest.h
+	mkdir -p $(dir $@)
+	$(CXX) $(DEFS_TEST) $(INCLUDES) $(CFLAGS) $(CFLAGS_$(BUILD_MODE)) $(CFLAGS_CC) -c -o $@ $<
+
+out/$(BUILD_MODE)/examples_provider_testrunner : \
+	$(examples_provider_unittest_obj_files) \
+	out/$(BUILD_MODE)/examples/provider/event_task_runner.o \
+	out/$(BUILD_MODE)/examples/provider/file_config_store.o \
+	out/$(BUILD_MODE)/examples/provider/ssl_stream.o \
+	out/$(BUILD_MODE)/examples/provider/timer_wheel.o \
+	out/$(BUILD_MODE)/libweave_common.a \
+	out/$(BUILD_MODE)/src/test/weave_testrunner.o \
+	third_party/lib/gmock.a \
+	third_party/lib/gtest.a
+	$(CXX) -o $@ $^ $(CFLAGS) -Lthird_party/lib -levent -lssl -lcrypto -lexpat -lpthread -lrt
+
+examples-test : out/$(BUILD_MODE)/examples_provider_testrunner
+	$(TEST_ENV) $< $(TEST_FLAGS)
+
+.PHONY : all-examples examples-test
 
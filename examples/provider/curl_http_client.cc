@@ -4,15 +4,9 @@
 
 #include "examples/provider/curl_http_client.h"
 
-#include <algorithm>
-#include <future>
-#include <thread>
-
 #include <base/bind.h>
 #include <base/logging.h>
-#include <curl/curl.h>
 #include <weave/enum_to_string.h>
-#include <weave/provider/task_runner.h>
 
 namespace weave {
 namespace examples {
@@ -56,123 +50,229 @@ size_t HeaderFunction(void* contents, size_t size, size_t nmemb, void* userp) {
   return size * nmemb;
 }
 
-std::pair<std::unique_ptr<CurlHttpClient::Response>, ErrorPtr>
-SendRequestBlocking(CurlHttpClient::Method method,
-                    const std::string& url,
-                    const CurlHttpClient::Headers& headers,
-                    const std::string& data) {
+}  // namespace
+
+struct CurlHttpClient::Request {
+  ~Request() {
+    if (header_list)
+      curl_slist_free_all(header_list);
+  }
+
   std::unique_ptr<CURL, decltype(&curl_easy_cleanup)> curl{curl_easy_init(),
                                                            &curl_easy_cleanup};
+  curl_slist* header_list{nullptr};
+  std::string data;
+  std::unique_ptr<ResponseImpl> response{new ResponseImpl};
+  provider::HttpClient::Headers response_headers;
+  SendRequestCallback callback;
+};
+
+CurlHttpClient::CurlHttpClient(EventTaskRunner* task_runner,
+                               bool enable_http2)
+    : task_runner_{task_runner}, enable_http2_{enable_http2} {
+  CHECK(share_);
+  CHECK(multi_);
+  // Everything runs on the task runner thread, so no lock functions needed.
+  CHECK_EQ(CURLSHE_OK, curl_share_setopt(share_.get(), CURLSHOPT_SHARE,
+                                         CURL_LOCK_DATA_DNS));
+  CHECK_EQ(CURLSHE_OK, curl_share_setopt(share_.get(), CURLSHOPT_SHARE,
+                                         CURL_LOCK_DATA_SSL_SESSION));
+#if LIBCURL_VERSION_NUM >= 0x073900
+  CHECK_EQ(CURLSHE_OK, curl_share_setopt(share_.get(), CURLSHOPT_SHARE,
+                                         CURL_LOCK_DATA_CONNECT));
+#endif
+#if LIBCURL_VERSION_NUM >= 0x072b00
+  if (enable_http2_) {
+    CHECK_EQ(CURLM_OK, curl_multi_setopt(multi_.get(), CURLMOPT_PIPELINING,
+                                         CURLPIPE_MULTIPLEX));
+  }
+#endif
+  timer_event_.reset(
+      evtimer_new(task_runner_->GetEventBase(), &OnTimer, this));
+  CHECK_EQ(CURLM_OK, curl_multi_setopt(multi_.get(), CURLMOPT_SOCKETFUNCTION,
+                                       &SocketFunction));
+  CHECK_EQ(CURLM_OK,
+           curl_multi_setopt(multi_.get(), CURLMOPT_SOCKETDATA, this));
+  CHECK_EQ(CURLM_OK, curl_multi_setopt(multi_.get(), CURLMOPT_TIMERFUNCTION,
+                                       &TimerFunction));
+  CHECK_EQ(CURLM_OK, curl_multi_setopt(multi_.get(), CURLMOPT_TIMERDATA, this));
+}
+
+CurlHttpClient::~CurlHttpClient() {
+  for (const auto& request : requests_)
+    curl_multi_remove_handle(multi_.get(), request.first);
+  requests_.clear();
+  socket_events_.clear();
+}
+
+void CurlHttpClient::SendRequest(Method method,
+                                 const std::string& url,
+                                 const Headers& headers,
+                                 const std::string& data,
+                                 const SendRequestCallback& callback) {
+  std::unique_ptr<Request> request{new Request};
+  CURL* curl = request->curl.get();
   CHECK(curl);
+  request->callback = callback;
 
   switch (method) {
     case CurlHttpClient::Method::kGet:
-      CHECK_EQ(CURLE_OK, curl_easy_setopt(curl.get(), CURLOPT_HTTPGET, 1L));
+      CHECK_EQ(CURLE_OK, curl_easy_setopt(curl, CURLOPT_HTTPGET, 1L));
       break;
     case CurlHttpClient::Method::kPost:
-      CHECK_EQ(CURLE_OK, curl_easy_setopt(curl.get(), CURLOPT_HTTPPOST, 1L));
+      CHECK_EQ(CURLE_OK, curl_easy_setopt(curl, CURLOPT_POST, 1L));
       break;
     case CurlHttpClient::Method::kPatch:
     case CurlHttpClient::Method::kPut:
-      CHECK_EQ(CURLE_OK, curl_easy_setopt(curl.get(), CURLOPT_CUSTOMREQUEST,
+      CHECK_EQ(CURLE_OK, curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST,
                                           weave::EnumToString(method).c_str()));
       break;
   }
 
-  CHECK_EQ(CURLE_OK, curl_easy_setopt(curl.get(), CURLOPT_URL, url.c_str()));
-
-  curl_slist* chunk = nullptr;
-  for (const auto& h : headers)
-    chunk = curl_slist_append(chunk, (h.first + ": " + h.second).c_str());
+  CHECK_EQ(CURLE_OK, curl_easy_setopt(curl, CURLOPT_URL, url.c_str()));
+  CHECK_EQ(CURLE_OK, curl_easy_setopt(curl, CURLOPT_SHARE, share_.get()));
+#if LIBCURL_VERSION_NUM >= 0x072f00
+  if (enable_http2_) {
+    CHECK_EQ(CURLE_OK, curl_easy_setopt(curl, CURLOPT_HTTP_VERSION,
+                                        CURL_HTTP_VERSION_2TLS));
+    // Prefer waiting for a connection which can be multiplexed to opening a
+    // new one.
+    CHECK_EQ(CURLE_OK, curl_easy_setopt(curl, CURLOPT_PIPEWAIT, 1L));
+  }
+#endif
 
-  CHECK_EQ(CURLE_OK, curl_easy_setopt(curl.get(), CURLOPT_HTTPHEADER, chunk));
+  for (const auto& h : headers) {
+    request->header_list = curl_slist_append(
+        request->header_list, (h.first + ": " + h.second).c_str());
+  }
+  CHECK_EQ(CURLE_OK,
+           curl_easy_setopt(curl, CURLOPT_HTTPHEADER, request->header_list));
 
   if (!data.empty() || method == CurlHttpClient::Method::kPost) {
-    CHECK_EQ(CURLE_OK,
-             curl_easy_setopt(curl.get(), CURLOPT_POSTFIELDS, data.c_str()));
+    // Curl does not copy the data, so it's kept in |request|.
+    request->data = data;
+    CHECK_EQ(CURLE_OK, curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE,
+                                        static_cast<long>(data.size())));
+    CHECK_EQ(CURLE_OK, curl_easy_setopt(curl, CURLOPT_POSTFIELDS,
+                                        request->data.c_str()));
   }
 
-  std::unique_ptr<ResponseImpl> response{new ResponseImpl};
-  CHECK_EQ(CURLE_OK,
-           curl_easy_setopt(curl.get(), CURLOPT_WRITEFUNCTION, &WriteFunction));
   CHECK_EQ(CURLE_OK,
-           curl_easy_setopt(curl.get(), CURLOPT_WRITEDATA, &response->data));
-  CHECK_EQ(CURLE_OK, curl_easy_setopt(curl.get(), CURLOPT_HEADERFUNCTION,
-                                      &HeaderFunction));
-  provider::HttpClient::Headers response_headers;
+           curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, &WriteFunction));
+  CHECK_EQ(CURLE_OK, curl_easy_setopt(curl, CURLOPT_WRITEDATA,
+                                      &request->response->data));
   CHECK_EQ(CURLE_OK,
-           curl_easy_setopt(curl.get(), CURLOPT_HEADERDATA, &response_headers));
+           curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, &HeaderFunction));
+  CHECK_EQ(CURLE_OK, curl_easy_setopt(curl, CURLOPT_HEADERDATA,
+                                      &request->response_headers));
 
-  CURLcode res = curl_easy_perform(curl.get());
-  if (chunk)
-    curl_slist_free_all(chunk);
-
-  ErrorPtr error;
-  if (res != CURLE_OK) {
-    Error::AddTo(&error, FROM_HERE, "curl_easy_perform_error",
-                 curl_easy_strerror(res));
-    return {nullptr, std::move(error)};
-  }
-
-  for (const auto& header : response_headers) {
-    if (header.first == "Content-Type")
-      response->content_type = header.second;
-  }
-
-  CHECK_EQ(CURLE_OK, curl_easy_getinfo(curl.get(), CURLINFO_RESPONSE_CODE,
-                                       &response->status));
+  CHECK_EQ(CURLM_OK, curl_multi_add_handle(multi_.get(), curl));
+  requests_.emplace(curl, std::move(request));
+}
 
-  return {std::move(response), nullptr};
+int CurlHttpClient::SocketFunction(CURL* easy,
+                                   curl_socket_t socket,
+                                   int what,
+                                   void* client,
+                                   void* socket_data) {
+  static_cast<CurlHttpClient*>(client)->WatchSocket(socket, what);
+  return 0;
 }
 
-}  // namespace
+int CurlHttpClient::TimerFunction(CURLM* multi,
+                                  long timeout_ms,
+                                  void* client) {
+  static_cast<CurlHttpClient*>(client)->SetTimer(timeout_ms);
+  return 0;
+}
 
-CurlHttpClient::CurlHttpClient(provider::TaskRunner* task_runner)
-    : task_runner_{task_runner} {}
+void CurlHttpClient::OnSocketEvent(int fd, int16_t what, void* client) {
+  int flags = 0;
+  flags |= (what & EV_READ) ? CURL_CSELECT_IN : 0;
+  flags |= (what & EV_WRITE) ? CURL_CSELECT_OUT : 0;
+  static_cast<CurlHttpClient*>(client)->SocketAction(fd, flags);
+}
 
-void CurlHttpClient::SendRequest(Method method,
-                                 const std::string& url,
-                                 const Headers& headers,
-                                 const std::string& data,
-                                 const SendRequestCallback& callback) {
-  pending_tasks_.emplace_back(
-      std::async(std::launch::async, SendRequestBlocking, method, url, headers,
-                 data),
-      callback);
-  if (pending_tasks_.size() == 1)  // More means check is scheduled.
-    CheckTasks();
+void CurlHttpClient::OnTimer(int fd, int16_t what, void* client) {
+  static_cast<CurlHttpClient*>(client)->SocketAction(CURL_SOCKET_TIMEOUT, 0);
 }
 
-void CurlHttpClient::CheckTasks() {
-  VLOG(4) << "CurlHttpClient::CheckTasks, size=" << pending_tasks_.size();
-  auto ready_begin =
-      std::partition(pending_tasks_.begin(), pending_tasks_.end(),
-                     [](const decltype(pending_tasks_)::value_type& value) {
-                       return value.first.wait_for(std::chrono::seconds(0)) !=
-                              std::future_status::ready;
-                     });
-
-  for (auto it = ready_begin; it != pending_tasks_.end(); ++it) {
-    CHECK(it->first.valid());
-    auto result = it->first.get();
-    VLOG(2) << "CurlHttpClient::CheckTasks done";
-    task_runner_->PostDelayedTask(
-        FROM_HERE, base::Bind(it->second, base::Passed(&result.first),
-                              base::Passed(&result.second)),
-        {});
+void CurlHttpClient::WatchSocket(curl_socket_t socket, int what) {
+  if (what == CURL_POLL_REMOVE) {
+    socket_events_.erase(socket);
+    return;
   }
 
-  pending_tasks_.erase(ready_begin, pending_tasks_.end());
+  int16_t flags = EV_PERSIST;
+  flags |= (what & CURL_POLL_IN) ? EV_READ : 0;
+  flags |= (what & CURL_POLL_OUT) ? EV_WRITE : 0;
+  EventPtr<event>& socket_event = socket_events_[socket];
+  socket_event.reset(event_new(task_runner_->GetEventBase(), socket, flags,
+                               &OnSocketEvent, this));
+  event_add(socket_event.get(), nullptr);
+}
 
-  if (pending_tasks_.empty()) {
-    VLOG(2) << "No more CurlHttpClient tasks";
+void CurlHttpClient::SetTimer(long timeout_ms) {
+  if (timeout_ms < 0) {
+    evtimer_del(timer_event_.get());
     return;
   }
+  timeval tv = {timeout_ms / 1000, (timeout_ms % 1000) * 1000};
+  evtimer_add(timer_event_.get(), &tv);
+}
+
+void CurlHttpClient::SocketAction(curl_socket_t socket, int flags) {
+  int running_handles = 0;
+  curl_multi_socket_action(multi_.get(), socket, flags, &running_handles);
+  ProcessCompletedRequests();
+}
 
-  task_runner_->PostDelayedTask(
-      FROM_HERE,
-      base::Bind(&CurlHttpClient::CheckTasks, weak_ptr_factory_.GetWeakPtr()),
-      base::TimeDelta::FromMilliseconds(100));
+void CurlHttpClient::ProcessCompletedRequests() {
+  int messages_left = 0;
+  while (CURLMsg* message = curl_multi_info_read(multi_.get(), &messages_left)) {
+    if (message->msg != CURLMSG_DONE)
+      continue;
+
+    CURL* curl = message->easy_handle;
+    CURLcode res = message->data.result;
+    curl_multi_remove_handle(multi_.get(), curl);
+
+    auto it = requests_.find(curl);
+    CHECK(it != requests_.end());
+    std::unique_ptr<Request> request = std::move(it->second);
+    requests_.erase(it);
+
+    long new_connections = 0;
+    curl_easy_getinfo(curl, CURLINFO_NUM_CONNECTS, &new_connections);
+    ++stats_.requests;
+    if (new_connections == 0)
+      ++stats_.reused_connections;
+    VLOG(2) << "CurlHttpClient request done, reused connections "
+            << stats_.reused_connections << " of " << stats_.requests;
+    if (res != CURLE_OK) {
+      ErrorPtr error;
+      Error::AddTo(&error, FROM_HERE, "curl_easy_perform_error",
+                   curl_easy_strerror(res));
+      task_runner_->PostDelayedTask(
+          FROM_HERE,
+          base::Bind(request->callback, nullptr, base::Passed(&error)), {});
+      continue;
+    }
+
+    std::unique_ptr<ResponseImpl> response = std::move(request->response);
+    for (const auto& header : request->response_headers) {
+      if (header.first == "Content-Type")
+        response->content_type = header.second;
+    }
+    CHECK_EQ(CURLE_OK, curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE,
+                                         &response->status));
+
+    std::unique_ptr<provider::HttpClient::Response> result{
+        std::move(response)};
+    task_runner_->PostDelayedTask(
+        FROM_HERE,
+        base::Bind(request->callback, base::Passed(&result), nullptr), {});
+  }
 }
 
 }  // namespace examples
@@ -5,26 +5,38 @@
 #ifndef LIBWEAVE_EXAMPLES_PROVIDER_CURL_HTTP_CLIENT_H_
 #define LIBWEAVE_EXAMPLES_PROVIDER_CURL_HTTP_CLIENT_H_
 
-#include <future>
+#include <map>
+#include <memory>
 #include <string>
 #include <utility>
 
-#include <base/memory/weak_ptr.h>
+#include <curl/curl.h>
 #include <weave/provider/http_client.h>
 
-namespace weave {
-
-namespace provider {
-class TaskRunner;
-}
+#include "examples/provider/event_task_runner.h"
 
+namespace weave {
 namespace examples {
 
-// Basic implementation of weave::HttpClient using libcurl. Should be used in
-// production code as it's blocking and does not validate server certificates.
+// Basic implementation of weave::HttpClient using libcurl multi interface
+// driven by event loop of EventTaskRunner. Should not be used in production
+// code as it does not validate server certificates.
+// All requests share DNS cache, TLS sessions and connections. With
+// |enable_http2| concurrent requests to the same host are multiplexed over a
+// single HTTP/2 connection when the server supports it.
 class CurlHttpClient : public provider::HttpClient {
  public:
-  explicit CurlHttpClient(provider::TaskRunner* task_runner);
+  struct Stats {
+    size_t requests{0};
+    // Requests completed without opening a new connection.
+    size_t reused_connections{0};
+  };
+
+  explicit CurlHttpClient(EventTaskRunner* task_runner,
+                          bool enable_http2 = false);
+  ~CurlHttpClient() override;
+
+  const Stats& GetStats() const { return stats_; }
 
   void SendRequest(Method method,
                    const std::string& url,
@@ -33,15 +45,32 @@ class CurlHttpClient : public provider::HttpClient {
                    const SendRequestCallback& callback) override;
 
  private:
-  void CheckTasks();
+  struct Request;
+
+  static int SocketFunction(CURL* easy,
+                            curl_socket_t socket,
+                            int what,
+                            void* client,
+                            void* socket_data);
+  static int TimerFunction(CURLM* multi, long timeout_ms, void* client);
+  static void OnSocketEvent(int fd, int16_t what, void* client);
+  static void OnTimer(int fd, int16_t what, void* client);
 
-  std::vector<
-      std::pair<std::future<std::pair<std::unique_ptr<Response>, ErrorPtr>>,
-                SendRequestCallback>>
-      pending_tasks_;
-  provider::TaskRunner* task_runner_{nullptr};
+  void WatchSocket(curl_socket_t socket, int what);
+  void SetTimer(long timeout_ms);
+  void SocketAction(curl_socket_t socket, int flags);
+  void ProcessCompletedRequests();
 
-  base::WeakPtrFactory<CurlHttpClient> weak_ptr_factory_{this};
+  EventTaskRunner* task_runner_{nullptr};
+  const bool enable_http2_{false};
+  std::unique_ptr<CURLSH, decltype(&curl_share_cleanup)> share_{
+      curl_share_init(), &curl_share_cleanup};
+  std::unique_ptr<CURLM, decltype(&curl_multi_cleanup)> multi_{
+      curl_multi_init(), &curl_multi_cleanup};
+  EventPtr<event> timer_event_;
+  std::map<curl_socket_t, EventPtr<event>> socket_events_;
+  std::map<CURL*, std::unique_ptr<Request>> requests_;
+  Stats stats_;
 };
 
 }  // namespace examples
@@ -4,6 +4,9 @@
 
 #include "examples/provider/event_http_server.h"
 
+#include <string.h>
+#include <strings.h>
+
 #include <vector>
 
 #include <base/bind.h>
@@ -11,6 +14,9 @@
 #include <event2/bufferevent_ssl.h>
 #include <evhtp.h>
 #include <openssl/err.h>
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+#include <openssl/rand.h>
 
 #include "examples/provider/event_task_runner.h"
 
@@ -19,6 +25,18 @@ namespace examples {
 
 namespace {
 
+// Privet clients usually send a burst of requests, so keep connections open
+// long enough to reuse them, but don't let idle clients hold sockets forever.
+const timeval kConnectionTimeout{30, 0};
+const uint64_t kMaxKeepAliveRequests = 100;
+
+const long kSessionCacheSize = 256;
+const uint8_t kSessionIdContext[] = "weave-privet";
+
+// Tickets stay valid for one rotation period after the key is replaced.
+const int kTicketKeyRotationPeriodSeconds = 60 * 60;
+const size_t kMaxTicketKeys = 2;
+
 std::string GetSslError() {
   char error[1000] = {};
   ERR_error_string_n(ERR_get_error(), error, sizeof(error));
@@ -27,24 +45,54 @@ std::string GetSslError() {
 
 }  // namespace
 
+// Request as seen by the evhtp thread which owns the connection. |req| is
+// reset on that thread when evhtp frees the request, e.g. if the client goes
+// away before the reply is ready.
+struct HttpServerImpl::RequestHandle {
+  evhtp_request_t* req{nullptr};
+  // Owner thread, or nullptr if connections are handled on the main loop.
+  evthr_t* thread{nullptr};
+};
+
+// Reply waiting to be sent by the owner thread of the connection.
+struct HttpServerImpl::Reply {
+  std::shared_ptr<RequestHandle> handle;
+  int status_code{0};
+  std::string mime_type;
+  std::unique_ptr<std::string> body;
+};
+
+// Copies everything libweave may need from the request on the owner thread,
+// so it's never touched from the libweave thread.
 class HttpServerImpl::RequestImpl : public Request {
  public:
-  RequestImpl(EventPtr<evhtp_request_t> req) : req_(std::move(req)) {
+  explicit RequestImpl(evhtp_request_t* req)
+      : handle_{std::make_shared<RequestHandle>()},
+        path_{req->uri->path->full} {
+    handle_->req = req;
+    handle_->thread = evhtp_request_get_connection(req)->thread;
+    evhtp_set_hook(&req->hooks, evhtp_hook_on_request_fini,
+                   reinterpret_cast<evhtp_hook>(&OnRequestFini),
+                   new std::shared_ptr<RequestHandle>{handle_});
+
+    evhtp_kvs_for_each(req->headers_in, &CopyHeader, &headers_);
+
     evbuf_t* input_buffer =
-        bufferevent_get_input(evhtp_request_get_bev(req_.get()));
+        bufferevent_get_input(evhtp_request_get_bev(req));
     data_.resize(evbuffer_get_length(input_buffer));
     evbuffer_remove(input_buffer, &data_[0], data_.size());
   }
 
   ~RequestImpl() {}
 
-  std::string GetPath() const override { return req_->uri->path->full; }
+  std::string GetPath() const override { return path_; }
 
   std::string GetFirstHeader(const std::string& name) const override {
-    const char* header = evhtp_header_find(req_->headers_in, name.c_str());
-    if (!header)
-      return {};
-    return header;
+    for (const auto& header : headers_) {
+      if (strcasecmp(header.first.c_str(), name.c_str()) == 0)
+        return header.second;
+    }
+    return {};
   }
 
   std::string GetData() { return data_; }
@@ -52,24 +100,80 @@ class HttpServerImpl::RequestImpl : public Request {
   void SendReply(int status_code,
                  const std::string& data,
                  const std::string& mime_type) override {
-    EventPtr<evbuffer> buf{evbuffer_new()};
-    evbuffer_add(buf.get(), data.data(), data.size());
-    evhtp_header_key_add(req_->headers_out, "Content-Type", 0);
-    evhtp_header_val_add(req_->headers_out, mime_type.c_str(), 1);
-    evhtp_send_reply_start(req_.get(), status_code);
-    evhtp_send_reply_body(req_.get(), buf.get());
-    evhtp_send_reply_end(req_.get());
+    SendReply(status_code, std::string{data}, mime_type);
+  }
+
+  void SendReply(int status_code,
+                 std::string&& data,
+                 const std::string& mime_type) override {
+    // The reply may be sent later by another thread, so it owns the body.
+    // evhtp sends the body by reference instead of copying it.
+    std::unique_ptr<Reply> reply{new Reply};
+    reply->handle = handle_;
+    reply->status_code = status_code;
+    reply->mime_type = mime_type;
+    reply->body.reset(new std::string{std::move(data)});
+    if (!handle_->thread)
+      return SendReplyNow(std::move(reply));
+    evthr_defer(handle_->thread, &SendReplyOnThread, reply.release());
   }
 
  private:
-  EventPtr<evhtp_request_t> req_;
+  static int CopyHeader(evhtp_kv_t* header, void* arg) {
+    static_cast<std::vector<std::pair<std::string, std::string>>*>(arg)
+        ->emplace_back(header->key, header->val);
+    return 0;
+  }
+
+  static evhtp_res OnRequestFini(evhtp_request_t* req, void* arg) {
+    std::unique_ptr<std::shared_ptr<RequestHandle>> handle{
+        static_cast<std::shared_ptr<RequestHandle>*>(arg)};
+    (*handle)->req = nullptr;
+    return EVHTP_RES_OK;
+  }
+
+  static void SendReplyOnThread(evthr_t* thread, void* arg, void* shared) {
+    SendReplyNow(std::unique_ptr<Reply>{static_cast<Reply*>(arg)});
+  }
+
+  static void FreeBody(const void* data, size_t size, void* arg) {
+    delete static_cast<std::string*>(arg);
+  }
+
+  static void SendReplyNow(std::unique_ptr<Reply> reply) {
+    evhtp_request_t* req = reply->handle->req;
+    if (!req)
+      return;
+
+    EventPtr<evbuffer> buf{evbuffer_new()};
+    if (!reply->body->empty()) {
+      std::string* body = reply->body.release();
+      evbuffer_add_reference(buf.get(), body->data(), body->size(), &FreeBody,
+                             body);
+    }
+    evhtp_header_key_add(req->headers_out, "Content-Type", 0);
+    evhtp_header_val_add(req->headers_out, reply->mime_type.c_str(), 1);
+    evhtp_send_reply_start(req, reply->status_code);
+    evhtp_send_reply_body(req, buf.get());
+    evhtp_send_reply_end(req);
+  }
+
+  std::shared_ptr<RequestHandle> handle_;
+  std::string path_;
+  std::vector<std::pair<std::string, std::string>> headers_;
   std::string data_;
 };
 
-HttpServerImpl::HttpServerImpl(EventTaskRunner* task_runner)
+HttpServerImpl::HttpServerImpl(EventTaskRunner* task_runner, int thread_count)
     : task_runner_{task_runner} {
+  weak_this_ = weak_ptr_factory_.GetWeakPtr();
+
   SSL_load_error_strings();
   SSL_library_init();
+#if OPENSSL_VERSION_NUMBER < 0x10100000L
+  if (thread_count > 0)
+    evhtp_ssl_use_threads();
+#endif
 
   std::unique_ptr<SSL_CTX, decltype(&SSL_CTX_free)> ctx{
       SSL_CTX_new(TLSv1_2_server_method()), &SSL_CTX_free};
@@ -93,11 +197,23 @@ HttpServerImpl::HttpServerImpl(EventTaskRunner* task_runner)
 
   CHECK_EQ(1, SSL_CTX_check_private_key(ctx.get())) << GetSslError();
 
+  SetupSessionResumption(ctx.get());
+
   httpd_.reset(evhtp_new(task_runner_->GetEventBase(), nullptr));
   CHECK(httpd_);
   httpsd_.reset(evhtp_new(task_runner_->GetEventBase(), nullptr));
   CHECK(httpsd_);
 
+  for (evhtp_t* htp : {httpd_.get(), httpsd_.get()}) {
+    evhtp_set_timeouts(htp, &kConnectionTimeout, &kConnectionTimeout);
+    evhtp_set_max_keepalive_requests(htp, kMaxKeepAliveRequests);
+    // TLS handshakes and HTTP parsing run on the workers, only handlers run
+    // on the main loop.
+    if (thread_count > 0) {
+      CHECK_EQ(0, evhtp_use_threads(htp, nullptr, thread_count, nullptr));
+    }
+  }
+
   httpsd_.get()->ssl_ctx = ctx.release();
 
   CHECK_EQ(0, evhtp_bind_socket(httpd_.get(), "0.0.0.0", GetHttpPort(), -1));
@@ -130,22 +246,104 @@ void HttpServerImpl::GenerateX509(X509* x509, EVP_PKEY* pkey) {
   CHECK_EQ(len, cert_fingerprint_.size());
 }
 
-void HttpServerImpl::NotFound(evhtp_request_t* req) {
-  EventPtr<evbuffer> buf{evbuffer_new()};
-  evbuffer_add_printf(buf.get(), "404 Not Found: %s\n", req->uri->path->full);
-  evhtp_send_reply_start(req, 404);
-  evhtp_send_reply_body(req, buf.get());
-  evhtp_send_reply_end(req);
+void HttpServerImpl::SetupSessionResumption(SSL_CTX* ctx) {
+  // Session ID based resumption for clients without ticket support.
+  SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_SERVER);
+  SSL_CTX_sess_set_cache_size(ctx, kSessionCacheSize);
+  SSL_CTX_set_timeout(ctx, kTicketKeyRotationPeriodSeconds * kMaxTicketKeys);
+  CHECK_EQ(1, SSL_CTX_set_session_id_context(ctx, kSessionIdContext,
+                                              sizeof(kSessionIdContext) - 1))
+      << GetSslError();
+
+  // Stateless resumption with session tickets encrypted by rotating keys.
+  SSL_CTX_set_app_data(ctx, this);
+  RotateTicketKeys();
+  CHECK_EQ(1, SSL_CTX_set_tlsext_ticket_key_cb(ctx, &TicketKeyCallback))
+      << GetSslError();
+}
+
+void HttpServerImpl::RotateTicketKeys() {
+  TicketKey key;
+  CHECK_EQ(1, RAND_bytes(reinterpret_cast<uint8_t*>(&key), sizeof(key)))
+      << GetSslError();
+  {
+    std::lock_guard<std::mutex> lock{ticket_keys_mutex_};
+    ticket_keys_.push_front(key);
+    if (ticket_keys_.size() > kMaxTicketKeys)
+      ticket_keys_.pop_back();
+  }
+
+  task_runner_->PostDelayedTask(
+      FROM_HERE, base::Bind(&HttpServerImpl::RotateTicketKeys,
+                            weak_ptr_factory_.GetWeakPtr()),
+      base::TimeDelta::FromSeconds(kTicketKeyRotationPeriodSeconds));
+}
+
+int HttpServerImpl::TicketKeyCallback(SSL* ssl,
+                                      uint8_t* key_name,
+                                      uint8_t* iv,
+                                      EVP_CIPHER_CTX* cipher_ctx,
+                                      HMAC_CTX* hmac_ctx,
+                                      int encrypt) {
+  HttpServerImpl* server =
+      static_cast<HttpServerImpl*>(SSL_CTX_get_app_data(SSL_get_SSL_CTX(ssl)));
+  return server->ProcessTicketKey(key_name, iv, cipher_ctx, hmac_ctx, encrypt);
+}
+
+int HttpServerImpl::ProcessTicketKey(uint8_t* key_name,
+                                     uint8_t* iv,
+                                     EVP_CIPHER_CTX* cipher_ctx,
+                                     HMAC_CTX* hmac_ctx,
+                                     int encrypt) {
+  // Called by handshakes on worker threads.
+  std::lock_guard<std::mutex> lock{ticket_keys_mutex_};
+  if (encrypt) {
+    const TicketKey& key = ticket_keys_.front();
+    if (RAND_bytes(iv, EVP_CIPHER_iv_length(EVP_aes_128_cbc())) != 1)
+      return -1;
+    memcpy(key_name, key.name, sizeof(key.name));
+    if (EVP_EncryptInit_ex(cipher_ctx, EVP_aes_128_cbc(), nullptr, key.aes_key,
+                           iv) != 1 ||
+        HMAC_Init_ex(hmac_ctx, key.hmac_key, sizeof(key.hmac_key),
+                     EVP_sha256(), nullptr) != 1) {
+      return -1;
+    }
+    return 1;
+  }
+
+  for (const auto& key : ticket_keys_) {
+    if (memcmp(key_name, key.name, sizeof(key.name)) != 0)
+      continue;
+    if (HMAC_Init_ex(hmac_ctx, key.hmac_key, sizeof(key.hmac_key),
+                     EVP_sha256(), nullptr) != 1 ||
+        EVP_DecryptInit_ex(cipher_ctx, EVP_aes_128_cbc(), nullptr, key.aes_key,
+                           iv) != 1) {
+      return -1;
+    }
+    // Resume, but ask OpenSSL to issue a new ticket if the key is retired.
+    return &key == &ticket_keys_.front() ? 1 : 2;
+  }
+
+  // Unknown or expired key, fall back to a full handshake.
+  return 0;
 }
 
 void HttpServerImpl::ProcessRequest(evhtp_request_t* req) {
-  std::unique_ptr<RequestImpl> request{new RequestImpl{EventPtr<evhtp_request_t>{req}}};
+  std::unique_ptr<RequestImpl> request{new RequestImpl{req}};
+  if (!evhtp_request_get_connection(req)->thread)
+    return DispatchRequest(std::move(request));
+  task_runner_->PostDelayedTaskFromAnyThread(
+      FROM_HERE, base::Bind(&HttpServerImpl::DispatchRequest, weak_this_,
+                            base::Passed(&request)),
+      {});
+}
+
+void HttpServerImpl::DispatchRequest(std::unique_ptr<RequestImpl> request) {
   std::string path = request->GetPath();
   auto it = handlers_.find(path);
-  if (it != handlers_.end()) {
+  if (it != handlers_.end())
     return it->second.Run(std::move(request));
-  }
-  NotFound(req);
+  request->SendReply(404, "404 Not Found: " + path + "\n", "text/plain");
 }
 
 void HttpServerImpl::ProcessRequestCallback(evhtp_request_t* req, void* arg) {
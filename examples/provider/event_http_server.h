@@ -8,7 +8,10 @@
 #include <evhtp.h>
 #include <openssl/ssl.h>
 
+#include <deque>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -23,11 +26,14 @@ namespace examples {
 class EventTaskRunner;
 
 // HTTP/HTTPS server implemented with libevhtp.
+// With |thread_count| > 0 connections are served by that many evhtp worker
+// threads, and only complete requests are passed to handlers on the thread
+// of |task_runner|. Replies are sent back by the worker of the connection.
 class HttpServerImpl : public provider::HttpServer {
  public:
   class RequestImpl;
 
-  explicit HttpServerImpl(EventTaskRunner* task_runner);
+  explicit HttpServerImpl(EventTaskRunner* task_runner, int thread_count = 0);
 
   void AddHttpRequestHandler(const std::string& path_prefix,
                              const RequestHandlerCallback& callback) override;
@@ -39,14 +45,38 @@ class HttpServerImpl : public provider::HttpServer {
   std::vector<uint8_t> GetHttpsCertificateFingerprint() const override;
 
  private:
+  struct RequestHandle;
+  struct Reply;
+
+  // Key used to encrypt and authenticate TLS session tickets.
+  struct TicketKey {
+    uint8_t name[16];
+    uint8_t aes_key[16];
+    uint8_t hmac_key[16];
+  };
+
   void GenerateX509(X509* x509, EVP_PKEY* pkey);
+  void SetupSessionResumption(SSL_CTX* ctx);
+  void RotateTicketKeys();
+  static int TicketKeyCallback(SSL* ssl,
+                               uint8_t* key_name,
+                               uint8_t* iv,
+                               EVP_CIPHER_CTX* cipher_ctx,
+                               HMAC_CTX* hmac_ctx,
+                               int encrypt);
+  int ProcessTicketKey(uint8_t* key_name,
+                       uint8_t* iv,
+                       EVP_CIPHER_CTX* cipher_ctx,
+                       HMAC_CTX* hmac_ctx,
+                       int encrypt);
   static void ProcessRequestCallback(evhtp_request_t* req, void* arg);
+  // Called on the thread which owns the connection.
   void ProcessRequest(evhtp_request_t* req);
+  void DispatchRequest(std::unique_ptr<RequestImpl> request);
   void ProcessReply(std::shared_ptr<RequestImpl> request,
                     int status_code,
                     const std::string& data,
                     const std::string& mime_type);
-  void NotFound(evhtp_request_t* req);
 
   std::map<std::string, RequestHandlerCallback> handlers_;
 
@@ -55,6 +85,14 @@ class HttpServerImpl : public provider::HttpServer {
   EventPtr<evhtp_t> httpd_;
   EventPtr<evhtp_t> httpsd_;
 
+  // Front key encrypts new tickets, the rest are only used to decrypt tickets
+  // issued before the last rotation. Guarded by |ticket_keys_mutex_|, as
+  // handshakes run on worker threads.
+  std::mutex ticket_keys_mutex_;
+  std::deque<TicketKey> ticket_keys_;
+
+  // Bound by worker threads, dereferenced on the main loop only.
+  base::WeakPtr<HttpServerImpl> weak_this_;
   base::WeakPtrFactory<HttpServerImpl> weak_ptr_factory_{this};
 };
 
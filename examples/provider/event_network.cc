@@ -20,6 +20,7 @@ namespace {
 const char kNetworkProbeHostname[] = "talk.google.com";
 const int kNetworkProbePort = 5223;
 const int kNetworkProbeTimeoutS = 2;
+const int kSslConnectTimeoutS = 30;
 }  // namespace
 
 void EventNetworkImpl::Deleter::operator()(evdns_base* dns_base) {
@@ -110,7 +111,9 @@ weave::provider::Network::State EventNetworkImpl::GetConnectionState() const {
 void EventNetworkImpl::OpenSslSocket(const std::string& host,
                                      uint16_t port,
                                      const OpenSslSocketCallback& callback) {
-  SSLStream::Connect(task_runner_, host, port, callback);
+  SSLStream::Connect(task_runner_, &ssl_session_cache_, host, port,
+                     base::TimeDelta::FromSeconds(kSslConnectTimeoutS),
+                     callback);
 }
 
 }  // namespace examples
@@ -9,6 +9,8 @@
 
 #include <base/memory/weak_ptr.h>
 
+#include "examples/provider/ssl_stream.h"
+
 struct evdns_base;
 struct bufferevent;
 
@@ -47,6 +49,7 @@ class EventNetworkImpl : public weave::provider::Network {
   std::vector<ConnectionChangedCallback> callbacks_;
   provider::Network::State network_state_{provider::Network::State::kOffline};
   std::unique_ptr<bufferevent, Deleter> connectivity_probe_;
+  SSLSessionCache ssl_session_cache_;
 
   base::WeakPtrFactory<EventNetworkImpl> weak_ptr_factory_{this};
 };
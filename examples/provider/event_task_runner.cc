@@ -5,6 +5,15 @@
 #include "examples/provider/event_task_runner.h"
 
 #include <signal.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <memory>
+
+#include <base/bind.h>
+#include <base/logging.h>
+#include <base/posix/eintr_wrapper.h>
 
 namespace weave {
 namespace examples {
@@ -13,15 +22,95 @@ namespace {
 event_base* g_event_base = nullptr;
 }
 
+EventTaskRunner::EventTaskRunner() {
+  wake_up_fd_ = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  CHECK_GE(wake_up_fd_, 0);
+  AddIoCompletionTask(wake_up_fd_, kReadable,
+                      base::Bind(&EventTaskRunner::ProcessForeignTasks,
+                                 base::Unretained(this)));
+}
+
+EventTaskRunner::~EventTaskRunner() {
+  RemoveIoCompletionTask(wake_up_fd_);
+  close(wake_up_fd_);
+  ForeignTask* task = foreign_tasks_.exchange(nullptr);
+  while (task) {
+    ForeignTask* next = task->next;
+    delete task;
+    task = next;
+  }
+}
+
 void EventTaskRunner::PostDelayedTask(
     const tracked_objects::Location& from_here,
     const base::Closure& task,
     base::TimeDelta delay) {
-  base::Time new_time = base::Time::Now() + delay;
-  if (queue_.empty() || new_time < queue_.top().first.first) {
-    ReScheduleEvent(delay);
+  // Tasks without delay are due in the current tick and run on the next loop
+  // iteration. Others are rounded up, so they never run earlier than
+  // requested.
+  uint64_t deadline = GetNowTicks();
+  if (delay > base::TimeDelta()) {
+    base::TimeDelta since_origin = base::TimeTicks::Now() - origin_ + delay;
+    deadline = (since_origin.InMicroseconds() +
+                base::Time::kMicrosecondsPerMillisecond - 1) /
+               base::Time::kMicrosecondsPerMillisecond;
+  }
+  timers_.Insert(deadline, task);
+  ReScheduleEvent(deadline);
+}
+
+void EventTaskRunner::PostDelayedTaskFromAnyThread(
+    const tracked_objects::Location& from_here,
+    const base::Closure& task,
+    base::TimeDelta delay) {
+  ForeignTask* foreign_task{
+      new ForeignTask{base::TimeTicks::Now() + delay, task, nullptr}};
+  ForeignTask* head = foreign_tasks_.load(std::memory_order_relaxed);
+  do {
+    foreign_task->next = head;
+  } while (!foreign_tasks_.compare_exchange_weak(head, foreign_task,
+                                                 std::memory_order_release,
+                                                 std::memory_order_relaxed));
+  // Only the first task after the loop drained the stack needs a wake up.
+  if (!head) {
+    uint64_t value = 1;
+    ignore_result(HANDLE_EINTR(write(wake_up_fd_, &value, sizeof(value))));
+  }
+}
+
+bool EventTaskRunner::PostTaskFromAnyThread(
+    const tracked_objects::Location& from_here,
+    const base::Closure& task) {
+  PostDelayedTaskFromAnyThread(from_here, task, {});
+  return true;
+}
+
+void EventTaskRunner::ProcessForeignTasks(int fd,
+                                          int16_t what,
+                                          EventTaskRunner* sender) {
+  // Reset the counter before taking tasks, so a post after the exchange
+  // produces a new edge for the edge triggered event.
+  uint64_t value = 0;
+  ignore_result(HANDLE_EINTR(read(wake_up_fd_, &value, sizeof(value))));
+
+  ForeignTask* task =
+      foreign_tasks_.exchange(nullptr, std::memory_order_acquire);
+  // Reverse to get the order of posting.
+  ForeignTask* ordered = nullptr;
+  while (task) {
+    ForeignTask* next = task->next;
+    task->next = ordered;
+    ordered = task;
+    task = next;
+  }
+
+  const base::TimeTicks now = base::TimeTicks::Now();
+  while (ordered) {
+    std::unique_ptr<ForeignTask> current{ordered};
+    ordered = current->next;
+    PostDelayedTask(FROM_HERE, current->task,
+                    std::max(base::TimeDelta(), current->deadline - now));
   }
-  queue_.emplace(std::make_pair(new_time, ++counter_), task);
 }
 
 void EventTaskRunner::AddIoCompletionTask(
@@ -61,9 +150,18 @@ void EventTaskRunner::Run() {
   g_event_base = nullptr;
 }
 
-void EventTaskRunner::ReScheduleEvent(base::TimeDelta delay) {
-  timespec ts = delay.ToTimeSpec();
-  timeval tv = {ts.tv_sec, ts.tv_nsec / 1000};
+uint64_t EventTaskRunner::GetNowTicks() const {
+  return (base::TimeTicks::Now() - origin_).InMilliseconds();
+}
+
+void EventTaskRunner::ReScheduleEvent(uint64_t deadline) {
+  if (deadline >= armed_deadline_)
+    return;
+  armed_deadline_ = deadline;
+  uint64_t now = GetNowTicks();
+  uint64_t delay_ms = deadline > now ? deadline - now : 0;
+  timeval tv = {static_cast<time_t>(delay_ms / 1000),
+                static_cast<suseconds_t>(delay_ms % 1000 * 1000)};
   event_add(task_event_.get(), &tv);
 }
 
@@ -79,16 +177,14 @@ void EventTaskRunner::FreeEvent(event* evnt) {
 }
 
 void EventTaskRunner::Process() {
-  while (!queue_.empty() && queue_.top().first.first <= base::Time::Now()) {
-    auto cb = queue_.top().second;
-    queue_.pop();
-    cb.Run();
-  }
-  if (!queue_.empty()) {
-    base::TimeDelta delta = std::max(
-        base::TimeDelta(), queue_.top().first.first - base::Time::Now());
-    ReScheduleEvent(delta);
-  }
+  armed_deadline_ = TimerWheel::kNoDeadline;
+  std::vector<base::Closure> expired;
+  timers_.Advance(GetNowTicks(), &expired);
+  // Tasks posted from here are not run before the next loop iteration, so I/O
+  // events are not starved by chains of immediate tasks.
+  for (const auto& task : expired)
+    task.Run();
+  ReScheduleEvent(timers_.GetNextWakeUp());
 }
 
 void EventTaskRunner::FdEventHandler(int fd, int16_t what, void* runner) {
@@ -5,7 +5,8 @@
 #ifndef LIBWEAVE_EXAMPLES_PROVIDER_EVENT_TASK_RUNNER_H_
 #define LIBWEAVE_EXAMPLES_PROVIDER_EVENT_TASK_RUNNER_H_
 
-#include <queue>
+#include <atomic>
+#include <map>
 #include <utility>
 #include <vector>
 
@@ -13,17 +14,34 @@
 #include <weave/provider/task_runner.h>
 
 #include "examples/provider/event_deleter.h"
+#include "examples/provider/timer_wheel.h"
 
 namespace weave {
 namespace examples {
 
-// Simple task runner implemented with libevent message loop.
+// Simple task runner implemented with libevent message loop. Delayed tasks
+// are kept in a timer wheel with deadlines on the monotonic clock, so wall
+// clock adjustments don't affect them.
 class EventTaskRunner : public provider::TaskRunner {
  public:
+  EventTaskRunner();
+  ~EventTaskRunner() override;
+
   void PostDelayedTask(const tracked_objects::Location& from_here,
                        const base::Closure& task,
                        base::TimeDelta delay) override;
 
+  // Same as PostDelayedTask, but can be called from any thread, e.g. by a
+  // sensor sampling thread. The task still runs on the thread which calls
+  // Run(). Tasks are passed through a lock-free queue, and the loop is woken
+  // up with eventfd.
+  void PostDelayedTaskFromAnyThread(const tracked_objects::Location& from_here,
+                                    const base::Closure& task,
+                                    base::TimeDelta delay);
+
+  bool PostTaskFromAnyThread(const tracked_objects::Location& from_here,
+                             const base::Closure& task) override;
+
   // Defines the types of I/O completion events that the
   // application can register to receive on a file descriptor.
   enum IOEvent : int16_t {
@@ -63,7 +81,10 @@ class EventTaskRunner : public provider::TaskRunner {
   void Run();
 
  private:
-  void ReScheduleEvent(base::TimeDelta delay);
+  // Returns current time in ticks of |timers_|.
+  uint64_t GetNowTicks() const;
+  // Arms |task_event_| for |deadline| if it's earlier than already armed.
+  void ReScheduleEvent(uint64_t deadline);
   static void EventHandler(int, int16_t, void* runner);
   static void FreeEvent(event* evnt);
   void Process();
@@ -71,20 +92,16 @@ class EventTaskRunner : public provider::TaskRunner {
   static void FdEventHandler(int fd, int16_t what, void* runner);
   void ProcessFd(int fd, int16_t what);
 
-  using QueueItem = std::pair<std::pair<base::Time, size_t>, base::Closure>;
-
-  struct Greater {
-    bool operator()(const QueueItem& a, const QueueItem& b) const {
-      return a.first > b.first;
-    }
+  struct ForeignTask {
+    base::TimeTicks deadline;
+    base::Closure task;
+    ForeignTask* next;
   };
+  void ProcessForeignTasks(int fd, int16_t what, EventTaskRunner* sender);
 
-  size_t counter_{0};  // Keeps order of tasks with the same time.
-
-  std::priority_queue<QueueItem,
-                      std::vector<QueueItem>,
-                      EventTaskRunner::Greater>
-      queue_;
+  const base::TimeTicks origin_{base::TimeTicks::Now()};
+  TimerWheel timers_;
+  uint64_t armed_deadline_{TimerWheel::kNoDeadline};
 
   EventPtr<event_base> base_{event_base_new()};
 
@@ -92,6 +109,10 @@ class EventTaskRunner : public provider::TaskRunner {
       event_new(base_.get(), -1, EV_TIMEOUT, &EventHandler, this)};
 
   std::map<int, std::pair<EventPtr<event>, IoCompletionCallback>> fd_task_map_;
+
+  // Stack of tasks posted from other threads, the newest first.
+  std::atomic<ForeignTask*> foreign_tasks_{nullptr};
+  int wake_up_fd_{-1};
 };
 
 }  // namespace examples
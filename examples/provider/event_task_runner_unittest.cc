@@ -0,0 +1,124 @@
+// Copyright 2016 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "examples/provider/event_task_runner.h"
+
+#include <thread>
+
+#include <base/bind.h>
+#include <gtest/gtest.h>
+
+#include "src/bind_lambda.h"
+
+namespace weave {
+namespace examples {
+
+namespace {
+
+void Quit(EventTaskRunner* runner) {
+  event_base_loopexit(runner->GetEventBase(), nullptr);
+}
+
+}  // namespace
+
+class EventTaskRunnerTest : public testing::Test {
+ protected:
+  // Posts a task which reposts itself without delay |hops| times, then stops
+  // the loop.
+  void PostChain(int hops) {
+    if (!hops)
+      return Quit(&runner_);
+    runner_.PostDelayedTask(FROM_HERE,
+                            base::Bind(&EventTaskRunnerTest::PostChain,
+                                       base::Unretained(this), hops - 1),
+                            {});
+  }
+
+  EventTaskRunner runner_;
+};
+
+TEST_F(EventTaskRunnerTest, ZeroDelayIsNotRoundedUp) {
+  // Rounding up would make every hop wait for the next millisecond tick.
+  const int kHops = 100;
+  base::TimeTicks start = base::TimeTicks::Now();
+  PostChain(kHops);
+  runner_.Run();
+  EXPECT_LT(base::TimeTicks::Now() - start,
+            base::TimeDelta::FromMilliseconds(kHops / 4));
+}
+
+TEST_F(EventTaskRunnerTest, DelayIsRespected) {
+  const base::TimeDelta kDelay = base::TimeDelta::FromMilliseconds(20);
+  base::TimeTicks start = base::TimeTicks::Now();
+  base::TimeTicks run_time;
+  runner_.PostDelayedTask(FROM_HERE, base::Bind([this, &run_time]() {
+                            run_time = base::TimeTicks::Now();
+                            Quit(&runner_);
+                          }),
+                          kDelay);
+  runner_.Run();
+  EXPECT_GE(run_time - start, kDelay);
+}
+
+TEST_F(EventTaskRunnerTest, Order) {
+  std::vector<int> order;
+  auto record = [&order](int i) { order.push_back(i); };
+  runner_.PostDelayedTask(FROM_HERE, base::Bind(record, 3),
+                          base::TimeDelta::FromMilliseconds(5));
+  runner_.PostDelayedTask(FROM_HERE, base::Bind(record, 1), {});
+  runner_.PostDelayedTask(FROM_HERE, base::Bind(record, 2), {});
+  runner_.PostDelayedTask(FROM_HERE, base::Bind(&Quit, &runner_),
+                          base::TimeDelta::FromMilliseconds(10));
+  runner_.Run();
+  EXPECT_EQ((std::vector<int>{1, 2, 3}), order);
+}
+
+TEST_F(EventTaskRunnerTest, PostFromManyThreads) {
+  const int kThreads = 8;
+  const int kTasksPerThread = 10000;
+  // Touched only on the loop thread, so tasks need no synchronization.
+  std::vector<int> last_task(kThreads, -1);
+  int count = 0;
+  auto task = [this, &last_task, &count](int thread, int i) {
+    // Tasks from one thread run in order of posting.
+    EXPECT_EQ(last_task[thread] + 1, i);
+    last_task[thread] = i;
+    if (++count == kThreads * kTasksPerThread)
+      Quit(&runner_);
+  };
+
+  std::vector<std::thread> threads;
+  for (int thread = 0; thread < kThreads; ++thread) {
+    threads.emplace_back([this, task, thread]() {
+      for (int i = 0; i < kTasksPerThread; ++i) {
+        runner_.PostDelayedTaskFromAnyThread(
+            FROM_HERE, base::Bind(task, thread, i), {});
+      }
+    });
+  }
+  runner_.Run();
+  for (auto& thread : threads)
+    thread.join();
+  EXPECT_EQ(kThreads * kTasksPerThread, count);
+}
+
+TEST_F(EventTaskRunnerTest, PostDelayedFromOtherThread) {
+  const base::TimeDelta kDelay = base::TimeDelta::FromMilliseconds(20);
+  base::TimeTicks start = base::TimeTicks::Now();
+  base::TimeTicks run_time;
+  std::thread thread{[this, &run_time, kDelay]() {
+    runner_.PostDelayedTaskFromAnyThread(FROM_HERE,
+                                         base::Bind([this, &run_time]() {
+                                           run_time = base::TimeTicks::Now();
+                                           Quit(&runner_);
+                                         }),
+                                         kDelay);
+  }};
+  runner_.Run();
+  thread.join();
+  EXPECT_GE(run_time - start, kDelay);
+}
+
+}  // namespace examples
+}  // namespace weave
@@ -4,28 +4,218 @@
 
 #include "examples/provider/file_config_store.h"
 
+#include <dirent.h>
+#include <fcntl.h>
 #include <sys/stat.h>
 #include <sys/utsname.h>
+#include <unistd.h>
 
+#include <cstring>
 #include <fstream>
 #include <map>
 #include <string>
 #include <vector>
 
 #include <base/bind.h>
+#include <base/posix/eintr_wrapper.h>
 
 namespace weave {
 namespace examples {
 
 const char kSettingsDir[] = "/var/lib/weave/";
 
+namespace {
+
+void AddFileError(ErrorPtr* error,
+                  const tracked_objects::Location& location,
+                  const std::string& path) {
+  Error::AddToPrintf(error, location, "file_error", "%s: %s", path.c_str(),
+                     strerror(errno));
+}
+
+// Writes |data| into temporary file and renames it over |path|, so readers
+// see either old or new content even if the device loses power.
+bool WriteFileAtomically(const std::string& dir,
+                         const std::string& path,
+                         const std::string& data,
+                         ErrorPtr* error) {
+  std::string tmp_path = path + ".tmp";
+  int fd = HANDLE_EINTR(open(tmp_path.c_str(),
+                             O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+                             S_IRUSR | S_IWUSR));
+  if (fd < 0) {
+    AddFileError(error, FROM_HERE, tmp_path);
+    return false;
+  }
+
+  for (size_t written = 0; written < data.size();) {
+    ssize_t res =
+        HANDLE_EINTR(write(fd, data.data() + written, data.size() - written));
+    if (res < 0) {
+      AddFileError(error, FROM_HERE, tmp_path);
+      close(fd);
+      unlink(tmp_path.c_str());
+      return false;
+    }
+    written += res;
+  }
+
+  if (fsync(fd) != 0) {
+    AddFileError(error, FROM_HERE, tmp_path);
+    close(fd);
+    unlink(tmp_path.c_str());
+    return false;
+  }
+  close(fd);
+
+  if (rename(tmp_path.c_str(), path.c_str()) != 0) {
+    AddFileError(error, FROM_HERE, path);
+    unlink(tmp_path.c_str());
+    return false;
+  }
+
+  // Make the rename itself durable.
+  int dir_fd = HANDLE_EINTR(open(dir.c_str(), O_RDONLY | O_DIRECTORY));
+  if (dir_fd >= 0) {
+    fsync(dir_fd);
+    close(dir_fd);
+  }
+  return true;
+}
+
+}  // namespace
+
+FileConfigStore::FileConfigStore(const std::string& model_id,
+                                 EventTaskRunner* task_runner)
+    : FileConfigStore{model_id, task_runner, kSettingsDir} {}
+
 FileConfigStore::FileConfigStore(const std::string& model_id,
-                                 provider::TaskRunner* task_runner)
+                                 EventTaskRunner* task_runner,
+                                 const std::string& settings_dir)
     : model_id_{model_id},
-      task_runner_{task_runner} {}
+      task_runner_{task_runner},
+      settings_dir_{settings_dir.empty() || settings_dir.back() == '/'
+                        ? settings_dir
+                        : settings_dir + "/"} {
+  ReadAhead();
+
+  CHECK_EQ(0, pipe2(wake_up_fds_, O_CLOEXEC | O_NONBLOCK));
+  task_runner_->AddIoCompletionTask(
+      wake_up_fds_[0], EventTaskRunner::kReadable,
+      base::Bind(&FileConfigStore::OnWriteDone,
+                 weak_ptr_factory_.GetWeakPtr()));
+  io_thread_ = std::thread{&FileConfigStore::IoThreadMain, this};
+}
+
+FileConfigStore::~FileConfigStore() {
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    stop_ = true;
+  }
+  queue_changed_.notify_one();
+  // Thread finishes queued writes before exit.
+  io_thread_.join();
+
+  task_runner_->RemoveIoCompletionTask(wake_up_fds_[0]);
+  close(wake_up_fds_[0]);
+  close(wake_up_fds_[1]);
+}
+
+void FileConfigStore::SetWriteDelayForTests(base::TimeDelta delay) {
+  std::lock_guard<std::mutex> lock{mutex_};
+  write_delay_ = delay;
+}
+
+void FileConfigStore::ReadAhead() {
+  const std::string prefix = "weave_settings_" + model_id_;
+  const std::string suffix = ".json";
+
+  std::unique_ptr<DIR, int (*)(DIR*)> dir{opendir(settings_dir_.c_str()),
+                                          &closedir};
+  if (!dir)
+    return;
+  while (dirent* entry = readdir(dir.get())) {
+    std::string file_name = entry->d_name;
+    if (file_name.size() < prefix.size() + suffix.size() ||
+        file_name.compare(0, prefix.size(), prefix) != 0 ||
+        file_name.compare(file_name.size() - suffix.size(), suffix.size(),
+                          suffix) != 0) {
+      continue;
+    }
+    std::string name = file_name.substr(
+        prefix.size(), file_name.size() - prefix.size() - suffix.size());
+    if (!name.empty()) {
+      if (name[0] != '_')
+        continue;  // Settings of another model with the same prefix.
+      name = name.substr(1);
+    }
+    LOG(INFO) << "Loading settings from " << GetPath(name);
+    std::ifstream str(GetPath(name));
+    settings_[name].assign(std::istreambuf_iterator<char>(str),
+                           std::istreambuf_iterator<char>());
+  }
+}
+
+void FileConfigStore::IoThreadMain() {
+  for (;;) {
+    WriteRequest request;
+    base::TimeDelta delay;
+    {
+      std::unique_lock<std::mutex> lock{mutex_};
+      queue_changed_.wait(lock,
+                          [this] { return stop_ || !write_queue_.empty(); });
+      if (write_queue_.empty())
+        return;  // Stopped and nothing left to write.
+      request = std::move(write_queue_.front());
+      write_queue_.pop_front();
+      delay = write_delay_;
+    }
+    if (delay > base::TimeDelta())
+      usleep(delay.InMicroseconds());
+
+    ErrorPtr error;
+    if (mkdir(settings_dir_.c_str(), S_IRWXU) != 0 && errno != EEXIST) {
+      AddFileError(&error, FROM_HERE, settings_dir_);
+    } else {
+      WriteFileAtomically(settings_dir_, request.path, request.data, &error);
+    }
+    if (error)
+      LOG(ERROR) << "Failed to save settings: " << error->GetMessage();
+
+    {
+      std::lock_guard<std::mutex> lock{mutex_};
+      write_results_.push_back(std::move(error));
+    }
+    char byte = 0;
+    ignore_result(HANDLE_EINTR(write(wake_up_fds_[1], &byte, 1)));
+  }
+}
+
+void FileConfigStore::OnWriteDone(int fd, int16_t what,
+                                  EventTaskRunner* sender) {
+  char buffer[64];
+  while (HANDLE_EINTR(read(fd, buffer, sizeof(buffer))) > 0) {
+  }
+
+  std::deque<ErrorPtr> results;
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    results.swap(write_results_);
+  }
+
+  for (auto& error : results) {
+    CHECK(!pending_callbacks_.empty());
+    DoneCallback callback = pending_callbacks_.front();
+    pending_callbacks_.pop_front();
+    if (!callback.is_null()) {
+      task_runner_->PostDelayedTask(
+          FROM_HERE, base::Bind(callback, base::Passed(&error)), {});
+    }
+  }
+}
 
 std::string FileConfigStore::GetPath(const std::string& name) const {
-  std::string path{kSettingsDir};
+  std::string path{settings_dir_};
   path += "weave_settings_" + model_id_;
   if (!name.empty())
     path += "_" + name;
@@ -67,21 +257,21 @@ std::string FileConfigStore::LoadSettings() {
 }
 
 std::string FileConfigStore::LoadSettings(const std::string& name) {
-  LOG(INFO) << "Loading settings from " << GetPath(name);
-  std::ifstream str(GetPath(name));
-  return std::string(std::istreambuf_iterator<char>(str),
-                     std::istreambuf_iterator<char>());
+  auto it = settings_.find(name);
+  return it != settings_.end() ? it->second : std::string{};
 }
 
 void FileConfigStore::SaveSettings(const std::string& name,
                                    const std::string& settings,
                                    const DoneCallback& callback) {
-  CHECK(mkdir(kSettingsDir, S_IRWXU) == 0 || errno == EEXIST);
   LOG(INFO) << "Saving settings to " << GetPath(name);
-  std::ofstream str(GetPath(name));
-  str << settings;
-  if (!callback.is_null())
-    task_runner_->PostDelayedTask(FROM_HERE, base::Bind(callback, nullptr), {});
+  settings_[name] = settings;
+  pending_callbacks_.push_back(callback);
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    write_queue_.push_back({GetPath(name), settings});
+  }
+  queue_changed_.notify_one();
 }
 
 }  // namespace examples
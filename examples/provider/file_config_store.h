@@ -5,20 +5,37 @@
 #ifndef LIBWEAVE_EXAMPLES_PROVIDER_FILE_CONFIG_STORE_H_
 #define LIBWEAVE_EXAMPLES_PROVIDER_FILE_CONFIG_STORE_H_
 
+#include <condition_variable>
+#include <deque>
 #include <map>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <vector>
 
+#include <base/memory/weak_ptr.h>
 #include <weave/provider/config_store.h>
-#include <weave/provider/task_runner.h>
+
+#include "examples/provider/event_task_runner.h"
 
 namespace weave {
 namespace examples {
 
+// Keeps settings files in memory and writes them on a background thread, so
+// slow storage does not block the task runner. All settings files of the
+// model are read at construction. Completion callbacks are posted to
+// |task_runner| in the order of SaveSettings calls.
 class FileConfigStore : public provider::ConfigStore {
  public:
+  FileConfigStore(const std::string& model_id, EventTaskRunner* task_runner);
+  // Keeps files in |settings_dir| instead of /var/lib/weave/.
   FileConfigStore(const std::string& model_id,
-                  provider::TaskRunner* task_runner);
+                  EventTaskRunner* task_runner,
+                  const std::string& settings_dir);
+  ~FileConfigStore() override;
+
+  // Delays every write by |delay| to simulate slow storage.
+  void SetWriteDelayForTests(base::TimeDelta delay);
 
   bool LoadDefaults(Settings* settings) override;
   std::string LoadSettings(const std::string& name) override;
@@ -29,9 +46,40 @@ class FileConfigStore : public provider::ConfigStore {
   std::string LoadSettings() override;
 
  private:
+  struct WriteRequest {
+    std::string path;
+    std::string data;
+  };
+
   std::string GetPath(const std::string& name) const;
+  void ReadAhead();
+  void IoThreadMain();
+  void OnWriteDone(int fd, int16_t what, EventTaskRunner* sender);
+
   const std::string model_id_;
-  provider::TaskRunner* task_runner_{nullptr};
+  EventTaskRunner* task_runner_{nullptr};
+  // Ends with '/'.
+  const std::string settings_dir_;
+
+  // Settings by name, including not yet written ones.
+  std::map<std::string, std::string> settings_;
+  // Callbacks of requests still owned by the I/O thread, in request order.
+  std::deque<DoneCallback> pending_callbacks_;
+
+  // I/O thread signals completed writes through this pipe.
+  int wake_up_fds_[2]{-1, -1};
+
+  // Guarded by |mutex_|.
+  std::mutex mutex_;
+  std::condition_variable queue_changed_;
+  std::deque<WriteRequest> write_queue_;
+  std::deque<ErrorPtr> write_results_;
+  bool stop_{false};
+  base::TimeDelta write_delay_;
+
+  std::thread io_thread_;
+
+  base::WeakPtrFactory<FileConfigStore> weak_ptr_factory_{this};
 };
 
 }  // namespace examples
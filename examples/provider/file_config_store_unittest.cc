@@ -0,0 +1,139 @@
+// Copyright 2016 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "examples/provider/file_config_store.h"
+
+#include <dirent.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <base/bind.h>
+#include <gtest/gtest.h>
+
+#include "src/bind_lambda.h"
+
+namespace weave {
+namespace examples {
+
+class FileConfigStoreTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    char dir[] = "/tmp/file_config_store_unittest.XXXXXX";
+    ASSERT_TRUE(mkdtemp(dir));
+    dir_ = dir;
+  }
+
+  void TearDown() override {
+    // The store writes settings files right into the directory.
+    DIR* dir = opendir(dir_.c_str());
+    ASSERT_NE(nullptr, dir);
+    while (const dirent* entry = readdir(dir)) {
+      std::string name = entry->d_name;
+      if (name != "." && name != "..") {
+        EXPECT_EQ(0, unlink((dir_ + "/" + name).c_str())) << name;
+      }
+    }
+    closedir(dir);
+    EXPECT_EQ(0, rmdir(dir_.c_str()));
+  }
+
+  void Quit() { event_base_loopexit(task_runner_.GetEventBase(), nullptr); }
+
+  // Measures how late ticks posted every millisecond run, until |done|.
+  void Tick(base::TimeTicks expected, const bool* done) {
+    max_tick_delay_ =
+        std::max(max_tick_delay_, base::TimeTicks::Now() - expected);
+    if (*done)
+      return Quit();
+    const base::TimeDelta kInterval = base::TimeDelta::FromMilliseconds(1);
+    task_runner_.PostDelayedTask(
+        FROM_HERE, base::Bind(&FileConfigStoreTest::Tick,
+                              base::Unretained(this),
+                              base::TimeTicks::Now() + kInterval, done),
+        kInterval);
+  }
+
+  EventTaskRunner task_runner_;
+  std::string dir_;
+  base::TimeDelta max_tick_delay_;
+};
+
+TEST_F(FileConfigStoreTest, SaveAndLoad) {
+  {
+    FileConfigStore store{"model", &task_runner_, dir_};
+    EXPECT_EQ("", store.LoadSettings());
+    store.SaveSettings("", "settings", {});
+    store.SaveSettings("snapshot", "snapshot1", {});
+    store.SaveSettings("snapshot", "snapshot2", {});
+    // Served from memory before writes finish.
+    EXPECT_EQ("snapshot2", store.LoadSettings("snapshot"));
+  }
+
+  FileConfigStore store{"model", &task_runner_, dir_};
+  EXPECT_EQ("settings", store.LoadSettings());
+  EXPECT_EQ("snapshot2", store.LoadSettings("snapshot"));
+  FileConfigStore other_model{"model2", &task_runner_, dir_};
+  EXPECT_EQ("", other_model.LoadSettings());
+}
+
+// Benchmark of the event loop latency during writes to slow storage.
+TEST_F(FileConfigStoreTest, SlowStorageDoesNotBlockLoop) {
+  const int kSaves = 5;
+  const base::TimeDelta kWriteDelay = base::TimeDelta::FromMilliseconds(50);
+  FileConfigStore store{"model", &task_runner_, dir_};
+  store.SetWriteDelayForTests(kWriteDelay);
+
+  std::vector<int> done_order;
+  base::TimeDelta save_time;
+  bool done = false;
+  base::TimeTicks start = base::TimeTicks::Now();
+  for (int i = 0; i < kSaves; ++i) {
+    base::TimeTicks save_start = base::TimeTicks::Now();
+    store.SaveSettings(
+        "", std::to_string(i),
+        base::Bind([&done_order, &done, i, kSaves](ErrorPtr error) {
+          EXPECT_FALSE(error);
+          done_order.push_back(i);
+          done = (i == kSaves - 1);
+        }));
+    save_time += base::TimeTicks::Now() - save_start;
+  }
+  Tick(base::TimeTicks::Now(), &done);
+  task_runner_.Run();
+  base::TimeDelta total_time = base::TimeTicks::Now() - start;
+  base::TimeDelta background_tick_delay = max_tick_delay_;
+
+  // The same writes on the loop itself, as a store without the I/O thread
+  // would do them.
+  max_tick_delay_ = base::TimeDelta();
+  done = false;
+  for (int i = 0; i < kSaves; ++i) {
+    task_runner_.PostDelayedTask(
+        FROM_HERE, base::Bind([&done, i, kSaves, kWriteDelay]() {
+          usleep(kWriteDelay.InMicroseconds());
+          done = (i == kSaves - 1);
+        }),
+        {});
+  }
+  Tick(base::TimeTicks::Now(), &done);
+  task_runner_.Run();
+  base::TimeDelta blocking_tick_delay = max_tick_delay_;
+
+  LOG(WARNING) << kSaves << " saves with " << kWriteDelay.InMilliseconds()
+               << " ms storage delay: total " << total_time.InMilliseconds()
+               << " ms, SaveSettings " << save_time.InMicroseconds()
+               << " us, max loop delay "
+               << background_tick_delay.InMicroseconds() << " us, or "
+               << blocking_tick_delay.InMicroseconds()
+               << " us when writing on the loop";
+  EXPECT_EQ((std::vector<int>{0, 1, 2, 3, 4}), done_order);
+  EXPECT_GE(total_time, kWriteDelay * kSaves);
+  // Saves which wrote before returning would take all of the write delays.
+  EXPECT_LT(save_time, kWriteDelay * kSaves);
+  EXPECT_LT(background_tick_delay, blocking_tick_delay);
+  EXPECT_EQ(std::to_string(kSaves - 1), store.LoadSettings());
+}
+
+}  // namespace examples
+}  // namespace weave
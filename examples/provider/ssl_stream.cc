@@ -4,17 +4,24 @@
 
 #include "examples/provider/ssl_stream.h"
 
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
 #include <openssl/err.h>
 
 #include <base/bind.h>
 #include <base/bind_helpers.h>
-#include <weave/provider/task_runner.h>
 
 namespace weave {
 namespace examples {
 
 namespace {
 
+// Largest plaintext of a single TLS record, so one lent buffer never needs
+// more than one record to be decrypted.
+const size_t kMaxTlsRecordSize = 16 * 1024;
+
 void AddSslError(ErrorPtr* error,
                  const tracked_objects::Location& location,
                  const std::string& error_code,
@@ -26,33 +33,94 @@ void AddSslError(ErrorPtr* error,
                      ERR_reason_error_string(ssl_error_code));
 }
 
-void RetryAsyncTask(provider::TaskRunner* task_runner,
-                    const tracked_objects::Location& location,
-                    const base::Closure& task) {
-  task_runner->PostDelayedTask(FROM_HERE, task,
-                               base::TimeDelta::FromMilliseconds(100));
+void PostConnectTimeout(
+    EventTaskRunner* task_runner,
+    const provider::Network::OpenSslSocketCallback& callback) {
+  ErrorPtr error;
+  Error::AddTo(&error, FROM_HERE, "connect_timeout",
+               "Timeout while establishing TLS connection");
+  task_runner->PostDelayedTask(
+      FROM_HERE, base::Bind(callback, nullptr, base::Passed(&error)), {});
 }
 
 }  // namespace
 
-void SSLStream::SslDeleter::operator()(BIO* bio) const {
+void SslDeleter::operator()(BIO* bio) const {
   BIO_free(bio);
 }
 
-void SSLStream::SslDeleter::operator()(SSL* ssl) const {
+void SslDeleter::operator()(SSL* ssl) const {
   SSL_free(ssl);
 }
 
-void SSLStream::SslDeleter::operator()(SSL_CTX* ctx) const {
+void SslDeleter::operator()(SSL_CTX* ctx) const {
   SSL_CTX_free(ctx);
 }
 
-SSLStream::SSLStream(provider::TaskRunner* task_runner,
+void SslDeleter::operator()(SSL_SESSION* session) const {
+  SSL_SESSION_free(session);
+}
+
+SSLSessionCache::SSLSessionCache() {}
+
+SSLSessionCache::~SSLSessionCache() {}
+
+SSLSessionCache::Entry* SSLSessionCache::GetEntry(
+    const std::string& end_point) {
+  Entry& entry = entries_[end_point];
+  if (!entry.ctx) {
+    entry.ctx.reset(SSL_CTX_new(TLSv1_2_client_method()));
+    CHECK(entry.ctx);
+    // Sessions are stored here, not in internal cache of SSL_CTX.
+    SSL_CTX_set_session_cache_mode(entry.ctx.get(), SSL_SESS_CACHE_OFF);
+  }
+  return &entry;
+}
+
+void SSLSessionCache::OnHandshakeDone(const std::string& end_point,
+                                      SSL* ssl,
+                                      base::TimeDelta elapsed) {
+  bool resumed = SSL_session_reused(ssl);
+  if (resumed) {
+    ++stats_.resumed_handshakes;
+    stats_.resumed_handshake_time += elapsed;
+  } else {
+    ++stats_.full_handshakes;
+    stats_.full_handshake_time += elapsed;
+  }
+  VLOG(1) << "TLS connection to " << end_point << " established in "
+          << elapsed.InMilliseconds() << "ms"
+          << (resumed ? " (resumed session)" : " (full handshake)")
+          << ", resumed " << stats_.resumed_handshakes << " of "
+          << stats_.resumed_handshakes + stats_.full_handshakes;
+
+  GetEntry(end_point)->session.reset(SSL_get1_session(ssl));
+}
+
+SSLStream::SSLStream(EventTaskRunner* task_runner,
+                     SSLSessionCache* session_cache,
+                     const std::string& host,
+                     const std::string& end_point,
                      std::unique_ptr<BIO, SslDeleter> stream_bio)
-    : task_runner_{task_runner} {
-  ctx_.reset(SSL_CTX_new(TLSv1_2_client_method()));
-  CHECK(ctx_);
-  ssl_.reset(SSL_new(ctx_.get()));
+    : task_runner_{task_runner},
+      end_point_{end_point},
+      connect_start_{base::Time::Now()} {
+  if (session_cache) {
+    session_cache_ = session_cache->weak_ptr_factory_.GetWeakPtr();
+    SSLSessionCache::Entry* entry = session_cache->GetEntry(end_point);
+    // SSL keeps own reference to the context.
+    ssl_.reset(SSL_new(entry->ctx.get()));
+    CHECK(ssl_);
+    if (entry->session)
+      SSL_set_session(ssl_.get(), entry->session.get());
+  } else {
+    std::unique_ptr<SSL_CTX, SslDeleter> ctx{
+        SSL_CTX_new(TLSv1_2_client_method())};
+    CHECK(ctx);
+    ssl_.reset(SSL_new(ctx.get()));
+    CHECK(ssl_);
+  }
+  SSL_set_tlsext_host_name(ssl_.get(), host.c_str());
 
   SSL_set_bio(ssl_.get(), stream_bio.get(), stream_bio.get());
   stream_bio.release();  // Owned by ssl now.
@@ -61,12 +129,40 @@ SSLStream::SSLStream(provider::TaskRunner* task_runner,
 
 SSLStream::~SSLStream() {
   CancelPendingOperations();
+  if (watched_fd_ >= 0)
+    task_runner_->RemoveIoCompletionTask(watched_fd_);
+  // Best effort close_notify. Without it OpenSSL marks the session as not
+  // resumable and SSLSessionCache can't use it.
+  if (SSL_is_init_finished(ssl_.get()))
+    SSL_shutdown(ssl_.get());
 }
 
 void SSLStream::RunTask(const base::Closure& task) {
   task.Run();
 }
 
+void SSLStream::RetryOnSocketEvent(const base::Closure& task) {
+  pending_operations_.push_back(task);
+  if (watched_fd_ >= 0)
+    return;
+
+  watched_fd_ = BIO_get_fd(SSL_get_rbio(ssl_.get()), nullptr);
+  CHECK_GE(watched_fd_, 0);
+  // Edge triggered, so idle connection does not wake up the loop.
+  task_runner_->AddIoCompletionTask(
+      watched_fd_, EventTaskRunner::kAll,
+      base::Bind(&SSLStream::OnSocketEvent, weak_ptr_factory_.GetWeakPtr()));
+}
+
+void SSLStream::OnSocketEvent(int fd, int16_t what, EventTaskRunner* sender) {
+  std::vector<base::Closure> operations;
+  operations.swap(pending_operations_);
+  // Post instead of running directly, as operations may destroy the stream
+  // and with it this callback.
+  for (const auto& operation : operations)
+    task_runner_->PostDelayedTask(FROM_HERE, operation, {});
+}
+
 void SSLStream::Read(void* buffer,
                      size_t size_to_read,
                      const ReadCallback& callback) {
@@ -83,10 +179,9 @@ void SSLStream::Read(void* buffer,
   int err = SSL_get_error(ssl_.get(), res);
 
   if (err == SSL_ERROR_WANT_READ || err == SSL_ERROR_WANT_WRITE) {
-    return RetryAsyncTask(
-        task_runner_, FROM_HERE,
-        base::Bind(&SSLStream::Read, weak_ptr_factory_.GetWeakPtr(), buffer,
-                   size_to_read, callback));
+    return RetryOnSocketEvent(base::Bind(&SSLStream::Read,
+                                         weak_ptr_factory_.GetWeakPtr(), buffer,
+                                         size_to_read, callback));
   }
 
   ErrorPtr weave_error;
@@ -98,11 +193,35 @@ void SSLStream::Read(void* buffer,
       {});
 }
 
+bool SSLStream::ReadAvailable(size_t max_size,
+                              const void** data,
+                              size_t* size,
+                              ErrorPtr* error) {
+  // Don't get ahead of reads which wait for the socket.
+  if (!pending_operations_.empty() || max_size == 0)
+    return false;
+
+  lent_buffer_.resize(std::min(max_size, kMaxTlsRecordSize));
+  int res = SSL_read(ssl_.get(), lent_buffer_.data(), lent_buffer_.size());
+  if (res > 0) {
+    *data = lent_buffer_.data();
+    *size = res;
+    return true;
+  }
+
+  int err = SSL_get_error(ssl_.get(), res);
+  if (err == SSL_ERROR_WANT_READ || err == SSL_ERROR_WANT_WRITE)
+    return false;
+
+  AddSslError(error, FROM_HERE, "read_failed", err);
+  return true;
+}
+
 void SSLStream::Write(const void* buffer,
                       size_t size_to_write,
                       const WriteCallback& callback) {
   int res = SSL_write(ssl_.get(), buffer, size_to_write);
-  if (res > 0) {
+  while (res > 0) {
     buffer = static_cast<const char*>(buffer) + res;
     size_to_write -= res;
     if (size_to_write == 0) {
@@ -112,20 +231,15 @@ void SSLStream::Write(const void* buffer,
                      base::Bind(callback, nullptr)),
           {});
     }
-
-    return RetryAsyncTask(
-        task_runner_, FROM_HERE,
-        base::Bind(&SSLStream::Write, weak_ptr_factory_.GetWeakPtr(), buffer,
-                   size_to_write, callback));
+    res = SSL_write(ssl_.get(), buffer, size_to_write);
   }
 
   int err = SSL_get_error(ssl_.get(), res);
 
   if (err == SSL_ERROR_WANT_READ || err == SSL_ERROR_WANT_WRITE) {
-    return RetryAsyncTask(
-        task_runner_, FROM_HERE,
-        base::Bind(&SSLStream::Write, weak_ptr_factory_.GetWeakPtr(), buffer,
-                   size_to_write, callback));
+    return RetryOnSocketEvent(base::Bind(&SSLStream::Write,
+                                         weak_ptr_factory_.GetWeakPtr(), buffer,
+                                         size_to_write, callback));
   }
 
   ErrorPtr weave_error;
@@ -138,12 +252,20 @@ void SSLStream::Write(const void* buffer,
 
 void SSLStream::CancelPendingOperations() {
   weak_ptr_factory_.InvalidateWeakPtrs();
+  pending_operations_.clear();
+  if (watched_fd_ >= 0) {
+    // Callback is bound to invalidated WeakPtr, so register it again.
+    task_runner_->RemoveIoCompletionTask(watched_fd_);
+    watched_fd_ = -1;
+  }
 }
 
 void SSLStream::Connect(
-    provider::TaskRunner* task_runner,
+    EventTaskRunner* task_runner,
+    SSLSessionCache* session_cache,
     const std::string& host,
     uint16_t port,
+    base::TimeDelta timeout,
     const provider::Network::OpenSslSocketCallback& callback) {
   SSL_library_init();
 
@@ -154,22 +276,54 @@ void SSLStream::Connect(
   CHECK(stream_bio);
   BIO_set_nbio(stream_bio.get(), 1);
 
-  std::unique_ptr<SSLStream> stream{
-      new SSLStream{task_runner, std::move(stream_bio)}};
+  std::unique_ptr<SSLStream> stream{new SSLStream{
+      task_runner, session_cache, host, end_point, std::move(stream_bio)}};
+  task_runner->PostDelayedTask(
+      FROM_HERE, base::Bind(&SSLStream::OnConnectTimeout,
+                            stream->weak_ptr_factory_.GetWeakPtr(), callback),
+      timeout);
   ConnectBio(std::move(stream), callback);
 }
 
+void SSLStream::OnConnectTimeout(
+    base::WeakPtr<SSLStream> stream,
+    const provider::Network::OpenSslSocketCallback& callback) {
+  if (!stream || !stream->connecting_)
+    return;
+
+  stream->connect_timed_out_ = true;
+  // If a retry is already posted, it fails itself.
+  if (stream->pending_operations_.empty())
+    return;
+
+  auto task_runner = stream->task_runner_;
+  // Deletes the stream together with the operation which owns it.
+  std::vector<base::Closure> operations;
+  operations.swap(stream->pending_operations_);
+  operations.clear();
+  PostConnectTimeout(task_runner, callback);
+}
+
 void SSLStream::ConnectBio(
     std::unique_ptr<SSLStream> stream,
     const provider::Network::OpenSslSocketCallback& callback) {
+  if (stream->connect_timed_out_)
+    return PostConnectTimeout(stream->task_runner_, callback);
+
   BIO* bio = SSL_get_rbio(stream->ssl_.get());
-  if (BIO_do_connect(bio) == 1)
+  if (BIO_do_connect(bio) == 1) {
+    // XMPP stanzas are small and latency sensitive.
+    int fd = BIO_get_fd(bio, nullptr);
+    int on = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
     return DoHandshake(std::move(stream), callback);
+  }
 
   auto task_runner = stream->task_runner_;
   if (BIO_should_retry(bio)) {
-    return RetryAsyncTask(
-        task_runner, FROM_HERE,
+    // Stream keeps itself alive in pending operation until socket event.
+    SSLStream* stream_ptr = stream.get();
+    return stream_ptr->RetryOnSocketEvent(
         base::Bind(&SSLStream::ConnectBio, base::Passed(&stream), callback));
   }
 
@@ -182,9 +336,18 @@ void SSLStream::ConnectBio(
 void SSLStream::DoHandshake(
     std::unique_ptr<SSLStream> stream,
     const provider::Network::OpenSslSocketCallback& callback) {
+  if (stream->connect_timed_out_)
+    return PostConnectTimeout(stream->task_runner_, callback);
+
   int res = SSL_do_handshake(stream->ssl_.get());
   auto task_runner = stream->task_runner_;
   if (res == 1) {
+    stream->connecting_ = false;
+    if (stream->session_cache_) {
+      stream->session_cache_->OnHandshakeDone(
+          stream->end_point_, stream->ssl_.get(),
+          base::Time::Now() - stream->connect_start_);
+    }
     return task_runner->PostDelayedTask(
         FROM_HERE, base::Bind(callback, base::Passed(&stream), nullptr), {});
   }
@@ -192,8 +355,8 @@ void SSLStream::DoHandshake(
   res = SSL_get_error(stream->ssl_.get(), res);
 
   if (res == SSL_ERROR_WANT_READ || res == SSL_ERROR_WANT_WRITE) {
-    return RetryAsyncTask(
-        task_runner, FROM_HERE,
+    SSLStream* stream_ptr = stream.get();
+    return stream_ptr->RetryOnSocketEvent(
         base::Bind(&SSLStream::DoHandshake, base::Passed(&stream), callback));
   }
 
@@ -7,17 +7,62 @@
 
 #include <openssl/ssl.h>
 
+#include <map>
+#include <string>
+#include <vector>
+
 #include <base/memory/weak_ptr.h>
+#include <base/time/time.h>
 #include <weave/provider/network.h>
 #include <weave/stream.h>
 
+#include "examples/provider/event_task_runner.h"
+
 namespace weave {
+namespace examples {
 
-namespace provider {
-class TaskRunner;
-}
+struct SslDeleter {
+  void operator()(BIO* bio) const;
+  void operator()(SSL* ssl) const;
+  void operator()(SSL_CTX* ctx) const;
+  void operator()(SSL_SESSION* session) const;
+};
 
-namespace examples {
+// Shares SSL_CTX between connections to the same host and keeps the last
+// negotiated session, so reconnects can use abbreviated handshakes.
+class SSLSessionCache {
+ public:
+  struct Stats {
+    size_t full_handshakes{0};
+    size_t resumed_handshakes{0};
+    // Time from Connect() to the end of handshake.
+    base::TimeDelta full_handshake_time;
+    base::TimeDelta resumed_handshake_time;
+  };
+
+  SSLSessionCache();
+  ~SSLSessionCache();
+
+  const Stats& GetStats() const { return stats_; }
+
+ private:
+  friend class SSLStream;
+
+  struct Entry {
+    std::unique_ptr<SSL_CTX, SslDeleter> ctx;
+    std::unique_ptr<SSL_SESSION, SslDeleter> session;
+  };
+
+  Entry* GetEntry(const std::string& end_point);
+  void OnHandshakeDone(const std::string& end_point,
+                       SSL* ssl,
+                       base::TimeDelta elapsed);
+
+  std::map<std::string, Entry> entries_;
+  Stats stats_;
+
+  base::WeakPtrFactory<SSLSessionCache> weak_ptr_factory_{this};
+};
 
 class SSLStream : public Stream {
  public:
@@ -26,26 +71,34 @@ class SSLStream : public Stream {
   void Read(void* buffer,
             size_t size_to_read,
             const ReadCallback& callback) override;
+  bool ReadAvailable(size_t max_size,
+                     const void** data,
+                     size_t* size,
+                     ErrorPtr* error) override;
 
+  // WriteV is not overridden: gathering buffers into one SSL_write produces
+  // fewer TLS records than writing them one by one.
   void Write(const void* buffer,
              size_t size_to_write,
              const WriteCallback& callback) override;
 
   void CancelPendingOperations() override;
 
-  static void Connect(provider::TaskRunner* task_runner,
+  // |session_cache| is optional. Without it every connection creates new
+  // SSL_CTX and runs full handshake. Fails with "connect_timeout" if TCP
+  // connection and handshake don't finish in |timeout|.
+  static void Connect(EventTaskRunner* task_runner,
+                      SSLSessionCache* session_cache,
                       const std::string& host,
                       uint16_t port,
+                      base::TimeDelta timeout,
                       const provider::Network::OpenSslSocketCallback& callback);
 
  private:
-  struct SslDeleter {
-    void operator()(BIO* bio) const;
-    void operator()(SSL* ssl) const;
-    void operator()(SSL_CTX* ctx) const;
-  };
-
-  SSLStream(provider::TaskRunner* task_runner,
+  SSLStream(EventTaskRunner* task_runner,
+            SSLSessionCache* session_cache,
+            const std::string& host,
+            const std::string& end_point,
             std::unique_ptr<BIO, SslDeleter> stream_bio);
 
   static void ConnectBio(
@@ -54,14 +107,35 @@ class SSLStream : public Stream {
   static void DoHandshake(
       std::unique_ptr<SSLStream> stream,
       const provider::Network::OpenSslSocketCallback& callback);
+  // Releases the stream if it still waits for the socket in ConnectBio or
+  // DoHandshake, as it's owned only by its own pending operation.
+  static void OnConnectTimeout(
+      base::WeakPtr<SSLStream> stream,
+      const provider::Network::OpenSslSocketCallback& callback);
 
   // Send task to this method with WeakPtr if callback should not be executed
   // after SSLStream is destroyed.
   void RunTask(const base::Closure& task);
 
-  provider::TaskRunner* task_runner_{nullptr};
-  std::unique_ptr<SSL_CTX, SslDeleter> ctx_;
+  // Runs |task| again when the socket becomes readable or writable.
+  void RetryOnSocketEvent(const base::Closure& task);
+  void OnSocketEvent(int fd, int16_t what, EventTaskRunner* sender);
+
+  EventTaskRunner* task_runner_{nullptr};
+  // Socket watched by |task_runner_|, -1 if not watched yet.
+  int watched_fd_{-1};
+  // Operations waiting for socket readiness. Any socket event retries all of
+  // them, as SSL may need to write while reading and vice versa.
+  std::vector<base::Closure> pending_operations_;
+  base::WeakPtr<SSLSessionCache> session_cache_;
+  std::string end_point_;
+  base::Time connect_start_;
   std::unique_ptr<SSL, SslDeleter> ssl_;
+  // True until Connect() reports the result.
+  bool connecting_{true};
+  bool connect_timed_out_{false};
+  // Decrypted data lent by ReadAvailable.
+  std::vector<uint8_t> lent_buffer_;
 
   base::WeakPtrFactory<SSLStream> weak_ptr_factory_{this};
 };
@@ -0,0 +1,114 @@
+// Copyright 2016 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "examples/provider/timer_wheel.h"
+
+#include <algorithm>
+
+#include <base/logging.h>
+
+namespace weave {
+namespace examples {
+
+namespace {
+
+// Rotates |bits| right, so slot |shift| becomes bit 0.
+uint64_t RotateRight(uint64_t bits, size_t shift) {
+  shift &= 63;
+  return shift ? (bits >> shift) | (bits << (64 - shift)) : bits;
+}
+
+}  // namespace
+
+const uint64_t TimerWheel::kNoDeadline;
+
+TimerWheel::TimerWheel() {}
+
+TimerWheel::~TimerWheel() {}
+
+void TimerWheel::Insert(uint64_t deadline, const base::Closure& task) {
+  InsertEntry({deadline, ++sequence_, task});
+  ++size_;
+}
+
+void TimerWheel::InsertEntry(Entry entry) {
+  const uint64_t max_delta = (1ull << (kLevelBits * kLevels)) - 1;
+  uint64_t deadline = std::max(entry.deadline, current_);
+  deadline = std::min(deadline - current_, max_delta) + current_;
+
+  size_t level = 0;
+  while (((deadline - current_) >> (kLevelBits * (level + 1))) != 0)
+    ++level;
+
+  size_t slot = (deadline >> (kLevelBits * level)) & (kSlotsPerLevel - 1);
+  slots_[level][slot].push_back(std::move(entry));
+  occupied_[level] |= 1ull << slot;
+}
+
+void TimerWheel::Cascade(size_t level) {
+  size_t slot = (current_ >> (kLevelBits * level)) & (kSlotsPerLevel - 1);
+  std::vector<Entry> entries;
+  entries.swap(slots_[level][slot]);
+  occupied_[level] &= ~(1ull << slot);
+  for (auto& entry : entries)
+    InsertEntry(std::move(entry));
+}
+
+void TimerWheel::CollectCurrentSlot(std::vector<base::Closure>* expired) {
+  size_t slot = current_ & (kSlotsPerLevel - 1);
+  std::vector<Entry>& entries = slots_[0][slot];
+  if (entries.empty())
+    return;
+
+  // Cascaded entries may be appended after entries inserted directly.
+  std::sort(entries.begin(), entries.end(),
+            [](const Entry& a, const Entry& b) {
+              return a.sequence < b.sequence;
+            });
+  for (auto& entry : entries)
+    expired->push_back(std::move(entry.task));
+  size_ -= entries.size();
+  entries.clear();
+  occupied_[0] &= ~(1ull << slot);
+}
+
+void TimerWheel::Advance(uint64_t now, std::vector<base::Closure>* expired) {
+  for (;;) {
+    CollectCurrentSlot(expired);
+    uint64_t next = GetNextWakeUp();
+    if (next > now) {
+      // Nothing is stored in slots between, so it's safe to jump.
+      current_ = std::max(current_, now);
+      return;
+    }
+    current_ = next;
+    for (size_t level = kLevels - 1; level > 0; --level) {
+      if ((current_ & ((1ull << (kLevelBits * level)) - 1)) == 0)
+        Cascade(level);
+    }
+  }
+}
+
+uint64_t TimerWheel::GetNextWakeUp() const {
+  uint64_t result = kNoDeadline;
+  if (occupied_[0] & (1ull << (current_ & (kSlotsPerLevel - 1))))
+    return current_;
+
+  for (size_t level = 0; level < kLevels; ++level) {
+    if (!occupied_[level])
+      continue;
+    size_t shift = kLevelBits * level;
+    size_t position = (current_ >> shift) & (kSlotsPerLevel - 1);
+    // Bit i is the slot which starts i + 1 slots after the current one. The
+    // current slot itself is reached again only after a full turn.
+    uint64_t ahead = RotateRight(occupied_[level], position + 1);
+    uint64_t distance = __builtin_ctzll(ahead) + 1;
+    uint64_t start = ((current_ >> shift) + distance) << shift;
+    result = std::min(result, start);
+  }
+  return result;
+}
+
+}  // namespace examples
+}  // namespace weave
@@ -0,0 +1,74 @@
+// Copyright 2016 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIBWEAVE_EXAMPLES_PROVIDER_TIMER_WHEEL_H_
+#define LIBWEAVE_EXAMPLES_PROVIDER_TIMER_WHEEL_H_
+
+#include <cstdint>
+#include <vector>
+
+#include <base/callback.h>
+#include <base/macros.h>
+
+namespace weave {
+namespace examples {
+
+// Hierarchical timer wheel with millisecond ticks. Level 0 has one slot per
+// tick, every next level has slots 64 times wider. Tasks are inserted in O(1)
+// and moved to lower levels only when time reaches their slot, so a large
+// number of far timers costs nothing until they are close to expiration.
+// Time is an abstract tick counter provided by the owner.
+class TimerWheel {
+ public:
+  static const uint64_t kNoDeadline = UINT64_MAX;
+
+  TimerWheel();
+  ~TimerWheel();
+
+  // Schedules |task| to be returned from Advance() when time reaches
+  // |deadline|. Deadlines in the past are due immediately.
+  void Insert(uint64_t deadline, const base::Closure& task);
+
+  // Moves time forward to |now| and appends expired tasks to |expired| in
+  // order of deadlines, tasks with equal deadlines in order of insertion.
+  void Advance(uint64_t now, std::vector<base::Closure>* expired);
+
+  // Returns the earliest time when Advance() needs to be called. It's exact
+  // for tasks in the lowest level and a lower bound for others, which need to
+  // be moved to lower levels first, at most one extra wake up per level.
+  // Returns kNoDeadline if empty.
+  uint64_t GetNextWakeUp() const;
+
+  uint64_t GetCurrentTime() const { return current_; }
+  size_t GetSize() const { return size_; }
+
+ private:
+  static const size_t kLevelBits = 6;
+  static const size_t kSlotsPerLevel = 1 << kLevelBits;
+  static const size_t kLevels = 6;
+
+  struct Entry {
+    uint64_t deadline;
+    uint64_t sequence;
+    base::Closure task;
+  };
+
+  void InsertEntry(Entry entry);
+  void Cascade(size_t level);
+  void CollectCurrentSlot(std::vector<base::Closure>* expired);
+
+  uint64_t current_{0};
+  uint64_t sequence_{0};
+  size_t size_{0};
+  std::vector<Entry> slots_[kLevels][kSlotsPerLevel];
+  // Bit per non-empty slot, to find the next timer without scanning.
+  uint64_t occupied_[kLevels] = {};
+
+  DISALLOW_COPY_AND_ASSIGN(TimerWheel);
+};
+
+}  // namespace examples
+}  // namespace weave
+
+#endif  // LIBWEAVE_EXAMPLES_PROVIDER_TIMER_WHEEL_H_
@@ -0,0 +1,194 @@
+// Copyright 2016 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "examples/provider/timer_wheel.h"
+
+#include <map>
+#include <random>
+#include <utility>
+
+#include <base/bind.h>
+#include <gtest/gtest.h>
+
+namespace weave {
+namespace examples {
+
+namespace {
+
+void Record(std::vector<int>* fired, int id) {
+  fired->push_back(id);
+}
+
+// Runs the same operations on a TimerWheel and on a reference multimap
+// ordered by deadline and insertion.
+class TimerWheelModel {
+ public:
+  void Insert(uint64_t deadline) {
+    int id = next_id_++;
+    wheel_.Insert(deadline, base::Bind(&Record, &fired_, id));
+    // Deadlines in the past are due at the current time.
+    reference_.emplace(std::make_pair(std::max(deadline, now_), id), id);
+  }
+
+  void Advance(uint64_t now) {
+    ASSERT_GE(now, now_);
+    now_ = now;
+    CheckNextWakeUp();
+
+    std::vector<int> expected;
+    while (!reference_.empty() && reference_.begin()->first.first <= now) {
+      expected.push_back(reference_.begin()->second);
+      reference_.erase(reference_.begin());
+    }
+    std::vector<base::Closure> expired;
+    wheel_.Advance(now, &expired);
+    fired_.clear();
+    for (const auto& task : expired)
+      task.Run();
+    EXPECT_EQ(expected, fired_) << "now " << now;
+    EXPECT_EQ(reference_.size(), wheel_.GetSize());
+    EXPECT_EQ(now, wheel_.GetCurrentTime());
+  }
+
+  void CheckNextWakeUp() const {
+    uint64_t next = wheel_.GetNextWakeUp();
+    if (reference_.empty()) {
+      EXPECT_EQ(TimerWheel::kNoDeadline, next);
+      return;
+    }
+    uint64_t earliest = reference_.begin()->first.first;
+    EXPECT_LE(next, std::max(earliest, wheel_.GetCurrentTime()));
+    EXPECT_GE(next, wheel_.GetCurrentTime());
+  }
+
+  // Advances to the wake up times returned by the wheel until the earliest
+  // task runs, as the task runner does.
+  void AdvanceToNextTask() {
+    if (reference_.empty())
+      return;
+    const size_t size = reference_.size();
+    int wake_ups = 0;
+    while (reference_.size() == size) {
+      ASSERT_LE(++wake_ups, 7) << "now " << now_;
+      Advance(wheel_.GetNextWakeUp());
+    }
+  }
+
+  uint64_t now() const { return now_; }
+  size_t size() const { return reference_.size(); }
+
+ private:
+  TimerWheel wheel_;
+  std::multimap<std::pair<uint64_t, int>, int> reference_;
+  std::vector<int> fired_;
+  uint64_t now_{0};
+  int next_id_{0};
+};
+
+// Distances around the boundaries of wheel levels.
+std::vector<uint64_t> GetBoundaryDistances() {
+  std::vector<uint64_t> distances{0, 1, 2};
+  for (uint64_t level_size = 64; level_size <= (1ull << 30); level_size *= 64) {
+    distances.push_back(level_size - 1);
+    distances.push_back(level_size);
+    distances.push_back(level_size + 1);
+    distances.push_back(2 * level_size - 1);
+  }
+  return distances;
+}
+
+}  // namespace
+
+TEST(TimerWheelTest, Empty) {
+  TimerWheel wheel;
+  EXPECT_EQ(TimerWheel::kNoDeadline, wheel.GetNextWakeUp());
+  std::vector<base::Closure> expired;
+  wheel.Advance(1000000, &expired);
+  EXPECT_TRUE(expired.empty());
+  EXPECT_EQ(1000000u, wheel.GetCurrentTime());
+}
+
+TEST(TimerWheelTest, LevelBoundaries) {
+  const std::vector<uint64_t> kDistances = GetBoundaryDistances();
+  // Start at a few offsets, so slots are not aligned with level boundaries.
+  for (uint64_t start : {0ull, 1ull, 63ull, 4095ull, 262143ull + 7}) {
+    TimerWheelModel model;
+    model.Advance(start);
+    for (uint64_t distance : kDistances)
+      model.Insert(start + distance);
+    // Step exactly onto every deadline, and one tick before and after.
+    for (uint64_t distance : kDistances) {
+      for (uint64_t time : {start + distance - (distance ? 1 : 0),
+                            start + distance, start + distance + 1}) {
+        if (time >= model.now())
+          model.Advance(time);
+      }
+    }
+    EXPECT_EQ(0u, model.size());
+  }
+}
+
+TEST(TimerWheelTest, DeadlinesInPast) {
+  TimerWheelModel model;
+  model.Advance(100000);
+  model.Insert(0);
+  model.Insert(99999);
+  model.Insert(100000);
+  model.Insert(50);
+  // Due now, in order of insertion.
+  model.Advance(100000);
+  EXPECT_EQ(0u, model.size());
+}
+
+TEST(TimerWheelTest, RandomOperations) {
+  const std::vector<uint64_t> kDistances = GetBoundaryDistances();
+  std::mt19937_64 random{42};
+  TimerWheelModel model;
+  for (int i = 0; i < 20000; ++i) {
+    uint64_t now = model.now();
+    switch (random() % 5) {
+      case 0:
+        model.Insert(now + kDistances[random() % kDistances.size()]);
+        break;
+      case 1:
+        model.Insert(now + random() % 5000);
+        break;
+      case 2:
+        model.Insert(now - std::min<uint64_t>(now, random() % 100));
+        break;
+      case 3:
+        model.Advance(now + (random() % 2 ? random() % 100
+                                          : random() % (1ull << 20)));
+        break;
+      case 4:
+        model.AdvanceToNextTask();
+        break;
+    }
+  }
+  model.Advance(model.now() + (1ull << 31));
+  EXPECT_EQ(0u, model.size());
+}
+
+TEST(TimerWheelTest, WakeUps) {
+  const std::vector<uint64_t> kDistances = GetBoundaryDistances();
+  TimerWheelModel model;
+  model.Advance(12345);
+  for (uint64_t distance : kDistances)
+    model.Insert(model.now() + distance);
+  while (model.size())
+    model.AdvanceToNextTask();
+}
+
+TEST(TimerWheelTest, ManyTimers) {
+  const int kTimers = 100000;
+  std::mt19937_64 random{7};
+  TimerWheelModel model;
+  for (int i = 0; i < kTimers; ++i)
+    model.Insert(random() % (1ull << 24));
+  for (uint64_t now = 0; model.size(); now += 1 << 16)
+    model.Advance(now);
+}
+
+}  // namespace examples
+}  // namespace weave
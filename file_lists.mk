@@ -5,13 +5,17 @@
 WEAVE_SRC_FILES := \
 	src/access_api_handler.cc \
 	src/access_black_list_manager_impl.cc \
+	src/access_traits_bundle.cc \
 	src/backoff_entry.cc \
 	src/base_api_handler.cc \
+	src/base_traits_bundle.cc \
 	src/commands/cloud_command_proxy.cc \
 	src/commands/command_instance.cc \
 	src/commands/command_queue.cc \
+	src/commands/command_worker_pool.cc \
 	src/commands/schema_constants.cc \
 	src/component_manager_impl.cc \
+	src/component_tree_publisher.cc \
 	src/config.cc \
 	src/data_encoding.cc \
 	src/device_manager.cc \
@@ -19,6 +23,8 @@ WEAVE_SRC_FILES := \
 	src/error.cc \
 	src/http_constants.cc \
 	src/json_error_codes.cc \
+	src/memory_usage.cc \
+	src/metrics.cc \
 	src/notification/notification_parser.cc \
 	src/notification/pull_channel.cc \
 	src/notification/xml_node.cc \
@@ -39,14 +45,23 @@ WEAVE_SRC_FILES := \
 	src/privet/wifi_bootstrap_manager.cc \
 	src/privet/wifi_ssid_generator.cc \
 	src/registration_status.cc \
+	src/snapshot_manager.cc \
+	src/startup_profiler.cc \
 	src/states/state_change_queue.cc \
+	src/states/state_latency_tracker.cc \
+	src/states/state_producer_hub.cc \
 	src/streams.cc \
 	src/string_utils.cc \
+	src/trace_log.cc \
+	src/tracing_task_runner.cc \
+	src/trait_bundle.cc \
 	src/utils.cc
 
 WEAVE_TEST_SRC_FILES := \
+	src/test/allocation_counter.cc \
 	src/test/fake_stream.cc \
 	src/test/fake_task_runner.cc \
+	src/test/simulated_cloud.cc \
 	src/test/unittest_utils.cc
 
 WEAVE_UNITTEST_SRC_FILES := \
@@ -57,11 +72,15 @@ WEAVE_UNITTEST_SRC_FILES := \
 	src/commands/cloud_command_proxy_unittest.cc \
 	src/commands/command_instance_unittest.cc \
 	src/commands/command_queue_unittest.cc \
+	src/commands/command_worker_pool_unittest.cc \
 	src/component_manager_unittest.cc \
+	src/component_tree_publisher_unittest.cc \
 	src/config_unittest.cc \
 	src/data_encoding_unittest.cc \
 	src/device_registration_info_unittest.cc \
 	src/error_unittest.cc \
+	src/memory_usage_unittest.cc \
+	src/metrics_unittest.cc \
 	src/notification/notification_parser_unittest.cc \
 	src/notification/xml_node_unittest.cc \
 	src/notification/xmpp_channel_unittest.cc \
@@ -71,14 +90,37 @@ WEAVE_UNITTEST_SRC_FILES := \
 	src/privet/privet_handler_unittest.cc \
 	src/privet/security_manager_unittest.cc \
 	src/privet/wifi_ssid_generator_unittest.cc \
+	src/snapshot_manager_unittest.cc \
+	src/startup_profiler_unittest.cc \
 	src/states/state_change_queue_unittest.cc \
+	src/states/state_latency_tracker_unittest.cc \
+	src/states/state_producer_hub_unittest.cc \
 	src/streams_unittest.cc \
 	src/string_utils_unittest.cc \
+	src/trace_log_unittest.cc \
+	src/tracing_task_runner_unittest.cc \
+	src/trait_bundle_unittest.cc \
 	src/test/weave_testrunner.cc
 
 WEAVE_EXPORTS_UNITTEST_SRC_FILES := \
 	src/weave_unittest.cc
 
+WEAVE_SOAKTEST_SRC_FILES := \
+	src/soak_test.cc
+
+WEAVE_STARTUP_BENCHMARK_SRC_FILES := \
+	src/startup_benchmark.cc
+
+WEAVE_STARTUP_BENCHMARK_TRAIT_FILES := \
+	src/startup_benchmark_traits.json
+
+WEAVE_TRAIT_BUNDLE_COMPILER_SRC_FILES := \
+	src/trait_bundle_compiler.cc
+
+WEAVE_BUILTIN_TRAIT_FILES := \
+	src/access_traits.json \
+	src/base_traits.json
+
 EXAMPLES_PROVIDER_SRC_FILES := \
 	examples/provider/avahi_client.cc \
 	examples/provider/bluez_client.cc \
@@ -88,8 +130,15 @@ EXAMPLES_PROVIDER_SRC_FILES := \
 	examples/provider/event_task_runner.cc \
 	examples/provider/file_config_store.cc \
 	examples/provider/ssl_stream.cc \
+	examples/provider/timer_wheel.cc \
 	examples/provider/wifi_manager.cc
 
+EXAMPLES_PROVIDER_UNITTEST_SRC_FILES := \
+	examples/provider/event_task_runner_unittest.cc \
+	examples/provider/file_config_store_unittest.cc \
+	examples/provider/ssl_stream_unittest.cc \
+	examples/provider/timer_wheel_unittest.cc
+
 THIRD_PARTY_CHROMIUM_BASE_SRC_FILES := \
 	third_party/chromium/base/bind_helpers.cc \
 	third_party/chromium/base/callback_internal.cc \
@@ -31,6 +31,60 @@ enum class GcdState {
   kInvalidCredentials,  // Our registration has been revoked.
 };
 
+// Accepts state updates from a thread other than the libweave thread, e.g.
+// a sensor sampling thread. Updates are applied on the libweave thread in
+// batches. Repeated updates of the same property made between batches are
+// coalesced and only the latest value is applied. Each producer must be used
+// by a single thread at a time; create one producer per thread.
+class StateProducer {
+ public:
+  virtual ~StateProducer() {}
+
+  // Sets value of the single property.
+  // |name| is full property name, including trait name. e.g. "base.network".
+  // Errors, e.g. unknown component, are only logged.
+  virtual void SetStateProperty(const std::string& component,
+                                const std::string& name,
+                                const base::Value& value) = 0;
+};
+
+// Immutable view of trait definitions and component instances, including
+// their state. See ComponentTreeReader.
+class ComponentTreeSnapshot {
+ public:
+  virtual ~ComponentTreeSnapshot() {}
+
+  // Returns the full JSON dictionary containing trait definitions.
+  virtual const base::DictionaryValue& GetTraits() const = 0;
+
+  // Returns the full JSON dictionary containing component instances.
+  virtual const base::DictionaryValue& GetComponents() const = 0;
+
+  // Returns value of the single property.
+  // |name| is full property name, including trait name. e.g. "base.network".
+  virtual const base::Value* GetStateProperty(const std::string& component,
+                                              const std::string& name,
+                                              ErrorPtr* error) const = 0;
+};
+
+// Gives a thread other than the libweave thread read access to traits and
+// components, without locks and without copying. The libweave thread
+// publishes a new snapshot in a task shortly after changes, so changes made
+// together are always seen together. Each reader must be used by a single
+// thread at a time; create one reader per thread.
+class ComponentTreeReader {
+ public:
+  virtual ~ComponentTreeReader() {}
+
+  // Returns the latest snapshot. It stays valid and unchanged until the next
+  // call of Acquire() or Release(), or until the reader is destroyed.
+  virtual const ComponentTreeSnapshot& Acquire() = 0;
+
+  // Lets memory of the snapshot returned by Acquire() be reclaimed. Call it
+  // when the reader is going to be idle for a while.
+  virtual void Release() = 0;
+};
+
 class Device {
  public:
   virtual ~Device() {}
@@ -49,6 +103,11 @@ class Device {
   // Adds new trait definitions to device.
   virtual void AddTraitDefinitionsFromJson(const std::string& json) = 0;
   virtual void AddTraitDefinitions(const base::DictionaryValue& dict) = 0;
+  // Same as above, but takes |size| bytes of a trait bundle at |data|, which
+  // is faster than parsing JSON. Bundles are generated from JSON files at
+  // build time by trait_bundle_compiler.
+  virtual void AddTraitDefinitionsFromBundle(const uint8_t* data,
+                                             size_t size) = 0;
 
   // Returns the full JSON dictionary containing trait definitions.
   virtual const base::DictionaryValue& GetTraits() const = 0;
@@ -100,6 +159,16 @@ class Device {
                                 const base::Value& value,
                                 ErrorPtr* error) = 0;
 
+  // Returns a new producer of state updates for use on another thread. Must
+  // be called on the libweave thread. The producer can be destroyed on its
+  // own thread, and may outlive the device.
+  virtual std::unique_ptr<StateProducer> CreateStateProducer() = 0;
+
+  // Returns a new reader of traits and components for use on another thread.
+  // Must be called on the libweave thread. The reader can be destroyed on its
+  // own thread, and may outlive the device.
+  virtual std::unique_ptr<ComponentTreeReader> CreateComponentTreeReader() = 0;
+
   // Callback type for AddCommandHandler.
   using CommandHandlerCallback =
       base::Callback<void(const std::weak_ptr<Command>& command)>;
@@ -116,6 +185,17 @@ class Device {
                                  const std::string& command_name,
                                  const CommandHandlerCallback& callback) = 0;
 
+  // Same as AddCommandHandler(), but |callback| is called on a worker thread,
+  // so it may block, e.g. while waiting for hardware. Handlers added this way
+  // share a bounded pool of threads. Methods of the command passed to
+  // |callback| which change the command, e.g. SetProgress() or Complete(), are
+  // executed on the libweave thread and wait for the result. The command
+  // expires when |callback| returns.
+  virtual void AddWorkerCommandHandler(
+      const std::string& component,
+      const std::string& command_name,
+      const CommandHandlerCallback& callback) = 0;
+
   // Adds a new command to the command queue.
   virtual bool AddCommand(const base::DictionaryValue& command,
                           std::string* id,
@@ -159,6 +239,40 @@ class Device {
       const PairingBeginCallback& begin_callback,
       const PairingEndCallback& end_callback) = 0;
 
+  // Returns a snapshot of internal counters, gauges and histograms of the
+  // library, one metric per line, sorted by name:
+  //   c <name> <value>
+  //   g <name> <value> <max>
+  //   h <name> <count> <sum> <bucket min>:<count>...
+  //   w <name> <value>:<details>...
+  // Gauges report their high-water mark as <max>. Histograms of times are in
+  // milliseconds, or in microseconds if their names end with "_us", and list
+  // non-empty buckets only.
+  // "w" lines list the largest recent samples, largest first.
+  // "startup.*" histograms have a sample per device start: the durations of
+  // the phases of Create(), and the times from Create() to the first Privet
+  // reply and to the first successful cloud request.
+  // Metrics are shared by all devices in the process.
+  virtual std::string GetMetrics() const = 0;
+
+  // Returns approximate memory used by parts of the library, e.g. trait
+  // definitions, components, commands, queued state changes, XMPP buffers and
+  // cloud requests, as a JSON object:
+  //   {"<area>": {"bytes": <current>, "maxBytes": <high-water mark>}, ...}
+  // The same numbers are reported by GetMetrics() as "memory.<area>_bytes"
+  // gauges. Usage is shared by all devices in the process.
+  virtual std::string GetMemoryUsage() const = 0;
+
+  // Starts recording libweave tasks, cloud and privet requests and commands
+  // into a ring buffer of the last |max_events| events. Zero stops recording
+  // and drops recorded events. Recording is off by default.
+  virtual void SetTraceBufferSize(size_t max_events) = 0;
+
+  // Returns recorded events in Chrome trace event JSON format, which can be
+  // loaded into chrome://tracing. Events are shared by all devices in the
+  // process.
+  virtual std::string GetTrace() const = 0;
+
   LIBWEAVE_EXPORT static std::unique_ptr<Device> Create(
       provider::ConfigStore* config_store,
       provider::TaskRunner* task_runner,
@@ -85,6 +85,11 @@ namespace provider {
 //   data - binary data of the response body wrapped into std::string object.
 //   mime_type - MIME type of the response, that should be transferred into
 //     "Content-Type" HTTP header.
+// The overload of SendReply(...) taking |data| as an rvalue is used by
+// libweave for the replies it builds, so implementations which keep the body
+// until the reply is sent may take it over instead of copying it. By default
+// it calls the other overload.
+//
 // Implementation of the SendReply(...) method may also add other standard
 // HTTP headers, like "Content-Length" or "Transfer-Encoding" depending on
 // capabilities of the server and client which made this request.
@@ -118,6 +123,11 @@ class HttpServer {
     virtual void SendReply(int status_code,
                            const std::string& data,
                            const std::string& mime_type) = 0;
+    virtual void SendReply(int status_code,
+                           std::string&& data,
+                           const std::string& mime_type) {
+      SendReply(status_code, static_cast<const std::string&>(data), mime_type);
+    }
   };
 
   // Callback type for AddRequestHandler.
@@ -18,6 +18,15 @@ namespace provider {
 
 // Interface with methods to post tasks into platform-specific message loop of
 // the current thread.
+//
+// Threading contract: libweave calls PostDelayedTask only from the thread
+// which runs the message loop, and all libweave objects must be used only
+// from tasks of that loop. Implementations are therefore not required to be
+// thread-safe. Tasks must run on the loop thread, not earlier than requested,
+// tasks with equal deadlines in order of posting. Code running on other
+// threads must not call PostDelayedTask unless the implementation explicitly
+// allows that; it should use PostTaskFromAnyThread or a thread-safe entry
+// point of the implementation to get onto the loop thread first.
 class TaskRunner {
  public:
   // Posts tasks to be executed with the given delay.
@@ -27,6 +36,16 @@ class TaskRunner {
                                const base::Closure& task,
                                base::TimeDelta delay) = 0;
 
+  // Posts |task| to run on the loop thread as soon as possible. Unlike
+  // PostDelayedTask, it may be called from any thread, so libweave uses it to
+  // wake up the loop when other threads have work for it. Implementations
+  // which are not thread-safe keep this default, which posts nothing and
+  // returns false; libweave then polls for such work on a timer.
+  virtual bool PostTaskFromAnyThread(const tracked_objects::Location& from_here,
+                                     const base::Closure& task) {
+    return false;
+  }
+
  protected:
   virtual ~TaskRunner() {}
 };
@@ -8,7 +8,7 @@
 #include <weave/provider/task_runner.h>
 
 #include <algorithm>
-#include <queue>
+#include <mutex>
 #include <utility>
 #include <vector>
 
@@ -26,9 +26,15 @@ class FakeTaskRunner : public TaskRunner {
   void PostDelayedTask(const tracked_objects::Location& from_here,
                        const base::Closure& task,
                        base::TimeDelta delay) override;
+  // Tasks from other threads are queued when the runner runs next.
+  bool PostTaskFromAnyThread(const tracked_objects::Location& from_here,
+                             const base::Closure& task) override;
 
   bool RunOnce();
   void Run(size_t number_of_iterations = 1000);
+  // Runs all tasks due no later than |time|, including tasks they post, and
+  // advances the clock to |time|. Returns the number of tasks run.
+  size_t RunUntil(base::Time time);
   void Break();
   base::Clock* GetClock();
   size_t GetTaskQueueSize() const;
@@ -37,6 +43,7 @@ class FakeTaskRunner : public TaskRunner {
   void SaveTask(const tracked_objects::Location& from_here,
                 const base::Closure& task,
                 base::TimeDelta delay);
+  void TakeTasksFromOtherThreads();
 
   using QueueItem = std::pair<std::pair<base::Time, size_t>, base::Closure>;
 
@@ -52,10 +59,12 @@ class FakeTaskRunner : public TaskRunner {
   class TestClock;
   std::unique_ptr<TestClock> test_clock_;
 
-  std::priority_queue<QueueItem,
-                      std::vector<QueueItem>,
-                      FakeTaskRunner::Greater>
-      queue_;
+  // Min-heap ordered by Greater. Unlike std::priority_queue, it allows moving
+  // tasks out, so closures and their bound arguments are not copied.
+  std::vector<QueueItem> queue_;
+
+  std::mutex other_threads_mutex_;
+  std::vector<base::Closure> other_threads_tasks_;
 };
 
 }  // namespace test
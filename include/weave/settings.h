@@ -69,6 +69,11 @@ struct Settings {
   // Local device id.
   std::string device_id;
 
+  // If true, traits, components and pending cloud commands are saved with
+  // ConfigStore::SaveSettings as "snapshot" and restored on the next start
+  // of the same firmware, so the device only syncs changes with the cloud.
+  bool warm_restart_enabled{false};
+
   // Internal options to tweak some library functionality. External code should
   // avoid using them.
   bool wifi_auto_setup_enabled{true};
@@ -6,9 +6,11 @@
 #define LIBWEAVE_INCLUDE_WEAVE_STREAM_H_
 
 #include <string>
+#include <vector>
 
 #include <base/callback.h>
 #include <weave/error.h>
+#include <weave/export.h>
 
 namespace weave {
 
@@ -26,6 +28,20 @@ class InputStream {
   virtual void Read(void* buffer,
                     size_t size_to_read,
                     const ReadCallback& callback) = 0;
+
+  // Synchronous fast path for data which is already available. Consumes up
+  // to |max_size| bytes and lends them to the caller from the stream's own
+  // buffer, without copying and without callback.
+  // Returns false if nothing is available right now, or the stream doesn't
+  // lend buffers; Read() should be used then. Otherwise either |error| is set,
+  // or |data| and |size| are set and stay valid until the next operation on
+  // the stream. |size| is 0 at the end of the stream.
+  virtual bool ReadAvailable(size_t max_size,
+                             const void** data,
+                             size_t* size,
+                             ErrorPtr* error) {
+    return false;
+  }
 };
 
 // Interface for async input streaming.
@@ -42,6 +58,18 @@ class OutputStream {
   virtual void Write(const void* buffer,
                      size_t size_to_write,
                      const WriteCallback& callback) = 0;
+
+  // Memory region for WriteV.
+  struct Buffer {
+    const void* data;
+    size_t size;
+  };
+
+  // Same as Write, but writes all |buffers| in order as a single operation.
+  // Caller guarantees that buffers are alive until callback is called.
+  // Default implementation gathers buffers into one and calls Write.
+  LIBWEAVE_EXPORT virtual void WriteV(const std::vector<Buffer>& buffers,
+                                      const WriteCallback& callback);
 };
 
 // Interface for async bi-directional streaming.
@@ -32,6 +32,10 @@ class FakeStream : public Stream {
   void Read(void* buffer,
             size_t size_to_read,
             const ReadCallback& callback) override;
+  bool ReadAvailable(size_t max_size,
+                     const void** data,
+                     size_t* size,
+                     ErrorPtr* error) override;
   void Write(const void* buffer,
              size_t size_to_write,
              const WriteCallback& callback) override;
@@ -40,6 +44,7 @@ class FakeStream : public Stream {
   provider::TaskRunner* task_runner_{nullptr};
   std::string write_data_;
   std::string read_data_;
+  std::string lent_data_;
 };
 
 }  // namespace test
@@ -23,6 +23,8 @@ class MockDevice : public Device {
                void(const SettingsChangedCallback& callback));
   MOCK_METHOD1(AddTraitDefinitionsFromJson, void(const std::string& json));
   MOCK_METHOD1(AddTraitDefinitions, void(const base::DictionaryValue& dict));
+  MOCK_METHOD2(AddTraitDefinitionsFromBundle,
+               void(const uint8_t* data, size_t size));
   MOCK_CONST_METHOD0(GetTraits, const base::DictionaryValue&());
   MOCK_METHOD1(AddTraitDefsChangedCallback,
                void(const base::Closure& callback));
@@ -51,10 +53,16 @@ class MockDevice : public Device {
                     const std::string& name,
                     const base::Value& value,
                     ErrorPtr* error));
+  MOCK_METHOD0(MockCreateStateProducer, StateProducer*());
+  MOCK_METHOD0(MockCreateComponentTreeReader, ComponentTreeReader*());
   MOCK_METHOD3(AddCommandHandler,
                void(const std::string& component,
                     const std::string& command_name,
                     const CommandHandlerCallback& callback));
+  MOCK_METHOD3(AddWorkerCommandHandler,
+               void(const std::string& component,
+                    const std::string& command_name,
+                    const CommandHandlerCallback& callback));
   MOCK_METHOD3(AddCommand,
                bool(const base::DictionaryValue&, std::string*, ErrorPtr*));
   MOCK_METHOD1(FindCommand, Command*(const std::string&));
@@ -68,6 +76,10 @@ class MockDevice : public Device {
   MOCK_METHOD2(AddPairingChangedCallbacks,
                void(const PairingBeginCallback& begin_callback,
                     const PairingEndCallback& end_callback));
+  MOCK_CONST_METHOD0(GetMetrics, std::string());
+  MOCK_CONST_METHOD0(GetMemoryUsage, std::string());
+  MOCK_METHOD1(SetTraceBufferSize, void(size_t max_events));
+  MOCK_CONST_METHOD0(GetTrace, std::string());
 
   // Deprecated methods.
   MOCK_METHOD1(AddCommandDefinitionsFromJson, void(const std::string&));
@@ -86,6 +98,15 @@ class MockDevice : public Device {
                     const base::Value& value,
                     ErrorPtr* error));
   MOCK_CONST_METHOD0(GetState, const base::DictionaryValue&());
+
+ private:
+  std::unique_ptr<StateProducer> CreateStateProducer() override {
+    return std::unique_ptr<StateProducer>{MockCreateStateProducer()};
+  }
+  std::unique_ptr<ComponentTreeReader> CreateComponentTreeReader() override {
+    return std::unique_ptr<ComponentTreeReader>{
+        MockCreateComponentTreeReader()};
+  }
 };
 
 }  // namespace test
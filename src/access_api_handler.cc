@@ -8,6 +8,7 @@
 #include <weave/device.h>
 
 #include "src/access_black_list_manager.h"
+#include "src/builtin_traits.h"
 #include "src/commands/schema_constants.h"
 #include "src/data_encoding.h"
 #include "src/json_error_codes.h"
@@ -53,68 +54,8 @@ bool GetIds(const base::DictionaryValue& parameters,
 AccessApiHandler::AccessApiHandler(Device* device,
                                    AccessBlackListManager* manager)
     : device_{device}, manager_{manager} {
-  device_->AddTraitDefinitionsFromJson(R"({
-    "_accessControlBlackList": {
-      "commands": {
-        "block": {
-          "minimalRole": "owner",
-          "parameters": {
-            "userId": {
-              "type": "string"
-            },
-            "applicationId": {
-              "type": "string"
-            },
-            "expirationTimeoutSec": {
-              "type": "integer"
-            }
-          }
-        },
-        "unblock": {
-          "minimalRole": "owner",
-          "parameters": {
-            "userId": {
-              "type": "string"
-            },
-            "applicationId": {
-              "type": "string"
-            }
-          }
-        },
-        "list": {
-          "minimalRole": "owner",
-          "parameters": {},
-          "results": {
-            "blackList": {
-              "type": "array",
-              "items": {
-                "type": "object",
-                "properties": {
-                  "userId": {
-                    "type": "string"
-                  },
-                  "applicationId": {
-                    "type": "string"
-                  }
-                },
-                "additionalProperties": false
-              }
-            }
-          }
-        }
-      },
-      "state": {
-        "size": {
-          "type": "integer",
-          "isRequired": true
-        },
-        "capacity": {
-          "type": "integer",
-          "isRequired": true
-        }
-      }
-    }
-  })");
+  device_->AddTraitDefinitionsFromBundle(kAccessTraitsBundle,
+                                         kAccessTraitsBundleSize);
   CHECK(device_->AddComponent(kComponent, {kTrait}, nullptr));
   UpdateState();
 
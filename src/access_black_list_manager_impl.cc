@@ -4,85 +4,217 @@
 
 #include "src/access_black_list_manager_impl.h"
 
+#include <algorithm>
+#include <tuple>
+
+#include <base/bind.h>
 #include <base/json/json_reader.h>
 #include <base/json/json_writer.h>
 #include <base/values.h>
 
 #include "src/commands/schema_constants.h"
 #include "src/data_encoding.h"
+#include "src/string_utils.h"
 
 namespace weave {
 
 namespace {
 const char kConfigFileName[] = "black_list";
+const char kJournalFileName[] = "black_list_journal";
 
 const char kUser[] = "user";
 const char kApp[] = "app";
 const char kExpiration[] = "expiration";
+
+// Journal is merged into the snapshot when it has this many records, so every
+// change rewrites a small blob, and the whole list is rewritten only once per
+// this many changes.
+const size_t kMaxJournalSize = 16;
+
+std::unique_ptr<base::DictionaryValue> EntryToJson(
+    const std::vector<uint8_t>& user_id,
+    const std::vector<uint8_t>& app_id,
+    const base::Time& expiration) {
+  std::unique_ptr<base::DictionaryValue> entry{new base::DictionaryValue};
+  entry->SetString(kUser, Base64Encode(user_id));
+  entry->SetString(kApp, Base64Encode(app_id));
+  entry->SetInteger(kExpiration, expiration.ToTimeT());
+  return entry;
+}
+
+bool EntryFromJson(const base::Value& value,
+                   std::vector<uint8_t>* user_id,
+                   std::vector<uint8_t>* app_id,
+                   base::Time* expiration) {
+  const base::DictionaryValue* entry{nullptr};
+  std::string user;
+  std::string app;
+  int expiration_time_t{0};
+  if (!value.GetAsDictionary(&entry) || !entry->GetString(kUser, &user) ||
+      !Base64Decode(user, user_id) || !entry->GetString(kApp, &app) ||
+      !Base64Decode(app, app_id) ||
+      !entry->GetInteger(kExpiration, &expiration_time_t)) {
+    return false;
+  }
+  *expiration = base::Time::FromTimeT(expiration_time_t);
+  return true;
+}
+
+void HashBytes(const std::vector<uint8_t>& bytes, size_t* hash) {
+  // FNV-1a.
+  for (uint8_t b : bytes) {
+    *hash ^= b;
+    *hash *= 1099511628211ull;
+  }
+  *hash ^= bytes.size();
+  *hash *= 1099511628211ull;
+}
+
+}  // namespace
+
+size_t AccessBlackListManagerImpl::KeyHash::operator()(const Key& key) const {
+  size_t hash = 14695981039346656037ull;
+  HashBytes(key.first, &hash);
+  HashBytes(key.second, &hash);
+  return hash;
 }
 
 AccessBlackListManagerImpl::AccessBlackListManagerImpl(
     provider::ConfigStore* store,
+    provider::TaskRunner* task_runner,
     size_t capacity,
     base::Clock* clock)
-    : capacity_{capacity}, clock_{clock}, store_{store} {
+    : capacity_{capacity},
+      clock_{clock ? clock : &default_clock_},
+      store_{store},
+      task_runner_{task_runner} {
   Load();
 }
 
 void AccessBlackListManagerImpl::Load() {
   if (!store_)
     return;
+
+  size_t loaded = 0;
   if (auto list = base::ListValue::From(
           base::JSONReader::Read(store_->LoadSettings(kConfigFileName)))) {
     for (const auto& e : *list) {
-      const base::DictionaryValue* entry{nullptr};
-      std::string user;
-      std::string app;
-      decltype(entries_)::key_type key;
-      int expiration;
-      if (e->GetAsDictionary(&entry) && entry->GetString(kUser, &user) &&
-          Base64Decode(user, &key.first) && entry->GetString(kApp, &app) &&
-          Base64Decode(app, &key.second) &&
-          entry->GetInteger(kExpiration, &expiration)) {
-        base::Time expiration_time = base::Time::FromTimeT(expiration);
-        if (expiration_time > clock_->Now())
-          entries_[key] = expiration_time;
+      Key key;
+      base::Time expiration;
+      if (EntryFromJson(*e, &key.first, &key.second, &expiration)) {
+        entries_[key] = expiration;
+        ++loaded;
       }
     }
-    if (entries_.size() < list->GetSize()) {
-      // Save some storage space by saving without expired entries.
-      Save({});
+  }
+
+  // Replay changes made after the snapshot was saved. Records are idempotent,
+  // so it's fine if some of them are already included in the snapshot.
+  journal_ = store_->LoadSettings(kJournalFileName);
+  for (const auto& line : Split(journal_, "\n", false, true)) {
+    Key key;
+    base::Time expiration;
+    auto value = base::JSONReader::Read(line);
+    if (!value || !EntryFromJson(*value, &key.first, &key.second, &expiration))
+      continue;
+    ++journal_size_;
+    if (expiration.is_null()) {
+      entries_.erase(key);
+    } else {
+      auto& current = entries_[key];
+      current = std::max(current, expiration);
     }
   }
+
+  for (const auto& e : entries_)
+    PushExpiration(e.first, e.second);
+  RemoveExpired();
+
+  if (journal_size_ > 0 || entries_.size() < loaded) {
+    // Save some storage space by saving without expired entries and merging
+    // the journal.
+    ScheduleCompaction();
+  }
 }
 
-void AccessBlackListManagerImpl::Save(const DoneCallback& callback) {
+void AccessBlackListManagerImpl::AppendToJournal(const Key& key,
+                                                 const base::Time& expiration,
+                                                 const DoneCallback& callback) {
   if (!store_) {
     if (!callback.is_null())
       callback.Run(nullptr);
     return;
   }
 
+  std::string record;
+  base::JSONWriter::Write(*EntryToJson(key.first, key.second, expiration),
+                          &record);
+  journal_ += record;
+  journal_ += '\n';
+  ++journal_size_;
+  store_->SaveSettings(kJournalFileName, journal_, callback);
+
+  if (journal_size_ >= kMaxJournalSize)
+    ScheduleCompaction();
+}
+
+void AccessBlackListManagerImpl::ScheduleCompaction() {
+  if (!task_runner_)
+    return Compact();
+
+  if (compaction_scheduled_)
+    return;
+  compaction_scheduled_ = true;
+  task_runner_->PostDelayedTask(
+      FROM_HERE, base::Bind(&AccessBlackListManagerImpl::Compact,
+                            weak_ptr_factory_.GetWeakPtr()),
+      {});
+}
+
+void AccessBlackListManagerImpl::Compact() {
+  compaction_scheduled_ = false;
+  RemoveExpired();
+
   base::ListValue list;
   for (const auto& e : entries_) {
-    scoped_ptr<base::DictionaryValue> entry{new base::DictionaryValue};
-    entry->SetString(kUser, Base64Encode(e.first.first));
-    entry->SetString(kApp, Base64Encode(e.first.second));
-    entry->SetInteger(kExpiration, e.second.ToTimeT());
-    list.Append(std::move(entry));
+    list.Append(
+        EntryToJson(e.first.first, e.first.second, e.second).release());
   }
 
   std::string json;
   base::JSONWriter::Write(list, &json);
-  store_->SaveSettings(kConfigFileName, json, callback);
+  store_->SaveSettings(kConfigFileName, json, {});
+
+  // Snapshot is saved first, so the journal is never lost. Crash before the
+  // next line just leaves records which will be replayed on top of snapshot.
+  if (!journal_.empty()) {
+    journal_.clear();
+    journal_size_ = 0;
+    store_->SaveSettings(kJournalFileName, journal_, {});
+  }
+}
+
+void AccessBlackListManagerImpl::PushExpiration(const Key& key,
+                                                const base::Time& expiration) {
+  if (expirations_.size() > 2 * (entries_.size() + kMaxJournalSize)) {
+    // Too many stale items, rebuild the heap from scratch.
+    std::vector<Expiration> items;
+    items.reserve(entries_.size() + 1);
+    for (const auto& e : entries_)
+      items.emplace_back(e.second, e.first);
+    expirations_ = decltype(expirations_){{}, std::move(items)};
+    return;
+  }
+  expirations_.emplace(expiration, key);
 }
 
 void AccessBlackListManagerImpl::RemoveExpired() {
-  for (auto i = begin(entries_); i != end(entries_);) {
-    if (i->second <= clock_->Now())
-      i = entries_.erase(i);
-    else
-      ++i;
+  const base::Time now = clock_->Now();
+  while (!expirations_.empty() && expirations_.top().first <= now) {
+    auto it = entries_.find(expirations_.top().second);
+    if (it != entries_.end() && it->second <= now)
+      entries_.erase(it);
+    expirations_.pop();
   }
 }
 
@@ -90,7 +222,6 @@ void AccessBlackListManagerImpl::Block(const std::vector<uint8_t>& user_id,
                                        const std::vector<uint8_t>& app_id,
                                        const base::Time& expiration,
                                        const DoneCallback& callback) {
-  // Iterating is OK as Save below is more expensive.
   RemoveExpired();
   if (expiration <= clock_->Now()) {
     if (!callback.is_null()) {
@@ -110,15 +241,20 @@ void AccessBlackListManagerImpl::Block(const std::vector<uint8_t>& user_id,
     }
     return;
   }
-  auto& value = entries_[std::make_pair(user_id, app_id)];
-  value = std::max(value, expiration);
-  Save(callback);
+  Key key{user_id, app_id};
+  auto& value = entries_[key];
+  if (value < expiration) {
+    value = expiration;
+    PushExpiration(key, expiration);
+  }
+  AppendToJournal(key, expiration, callback);
 }
 
 void AccessBlackListManagerImpl::Unblock(const std::vector<uint8_t>& user_id,
                                          const std::vector<uint8_t>& app_id,
                                          const DoneCallback& callback) {
-  if (!entries_.erase(std::make_pair(user_id, app_id))) {
+  Key key{user_id, app_id};
+  if (!entries_.erase(key)) {
     if (!callback.is_null()) {
       ErrorPtr error;
       Error::AddTo(&error, FROM_HERE, "entry_not_found", "Unknown entry");
@@ -126,18 +262,21 @@ void AccessBlackListManagerImpl::Unblock(const std::vector<uint8_t>& user_id,
     }
     return;
   }
-  // Iterating is OK as Save below is more expensive.
   RemoveExpired();
-  Save(callback);
+  // Null expiration marks removed entry.
+  AppendToJournal(key, {}, callback);
 }
 
 bool AccessBlackListManagerImpl::IsBlocked(
     const std::vector<uint8_t>& user_id,
     const std::vector<uint8_t>& app_id) const {
+  if (entries_.empty())
+    return false;
+  const base::Time now = clock_->Now();
   for (const auto& user : {{}, user_id}) {
     for (const auto& app : {{}, app_id}) {
       auto both = entries_.find(std::make_pair(user, app));
-      if (both != end(entries_) && both->second > clock_->Now())
+      if (both != end(entries_) && both->second > now)
         return true;
     }
   }
@@ -147,8 +286,13 @@ bool AccessBlackListManagerImpl::IsBlocked(
 std::vector<AccessBlackListManager::Entry>
 AccessBlackListManagerImpl::GetEntries() const {
   std::vector<Entry> result;
+  result.reserve(entries_.size());
   for (const auto& e : entries_)
     result.push_back({e.first.first, e.first.second, e.second});
+  // Keep order stable for callers, hash table order is arbitrary.
+  std::sort(result.begin(), result.end(), [](const Entry& l, const Entry& r) {
+    return std::tie(l.user_id, l.app_id) < std::tie(r.user_id, r.app_id);
+  });
   return result;
 }
 
@@ -5,21 +5,33 @@
 #ifndef LIBWEAVE_SRC_ACCESS_BLACK_LIST_IMPL_H_
 #define LIBWEAVE_SRC_ACCESS_BLACK_LIST_IMPL_H_
 
-#include <map>
+#include <functional>
+#include <queue>
+#include <string>
+#include <unordered_map>
 #include <utility>
 
+#include <base/memory/weak_ptr.h>
 #include <base/time/default_clock.h>
 #include <base/time/time.h>
 #include <weave/error.h>
 #include <weave/provider/config_store.h>
+#include <weave/provider/task_runner.h>
 
 #include "src/access_black_list_manager.h"
 
 namespace weave {
 
+// Keeps entries in a hash table indexed by (user_id, app_id) and expiration
+// times in a min-heap, so lookups and expiration are cheap regardless of the
+// size of the list.
+// Changes are persisted as a journal next to a snapshot of the whole list.
+// ConfigStore only saves whole blobs, so the journal is bounded by a small
+// number of records and merged into the snapshot on |task_runner| when full.
 class AccessBlackListManagerImpl : public AccessBlackListManager {
  public:
   explicit AccessBlackListManagerImpl(provider::ConfigStore* store,
+                                      provider::TaskRunner* task_runner,
                                       size_t capacity = 1024,
                                       base::Clock* clock = nullptr);
 
@@ -38,18 +50,43 @@ class AccessBlackListManagerImpl : public AccessBlackListManager {
   size_t GetCapacity() const override;
 
  private:
+  using Key = std::pair<std::vector<uint8_t>, std::vector<uint8_t>>;
+  using Expiration = std::pair<base::Time, Key>;
+
+  struct KeyHash {
+    size_t operator()(const Key& key) const;
+  };
+
   void Load();
-  void Save(const DoneCallback& callback);
+  void AppendToJournal(const Key& key,
+                       const base::Time& expiration,
+                       const DoneCallback& callback);
+  void ScheduleCompaction();
+  void Compact();
   void RemoveExpired();
+  void PushExpiration(const Key& key, const base::Time& expiration);
 
   const size_t capacity_{0};
   base::DefaultClock default_clock_;
   base::Clock* clock_{&default_clock_};
 
   provider::ConfigStore* store_{nullptr};
-  std::map<std::pair<std::vector<uint8_t>, std::vector<uint8_t>>, base::Time>
-      entries_;
+  provider::TaskRunner* task_runner_{nullptr};
+  std::unordered_map<Key, base::Time, KeyHash> entries_;
+
+  // May contain stale items for entries which were extended or removed. Such
+  // items are dropped when they reach the top of the heap.
+  std::priority_queue<Expiration,
+                      std::vector<Expiration>,
+                      std::greater<Expiration>>
+      expirations_;
+
+  // Serialized journal records not yet merged into the snapshot, one per line.
+  std::string journal_;
+  size_t journal_size_{0};
+  bool compaction_scheduled_{false};
 
+  base::WeakPtrFactory<AccessBlackListManagerImpl> weak_ptr_factory_{this};
   DISALLOW_COPY_AND_ASSIGN(AccessBlackListManagerImpl);
 };
 
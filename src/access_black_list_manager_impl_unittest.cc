@@ -4,8 +4,12 @@
 
 #include "src/access_black_list_manager_impl.h"
 
+#include <algorithm>
+
 #include <gmock/gmock.h>
+#include <base/json/json_reader.h>
 #include <gtest/gtest.h>
+#include <weave/provider/test/fake_task_runner.h>
 #include <weave/provider/test/mock_config_store.h>
 #include <weave/test/unittest_utils.h>
 
@@ -33,6 +37,8 @@ class AccessBlackListManagerImplTest : public testing::Test {
 
     EXPECT_CALL(config_store_, LoadSettings("black_list"))
         .WillOnce(Return(to_load));
+    EXPECT_CALL(config_store_, LoadSettings("black_list_journal"))
+        .WillOnce(Return(""));
 
     EXPECT_CALL(config_store_, SaveSettings("black_list", _, _))
         .WillOnce(testing::WithArgs<1, 2>(testing::Invoke(
@@ -49,13 +55,49 @@ class AccessBlackListManagerImplTest : public testing::Test {
 
     EXPECT_CALL(clock_, Now())
         .WillRepeatedly(Return(base::Time::FromTimeT(1412121212)));
-    manager_.reset(new AccessBlackListManagerImpl{&config_store_, 10, &clock_});
+    manager_.reset(
+        new AccessBlackListManagerImpl{&config_store_, nullptr, 10, &clock_});
   }
+
+  void ExpectJournal(const std::string& journal) {
+    EXPECT_CALL(config_store_, SaveSettings("black_list_journal", journal, _))
+        .WillOnce(testing::WithArgs<2>(
+            testing::Invoke([](const DoneCallback& callback) {
+              if (!callback.is_null())
+                callback.Run(nullptr);
+            })));
+  }
+
   StrictMock<test::MockClock> clock_;
   StrictMock<provider::test::MockConfigStore> config_store_{false};
   std::unique_ptr<AccessBlackListManagerImpl> manager_;
 };
 
+TEST(AccessBlackListManagerImplDefaultClockTest, Load) {
+  provider::test::MockConfigStore config_store;
+  AccessBlackListManagerImpl manager{&config_store, nullptr};
+  EXPECT_EQ(0u, manager.GetSize());
+}
+
+TEST(AccessBlackListManagerImplJournalTest, JournalIsBounded) {
+  provider::test::MockConfigStore config_store;
+  size_t max_records = 0;
+  EXPECT_CALL(config_store, SaveSettings("black_list_journal", _, _))
+      .WillRepeatedly(testing::WithArgs<1>(
+          testing::Invoke([&max_records](const std::string& journal) {
+            max_records = std::max<size_t>(
+                max_records, std::count(journal.begin(), journal.end(), '\n'));
+          })));
+  AccessBlackListManagerImpl manager{&config_store, nullptr, 100};
+  // Journal stays small when the list is much longer than it.
+  for (uint8_t i = 0; i < 80; ++i) {
+    manager.Block({i}, {i}, base::Time::Now() + base::TimeDelta::FromDays(1),
+                  {});
+  }
+  EXPECT_EQ(80u, manager.GetSize());
+  EXPECT_EQ(16u, max_records);
+}
+
 TEST_F(AccessBlackListManagerImplTest, Init) {
   EXPECT_EQ(1u, manager_->GetSize());
   EXPECT_EQ(10u, manager_->GetCapacity());
@@ -66,23 +108,99 @@ TEST_F(AccessBlackListManagerImplTest, Init) {
 }
 
 TEST_F(AccessBlackListManagerImplTest, Block) {
+  ExpectJournal(R"({"app":"CAgI","expiration":1419990000,"user":"BwcH"})"
+                "\n");
+  manager_->Block({7, 7, 7}, {8, 8, 8}, base::Time::FromTimeT(1419990000), {});
+  EXPECT_EQ(2u, manager_->GetSize());
+}
+
+TEST_F(AccessBlackListManagerImplTest, BlockAppendsToJournal) {
+  testing::InSequence s;
+  ExpectJournal(R"({"app":"CAgI","expiration":1419990000,"user":"BwcH"})"
+                "\n");
+  ExpectJournal(R"({"app":"CAgI","expiration":1419990000,"user":"BwcH"})"
+                "\n"
+                R"({"app":"CQkJ","expiration":1419990001,"user":"BwcH"})"
+                "\n");
+  manager_->Block({7, 7, 7}, {8, 8, 8}, base::Time::FromTimeT(1419990000), {});
+  manager_->Block({7, 7, 7}, {9, 9, 9}, base::Time::FromTimeT(1419990001), {});
+  EXPECT_EQ(3u, manager_->GetSize());
+}
+
+TEST_F(AccessBlackListManagerImplTest, BlockCompactsJournal) {
+  EXPECT_CALL(config_store_, SaveSettings("black_list_journal", _, _))
+      .Times(15)
+      .WillRepeatedly(testing::Return());
+  for (int i = 0; i < 15; ++i) {
+    manager_->Block({7, 7, 7}, {8, 8, 8},
+                    base::Time::FromTimeT(1419990000 + i), {});
+  }
+
+  testing::InSequence s;
+  EXPECT_CALL(config_store_, SaveSettings("black_list_journal", _, _))
+      .WillOnce(testing::Return());
   EXPECT_CALL(config_store_, SaveSettings("black_list", _, _))
-      .WillOnce(testing::WithArgs<1, 2>(testing::Invoke(
-          [](const std::string& json, const DoneCallback& callback) {
-            std::string to_save = R"([{
+      .WillOnce(testing::WithArgs<1>(
+          testing::Invoke([](const std::string& json) {
+            // Order of entries is not defined.
+            auto list = base::ListValue::From(
+                base::JSONReader::Read(json));
+            ASSERT_TRUE(list);
+            EXPECT_EQ(2u, list->GetSize());
+            EXPECT_NE(list->end(), list->Find(*test::CreateValue(R"({
                 "user": "AQID",
                 "app": "AwQF",
                 "expiration": 1419999999
-              }, {
+              })")));
+            EXPECT_NE(list->end(), list->Find(*test::CreateValue(R"({
+                "user": "BwcH",
+                "app": "CAgI",
+                "expiration": 1419990015
+              })")));
+          })));
+  ExpectJournal("");
+  manager_->Block({7, 7, 7}, {8, 8, 8}, base::Time::FromTimeT(1419990015), {});
+  EXPECT_EQ(2u, manager_->GetSize());
+}
+
+TEST_F(AccessBlackListManagerImplTest, LoadJournal) {
+  EXPECT_CALL(config_store_, LoadSettings("black_list"))
+      .WillOnce(Return(R"([{
+        "user": "AQID",
+        "app": "AwQF",
+        "expiration": 1419999999
+      }])"));
+  EXPECT_CALL(config_store_, LoadSettings("black_list_journal"))
+      .WillOnce(Return(
+          R"({"app":"CAgI","expiration":1419990000,"user":"BwcH"})"
+          "\n"
+          R"({"app":"AwQF","expiration":0,"user":"AQID"})"
+          "\n"
+          R"({"app":"CAgI","expiration":1419980000,"user":"BwcH"})"
+          "\n"
+          "broken\n"));
+
+  provider::test::FakeTaskRunner task_runner;
+  AccessBlackListManagerImpl manager{&config_store_, &task_runner, 10, &clock_};
+  EXPECT_EQ((std::vector<AccessBlackListManagerImpl::Entry>{{
+                {7, 7, 7}, {8, 8, 8}, base::Time::FromTimeT(1419990000),
+            }}),
+            manager.GetEntries());
+
+  // Compaction runs in background.
+  testing::InSequence s;
+  EXPECT_CALL(config_store_, SaveSettings("black_list", _, _))
+      .WillOnce(testing::WithArgs<1>(
+          testing::Invoke([](const std::string& json) {
+            std::string to_save = R"([{
                 "app": "CAgI",
                 "user": "BwcH",
                 "expiration": 1419990000
               }])";
             EXPECT_JSON_EQ(to_save, *test::CreateValue(json));
-            if (!callback.is_null())
-              callback.Run(nullptr);
           })));
-  manager_->Block({7, 7, 7}, {8, 8, 8}, base::Time::FromTimeT(1419990000), {});
+  ExpectJournal("");
+  task_runner.RunOnce();
 }
 
 TEST_F(AccessBlackListManagerImplTest, BlockExpired) {
@@ -93,7 +211,7 @@ TEST_F(AccessBlackListManagerImplTest, BlockExpired) {
 }
 
 TEST_F(AccessBlackListManagerImplTest, BlockListIsFull) {
-  EXPECT_CALL(config_store_, SaveSettings("black_list", _, _))
+  EXPECT_CALL(config_store_, SaveSettings("black_list_journal", _, _))
       .WillRepeatedly(testing::WithArgs<1, 2>(testing::Invoke(
           [](const std::string& json, const DoneCallback& callback) {
             if (!callback.is_null())
@@ -111,15 +229,30 @@ TEST_F(AccessBlackListManagerImplTest, BlockListIsFull) {
                   }));
 }
 
+TEST_F(AccessBlackListManagerImplTest, BlockRemovesExpired) {
+  ExpectJournal(R"({"app":"CAgI","expiration":1413000000,"user":"BwcH"})"
+                "\n");
+  manager_->Block({7, 7, 7}, {8, 8, 8}, base::Time::FromTimeT(1413000000), {});
+  EXPECT_TRUE(manager_->IsBlocked({7, 7, 7}, {8, 8, 8}));
+
+  EXPECT_CALL(clock_, Now())
+      .WillRepeatedly(Return(base::Time::FromTimeT(1414000000)));
+  EXPECT_FALSE(manager_->IsBlocked({7, 7, 7}, {8, 8, 8}));
+  EXPECT_CALL(config_store_, SaveSettings("black_list_journal", _, _))
+      .WillOnce(testing::Return());
+  manager_->Block({5, 5, 5}, {8, 8, 8}, base::Time::FromTimeT(1419990000), {});
+  EXPECT_EQ((std::vector<AccessBlackListManagerImpl::Entry>{
+                {{1, 2, 3}, {3, 4, 5}, base::Time::FromTimeT(1419999999)},
+                {{5, 5, 5}, {8, 8, 8}, base::Time::FromTimeT(1419990000)},
+            }),
+            manager_->GetEntries());
+}
+
 TEST_F(AccessBlackListManagerImplTest, Unblock) {
-  EXPECT_CALL(config_store_, SaveSettings("black_list", _, _))
-      .WillOnce(testing::WithArgs<1, 2>(testing::Invoke(
-          [](const std::string& json, const DoneCallback& callback) {
-            EXPECT_JSON_EQ("[]", *test::CreateValue(json));
-            if (!callback.is_null())
-              callback.Run(nullptr);
-          })));
+  ExpectJournal(R"({"app":"AwQF","expiration":0,"user":"AQID"})"
+                "\n");
   manager_->Unblock({1, 2, 3}, {3, 4, 5}, {});
+  EXPECT_EQ(0u, manager_->GetSize());
 }
 
 TEST_F(AccessBlackListManagerImplTest, UnblockNotFound) {
@@ -139,7 +272,7 @@ class AccessBlackListManagerImplIsBlockedTest
  public:
   void SetUp() override {
     AccessBlackListManagerImplTest::SetUp();
-    EXPECT_CALL(config_store_, SaveSettings("black_list", _, _))
+    EXPECT_CALL(config_store_, SaveSettings("black_list_journal", _, _))
         .WillOnce(testing::WithArgs<2>(
             testing::Invoke([](const DoneCallback& callback) {
               if (!callback.is_null())
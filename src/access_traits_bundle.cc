@@ -0,0 +1,52 @@
+// Generated by trait_bundle_compiler from src/access_traits.json. Do not edit.
+
+#include <stddef.h>
+#include <stdint.h>
+
+extern const uint8_t kAccessTraitsBundle[] = {
+    0x57, 0x54, 0x42, 0x01, 0x07, 0x01, 0x17, 0x5f, 0x61, 0x63, 0x63, 0x65,
+    0x73, 0x73, 0x43, 0x6f, 0x6e, 0x74, 0x72, 0x6f, 0x6c, 0x42, 0x6c, 0x61,
+    0x63, 0x6b, 0x4c, 0x69, 0x73, 0x74, 0x07, 0x02, 0x08, 0x63, 0x6f, 0x6d,
+    0x6d, 0x61, 0x6e, 0x64, 0x73, 0x07, 0x03, 0x05, 0x62, 0x6c, 0x6f, 0x63,
+    0x6b, 0x07, 0x02, 0x0b, 0x6d, 0x69, 0x6e, 0x69, 0x6d, 0x61, 0x6c, 0x52,
+    0x6f, 0x6c, 0x65, 0x05, 0x05, 0x6f, 0x77, 0x6e, 0x65, 0x72, 0x0a, 0x70,
+    0x61, 0x72, 0x61, 0x6d, 0x65, 0x74, 0x65, 0x72, 0x73, 0x07, 0x03, 0x0d,
+    0x61, 0x70, 0x70, 0x6c, 0x69, 0x63, 0x61, 0x74, 0x69, 0x6f, 0x6e, 0x49,
+    0x64, 0x07, 0x01, 0x04, 0x74, 0x79, 0x70, 0x65, 0x05, 0x06, 0x73, 0x74,
+    0x72, 0x69, 0x6e, 0x67, 0x14, 0x65, 0x78, 0x70, 0x69, 0x72, 0x61, 0x74,
+    0x69, 0x6f, 0x6e, 0x54, 0x69, 0x6d, 0x65, 0x6f, 0x75, 0x74, 0x53, 0x65,
+    0x63, 0x07, 0x01, 0x04, 0x74, 0x79, 0x70, 0x65, 0x05, 0x07, 0x69, 0x6e,
+    0x74, 0x65, 0x67, 0x65, 0x72, 0x06, 0x75, 0x73, 0x65, 0x72, 0x49, 0x64,
+    0x07, 0x01, 0x04, 0x74, 0x79, 0x70, 0x65, 0x05, 0x06, 0x73, 0x74, 0x72,
+    0x69, 0x6e, 0x67, 0x04, 0x6c, 0x69, 0x73, 0x74, 0x07, 0x03, 0x0b, 0x6d,
+    0x69, 0x6e, 0x69, 0x6d, 0x61, 0x6c, 0x52, 0x6f, 0x6c, 0x65, 0x05, 0x05,
+    0x6f, 0x77, 0x6e, 0x65, 0x72, 0x0a, 0x70, 0x61, 0x72, 0x61, 0x6d, 0x65,
+    0x74, 0x65, 0x72, 0x73, 0x07, 0x00, 0x07, 0x72, 0x65, 0x73, 0x75, 0x6c,
+    0x74, 0x73, 0x07, 0x01, 0x09, 0x62, 0x6c, 0x61, 0x63, 0x6b, 0x4c, 0x69,
+    0x73, 0x74, 0x07, 0x02, 0x05, 0x69, 0x74, 0x65, 0x6d, 0x73, 0x07, 0x03,
+    0x14, 0x61, 0x64, 0x64, 0x69, 0x74, 0x69, 0x6f, 0x6e, 0x61, 0x6c, 0x50,
+    0x72, 0x6f, 0x70, 0x65, 0x72, 0x74, 0x69, 0x65, 0x73, 0x01, 0x0a, 0x70,
+    0x72, 0x6f, 0x70, 0x65, 0x72, 0x74, 0x69, 0x65, 0x73, 0x07, 0x02, 0x0d,
+    0x61, 0x70, 0x70, 0x6c, 0x69, 0x63, 0x61, 0x74, 0x69, 0x6f, 0x6e, 0x49,
+    0x64, 0x07, 0x01, 0x04, 0x74, 0x79, 0x70, 0x65, 0x05, 0x06, 0x73, 0x74,
+    0x72, 0x69, 0x6e, 0x67, 0x06, 0x75, 0x73, 0x65, 0x72, 0x49, 0x64, 0x07,
+    0x01, 0x04, 0x74, 0x79, 0x70, 0x65, 0x05, 0x06, 0x73, 0x74, 0x72, 0x69,
+    0x6e, 0x67, 0x04, 0x74, 0x79, 0x70, 0x65, 0x05, 0x06, 0x6f, 0x62, 0x6a,
+    0x65, 0x63, 0x74, 0x04, 0x74, 0x79, 0x70, 0x65, 0x05, 0x05, 0x61, 0x72,
+    0x72, 0x61, 0x79, 0x07, 0x75, 0x6e, 0x62, 0x6c, 0x6f, 0x63, 0x6b, 0x07,
+    0x02, 0x0b, 0x6d, 0x69, 0x6e, 0x69, 0x6d, 0x61, 0x6c, 0x52, 0x6f, 0x6c,
+    0x65, 0x05, 0x05, 0x6f, 0x77, 0x6e, 0x65, 0x72, 0x0a, 0x70, 0x61, 0x72,
+    0x61, 0x6d, 0x65, 0x74, 0x65, 0x72, 0x73, 0x07, 0x02, 0x0d, 0x61, 0x70,
+    0x70, 0x6c, 0x69, 0x63, 0x61, 0x74, 0x69, 0x6f, 0x6e, 0x49, 0x64, 0x07,
+    0x01, 0x04, 0x74, 0x79, 0x70, 0x65, 0x05, 0x06, 0x73, 0x74, 0x72, 0x69,
+    0x6e, 0x67, 0x06, 0x75, 0x73, 0x65, 0x72, 0x49, 0x64, 0x07, 0x01, 0x04,
+    0x74, 0x79, 0x70, 0x65, 0x05, 0x06, 0x73, 0x74, 0x72, 0x69, 0x6e, 0x67,
+    0x05, 0x73, 0x74, 0x61, 0x74, 0x65, 0x07, 0x02, 0x08, 0x63, 0x61, 0x70,
+    0x61, 0x63, 0x69, 0x74, 0x79, 0x07, 0x02, 0x0a, 0x69, 0x73, 0x52, 0x65,
+    0x71, 0x75, 0x69, 0x72, 0x65, 0x64, 0x02, 0x04, 0x74, 0x79, 0x70, 0x65,
+    0x05, 0x07, 0x69, 0x6e, 0x74, 0x65, 0x67, 0x65, 0x72, 0x04, 0x73, 0x69,
+    0x7a, 0x65, 0x07, 0x02, 0x0a, 0x69, 0x73, 0x52, 0x65, 0x71, 0x75, 0x69,
+    0x72, 0x65, 0x64, 0x02, 0x04, 0x74, 0x79, 0x70, 0x65, 0x05, 0x07, 0x69,
+    0x6e, 0x74, 0x65, 0x67, 0x65, 0x72,
+};
+extern const size_t kAccessTraitsBundleSize = sizeof(kAccessTraitsBundle);
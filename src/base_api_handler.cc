@@ -7,6 +7,7 @@
 #include <base/bind.h>
 #include <weave/device.h>
 
+#include "src/builtin_traits.h"
 #include "src/commands/schema_constants.h"
 #include "src/device_registration_info.h"
 
@@ -24,79 +25,8 @@ const char kBaseStatePairingEnabled[] = "base.localPairingEnabled";
 BaseApiHandler::BaseApiHandler(DeviceRegistrationInfo* device_info,
                                Device* device)
     : device_info_{device_info}, device_{device} {
-  device_->AddTraitDefinitionsFromJson(R"({
-    "base": {
-      "commands": {
-        "updateBaseConfiguration": {
-          "minimalRole": "manager",
-          "parameters": {
-            "localAnonymousAccessMaxRole": {
-              "enum": [ "none", "viewer", "user" ],
-              "type": "string"
-            },
-            "localDiscoveryEnabled": {
-              "type": "boolean"
-            },
-            "localPairingEnabled": {
-              "type": "boolean"
-            }
-          }
-        },
-        "updateDeviceInfo": {
-          "minimalRole": "manager",
-          "parameters": {
-            "description": {
-              "type": "string"
-            },
-            "location": {
-              "type": "string"
-            },
-            "name": {
-              "type": "string"
-            }
-          }
-        },
-        "reboot": {
-          "minimalRole": "user",
-          "parameters": {},
-          "errors": ["notEnoughBattery"]
-        },
-        "identify": {
-          "minimalRole": "user",
-          "parameters": {}
-        }
-      },
-      "state": {
-        "firmwareVersion": {
-          "type": "string",
-          "isRequired": true
-        },
-        "localDiscoveryEnabled": {
-          "type": "boolean",
-          "isRequired": true
-        },
-        "localAnonymousAccessMaxRole": {
-          "type": "string",
-          "enum": [ "none", "viewer", "user" ],
-        "isRequired": true
-        },
-        "localPairingEnabled": {
-          "type": "boolean",
-          "isRequired": true
-        },
-        "connectionStatus": {
-          "type": "string"
-        },
-        "network": {
-          "type": "object",
-          "additionalProperties": false,
-          "properties": {
-            "name": { "type": "string" }
-          }
-        }
-      }
-    }
-  })");
+  device_->AddTraitDefinitionsFromBundle(kBaseTraitsBundle,
+                                         kBaseTraitsBundleSize);
   CHECK(device_->AddComponent(kBaseComponent, {kBaseTrait}, nullptr));
   OnConfigChanged(device_->GetSettings());
 
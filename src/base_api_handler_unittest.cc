@@ -31,9 +31,9 @@ namespace weave {
 class BaseApiHandlerTest : public ::testing::Test {
  protected:
   void SetUp() override {
-    EXPECT_CALL(device_, AddTraitDefinitionsFromJson(_))
-        .WillRepeatedly(Invoke([this](const std::string& json) {
-          EXPECT_TRUE(component_manager_.LoadTraits(json, nullptr));
+    EXPECT_CALL(device_, AddTraitDefinitionsFromBundle(_, _))
+        .WillRepeatedly(Invoke([this](const uint8_t* data, size_t size) {
+          EXPECT_TRUE(component_manager_.LoadTraitBundle(data, size, nullptr));
         }));
     EXPECT_CALL(device_, SetStateProperties(_, _, _))
         .WillRepeatedly(
@@ -0,0 +1,75 @@
+// Generated by trait_bundle_compiler from src/base_traits.json. Do not edit.
+
+#include <stddef.h>
+#include <stdint.h>
+
+extern const uint8_t kBaseTraitsBundle[] = {
+    0x57, 0x54, 0x42, 0x01, 0x07, 0x01, 0x04, 0x62, 0x61, 0x73, 0x65, 0x07,
+    0x02, 0x08, 0x63, 0x6f, 0x6d, 0x6d, 0x61, 0x6e, 0x64, 0x73, 0x07, 0x04,
+    0x08, 0x69, 0x64, 0x65, 0x6e, 0x74, 0x69, 0x66, 0x79, 0x07, 0x02, 0x0b,
+    0x6d, 0x69, 0x6e, 0x69, 0x6d, 0x61, 0x6c, 0x52, 0x6f, 0x6c, 0x65, 0x05,
+    0x04, 0x75, 0x73, 0x65, 0x72, 0x0a, 0x70, 0x61, 0x72, 0x61, 0x6d, 0x65,
+    0x74, 0x65, 0x72, 0x73, 0x07, 0x00, 0x06, 0x72, 0x65, 0x62, 0x6f, 0x6f,
+    0x74, 0x07, 0x03, 0x06, 0x65, 0x72, 0x72, 0x6f, 0x72, 0x73, 0x06, 0x01,
+    0x05, 0x10, 0x6e, 0x6f, 0x74, 0x45, 0x6e, 0x6f, 0x75, 0x67, 0x68, 0x42,
+    0x61, 0x74, 0x74, 0x65, 0x72, 0x79, 0x0b, 0x6d, 0x69, 0x6e, 0x69, 0x6d,
+    0x61, 0x6c, 0x52, 0x6f, 0x6c, 0x65, 0x05, 0x04, 0x75, 0x73, 0x65, 0x72,
+    0x0a, 0x70, 0x61, 0x72, 0x61, 0x6d, 0x65, 0x74, 0x65, 0x72, 0x73, 0x07,
+    0x00, 0x17, 0x75, 0x70, 0x64, 0x61, 0x74, 0x65, 0x42, 0x61, 0x73, 0x65,
+    0x43, 0x6f, 0x6e, 0x66, 0x69, 0x67, 0x75, 0x72, 0x61, 0x74, 0x69, 0x6f,
+    0x6e, 0x07, 0x02, 0x0b, 0x6d, 0x69, 0x6e, 0x69, 0x6d, 0x61, 0x6c, 0x52,
+    0x6f, 0x6c, 0x65, 0x05, 0x07, 0x6d, 0x61, 0x6e, 0x61, 0x67, 0x65, 0x72,
+    0x0a, 0x70, 0x61, 0x72, 0x61, 0x6d, 0x65, 0x74, 0x65, 0x72, 0x73, 0x07,
+    0x03, 0x1b, 0x6c, 0x6f, 0x63, 0x61, 0x6c, 0x41, 0x6e, 0x6f, 0x6e, 0x79,
+    0x6d, 0x6f, 0x75, 0x73, 0x41, 0x63, 0x63, 0x65, 0x73, 0x73, 0x4d, 0x61,
+    0x78, 0x52, 0x6f, 0x6c, 0x65, 0x07, 0x02, 0x04, 0x65, 0x6e, 0x75, 0x6d,
+    0x06, 0x03, 0x05, 0x04, 0x6e, 0x6f, 0x6e, 0x65, 0x05, 0x06, 0x76, 0x69,
+    0x65, 0x77, 0x65, 0x72, 0x05, 0x04, 0x75, 0x73, 0x65, 0x72, 0x04, 0x74,
+    0x79, 0x70, 0x65, 0x05, 0x06, 0x73, 0x74, 0x72, 0x69, 0x6e, 0x67, 0x15,
+    0x6c, 0x6f, 0x63, 0x61, 0x6c, 0x44, 0x69, 0x73, 0x63, 0x6f, 0x76, 0x65,
+    0x72, 0x79, 0x45, 0x6e, 0x61, 0x62, 0x6c, 0x65, 0x64, 0x07, 0x01, 0x04,
+    0x74, 0x79, 0x70, 0x65, 0x05, 0x07, 0x62, 0x6f, 0x6f, 0x6c, 0x65, 0x61,
+    0x6e, 0x13, 0x6c, 0x6f, 0x63, 0x61, 0x6c, 0x50, 0x61, 0x69, 0x72, 0x69,
+    0x6e, 0x67, 0x45, 0x6e, 0x61, 0x62, 0x6c, 0x65, 0x64, 0x07, 0x01, 0x04,
+    0x74, 0x79, 0x70, 0x65, 0x05, 0x07, 0x62, 0x6f, 0x6f, 0x6c, 0x65, 0x61,
+    0x6e, 0x10, 0x75, 0x70, 0x64, 0x61, 0x74, 0x65, 0x44, 0x65, 0x76, 0x69,
+    0x63, 0x65, 0x49, 0x6e, 0x66, 0x6f, 0x07, 0x02, 0x0b, 0x6d, 0x69, 0x6e,
+    0x69, 0x6d, 0x61, 0x6c, 0x52, 0x6f, 0x6c, 0x65, 0x05, 0x07, 0x6d, 0x61,
+    0x6e, 0x61, 0x67, 0x65, 0x72, 0x0a, 0x70, 0x61, 0x72, 0x61, 0x6d, 0x65,
+    0x74, 0x65, 0x72, 0x73, 0x07, 0x03, 0x0b, 0x64, 0x65, 0x73, 0x63, 0x72,
+    0x69, 0x70, 0x74, 0x69, 0x6f, 0x6e, 0x07, 0x01, 0x04, 0x74, 0x79, 0x70,
+    0x65, 0x05, 0x06, 0x73, 0x74, 0x72, 0x69, 0x6e, 0x67, 0x08, 0x6c, 0x6f,
+    0x63, 0x61, 0x74, 0x69, 0x6f, 0x6e, 0x07, 0x01, 0x04, 0x74, 0x79, 0x70,
+    0x65, 0x05, 0x06, 0x73, 0x74, 0x72, 0x69, 0x6e, 0x67, 0x04, 0x6e, 0x61,
+    0x6d, 0x65, 0x07, 0x01, 0x04, 0x74, 0x79, 0x70, 0x65, 0x05, 0x06, 0x73,
+    0x74, 0x72, 0x69, 0x6e, 0x67, 0x05, 0x73, 0x74, 0x61, 0x74, 0x65, 0x07,
+    0x06, 0x10, 0x63, 0x6f, 0x6e, 0x6e, 0x65, 0x63, 0x74, 0x69, 0x6f, 0x6e,
+    0x53, 0x74, 0x61, 0x74, 0x75, 0x73, 0x07, 0x01, 0x04, 0x74, 0x79, 0x70,
+    0x65, 0x05, 0x06, 0x73, 0x74, 0x72, 0x69, 0x6e, 0x67, 0x0f, 0x66, 0x69,
+    0x72, 0x6d, 0x77, 0x61, 0x72, 0x65, 0x56, 0x65, 0x72, 0x73, 0x69, 0x6f,
+    0x6e, 0x07, 0x02, 0x0a, 0x69, 0x73, 0x52, 0x65, 0x71, 0x75, 0x69, 0x72,
+    0x65, 0x64, 0x02, 0x04, 0x74, 0x79, 0x70, 0x65, 0x05, 0x06, 0x73, 0x74,
+    0x72, 0x69, 0x6e, 0x67, 0x1b, 0x6c, 0x6f, 0x63, 0x61, 0x6c, 0x41, 0x6e,
+    0x6f, 0x6e, 0x79, 0x6d, 0x6f, 0x75, 0x73, 0x41, 0x63, 0x63, 0x65, 0x73,
+    0x73, 0x4d, 0x61, 0x78, 0x52, 0x6f, 0x6c, 0x65, 0x07, 0x03, 0x04, 0x65,
+    0x6e, 0x75, 0x6d, 0x06, 0x03, 0x05, 0x04, 0x6e, 0x6f, 0x6e, 0x65, 0x05,
+    0x06, 0x76, 0x69, 0x65, 0x77, 0x65, 0x72, 0x05, 0x04, 0x75, 0x73, 0x65,
+    0x72, 0x0a, 0x69, 0x73, 0x52, 0x65, 0x71, 0x75, 0x69, 0x72, 0x65, 0x64,
+    0x02, 0x04, 0x74, 0x79, 0x70, 0x65, 0x05, 0x06, 0x73, 0x74, 0x72, 0x69,
+    0x6e, 0x67, 0x15, 0x6c, 0x6f, 0x63, 0x61, 0x6c, 0x44, 0x69, 0x73, 0x63,
+    0x6f, 0x76, 0x65, 0x72, 0x79, 0x45, 0x6e, 0x61, 0x62, 0x6c, 0x65, 0x64,
+    0x07, 0x02, 0x0a, 0x69, 0x73, 0x52, 0x65, 0x71, 0x75, 0x69, 0x72, 0x65,
+    0x64, 0x02, 0x04, 0x74, 0x79, 0x70, 0x65, 0x05, 0x07, 0x62, 0x6f, 0x6f,
+    0x6c, 0x65, 0x61, 0x6e, 0x13, 0x6c, 0x6f, 0x63, 0x61, 0x6c, 0x50, 0x61,
+    0x69, 0x72, 0x69, 0x6e, 0x67, 0x45, 0x6e, 0x61, 0x62, 0x6c, 0x65, 0x64,
+    0x07, 0x02, 0x0a, 0x69, 0x73, 0x52, 0x65, 0x71, 0x75, 0x69, 0x72, 0x65,
+    0x64, 0x02, 0x04, 0x74, 0x79, 0x70, 0x65, 0x05, 0x07, 0x62, 0x6f, 0x6f,
+    0x6c, 0x65, 0x61, 0x6e, 0x07, 0x6e, 0x65, 0x74, 0x77, 0x6f, 0x72, 0x6b,
+    0x07, 0x03, 0x14, 0x61, 0x64, 0x64, 0x69, 0x74, 0x69, 0x6f, 0x6e, 0x61,
+    0x6c, 0x50, 0x72, 0x6f, 0x70, 0x65, 0x72, 0x74, 0x69, 0x65, 0x73, 0x01,
+    0x0a, 0x70, 0x72, 0x6f, 0x70, 0x65, 0x72, 0x74, 0x69, 0x65, 0x73, 0x07,
+    0x01, 0x04, 0x6e, 0x61, 0x6d, 0x65, 0x07, 0x01, 0x04, 0x74, 0x79, 0x70,
+    0x65, 0x05, 0x06, 0x73, 0x74, 0x72, 0x69, 0x6e, 0x67, 0x04, 0x74, 0x79,
+    0x70, 0x65, 0x05, 0x06, 0x6f, 0x62, 0x6a, 0x65, 0x63, 0x74,
+};
+extern const size_t kBaseTraitsBundleSize = sizeof(kBaseTraitsBundle);
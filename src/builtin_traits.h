@@ -0,0 +1,20 @@
+// Copyright 2016 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIBWEAVE_SRC_BUILTIN_TRAITS_H_
+#define LIBWEAVE_SRC_BUILTIN_TRAITS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Trait bundles of the traits which libweave implements itself. They are
+// compiled from src/base_traits.json and src/access_traits.json and checked
+// in, so builds need no generation step. Run `make update-trait-bundles` after
+// changing the JSON files.
+extern const uint8_t kBaseTraitsBundle[];
+extern const size_t kBaseTraitsBundleSize;
+extern const uint8_t kAccessTraitsBundle[];
+extern const size_t kAccessTraitsBundleSize;
+
+#endif  // LIBWEAVE_SRC_BUILTIN_TRAITS_H_
@@ -14,6 +14,26 @@
 
 namespace weave {
 
+namespace {
+
+bool IsFinalState(Command::State state) {
+  switch (state) {
+    case Command::State::kDone:
+    case Command::State::kCancelled:
+    case Command::State::kAborted:
+    case Command::State::kExpired:
+      return true;
+    case Command::State::kQueued:
+    case Command::State::kInProgress:
+    case Command::State::kPaused:
+    case Command::State::kError:
+      return false;
+  }
+  return false;
+}
+
+}  // namespace
+
 CloudCommandProxy::CloudCommandProxy(
     CommandInstance* command_instance,
     CloudCommandUpdateInterface* cloud_command_updater,
@@ -152,6 +172,10 @@ void CloudCommandProxy::OnUpdateCommandDone(ErrorPtr error) {
   if (!error) {
     // Remove the succeeded update from the queue.
     update_queue_.pop_front();
+    // Updates are queued on every state change, so the final state is
+    // acknowledged once nothing is left.
+    if (update_queue_.empty() && IsFinalState(command_instance_->GetState()))
+      command_instance_->RecordStage(CommandInstance::Stage::kAcknowledged);
   }
   // If we have more pending updates, send a new request to the server
   // immediately, if possible.
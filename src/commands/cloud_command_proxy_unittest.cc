@@ -164,6 +164,19 @@ TEST_F(CloudCommandProxyTest, ImmediateUpdate) {
   task_runner_.RunOnce();
 }
 
+TEST_F(CloudCommandProxyTest, AcknowledgeFinalState) {
+  DoneCallback callback;
+  EXPECT_CALL(cloud_updater_, UpdateCommand(kCmdID, _, _))
+      .WillOnce(SaveArg<2>(&callback));
+  command_instance_->Complete({}, nullptr);
+  task_runner_.RunOnce();
+  EXPECT_TRUE(command_instance_->GetStageTime(
+                  CommandInstance::Stage::kAcknowledged).is_null());
+  callback.Run(nullptr);
+  EXPECT_FALSE(command_instance_->GetStageTime(
+                   CommandInstance::Stage::kAcknowledged).is_null());
+}
+
 TEST_F(CloudCommandProxyTest, DelayedUpdate) {
   // Simulate that the current device state has changed.
   current_state_update_id_ = 20;
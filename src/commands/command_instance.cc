@@ -4,6 +4,8 @@
 
 #include "src/commands/command_instance.h"
 
+#include <mutex>
+
 #include <base/values.h>
 #include <weave/enum_to_string.h>
 #include <weave/error.h>
@@ -12,6 +14,9 @@
 #include "src/commands/command_queue.h"
 #include "src/commands/schema_constants.h"
 #include "src/json_error_codes.h"
+#include "src/memory_usage.h"
+#include "src/metrics.h"
+#include "src/trace_log.h"
 #include "src/utils.h"
 
 namespace weave {
@@ -34,6 +39,50 @@ const EnumToStringMap<Command::Origin>::Map kMapOrigin[] = {
     {Command::Origin::kCloud, "cloud"},
 };
 
+const char kTraceCategory[] = "command";
+
+const char* const kStageMetricNames[] = {
+    "commands.dispatch_ms", "commands.progress_ms", "commands.finish_ms",
+    "commands.ack_ms",
+};
+
+// Labels of CommandInstance::Arrival values, in order.
+const char* const kArrivalLabels[] = {
+    "other", "push", "fetch", "privet",
+};
+
+using StageHistograms = std::array<Histogram*, arraysize(kStageMetricNames)>;
+
+// Returns the stage histograms of commands with |origin|, |arrival| and
+// |name|. Metric names are built and registered once per command name, not per
+// command.
+const StageHistograms* GetStageHistograms(Command::Origin origin,
+                                          CommandInstance::Arrival arrival,
+                                          const std::string& name) {
+  // Commands of devices on different threads share the cache, like the
+  // registry. Never destroyed, like the registry.
+  static std::mutex* const mutex = new std::mutex;
+  static std::map<std::string, StageHistograms>* const histograms =
+      new std::map<std::string, StageHistograms>[2 * arraysize(kArrivalLabels)];
+  size_t arrival_index = static_cast<size_t>(arrival);
+  CHECK_LT(arrival_index, arraysize(kArrivalLabels));
+  auto& by_name = histograms[2 * arrival_index +
+                             (origin == Command::Origin::kLocal ? 0 : 1)];
+
+  std::lock_guard<std::mutex> lock{*mutex};
+  auto it = by_name.find(name);
+  if (it != by_name.end())
+    return &it->second;
+
+  StageHistograms& result = by_name[name];
+  for (size_t i = 0; i < result.size(); ++i) {
+    result[i] = MetricsRegistry::GetInstance()->GetHistogram(
+        std::string{kStageMetricNames[i]} + "{origin=" + EnumToString(origin) +
+        ",arrival=" + kArrivalLabels[arrival_index] + ",name=" + name + "}");
+  }
+  return &result;
+}
+
 bool ReportInvalidStateTransition(ErrorPtr* error,
                                   Command::State from,
                                   Command::State to) {
@@ -56,11 +105,16 @@ LIBWEAVE_EXPORT EnumToStringMap<Command::Origin>::EnumToStringMap()
 CommandInstance::CommandInstance(const std::string& name,
                                  Command::Origin origin,
                                  const base::DictionaryValue& parameters)
-    : name_{name}, origin_{origin} {
+    : name_{name},
+      origin_{origin},
+      arrival_time_{base::TimeTicks::Now()},
+      memory_usage_{GetMemoryGauge("commands")} {
   parameters_.MergeDictionary(&parameters);
+  UpdateMemoryUsage();
 }
 
 CommandInstance::~CommandInstance() {
+  EndTraceSpan();
   FOR_EACH_OBSERVER(Observer, observers_, OnCommandDestroyed());
 }
 
@@ -109,6 +163,7 @@ bool CommandInstance::SetProgress(const base::DictionaryValue& progress,
   if (!progress_.Equals(&progress)) {
     progress_.Clear();
     progress_.MergeDictionary(&progress);
+    UpdateMemoryUsage();
     FOR_EACH_OBSERVER(Observer, observers_, OnProgressChanged());
   }
 
@@ -120,6 +175,7 @@ bool CommandInstance::Complete(const base::DictionaryValue& results,
   if (!results_.Equals(&results)) {
     results_.Clear();
     results_.MergeDictionary(&results);
+    UpdateMemoryUsage();
     FOR_EACH_OBSERVER(Observer, observers_, OnResultsChanged());
   }
   // Change status even if result is unchanged.
@@ -131,6 +187,7 @@ bool CommandInstance::Complete(const base::DictionaryValue& results,
 
 bool CommandInstance::SetError(const Error* command_error, ErrorPtr* error) {
   error_ = command_error ? command_error->Clone() : nullptr;
+  UpdateMemoryUsage();
   FOR_EACH_OBSERVER(Observer, observers_, OnErrorChanged());
   return SetStatus(State::kError, error);
 }
@@ -246,6 +303,7 @@ bool CommandInstance::Pause(ErrorPtr* error) {
 
 bool CommandInstance::Abort(const Error* command_error, ErrorPtr* error) {
   error_ = command_error ? command_error->Clone() : nullptr;
+  UpdateMemoryUsage();
   FOR_EACH_OBSERVER(Observer, observers_, OnErrorChanged());
   bool result = SetStatus(State::kAborted, error);
   RemoveFromQueue();
@@ -278,10 +336,83 @@ bool CommandInstance::SetStatus(Command::State status, ErrorPtr* error) {
       break;
   }
   state_ = status;
+  switch (state_) {
+    case State::kDone:
+    case State::kCancelled:
+    case State::kAborted:
+    case State::kExpired:
+      RecordStage(Stage::kFinished);
+      EndTraceSpan();
+      break;
+    case State::kInProgress:
+      RecordStage(Stage::kInProgress);
+      break;
+    case State::kQueued:
+    case State::kPaused:
+    case State::kError:
+      break;
+  }
   FOR_EACH_OBSERVER(Observer, observers_, OnStateChanged());
   return true;
 }
 
+void CommandInstance::SetArrival(Arrival arrival) {
+  CHECK(!stage_histograms_) << "Arrival of a queued command can't change";
+  arrival_ = arrival;
+}
+
+void CommandInstance::RecordStage(Stage stage) {
+  size_t index = static_cast<size_t>(stage);
+  CHECK_LT(index, stage_times_.size());
+  if (!stage_times_[index].is_null())
+    return;
+  stage_times_[index] = base::TimeTicks::Now();
+  if (!stage_histograms_)
+    stage_histograms_ = GetStageHistograms(origin_, arrival_, name_);
+  (*stage_histograms_)[index]->AddTime(stage_times_[index] - arrival_time_);
+}
+
+base::TimeTicks CommandInstance::GetStageTime(Stage stage) const {
+  return stage_times_[static_cast<size_t>(stage)];
+}
+
+void CommandInstance::AttachToQueue(CommandQueue* queue) {
+  queue_ = queue;
+  // ID and component are known by now.
+  UpdateMemoryUsage();
+  if (!stage_histograms_)
+    stage_histograms_ = GetStageHistograms(origin_, arrival_, name_);
+  TraceLog* trace_log = TraceLog::GetInstance();
+  if (trace_span_id_ || !trace_log->IsEnabled())
+    return;
+  std::unique_ptr<base::DictionaryValue> args{new base::DictionaryValue};
+  args->SetString("id", id_);
+  args->SetString("component", component_);
+  args->SetString("origin", EnumToString(origin_));
+  trace_span_id_ =
+      trace_log->BeginSpan(kTraceCategory, name_, std::move(args));
+}
+
+void CommandInstance::EndTraceSpan() {
+  if (!trace_span_id_)
+    return;
+  std::unique_ptr<base::DictionaryValue> args{new base::DictionaryValue};
+  args->SetString("state", EnumToString(state_));
+  TraceLog::GetInstance()->EndSpan(kTraceCategory, name_, trace_span_id_,
+                                   std::move(args));
+  trace_span_id_ = 0;
+}
+
+void CommandInstance::UpdateMemoryUsage() {
+  size_t size = sizeof(*this) + EstimateMemoryUsage(id_) +
+                EstimateMemoryUsage(name_) + EstimateMemoryUsage(component_) +
+                EstimateMemoryUsage(parameters_) +
+                EstimateMemoryUsage(progress_) + EstimateMemoryUsage(results_);
+  for (const Error* error = error_.get(); error; error = error->GetInnerError())
+    size += sizeof(Error) + EstimateMemoryUsage(error->GetMessage());
+  memory_usage_.Set(size);
+}
+
 void CommandInstance::RemoveFromQueue() {
   if (queue_)
     queue_->RemoveLater(GetID());
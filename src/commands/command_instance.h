@@ -5,6 +5,7 @@
 #ifndef LIBWEAVE_SRC_COMMANDS_COMMAND_INSTANCE_H_
 #define LIBWEAVE_SRC_COMMANDS_COMMAND_INSTANCE_H_
 
+#include <array>
 #include <map>
 #include <memory>
 #include <string>
@@ -12,9 +13,12 @@
 
 #include <base/macros.h>
 #include <base/observer_list.h>
+#include <base/time/time.h>
 #include <weave/command.h>
 #include <weave/error.h>
 
+#include "src/memory_usage.h"
+
 namespace base {
 class Value;
 }  // namespace base
@@ -24,6 +28,7 @@ namespace weave {
 class CommandDictionary;
 class CommandObserver;
 class CommandQueue;
+class Histogram;
 
 class CommandInstance final : public Command {
  public:
@@ -39,6 +44,24 @@ class CommandInstance final : public Command {
     virtual ~Observer() {}
   };
 
+  // Stages of command processing. Latency of each stage since the arrival of
+  // the command, i.e. construction of the instance, is published as a
+  // histogram per command name, origin and arrival.
+  enum class Stage {
+    kDispatched,    // Passed to a handler.
+    kInProgress,    // Reported progress for the first time.
+    kFinished,      // Reached a final state.
+    kAcknowledged,  // The final state is accepted by the cloud.
+  };
+
+  // How the command reached the device.
+  enum class Arrival {
+    kOther,   // Added by the application or restored from settings.
+    kPush,    // Delivered in a notification, e.g. over XMPP.
+    kFetch,   // Fetched from the command queue of the cloud.
+    kPrivet,  // Posted to /privet/v3/commands/execute.
+  };
+
   // Construct a command instance given the full command |name| which must
   // be in format "<package_name>.<command_name>" and a list of parameters and
   // their values specified in |parameters|.
@@ -87,14 +110,29 @@ class CommandInstance final : public Command {
   void AddObserver(Observer* observer);
   void RemoveObserver(Observer* observer);
 
+  // Sets how the command reached the device. Must be called before the command
+  // is added to a queue or reaches any stage.
+  void SetArrival(Arrival arrival);
+
+  // Records that the command has reached |stage| now. Only the first call for
+  // each stage is recorded.
+  void RecordStage(Stage stage);
+  // Returns the time the command reached |stage|, or null time if it hasn't.
+  base::TimeTicks GetStageTime(Stage stage) const;
+  base::TimeTicks GetArrivalTime() const { return arrival_time_; }
+
   // Sets the pointer to queue this command is part of.
-  void AttachToQueue(CommandQueue* queue) { queue_ = queue; }
+  void AttachToQueue(CommandQueue* queue);
   void DetachFromQueue() { queue_ = nullptr; }
 
  private:
   // Helper function to update the command status.
   // Used by Abort(), Cancel(), Done() methods.
   bool SetStatus(Command::State status, ErrorPtr* error);
+  // Ends the trace span started by AttachToQueue(), if any.
+  void EndTraceSpan();
+  // Updates the memory accounted for this command after its values change.
+  void UpdateMemoryUsage();
   // Helper method that removes this command from the command queue.
   // Note that since the command queue owns the lifetime of the command instance
   // object, removing a command from the queue will also destroy it.
@@ -108,6 +146,7 @@ class CommandInstance final : public Command {
   std::string component_;
   // The origin of the command, either "local" or "cloud".
   Command::Origin origin_ = Command::Origin::kLocal;
+  Arrival arrival_ = Arrival::kOther;
   // Command parameters and their values.
   base::DictionaryValue parameters_;
   // Current command execution progress.
@@ -123,6 +162,17 @@ class CommandInstance final : public Command {
   // Pointer to the command queue this command instance is added to.
   // The queue owns the command instance, so it outlives this object.
   CommandQueue* queue_ = nullptr;
+  // Trace span from queueing to a final state.
+  uint64_t trace_span_id_ = 0;
+  // Times the command has reached each of the stages.
+  base::TimeTicks arrival_time_;
+  std::array<base::TimeTicks, 4> stage_times_;
+  // Histograms of the stages for the name, origin and arrival of this command,
+  // shared by all such commands. Looked up once, at AttachToQueue() or at the
+  // first RecordStage().
+  const std::array<Histogram*, 4>* stage_histograms_ = nullptr;
+  // Approximate memory held by this command.
+  TrackedMemory memory_usage_;
 
   DISALLOW_COPY_AND_ASSIGN(CommandInstance);
 };
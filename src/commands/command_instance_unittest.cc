@@ -7,6 +7,9 @@
 #include <gtest/gtest.h>
 #include <weave/test/unittest_utils.h>
 
+#include "src/metrics.h"
+#include "src/test/allocation_counter.h"
+
 namespace weave {
 
 using test::CreateDictionaryValue;
@@ -33,6 +36,70 @@ TEST(CommandInstanceTest, Test) {
   EXPECT_EQ(Command::Origin::kLocal, instance2.GetOrigin());
 }
 
+TEST(CommandInstanceTest, Stages) {
+  Histogram* progress = MetricsRegistry::GetInstance()->GetHistogram(
+      "commands.progress_ms{origin=local,arrival=other,name=robot.stages}");
+  Histogram* finish = MetricsRegistry::GetInstance()->GetHistogram(
+      "commands.finish_ms{origin=local,arrival=other,name=robot.stages}");
+  int64_t progress_count = progress->GetCount();
+  int64_t finish_count = finish->GetCount();
+
+  CommandInstance instance{"robot.stages", Command::Origin::kLocal, {}};
+  EXPECT_FALSE(instance.GetArrivalTime().is_null());
+  EXPECT_TRUE(
+      instance.GetStageTime(CommandInstance::Stage::kInProgress).is_null());
+  EXPECT_TRUE(instance.SetProgress({}, nullptr));
+  base::TimeTicks in_progress =
+      instance.GetStageTime(CommandInstance::Stage::kInProgress);
+  EXPECT_LE(instance.GetArrivalTime(), in_progress);
+  EXPECT_TRUE(instance.Pause(nullptr));
+  EXPECT_TRUE(instance.SetProgress({}, nullptr));
+  // Only the first time is recorded.
+  EXPECT_EQ(in_progress,
+            instance.GetStageTime(CommandInstance::Stage::kInProgress));
+  EXPECT_TRUE(instance.Complete({}, nullptr));
+  EXPECT_LE(in_progress,
+            instance.GetStageTime(CommandInstance::Stage::kFinished));
+
+  EXPECT_EQ(progress_count + 1, progress->GetCount());
+  EXPECT_EQ(finish_count + 1, finish->GetCount());
+}
+
+TEST(CommandInstanceTest, StagesByArrival) {
+  Histogram* other = MetricsRegistry::GetInstance()->GetHistogram(
+      "commands.dispatch_ms{origin=local,arrival=other,name=robot.arrival}");
+  Histogram* privet = MetricsRegistry::GetInstance()->GetHistogram(
+      "commands.dispatch_ms{origin=local,arrival=privet,name=robot.arrival}");
+  int64_t other_count = other->GetCount();
+  int64_t privet_count = privet->GetCount();
+
+  CommandInstance instance{"robot.arrival", Command::Origin::kLocal, {}};
+  instance.SetArrival(CommandInstance::Arrival::kPrivet);
+  instance.RecordStage(CommandInstance::Stage::kDispatched);
+
+  EXPECT_EQ(other_count, other->GetCount());
+  EXPECT_EQ(privet_count + 1, privet->GetCount());
+}
+
+TEST(CommandInstanceTest, RecordStageAllocations) {
+  CommandInstance first{"robot.stages", Command::Origin::kCloud, {}};
+  first.RecordStage(CommandInstance::Stage::kDispatched);
+
+  // Histograms are looked up by name once, for the first command.
+  CommandInstance instance{"robot.stages", Command::Origin::kCloud, {}};
+  EXPECT_MAX_ALLOCATIONS(
+      0, instance.RecordStage(CommandInstance::Stage::kDispatched));
+}
+
+TEST(CommandInstanceTest, SetProgressAllocations) {
+  CommandInstance instance{"robot.stages", Command::Origin::kLocal, {}};
+  EXPECT_TRUE(instance.SetProgress(*CreateDictionaryValue("{'p': 1}"),
+                                   nullptr));
+  auto progress = CreateDictionaryValue("{'p': 2}");
+  EXPECT_ALLOCATION_BUDGET(
+      2, EXPECT_TRUE(instance.SetProgress(*progress, nullptr)));
+}
+
 TEST(CommandInstanceTest, SetID) {
   CommandInstance instance{"base.reboot", Command::Origin::kLocal, {}};
   instance.SetID("command_id");
@@ -7,6 +7,8 @@
 #include <base/bind.h>
 #include <base/time/time.h>
 
+#include "src/metrics.h"
+
 namespace weave {
 
 namespace {
@@ -16,12 +18,30 @@ std::string GetCommandHandlerKey(const std::string& component_path,
                                  const std::string& command_name) {
   return component_path + ":" + command_name;
 }
+
+struct Metrics {
+  Counter* added{MetricsRegistry::GetInstance()->GetCounter("commands.added")};
+  Counter* no_handler{
+      MetricsRegistry::GetInstance()->GetCounter("commands.no_handler")};
+  Counter* removed{
+      MetricsRegistry::GetInstance()->GetCounter("commands.removed")};
+  Gauge* queued{MetricsRegistry::GetInstance()->GetGauge("commands.queued")};
+};
+
+const Metrics& GetMetrics() {
+  static const Metrics metrics;
+  return metrics;
+}
 }
 
 CommandQueue::CommandQueue(provider::TaskRunner* task_runner,
                            base::Clock* clock)
     : task_runner_{task_runner}, clock_{clock} {}
 
+CommandQueue::~CommandQueue() {
+  GetMetrics().queued->Add(-static_cast<int64_t>(map_.size()));
+}
+
 void CommandQueue::AddCommandAddedCallback(const CommandCallback& callback) {
   on_command_added_.push_back(callback);
   // Send all pre-existed commands.
@@ -45,6 +65,7 @@ void CommandQueue::AddCommandHandler(
       if (command.second->GetState() == Command::State::kQueued &&
           command.second->GetName() == command_name &&
           command.second->GetComponent() == component_path) {
+        command.second->RecordStage(CommandInstance::Stage::kDispatched);
         callback.Run(command.second);
       }
     }
@@ -61,6 +82,7 @@ void CommandQueue::AddCommandHandler(
                                              command.second->GetName());
       if (command.second->GetState() == Command::State::kQueued &&
           command_callbacks_.find(key) == command_callbacks_.end()) {
+        command.second->RecordStage(CommandInstance::Stage::kDispatched);
         callback.Run(command.second);
       }
     }
@@ -77,6 +99,8 @@ void CommandQueue::Add(std::unique_ptr<CommandInstance> instance) {
   auto pair = map_.insert(std::make_pair(id, std::move(instance)));
   LOG_IF(FATAL, !pair.second) << "Command with ID '" << id
                               << "' is already in the queue";
+  GetMetrics().added->Increment();
+  GetMetrics().queued->Add(1);
   for (const auto& cb : on_command_added_)
     cb.Run(pair.first->second.get());
 
@@ -84,10 +108,15 @@ void CommandQueue::Add(std::unique_ptr<CommandInstance> instance) {
                                          pair.first->second->GetName());
   auto it_handler = command_callbacks_.find(key);
 
-  if (it_handler != command_callbacks_.end())
+  if (it_handler != command_callbacks_.end()) {
+    pair.first->second->RecordStage(CommandInstance::Stage::kDispatched);
     it_handler->second.Run(pair.first->second);
-  else if (!default_command_callback_.is_null())
+  } else if (!default_command_callback_.is_null()) {
+    pair.first->second->RecordStage(CommandInstance::Stage::kDispatched);
     default_command_callback_.Run(pair.first->second);
+  } else {
+    GetMetrics().no_handler->Increment();
+  }
 }
 
 void CommandQueue::RemoveLater(const std::string& id) {
@@ -110,6 +139,8 @@ bool CommandQueue::Remove(const std::string& id) {
   std::shared_ptr<CommandInstance> instance = p->second;
   instance->DetachFromQueue();
   map_.erase(p);
+  GetMetrics().removed->Increment();
+  GetMetrics().queued->Add(-1);
   for (const auto& cb : on_command_removed_)
     cb.Run(instance.get());
   return true;
@@ -142,4 +173,12 @@ CommandInstance* CommandQueue::Find(const std::string& id) const {
   return (p != map_.end()) ? p->second.get() : nullptr;
 }
 
+std::vector<const CommandInstance*> CommandQueue::GetCommands() const {
+  std::vector<const CommandInstance*> commands;
+  commands.reserve(map_.size());
+  for (const auto& pair : map_)
+    commands.push_back(pair.second.get());
+  return commands;
+}
+
 }  // namespace weave
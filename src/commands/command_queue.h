@@ -26,6 +26,7 @@ namespace weave {
 class CommandQueue final {
  public:
   CommandQueue(provider::TaskRunner* task_runner, base::Clock* clock);
+  ~CommandQueue();
 
   // TODO: Remove AddCommandAddedCallback and AddCommandRemovedCallback.
   using CommandCallback = base::Callback<void(Command* command)>;
@@ -60,6 +61,9 @@ class CommandQueue final {
   // pointer should not be persisted for a long period of time.
   CommandInstance* Find(const std::string& id) const;
 
+  // Returns all command instances in the queue, ordered by ID.
+  std::vector<const CommandInstance*> GetCommands() const;
+
  private:
   friend class CommandQueueTest;
 
@@ -15,7 +15,9 @@
 #include <weave/provider/test/fake_task_runner.h>
 
 #include "src/bind_lambda.h"
+#include "src/metrics.h"
 #include "src/string_utils.h"
+#include "src/test/allocation_counter.h"
 
 namespace weave {
 
@@ -96,6 +98,14 @@ TEST_F(CommandQueueTest, Add) {
   EXPECT_FALSE(queue_.IsEmpty());
 }
 
+TEST_F(CommandQueueTest, AddAllocations) {
+  FakeDispatcher dispatcher(&queue_);
+  queue_.Add(CreateDummyCommandInstance("base.reboot", "id1"));
+  auto command = CreateDummyCommandInstance("base.reboot", "id2");
+  EXPECT_ALLOCATION_BUDGET(4, queue_.Add(std::move(command)));
+  EXPECT_MAX_ALLOCATIONS(0, EXPECT_TRUE(queue_.Find("id2")));
+}
+
 TEST_F(CommandQueueTest, Remove) {
   const std::string id1 = "id1";
   const std::string id2 = "id2";
@@ -115,6 +125,21 @@ TEST_F(CommandQueueTest, Remove) {
   EXPECT_TRUE(queue_.IsEmpty());
 }
 
+TEST_F(CommandQueueTest, Metrics) {
+  // Metrics are process-wide, so only changes are checked.
+  auto registry = MetricsRegistry::GetInstance();
+  int64_t added = registry->GetCounter("commands.added")->Get();
+  int64_t removed = registry->GetCounter("commands.removed")->Get();
+  int64_t queued = registry->GetGauge("commands.queued")->Get();
+
+  queue_.Add(CreateDummyCommandInstance("base.reboot", "id1"));
+  queue_.Add(CreateDummyCommandInstance("base.reboot", "id2"));
+  EXPECT_TRUE(Remove("id1"));
+  EXPECT_EQ(added + 2, registry->GetCounter("commands.added")->Get());
+  EXPECT_EQ(removed + 1, registry->GetCounter("commands.removed")->Get());
+  EXPECT_EQ(queued + 1, registry->GetGauge("commands.queued")->Get());
+}
+
 TEST_F(CommandQueueTest, RemoveLater) {
   const std::string id1 = "id1";
   queue_.Add(CreateDummyCommandInstance("base.reboot", id1));
@@ -0,0 +1,339 @@
+// Copyright 2016 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "src/commands/command_worker_pool.h"
+
+#include <base/bind.h>
+#include <base/logging.h>
+#include <weave/error.h>
+
+#include "src/commands/schema_constants.h"
+
+namespace weave {
+
+namespace {
+
+// Command method bound to its arguments.
+using CommandMethod = base::Callback<bool(Command* command, ErrorPtr* error)>;
+
+bool SetCommandProgress(const base::DictionaryValue* progress,
+                        Command* command,
+                        ErrorPtr* error) {
+  return command->SetProgress(*progress, error);
+}
+
+bool CompleteCommand(const base::DictionaryValue* results,
+                     Command* command,
+                     ErrorPtr* error) {
+  return command->Complete(*results, error);
+}
+
+bool PauseCommand(Command* command, ErrorPtr* error) {
+  return command->Pause(error);
+}
+
+bool SetCommandError(const Error* command_error,
+                     Command* command,
+                     ErrorPtr* error) {
+  return command->SetError(command_error, error);
+}
+
+bool AbortCommand(const Error* command_error,
+                  Command* command,
+                  ErrorPtr* error) {
+  return command->Abort(command_error, error);
+}
+
+bool CancelCommand(Command* command, ErrorPtr* error) {
+  return command->Cancel(error);
+}
+
+Error* CloneError(const Error* error) {
+  return error ? error->Clone().release() : nullptr;
+}
+
+}  // namespace
+
+struct CommandWorkerPool::Call {
+  CommandProxy* proxy{nullptr};
+  CommandMethod method;
+  bool done{false};
+  bool result{false};
+  ErrorPtr error;
+};
+
+struct CommandWorkerPool::Job {
+  Device::CommandHandlerCallback callback;
+  std::shared_ptr<CommandProxy> proxy;
+};
+
+// Command passed to handlers running on workers. Methods must be called from
+// a single worker thread at a time.
+class CommandWorkerPool::CommandProxy : public Command {
+ public:
+  CommandProxy(CommandWorkerPool* pool, const std::shared_ptr<Command>& command)
+      : pool_{pool},
+        command_{command},
+        id_{command->GetID()},
+        name_{command->GetName()},
+        component_{command->GetComponent()},
+        origin_{command->GetOrigin()} {
+    parameters_.MergeDictionary(&command->GetParameters());
+    Update(*command);
+  }
+
+  // Executes |call| on the libweave thread.
+  void Execute(Call* call) {
+    auto command = command_.lock();
+    if (!command) {
+      call->result = Error::AddTo(&call->error, FROM_HERE,
+                                  errors::commands::kCommandDestroyed,
+                                  "Command has been destroyed");
+      return;
+    }
+    call->result = call->method.Run(command.get(), &call->error);
+    Update(*command);
+  }
+
+  // Command implementation.
+  const std::string& GetID() const override { return id_; }
+  const std::string& GetName() const override { return name_; }
+  const std::string& GetComponent() const override { return component_; }
+  Command::State GetState() const override { return state_; }
+  Command::Origin GetOrigin() const override { return origin_; }
+  const base::DictionaryValue& GetParameters() const override {
+    return parameters_;
+  }
+  const base::DictionaryValue& GetProgress() const override {
+    return progress_;
+  }
+  const base::DictionaryValue& GetResults() const override { return results_; }
+  const Error* GetError() const override { return error_.get(); }
+
+  bool SetProgress(const base::DictionaryValue& progress,
+                   ErrorPtr* error) override {
+    return Run(base::Bind(&SetCommandProgress,
+                          base::Owned(progress.DeepCopy())),
+               error);
+  }
+  bool Complete(const base::DictionaryValue& results,
+                ErrorPtr* error) override {
+    return Run(base::Bind(&CompleteCommand, base::Owned(results.DeepCopy())),
+               error);
+  }
+  bool Pause(ErrorPtr* error) override {
+    return Run(base::Bind(&PauseCommand), error);
+  }
+  bool SetError(const Error* command_error, ErrorPtr* error) override {
+    return Run(base::Bind(&SetCommandError,
+                          base::Owned(CloneError(command_error))),
+               error);
+  }
+  bool Abort(const Error* command_error, ErrorPtr* error) override {
+    return Run(
+        base::Bind(&AbortCommand, base::Owned(CloneError(command_error))),
+        error);
+  }
+  bool Cancel(ErrorPtr* error) override {
+    return Run(base::Bind(&CancelCommand), error);
+  }
+
+ private:
+  bool Run(const CommandMethod& method, ErrorPtr* error) {
+    Call call;
+    call.proxy = this;
+    call.method = method;
+    pool_->PostCall(&call);
+    if (!call.result && error)
+      *error = std::move(call.error);
+    return call.result;
+  }
+
+  // Copies the mutable part of |command|. Called on the libweave thread
+  // while the worker waits, or before the worker gets the proxy.
+  void Update(const Command& command) {
+    state_ = command.GetState();
+    progress_.Clear();
+    progress_.MergeDictionary(&command.GetProgress());
+    results_.Clear();
+    results_.MergeDictionary(&command.GetResults());
+    error_.reset(CloneError(command.GetError()));
+  }
+
+  CommandWorkerPool* pool_{nullptr};
+  // Accessed only on the libweave thread.
+  std::weak_ptr<Command> command_;
+
+  const std::string id_;
+  const std::string name_;
+  const std::string component_;
+  const Command::Origin origin_;
+  base::DictionaryValue parameters_;
+
+  Command::State state_{Command::State::kQueued};
+  base::DictionaryValue progress_;
+  base::DictionaryValue results_;
+  ErrorPtr error_;
+
+  DISALLOW_COPY_AND_ASSIGN(CommandProxy);
+};
+
+CommandWorkerPool::CommandWorkerPool(provider::TaskRunner* task_runner,
+                                     size_t max_threads,
+                                     base::TimeDelta poll_interval)
+    : task_runner_{task_runner},
+      max_threads_{max_threads},
+      poll_interval_{poll_interval} {
+  CHECK_GT(max_threads_, 0u);
+  run_calls_ =
+      base::Bind(&CommandWorkerPool::OnWakeUp, weak_ptr_factory_.GetWeakPtr());
+}
+
+CommandWorkerPool::~CommandWorkerPool() {
+  std::deque<std::unique_ptr<Job>> jobs;
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    stopping_ = true;
+    // Handlers which have not started yet are dropped. Their commands stay in
+    // the queue, as if there was no handler.
+    jobs.swap(jobs_);
+    for (Call* call : calls_) {
+      call->result = Error::AddTo(&call->error, FROM_HERE,
+                                  errors::commands::kCommandDestroyed,
+                                  "Command worker pool is shutting down");
+      call->done = true;
+    }
+    calls_.clear();
+  }
+  job_added_.notify_all();
+  call_done_.notify_all();
+  for (auto& thread : threads_)
+    thread.join();
+}
+
+Device::CommandHandlerCallback CommandWorkerPool::Wrap(
+    const Device::CommandHandlerCallback& callback) {
+  return base::Bind(&CommandWorkerPool::Dispatch,
+                    weak_ptr_factory_.GetWeakPtr(), callback);
+}
+
+void CommandWorkerPool::Dispatch(
+    const Device::CommandHandlerCallback& callback,
+    const std::weak_ptr<Command>& command) {
+  auto command_ptr = command.lock();
+  if (!command_ptr)
+    return;
+
+  std::unique_ptr<Job> job{new Job};
+  job->callback = callback;
+  job->proxy = std::make_shared<CommandProxy>(this, command_ptr);
+  ++active_handler_count_;
+  bool woken_by_workers = false;
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    jobs_.push_back(std::move(job));
+    if (jobs_.size() > idle_thread_count_ && threads_.size() < max_threads_)
+      threads_.emplace_back(&CommandWorkerPool::WorkerLoop, this);
+    // Also finds out whether workers can wake up the libweave thread.
+    woken_by_workers = RequestRun();
+  }
+  job_added_.notify_one();
+  if (!woken_by_workers)
+    SchedulePoll();
+}
+
+void CommandWorkerPool::WorkerLoop() {
+  for (;;) {
+    std::unique_ptr<Job> job;
+    {
+      std::unique_lock<std::mutex> lock{mutex_};
+      ++idle_thread_count_;
+      job_added_.wait(lock, [this]() { return stopping_ || !jobs_.empty(); });
+      --idle_thread_count_;
+      if (stopping_)
+        return;
+      job = std::move(jobs_.front());
+      jobs_.pop_front();
+    }
+
+    job->callback.Run(job->proxy);
+    job.reset();
+
+    std::lock_guard<std::mutex> lock{mutex_};
+    ++finished_handler_count_;
+    RequestRun();
+  }
+}
+
+bool CommandWorkerPool::PostCall(Call* call) {
+  std::unique_lock<std::mutex> lock{mutex_};
+  if (stopping_) {
+    call->result = Error::AddTo(&call->error, FROM_HERE,
+                                errors::commands::kCommandDestroyed,
+                                "Command worker pool is shutting down");
+    return false;
+  }
+  calls_.push_back(call);
+  RequestRun();
+  call_done_.wait(lock, [call]() { return call->done; });
+  return true;
+}
+
+void CommandWorkerPool::RunPendingCalls() {
+  std::vector<Call*> calls;
+  size_t finished_handler_count = 0;
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    calls.swap(calls_);
+    std::swap(finished_handler_count, finished_handler_count_);
+  }
+  // Workers are blocked until |done| is set, so calls are safe to use.
+  for (Call* call : calls)
+    call->proxy->Execute(call);
+  if (!calls.empty()) {
+    {
+      std::lock_guard<std::mutex> lock{mutex_};
+      for (Call* call : calls)
+        call->done = true;
+    }
+    call_done_.notify_all();
+  }
+  CHECK_GE(active_handler_count_, finished_handler_count);
+  active_handler_count_ -= finished_handler_count;
+}
+
+bool CommandWorkerPool::RequestRun() {
+  // The destructor joins workers after setting |stopping_|, so |task_runner_|
+  // outlives every call made before that.
+  if (run_posted_ || stopping_)
+    return true;
+  run_posted_ = task_runner_->PostTaskFromAnyThread(FROM_HERE, run_calls_);
+  return run_posted_;
+}
+
+void CommandWorkerPool::OnWakeUp() {
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    run_posted_ = false;
+  }
+  RunPendingCalls();
+}
+
+void CommandWorkerPool::SchedulePoll() {
+  if (poll_scheduled_ || active_handler_count_ == 0)
+    return;
+  poll_scheduled_ = true;
+  task_runner_->PostDelayedTask(
+      FROM_HERE, base::Bind(&CommandWorkerPool::OnPollTimer,
+                            weak_ptr_factory_.GetWeakPtr()),
+      poll_interval_);
+}
+
+void CommandWorkerPool::OnPollTimer() {
+  poll_scheduled_ = false;
+  RunPendingCalls();
+  SchedulePoll();
+}
+
+}  // namespace weave
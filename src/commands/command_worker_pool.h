@@ -0,0 +1,103 @@
+// Copyright 2016 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIBWEAVE_SRC_COMMANDS_COMMAND_WORKER_POOL_H_
+#define LIBWEAVE_SRC_COMMANDS_COMMAND_WORKER_POOL_H_
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <base/callback.h>
+#include <base/macros.h>
+#include <base/memory/weak_ptr.h>
+#include <base/time/time.h>
+#include <weave/device.h>
+#include <weave/provider/task_runner.h>
+
+namespace weave {
+
+// Runs command handlers on a bounded pool of worker threads.
+// Handlers receive a proxy of the command. Calls of proxy methods which
+// change the command, e.g. SetProgress() or Complete(), are executed on the
+// libweave thread while the worker waits for the result, so handlers may
+// block and still get exact return values and errors. Getters of the proxy
+// return values as of the last such call.
+// Workers wake the libweave thread with
+// provider::TaskRunner::PostTaskFromAnyThread when they queue a call or finish
+// a handler. If the task runner doesn't support that, calls are picked up
+// every |poll_interval| while there are unfinished handlers.
+class CommandWorkerPool final {
+ public:
+  CommandWorkerPool(provider::TaskRunner* task_runner,
+                    size_t max_threads,
+                    base::TimeDelta poll_interval =
+                        base::TimeDelta::FromMilliseconds(10));
+
+  // Fails calls of unfinished handlers and waits until they return.
+  ~CommandWorkerPool();
+
+  // Returns handler which runs |callback| on a worker thread. The proxy
+  // passed to |callback| expires when |callback| returns.
+  Device::CommandHandlerCallback Wrap(
+      const Device::CommandHandlerCallback& callback);
+
+  // Executes pending calls of workers now.
+  void RunPendingCalls();
+
+  // Number of handlers which were started and haven't returned yet.
+  size_t GetActiveHandlerCount() const { return active_handler_count_; }
+
+ private:
+  class CommandProxy;
+  struct Call;
+  struct Job;
+
+  void Dispatch(const Device::CommandHandlerCallback& callback,
+                const std::weak_ptr<Command>& command);
+  void WorkerLoop();
+
+  // Called from workers. Waits until |call| is executed on the libweave
+  // thread. Returns false if the pool is being destroyed.
+  bool PostCall(Call* call);
+
+  // Posts |run_calls_| unless it's already posted. Returns false if the task
+  // runner can't be woken up from other threads. Must be called with |mutex_|
+  // held.
+  bool RequestRun();
+  void OnWakeUp();
+
+  void SchedulePoll();
+  void OnPollTimer();
+
+  provider::TaskRunner* task_runner_{nullptr};
+  const size_t max_threads_;
+  const base::TimeDelta poll_interval_;
+  size_t active_handler_count_{0};
+  bool poll_scheduled_{false};
+
+  // Guards everything below.
+  std::mutex mutex_;
+  std::condition_variable job_added_;
+  std::condition_variable call_done_;
+  std::deque<std::unique_ptr<Job>> jobs_;
+  std::vector<Call*> calls_;
+  std::vector<std::thread> threads_;
+  size_t idle_thread_count_{0};
+  size_t finished_handler_count_{0};
+  bool stopping_{false};
+  bool run_posted_{false};
+  // Bound to OnWakeUp() in the constructor, so workers only copy it.
+  base::Closure run_calls_;
+
+  base::WeakPtrFactory<CommandWorkerPool> weak_ptr_factory_{this};
+  DISALLOW_COPY_AND_ASSIGN(CommandWorkerPool);
+};
+
+}  // namespace weave
+
+#endif  // LIBWEAVE_SRC_COMMANDS_COMMAND_WORKER_POOL_H_
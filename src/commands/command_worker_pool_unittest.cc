@@ -0,0 +1,181 @@
+// Copyright 2016 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "src/commands/command_worker_pool.h"
+
+#include <atomic>
+
+#include <base/bind.h>
+#include <gtest/gtest.h>
+#include <weave/provider/test/fake_task_runner.h>
+#include <weave/test/unittest_utils.h>
+
+#include "src/commands/command_instance.h"
+#include "src/commands/schema_constants.h"
+
+namespace weave {
+
+namespace {
+
+void CompleteOnWorker(std::thread::id main_thread,
+                      const std::weak_ptr<Command>& command) {
+  EXPECT_NE(main_thread, std::this_thread::get_id());
+  auto cmd = command.lock();
+  ASSERT_TRUE(cmd);
+  EXPECT_EQ("robot.jump", cmd->GetName());
+  EXPECT_EQ(Command::State::kQueued, cmd->GetState());
+  int height = 0;
+  EXPECT_TRUE(cmd->GetParameters().GetInteger("height", &height));
+  EXPECT_EQ(53, height);
+
+  auto progress = test::CreateDictionaryValue("{'progress': 50}");
+  EXPECT_TRUE(cmd->SetProgress(*progress, nullptr));
+  EXPECT_EQ(Command::State::kInProgress, cmd->GetState());
+  EXPECT_JSON_EQ("{'progress': 50}", cmd->GetProgress());
+
+  auto results = test::CreateDictionaryValue("{'status': 'landed'}");
+  EXPECT_TRUE(cmd->Complete(*results, nullptr));
+  EXPECT_EQ(Command::State::kDone, cmd->GetState());
+
+  ErrorPtr error;
+  EXPECT_FALSE(cmd->SetProgress(*progress, &error));
+  EXPECT_EQ(errors::commands::kInvalidState, error->GetCode());
+}
+
+void WaitForRelease(std::atomic<int>* running,
+                    std::atomic<int>* max_running,
+                    std::atomic<bool>* release,
+                    const std::weak_ptr<Command>& command) {
+  int now_running = ++*running;
+  int max = max_running->load();
+  while (now_running > max &&
+         !max_running->compare_exchange_weak(max, now_running)) {
+  }
+  while (!release->load())
+    std::this_thread::yield();
+  --*running;
+  auto cmd = command.lock();
+  EXPECT_TRUE(cmd->Complete({}, nullptr));
+}
+
+void ProgressUntilFailure(const std::weak_ptr<Command>& command) {
+  auto cmd = command.lock();
+  ErrorPtr error;
+  for (int i = 0;; ++i) {
+    base::DictionaryValue progress;
+    progress.SetInteger("step", i);
+    if (!cmd->SetProgress(progress, &error))
+      break;
+  }
+  EXPECT_EQ(errors::commands::kCommandDestroyed, error->GetCode());
+}
+
+class PollingTaskRunner : public provider::test::FakeTaskRunner {
+ public:
+  bool PostTaskFromAnyThread(const tracked_objects::Location& from_here,
+                             const base::Closure& task) override {
+    return false;
+  }
+};
+
+}  // namespace
+
+class CommandWorkerPoolTest : public ::testing::Test {
+ protected:
+  std::shared_ptr<Command> CreateCommand(const std::string& json) {
+    auto params = test::CreateDictionaryValue(json);
+    std::shared_ptr<Command> command{
+        new CommandInstance{"robot.jump", Command::Origin::kLocal, *params}};
+    commands_.push_back(command);
+    return command;
+  }
+
+  void RunUntilIdle() {
+    while (pool_->GetActiveHandlerCount() > 0)
+      task_runner_.RunOnce();
+  }
+
+  provider::test::FakeTaskRunner task_runner_;
+  std::unique_ptr<CommandWorkerPool> pool_{
+      new CommandWorkerPool{&task_runner_, 2}};
+  std::vector<std::shared_ptr<Command>> commands_;
+};
+
+TEST_F(CommandWorkerPoolTest, RunOnWorker) {
+  auto command = CreateCommand("{'height': 53}");
+  auto handler =
+      pool_->Wrap(base::Bind(&CompleteOnWorker, std::this_thread::get_id()));
+  base::Time start = task_runner_.GetClock()->Now();
+  handler.Run(command);
+  EXPECT_EQ(1u, pool_->GetActiveHandlerCount());
+  RunUntilIdle();
+
+  EXPECT_EQ(Command::State::kDone, command->GetState());
+  EXPECT_JSON_EQ("{'progress': 50}", command->GetProgress());
+  EXPECT_JSON_EQ("{'status': 'landed'}", command->GetResults());
+
+  // Workers woke up the loop, so calls didn't wait for a poll tick.
+  EXPECT_EQ(start, task_runner_.GetClock()->Now());
+  EXPECT_FALSE(task_runner_.RunOnce());
+}
+
+TEST_F(CommandWorkerPoolTest, PollWithoutWakeUp) {
+  PollingTaskRunner task_runner;
+  pool_.reset(new CommandWorkerPool{&task_runner, 2});
+  auto command = CreateCommand("{'height': 53}");
+  base::Time start = task_runner.GetClock()->Now();
+  pool_->Wrap(base::Bind(&CompleteOnWorker, std::this_thread::get_id()))
+      .Run(command);
+  while (pool_->GetActiveHandlerCount() > 0)
+    task_runner.RunOnce();
+
+  EXPECT_EQ(Command::State::kDone, command->GetState());
+  EXPECT_LE(start + base::TimeDelta::FromMilliseconds(10),
+            task_runner.GetClock()->Now());
+  // Polling stops with the last handler.
+  EXPECT_FALSE(task_runner.RunOnce());
+  pool_.reset();
+}
+
+TEST_F(CommandWorkerPoolTest, MaxThreads) {
+  std::atomic<int> running{0};
+  std::atomic<int> max_running{0};
+  std::atomic<bool> release{false};
+  auto handler = pool_->Wrap(
+      base::Bind(&WaitForRelease, &running, &max_running, &release));
+  for (int i = 0; i < 5; ++i)
+    handler.Run(CreateCommand("{}"));
+
+  while (running.load() < 2)
+    std::this_thread::yield();
+  release.store(true);
+  RunUntilIdle();
+
+  EXPECT_EQ(2, max_running.load());
+  for (const auto& command : commands_)
+    EXPECT_EQ(Command::State::kDone, command->GetState());
+}
+
+TEST_F(CommandWorkerPoolTest, DestroyedCommand) {
+  auto command = CreateCommand("{}");
+  pool_->Wrap(base::Bind(&ProgressUntilFailure)).Run(command);
+
+  while (command->GetState() != Command::State::kInProgress)
+    pool_->RunPendingCalls();
+  commands_.clear();
+  command.reset();
+  RunUntilIdle();
+}
+
+TEST_F(CommandWorkerPoolTest, DestroyedPool) {
+  auto command = CreateCommand("{}");
+  pool_->Wrap(base::Bind(&ProgressUntilFailure)).Run(command);
+
+  while (command->GetState() != Command::State::kInProgress)
+    pool_->RunPendingCalls();
+  pool_.reset();
+  EXPECT_EQ(Command::State::kInProgress, command->GetState());
+}
+
+}  // namespace weave
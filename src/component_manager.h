@@ -63,6 +63,11 @@ class ComponentManager {
   // definitions from.
   virtual bool LoadTraits(const std::string& json, ErrorPtr* error) = 0;
 
+  // Same as the overload above, but takes a trait bundle, see trait_bundle.h.
+  virtual bool LoadTraitBundle(const uint8_t* data,
+                               size_t size,
+                               ErrorPtr* error) = 0;
+
   // Sets callback which is called when new trait definitions are added.
   virtual void AddTraitDefChangedCallback(const base::Closure& callback) = 0;
 
@@ -181,6 +186,9 @@ class ComponentManager {
 
   virtual void AddStateChangedCallback(const base::Closure& callback) = 0;
 
+  // Returns a new reader of traits and components for another thread.
+  virtual std::unique_ptr<ComponentTreeReader> CreateComponentTreeReader() = 0;
+
   // Returns the recorded state changes since last time this method was called.
   virtual StateSnapshot GetAndClearRecordedStateChanges() = 0;
 
@@ -200,6 +208,26 @@ class ComponentManager {
   virtual Token AddServerStateUpdatedCallback(
       const base::Callback<void(UpdateID)>& callback) = 0;
 
+  // Returns a snapshot of traits, components, pending cloud commands and the
+  // last state change ID, which can be restored after a restart.
+  virtual std::unique_ptr<base::DictionaryValue> CreateSnapshot() const = 0;
+
+  // Restores traits, components and the last state change ID from |snapshot|
+  // created by CreateSnapshot(). Must be called before any traits are loaded.
+  // Commands are not restored, as they need cloud proxies. Restored traits and
+  // components may be added again, which is a no-op, so code that builds them
+  // at startup works unchanged. If a definition or the traits of a component
+  // differ, the restored one is replaced. Components which are not added again
+  // are removed by RemoveRestoredComponents().
+  virtual bool RestoreSnapshot(const base::DictionaryValue& snapshot,
+                               ErrorPtr* error) = 0;
+
+  // Removes restored components which were not added again since
+  // RestoreSnapshot(), e.g. of hot-plugged devices which are gone. Called when
+  // the device connects to the cloud, once the application had time to build
+  // its component tree.
+  virtual void RemoveRestoredComponents() = 0;
+
   // Helper method for legacy API to obtain first component that implements
   // the given trait. This is useful for routing commands that have no component
   // path specified.
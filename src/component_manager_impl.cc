@@ -4,13 +4,16 @@
 
 #include "src/component_manager_impl.h"
 
+#include <base/bind.h>
 #include <base/strings/string_number_conversions.h>
 #include <base/strings/string_util.h>
 #include <base/strings/stringprintf.h>
 
 #include "src/commands/schema_constants.h"
 #include "src/json_error_codes.h"
+#include "src/memory_usage.h"
 #include "src/string_utils.h"
+#include "src/trait_bundle.h"
 #include "src/utils.h"
 
 namespace weave {
@@ -25,16 +28,89 @@ const EnumToStringMap<UserRole>::Map kMap[] = {
     {UserRole::kOwner, commands::attributes::kCommand_Role_Owner},
     {UserRole::kManager, commands::attributes::kCommand_Role_Manager},
 };
+
+struct Metrics {
+  Gauge* traits_memory{GetMemoryGauge("traits")};
+  Gauge* components_memory{GetMemoryGauge("components")};
+  Gauge* snapshot_memory{GetMemoryGauge("tree_snapshots")};
+};
+
+const Metrics& GetMetrics() {
+  static const Metrics metrics;
+  return metrics;
+}
+
+const char kSnapshotTraits[] = "traits";
+const char kSnapshotComponents[] = "components";
+const char kSnapshotCommands[] = "commands";
+const char kSnapshotLastUpdateId[] = "lastUpdateId";
+
+std::string JoinPath(const std::string& path, const std::string& name) {
+  return path.empty() ? name : path + "." + name;
+}
+
+bool HasTraits(const base::DictionaryValue& component,
+               const std::vector<std::string>& traits) {
+  const base::ListValue* component_traits = nullptr;
+  if (!component.GetList("traits", &component_traits) ||
+      component_traits->GetSize() != traits.size()) {
+    return false;
+  }
+  for (size_t i = 0; i < traits.size(); ++i) {
+    std::string trait;
+    if (!component_traits->GetString(i, &trait) || trait != traits[i])
+      return false;
+  }
+  return true;
+}
 }  // anonymous namespace
 
 template <>
 LIBWEAVE_EXPORT EnumToStringMap<UserRole>::EnumToStringMap()
     : EnumToStringMap(kMap) {}
 
+// Copy of traits and components published to other threads.
+class ComponentManagerImpl::TreeSnapshot : public ComponentTreeSnapshot {
+ public:
+  TreeSnapshot(const base::DictionaryValue& traits,
+               const base::DictionaryValue& components)
+      : memory_usage_{GetMetrics().snapshot_memory} {
+    traits_.MergeDictionary(&traits);
+    components_.MergeDictionary(&components);
+    memory_usage_.Set(EstimateMemoryUsage(traits_) +
+                      EstimateMemoryUsage(components_));
+  }
+
+  const base::DictionaryValue& GetTraits() const override { return traits_; }
+
+  const base::DictionaryValue& GetComponents() const override {
+    return components_;
+  }
+
+  const base::Value* GetStateProperty(const std::string& component,
+                                      const std::string& name,
+                                      ErrorPtr* error) const override {
+    return GetStatePropertyAt(&components_, component, name, error);
+  }
+
+ private:
+  base::DictionaryValue traits_;
+  base::DictionaryValue components_;
+  TrackedMemory memory_usage_;
+
+  DISALLOW_COPY_AND_ASSIGN(TreeSnapshot);
+};
+
 ComponentManagerImpl::ComponentManagerImpl(provider::TaskRunner* task_runner,
                                            base::Clock* clock)
-    : clock_{clock ? clock : &default_clock_},
-      command_queue_{task_runner, clock_} {}
+    : task_runner_{task_runner},
+      clock_{clock ? clock : &default_clock_},
+      traits_memory_usage_{GetMetrics().traits_memory},
+      components_memory_usage_{GetMetrics().components_memory},
+      command_queue_{task_runner, clock_} {
+  traits_memory_usage_.Set(EstimateMemoryUsage(traits_));
+  components_memory_usage_.Set(EstimateMemoryUsage(components_));
+}
 
 ComponentManagerImpl::~ComponentManagerImpl() {}
 
@@ -48,10 +124,23 @@ bool ComponentManagerImpl::AddComponent(const std::string& path,
     if (!root)
       return false;
   }
+  bool replace = false;
+  const base::DictionaryValue* existing = nullptr;
   if (root->GetWithoutPathExpansion(name, nullptr)) {
-    return Error::AddToPrintf(error, FROM_HERE, errors::commands::kInvalidState,
-                              "Component '%s' already exists at path '%s'",
-                              name.c_str(), path.c_str());
+    std::string component_path = JoinPath(path, name);
+    if (!restored_components_.count(component_path) ||
+        !root->GetDictionaryWithoutPathExpansion(name, &existing)) {
+      return Error::AddToPrintf(
+          error, FROM_HERE, errors::commands::kInvalidState,
+          "Component '%s' already exists at path '%s'", name.c_str(),
+          path.c_str());
+    }
+    // The component was restored from a snapshot and is added again.
+    if (HasTraits(*existing, traits)) {
+      restored_components_.erase(component_path);
+      return true;
+    }
+    replace = true;
   }
 
   // Check to make sure the declared traits are already defined.
@@ -62,13 +151,25 @@ bool ComponentManagerImpl::AddComponent(const std::string& path,
                                 "Trait '%s' is undefined", trait.c_str());
     }
   }
+  // Only the added and removed subtrees are measured.
+  int64_t size_change = 0;
+  if (replace) {
+    // Traits changed since the snapshot was made.
+    ForgetRestoredComponents(JoinPath(path, name));
+    scoped_ptr<base::Value> old_component;
+    root->RemoveWithoutPathExpansion(name, &old_component);
+    size_change -= EstimateDictionaryEntryUsage(name, *old_component);
+  }
   std::unique_ptr<base::DictionaryValue> dict{new base::DictionaryValue};
   std::unique_ptr<base::ListValue> traits_list{new base::ListValue};
   traits_list->AppendStrings(traits);
   dict->Set("traits", traits_list.release());
+  size_change += EstimateDictionaryEntryUsage(name, *dict);
   root->SetWithoutPathExpansion(name, dict.release());
+  components_memory_usage_.Add(size_change);
   for (const auto& cb : on_componet_tree_changed_)
     cb.Run();
+  ScheduleTreeSnapshot();
   return true;
 }
 
@@ -87,14 +188,42 @@ bool ComponentManagerImpl::AddComponentArrayItem(
   if (!root->GetListWithoutPathExpansion(name, &array_value)) {
     array_value = new base::ListValue;
     root->SetWithoutPathExpansion(name, array_value);
+    components_memory_usage_.Add(
+        EstimateDictionaryEntryUsage(name, *array_value));
+  }
+  std::string array_path = JoinPath(path, name);
+  auto restored = restored_components_.find(array_path);
+  if (restored != restored_components_.end()) {
+    // Items restored from a snapshot are added again in order.
+    size_t index = array_value->GetSize() - restored->second;
+    const base::DictionaryValue* item = nullptr;
+    if (array_value->GetDictionary(index, &item) && HasTraits(*item, traits)) {
+      if (--restored->second == 0)
+        restored_components_.erase(restored);
+      return true;
+    }
+    // The array changed since the snapshot was made, the rest of restored
+    // items are dropped.
+    restored_components_.erase(restored);
+    while (array_value->GetSize() > index) {
+      size_t last = array_value->GetSize() - 1;
+      ForgetRestoredComponents(array_path + "[" + std::to_string(last) + "]");
+      scoped_ptr<base::Value> item;
+      array_value->Remove(last, &item);
+      components_memory_usage_.Add(
+          -static_cast<int64_t>(EstimateListItemUsage(last + 1, *item)));
+    }
   }
   std::unique_ptr<base::DictionaryValue> dict{new base::DictionaryValue};
   std::unique_ptr<base::ListValue> traits_list{new base::ListValue};
   traits_list->AppendStrings(traits);
   dict->Set("traits", traits_list.release());
+  components_memory_usage_.Add(
+      EstimateListItemUsage(array_value->GetSize() + 1, *dict));
   array_value->Append(dict.release());
   for (const auto& cb : on_componet_tree_changed_)
     cb.Run();
+  ScheduleTreeSnapshot();
   return true;
 }
 
@@ -108,14 +237,19 @@ bool ComponentManagerImpl::RemoveComponent(const std::string& path,
       return false;
   }
 
-  if (!root->RemoveWithoutPathExpansion(name, nullptr)) {
+  scoped_ptr<base::Value> component;
+  if (!root->RemoveWithoutPathExpansion(name, &component)) {
     return Error::AddToPrintf(error, FROM_HERE, errors::commands::kInvalidState,
                               "Component '%s' does not exist at path '%s'",
                               name.c_str(), path.c_str());
   }
+  ForgetRestoredComponents(JoinPath(path, name));
 
+  components_memory_usage_.Add(
+      -static_cast<int64_t>(EstimateDictionaryEntryUsage(name, *component)));
   for (const auto& cb : on_componet_tree_changed_)
     cb.Run();
+  ScheduleTreeSnapshot();
   return true;
 }
 
@@ -138,15 +272,21 @@ bool ComponentManagerImpl::RemoveComponentArrayItem(const std::string& path,
         path.c_str());
   }
 
-  if (!array_value->Remove(index, nullptr)) {
+  size_t array_size = array_value->GetSize();
+  scoped_ptr<base::Value> item;
+  if (!array_value->Remove(index, &item)) {
     return Error::AddToPrintf(
         error, FROM_HERE, errors::commands::kInvalidState,
         "Component array '%s' at path '%s' does not have an element %zu",
         name.c_str(), path.c_str(), index);
   }
+  ForgetRestoredArrayItem(JoinPath(path, name), index, array_size);
 
+  components_memory_usage_.Add(
+      -static_cast<int64_t>(EstimateListItemUsage(array_size, *item)));
   for (const auto& cb : on_componet_tree_changed_)
     cb.Run();
+  ScheduleTreeSnapshot();
   return true;
 }
 
@@ -158,46 +298,76 @@ void ComponentManagerImpl::AddComponentTreeChangedCallback(
 
 bool ComponentManagerImpl::LoadTraits(const base::DictionaryValue& dict,
                                       ErrorPtr* error) {
+  return AddTraits(std::unique_ptr<base::DictionaryValue>{
+                       dict.CreateDeepCopy().release()},
+                   error);
+}
+
+bool ComponentManagerImpl::LoadTraits(const std::string& json,
+                                      ErrorPtr* error) {
+  std::unique_ptr<base::DictionaryValue> dict = LoadJsonDict(json, error);
+  if (!dict)
+    return false;
+  return AddTraits(std::move(dict), error);
+}
+
+bool ComponentManagerImpl::LoadTraitBundle(const uint8_t* data,
+                                           size_t size,
+                                           ErrorPtr* error) {
+  std::unique_ptr<base::DictionaryValue> dict =
+      DecodeTraitBundle(data, size, error);
+  if (!dict)
+    return false;
+  return AddTraits(std::move(dict), error);
+}
+
+bool ComponentManagerImpl::AddTraits(
+    std::unique_ptr<base::DictionaryValue> dict,
+    ErrorPtr* error) {
   bool modified = false;
   bool result = true;
   // Check if any of the new traits are already defined. If so, make sure the
-  // definition is exactly the same, or else this is an error.
-  for (base::DictionaryValue::Iterator it(dict); !it.IsAtEnd(); it.Advance()) {
-    if (it.value().GetType() != base::Value::TYPE_DICTIONARY) {
+  // definition is exactly the same, or else this is an error. Definitions are
+  // taken out of |dict| one by one, in order, so new ones can be moved.
+  while (!dict->empty()) {
+    std::string name = base::DictionaryValue::Iterator{*dict}.key();
+    scoped_ptr<base::Value> definition;
+    CHECK(dict->RemoveWithoutPathExpansion(name, &definition));
+    if (definition->GetType() != base::Value::TYPE_DICTIONARY) {
       Error::AddToPrintf(error, FROM_HERE, errors::commands::kTypeMismatch,
-                         "Trait '%s' must be an object", it.key().c_str());
+                         "Trait '%s' must be an object", name.c_str());
       result = false;
       break;
     }
     const base::DictionaryValue* existing_def = nullptr;
-    if (traits_.GetDictionary(it.key(), &existing_def)) {
-      if (!existing_def->Equals(&it.value())) {
-        Error::AddToPrintf(error, FROM_HERE, errors::commands::kTypeMismatch,
-                           "Trait '%s' cannot be redefined", it.key().c_str());
-        result = false;
-        break;
+    if (traits_.GetDictionary(name, &existing_def)) {
+      bool restored = restored_traits_.erase(name) > 0;
+      if (!existing_def->Equals(definition.get())) {
+        if (!restored) {
+          Error::AddToPrintf(error, FROM_HERE, errors::commands::kTypeMismatch,
+                             "Trait '%s' cannot be redefined", name.c_str());
+          result = false;
+          break;
+        }
+        // The definition changed since the snapshot was made.
+        traits_.Set(name, std::move(definition));
+        modified = true;
       }
     } else {
-      traits_.Set(it.key(), it.value().DeepCopy());
+      traits_.Set(name, std::move(definition));
       modified = true;
     }
   }
 
   if (modified) {
+    traits_memory_usage_.Set(EstimateMemoryUsage(traits_));
     for (const auto& cb : on_trait_changed_)
       cb.Run();
+    ScheduleTreeSnapshot();
   }
   return result;
 }
 
-bool ComponentManagerImpl::LoadTraits(const std::string& json,
-                                      ErrorPtr* error) {
-  std::unique_ptr<const base::DictionaryValue> dict = LoadJsonDict(json, error);
-  if (!dict)
-    return false;
-  return LoadTraits(*dict, error);
-}
-
 void ComponentManagerImpl::AddTraitDefChangedCallback(
     const base::Closure& callback) {
   on_trait_changed_.push_back(callback);
@@ -375,13 +545,18 @@ bool ComponentManagerImpl::SetStateProperties(const std::string& component_path,
   if (!component)
     return false;
 
+  // Only the merged values are measured, as state changes are frequent.
+  int64_t size_change = 0;
   base::DictionaryValue* state = nullptr;
   if (!component->GetDictionary("state", &state)) {
     state = new base::DictionaryValue;
     component->Set("state", state);
+    size_change += EstimateDictionaryEntryUsage("state", *state);
   }
-  state->MergeDictionary(&dict);
+  size_change += MergeDictionaryAndEstimate(dict, state);
+  components_memory_usage_.Add(size_change);
   last_state_change_id_++;
+  state_latency_tracker_.OnStateChanged(last_state_change_id_);
   auto& queue = state_change_queues_[component_path];
   if (!queue)
     queue.reset(new StateChangeQueue{kMaxStateChangeQueueSize});
@@ -389,6 +564,7 @@ bool ComponentManagerImpl::SetStateProperties(const std::string& component_path,
   queue->NotifyPropertiesUpdated(timestamp, dict);
   for (const auto& cb : on_state_changed_)
     cb.Run();
+  ScheduleTreeSnapshot();
   return true;
 }
 
@@ -404,29 +580,7 @@ const base::Value* ComponentManagerImpl::GetStateProperty(
     const std::string& component_path,
     const std::string& name,
     ErrorPtr* error) const {
-  const base::DictionaryValue* component = FindComponent(component_path, error);
-  if (!component)
-    return nullptr;
-  auto pair = SplitAtFirst(name, ".", true);
-  if (pair.first.empty()) {
-    return Error::AddToPrintf(error, FROM_HERE,
-                              errors::commands::kPropertyMissing,
-                              "Empty state package in '%s'", name.c_str());
-  }
-  if (pair.second.empty()) {
-    return Error::AddToPrintf(
-        error, FROM_HERE, errors::commands::kPropertyMissing,
-        "State property name not specified in '%s'", name.c_str());
-  }
-  std::string key = base::StringPrintf("state.%s", name.c_str());
-  const base::Value* value = nullptr;
-  if (!component->Get(key, &value)) {
-    return Error::AddToPrintf(error, FROM_HERE,
-                              errors::commands::kPropertyMissing,
-                              "State property '%s' not found in component '%s'",
-                              name.c_str(), component_path.c_str());
-  }
-  return value;
+  return GetStatePropertyAt(&components_, component_path, name, error);
 }
 
 bool ComponentManagerImpl::SetStateProperty(const std::string& component_path,
@@ -471,10 +625,13 @@ ComponentManagerImpl::GetAndClearRecordedStateChanges() {
   };
   std::sort(snapshot.state_changes.begin(), snapshot.state_changes.end(), pred);
   state_change_queues_.clear();
+  if (!snapshot.state_changes.empty())
+    state_latency_tracker_.OnUpdateSent(snapshot.update_id);
   return snapshot;
 }
 
 void ComponentManagerImpl::NotifyStateUpdatedOnServer(UpdateID id) {
+  state_latency_tracker_.OnUpdateAcknowledged(id);
   on_server_state_updated_.Notify(id);
 }
 
@@ -485,6 +642,173 @@ ComponentManager::Token ComponentManagerImpl::AddServerStateUpdatedCallback(
   return Token{on_server_state_updated_.Add(callback).release()};
 }
 
+std::unique_ptr<base::DictionaryValue> ComponentManagerImpl::CreateSnapshot()
+    const {
+  std::unique_ptr<base::DictionaryValue> snapshot{new base::DictionaryValue};
+  snapshot->Set(kSnapshotTraits, traits_.DeepCopy());
+  snapshot->Set(kSnapshotComponents, components_.DeepCopy());
+  std::unique_ptr<base::ListValue> commands{new base::ListValue};
+  for (const CommandInstance* command : command_queue_.GetCommands()) {
+    Command::State state = command->GetState();
+    if (command->GetOrigin() != Command::Origin::kCloud ||
+        (state != Command::State::kQueued &&
+         state != Command::State::kInProgress &&
+         state != Command::State::kPaused)) {
+      continue;
+    }
+    std::unique_ptr<base::DictionaryValue> json = command->ToJson();
+    json->SetString(commands::attributes::kCommand_Component,
+                    command->GetComponent());
+    commands->Append(json.release());
+  }
+  snapshot->Set(kSnapshotCommands, commands.release());
+  snapshot->SetString(kSnapshotLastUpdateId,
+                      std::to_string(last_state_change_id_));
+  return snapshot;
+}
+
+bool ComponentManagerImpl::RestoreSnapshot(
+    const base::DictionaryValue& snapshot,
+    ErrorPtr* error) {
+  if (!traits_.empty() || !components_.empty()) {
+    return Error::AddTo(error, FROM_HERE, errors::commands::kInvalidState,
+                        "Snapshot must be restored before adding traits");
+  }
+  const base::DictionaryValue* traits = nullptr;
+  const base::DictionaryValue* components = nullptr;
+  std::string last_update_id;
+  UpdateID id = 0;
+  if (!snapshot.GetDictionary(kSnapshotTraits, &traits) ||
+      !snapshot.GetDictionary(kSnapshotComponents, &components) ||
+      !snapshot.GetString(kSnapshotLastUpdateId, &last_update_id) ||
+      !base::StringToUint64(last_update_id, &id)) {
+    return Error::AddTo(error, FROM_HERE, errors::commands::kPropertyMissing,
+                        "Snapshot is incomplete");
+  }
+  if (!LoadTraits(*traits, error))
+    return false;
+  for (base::DictionaryValue::Iterator it(traits_); !it.IsAtEnd(); it.Advance())
+    restored_traits_.insert(it.key());
+
+  components_.MergeDictionary(components);
+  AddRestoredComponents("", components_);
+  last_state_change_id_ = id;
+  components_memory_usage_.Set(EstimateMemoryUsage(components_));
+  for (const auto& cb : on_componet_tree_changed_)
+    cb.Run();
+  ScheduleTreeSnapshot();
+  return true;
+}
+
+void ComponentManagerImpl::AddRestoredComponents(
+    const std::string& path,
+    const base::DictionaryValue& components) {
+  for (base::DictionaryValue::Iterator it(components); !it.IsAtEnd();
+       it.Advance()) {
+    std::string component_path = JoinPath(path, it.key());
+    const base::DictionaryValue* component = nullptr;
+    const base::DictionaryValue* children = nullptr;
+    const base::ListValue* array = nullptr;
+    if (it.value().GetAsDictionary(&component)) {
+      restored_components_[component_path] = 1;
+      if (component->GetDictionary("components", &children))
+        AddRestoredComponents(component_path, *children);
+    } else if (it.value().GetAsList(&array) && !array->empty()) {
+      restored_components_[component_path] = array->GetSize();
+      for (size_t i = 0; i < array->GetSize(); ++i) {
+        if (array->GetDictionary(i, &component) &&
+            component->GetDictionary("components", &children)) {
+          AddRestoredComponents(
+              component_path + "[" + std::to_string(i) + "]", *children);
+        }
+      }
+    }
+  }
+}
+
+void ComponentManagerImpl::RemoveRestoredComponents() {
+  // Components sort before their sub-components, so the restored ones below a
+  // removed component are forgotten with it.
+  while (!restored_components_.empty()) {
+    std::string path = restored_components_.begin()->first;
+    size_t count = restored_components_.begin()->second;
+    std::string parent;
+    std::string name = path;
+    size_t pos = path.rfind('.');
+    if (pos != std::string::npos) {
+      parent = path.substr(0, pos);
+      name = path.substr(pos + 1);
+    }
+    VLOG(1) << "Removing component '" << path << "' restored from a snapshot";
+    base::DictionaryValue* root =
+        parent.empty() ? &components_ : FindComponentGraftNode(parent, nullptr);
+    base::ListValue* array_value = nullptr;
+    if (root && root->GetListWithoutPathExpansion(name, &array_value) &&
+        array_value->GetSize() > count) {
+      // Only the items at the end were not added again.
+      for (size_t i = 0; i < count; ++i) {
+        CHECK(RemoveComponentArrayItem(parent, name,
+                                       array_value->GetSize() - 1, nullptr));
+      }
+    } else if (root) {
+      CHECK(RemoveComponent(parent, name, nullptr));
+    }
+    restored_components_.erase(path);
+  }
+}
+
+void ComponentManagerImpl::ForgetRestoredArrayItem(
+    const std::string& array_path,
+    size_t index,
+    size_t array_size) {
+  auto restored = restored_components_.find(array_path);
+  if (restored != restored_components_.end() &&
+      index >= array_size - restored->second) {
+    if (--restored->second == 0)
+      restored_components_.erase(restored);
+  }
+  std::string prefix = array_path + "[";
+  std::map<std::string, size_t> moved;
+  auto it = restored_components_.lower_bound(prefix);
+  while (it != restored_components_.end() &&
+         it->first.compare(0, prefix.size(), prefix) == 0) {
+    size_t end = it->first.find(']', prefix.size());
+    size_t item = 0;
+    CHECK(base::StringToSizeT(
+        it->first.substr(prefix.size(), end - prefix.size()), &item));
+    if (item < index) {
+      ++it;
+      continue;
+    }
+    if (item > index) {
+      moved[prefix + std::to_string(item - 1) + it->first.substr(end)] =
+          it->second;
+    }
+    it = restored_components_.erase(it);
+  }
+  restored_components_.insert(moved.begin(), moved.end());
+}
+
+void ComponentManagerImpl::ForgetRestoredComponents(const std::string& path) {
+  auto it = restored_components_.lower_bound(path);
+  while (it != restored_components_.end() &&
+         it->first.compare(0, path.size(), path) == 0) {
+    char next = it->first.size() > path.size() ? it->first[path.size()] : '.';
+    if (next == '.' || next == '[')
+      it = restored_components_.erase(it);
+    else
+      ++it;
+  }
+}
+
+std::unique_ptr<ComponentTreeReader>
+ComponentManagerImpl::CreateComponentTreeReader() {
+  auto reader = tree_publisher_.CreateReader();
+  if (tree_snapshot_dirty_)
+    PublishTreeSnapshot();
+  return reader;
+}
+
 std::string ComponentManagerImpl::FindComponentWithTrait(
     const std::string& trait) const {
   for (base::DictionaryValue::Iterator it(components_); !it.IsAtEnd();
@@ -536,8 +860,10 @@ bool ComponentManagerImpl::AddLegacyCommandDefinitions(
   }
 
   if (modified) {
+    traits_memory_usage_.Set(EstimateMemoryUsage(traits_));
     for (const auto& cb : on_trait_changed_)
       cb.Run();
+    ScheduleTreeSnapshot();
   }
   return result;
 }
@@ -574,8 +900,10 @@ bool ComponentManagerImpl::AddLegacyStateDefinitions(
   }
 
   if (modified) {
+    traits_memory_usage_.Set(EstimateMemoryUsage(traits_));
     for (const auto& cb : on_trait_changed_)
       cb.Run();
+    ScheduleTreeSnapshot();
   }
   return result;
 }
@@ -627,6 +955,8 @@ void ComponentManagerImpl::AddTraitToLegacyComponent(const std::string& trait) {
     // at startup.
     component = new base::DictionaryValue;
     components_.Set("__weave__", component);
+    components_memory_usage_.Add(
+        EstimateDictionaryEntryUsage("__weave__", *component));
   } else {
     CHECK(components_.GetDictionary(it.key(), &component));
   }
@@ -634,8 +964,35 @@ void ComponentManagerImpl::AddTraitToLegacyComponent(const std::string& trait) {
   if (!component->GetList("traits", &traits)) {
     traits = new base::ListValue;
     component->Set("traits", traits);
+    components_memory_usage_.Add(
+        EstimateDictionaryEntryUsage("traits", *traits));
   }
   traits->AppendString(trait);
+  const base::Value* added = nullptr;
+  CHECK(traits->Get(traits->GetSize() - 1, &added));
+  components_memory_usage_.Add(
+      EstimateListItemUsage(traits->GetSize(), *added));
+  ScheduleTreeSnapshot();
+}
+
+void ComponentManagerImpl::ScheduleTreeSnapshot() {
+  tree_snapshot_dirty_ = true;
+  // Nobody reads snapshots, so don't bother copying.
+  if (tree_snapshot_scheduled_ || !tree_publisher_.HasReaders())
+    return;
+  tree_snapshot_scheduled_ = true;
+  // Publish once all changes of the current task are done.
+  task_runner_->PostDelayedTask(
+      FROM_HERE, base::Bind(&ComponentManagerImpl::PublishTreeSnapshot,
+                            weak_ptr_factory_.GetWeakPtr()),
+      {});
+}
+
+void ComponentManagerImpl::PublishTreeSnapshot() {
+  tree_snapshot_scheduled_ = false;
+  tree_snapshot_dirty_ = false;
+  tree_publisher_.Publish(std::unique_ptr<const ComponentTreeSnapshot>{
+      new TreeSnapshot{traits_, components_}});
 }
 
 base::DictionaryValue* ComponentManagerImpl::FindComponentGraftNode(
@@ -646,6 +1003,8 @@ base::DictionaryValue* ComponentManagerImpl::FindComponentGraftNode(
   if (component && !component->GetDictionary("components", &root)) {
     root = new base::DictionaryValue;
     component->Set("components", root);
+    components_memory_usage_.Add(
+        EstimateDictionaryEntryUsage("components", *root));
   }
   return root;
 }
@@ -742,4 +1101,35 @@ const base::DictionaryValue* ComponentManagerImpl::FindComponentAt(
   return root;
 }
 
+const base::Value* ComponentManagerImpl::GetStatePropertyAt(
+    const base::DictionaryValue* root,
+    const std::string& component_path,
+    const std::string& name,
+    ErrorPtr* error) {
+  const base::DictionaryValue* component =
+      FindComponentAt(root, component_path, error);
+  if (!component)
+    return nullptr;
+  auto pair = SplitAtFirst(name, ".", true);
+  if (pair.first.empty()) {
+    return Error::AddToPrintf(error, FROM_HERE,
+                              errors::commands::kPropertyMissing,
+                              "Empty state package in '%s'", name.c_str());
+  }
+  if (pair.second.empty()) {
+    return Error::AddToPrintf(
+        error, FROM_HERE, errors::commands::kPropertyMissing,
+        "State property name not specified in '%s'", name.c_str());
+  }
+  std::string key = base::StringPrintf("state.%s", name.c_str());
+  const base::Value* value = nullptr;
+  if (!component->Get(key, &value)) {
+    return Error::AddToPrintf(error, FROM_HERE,
+                              errors::commands::kPropertyMissing,
+                              "State property '%s' not found in component '%s'",
+                              name.c_str(), component_path.c_str());
+  }
+  return value;
+}
+
 }  // namespace weave
@@ -5,11 +5,19 @@
 #ifndef LIBWEAVE_SRC_COMPONENT_MANAGER_IMPL_H_
 #define LIBWEAVE_SRC_COMPONENT_MANAGER_IMPL_H_
 
+#include <map>
+#include <set>
+#include <string>
+
+#include <base/memory/weak_ptr.h>
 #include <base/time/default_clock.h>
 
 #include "src/commands/command_queue.h"
 #include "src/component_manager.h"
+#include "src/component_tree_publisher.h"
+#include "src/memory_usage.h"
 #include "src/states/state_change_queue.h"
+#include "src/states/state_latency_tracker.h"
 
 namespace weave {
 
@@ -26,6 +34,11 @@ class ComponentManagerImpl final : public ComponentManager {
   // definitions from.
   bool LoadTraits(const std::string& json, ErrorPtr* error) override;
 
+  // Same as the overload above, but takes a trait bundle, see trait_bundle.h.
+  bool LoadTraitBundle(const uint8_t* data,
+                       size_t size,
+                       ErrorPtr* error) override;
+
   // Sets callback which is called when new trait definitions are added.
   void AddTraitDefChangedCallback(const base::Closure& callback) override;
 
@@ -145,6 +158,8 @@ class ComponentManagerImpl final : public ComponentManager {
 
   void AddStateChangedCallback(const base::Closure& callback) override;
 
+  std::unique_ptr<ComponentTreeReader> CreateComponentTreeReader() override;
+
   // Returns the recorded state changes since last time this method was called.
   StateSnapshot GetAndClearRecordedStateChanges() override;
 
@@ -166,6 +181,18 @@ class ComponentManagerImpl final : public ComponentManager {
   Token AddServerStateUpdatedCallback(
       const base::Callback<void(UpdateID)>& callback) override;
 
+  // Returns a snapshot of traits, components, pending cloud commands and the
+  // last state change ID, which can be restored after a restart.
+  std::unique_ptr<base::DictionaryValue> CreateSnapshot() const override;
+
+  // Restores traits, components and the last state change ID from |snapshot|.
+  // Restored traits and components may be added again.
+  bool RestoreSnapshot(const base::DictionaryValue& snapshot,
+                       ErrorPtr* error) override;
+
+  // Removes restored components which were not added again.
+  void RemoveRestoredComponents() override;
+
   // Helper method for legacy API to obtain first component that implements
   // the given trait. This is useful for routing commands that have no component
   // path specified.
@@ -186,6 +213,12 @@ class ComponentManagerImpl final : public ComponentManager {
   const base::DictionaryValue& GetLegacyCommandDefinitions() const override;
 
  private:
+  class TreeSnapshot;
+
+  // Moves the trait definitions in |dict| to |traits_| instead of copying
+  // them. Used by all LoadTraits() overloads.
+  bool AddTraits(std::unique_ptr<base::DictionaryValue> dict, ErrorPtr* error);
+
   // A helper method to find a JSON element of component at |path| to add new
   // sub-components to.
   base::DictionaryValue* FindComponentGraftNode(const std::string& path,
@@ -193,6 +226,19 @@ class ComponentManagerImpl final : public ComponentManager {
   base::DictionaryValue* FindMutableComponent(const std::string& path,
                                               ErrorPtr* error);
 
+  // Records components in |components| at |path| as restored from a snapshot.
+  void AddRestoredComponents(const std::string& path,
+                             const base::DictionaryValue& components);
+  // Forgets restored components at |path| and below, so adding them again is
+  // an error as usual.
+  void ForgetRestoredComponents(const std::string& path);
+  // Forgets the restored item |index| of the array at |array_path| of
+  // |array_size| items and its sub-components, and renumbers the restored
+  // sub-components of the items after it.
+  void ForgetRestoredArrayItem(const std::string& array_path,
+                               size_t index,
+                               size_t array_size);
+
   // Legacy API support: Helper function to support state/command definitions.
   // Adds the given trait to at least one component.
   // Searches for available components and if none of them already supports this
@@ -206,6 +252,20 @@ class ComponentManagerImpl final : public ComponentManager {
       const std::string& path,
       ErrorPtr* error);
 
+  // Helper method to find a state property of a component given a root node
+  // of the components tree.
+  static const base::Value* GetStatePropertyAt(
+      const base::DictionaryValue* root,
+      const std::string& component_path,
+      const std::string& name,
+      ErrorPtr* error);
+
+  // Publishes a snapshot for readers after the current task, if there are
+  // any readers.
+  void ScheduleTreeSnapshot();
+  void PublishTreeSnapshot();
+
+  provider::TaskRunner* task_runner_{nullptr};
   base::DefaultClock default_clock_;
   base::Clock* clock_{nullptr};
 
@@ -218,17 +278,33 @@ class ComponentManagerImpl final : public ComponentManager {
 
   base::DictionaryValue traits_;      // Trait definitions.
   base::DictionaryValue components_;  // Component instances.
+  TrackedMemory traits_memory_usage_;
+  TrackedMemory components_memory_usage_;
   CommandQueue command_queue_;  // Command queue containing command instances.
   std::vector<base::Closure> on_trait_changed_;
   std::vector<base::Closure> on_componet_tree_changed_;
   std::vector<base::Closure> on_state_changed_;
   uint32_t next_command_id_{0};
   std::map<std::string, std::unique_ptr<StateChangeQueue>> state_change_queues_;
+  StateLatencyTracker state_latency_tracker_;
+  // Paths of components restored from a snapshot which were not added again
+  // yet, mapped to the number of such components. For component arrays it is
+  // the number of items at the end of the array.
+  std::map<std::string, size_t> restored_components_;
+  // Traits restored from a snapshot which were not loaded again yet. They may
+  // be redefined.
+  std::set<std::string> restored_traits_;
 
   // Legacy API support.
   mutable base::DictionaryValue legacy_state_;         // Device state.
   mutable base::DictionaryValue legacy_command_defs_;  // Command definitions.
 
+  ComponentTreePublisher tree_publisher_;
+  bool tree_snapshot_dirty_{true};
+  bool tree_snapshot_scheduled_{false};
+
+  base::WeakPtrFactory<ComponentManagerImpl> weak_ptr_factory_{this};
+
   DISALLOW_COPY_AND_ASSIGN(ComponentManagerImpl);
 };
 
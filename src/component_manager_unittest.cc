@@ -12,8 +12,11 @@
 
 #include "src/bind_lambda.h"
 #include "src/commands/schema_constants.h"
+#include "src/memory_usage.h"
 #include "src/mock_component_manager.h"
+#include "src/test/allocation_counter.h"
 #include "src/test/mock_clock.h"
+#include "src/trait_bundle.h"
 
 namespace weave {
 
@@ -302,6 +305,58 @@ TEST_F(ComponentManagerTest, LoadTraitsNotAnObject) {
   EXPECT_EQ(errors::commands::kTypeMismatch, error->GetCode());
 }
 
+TEST_F(ComponentManagerTest, LoadTraitBundle) {
+  const char kTraits[] = R"({
+    "trait1": {
+      "commands": {
+        "command1": {
+          "minimalRole": "user",
+          "parameters": {"height": {"type": "integer", "minimum": -5}}
+        }
+      },
+      "state": {
+        "property1": {"type": "number", "maximum": 0.5}
+      }
+    },
+    "trait2": {
+      "state": {
+        "property2": {"type": "string", "enum": ["a", "b"]}
+      }
+    }
+  })";
+  std::vector<uint8_t> bundle;
+  ASSERT_TRUE(
+      EncodeTraitBundle(*CreateDictionaryValue(kTraits), &bundle, nullptr));
+  int count = 0;
+  manager_.AddTraitDefChangedCallback(base::Bind([&count]() { count++; }));
+  EXPECT_TRUE(manager_.LoadTraitBundle(bundle.data(), bundle.size(), nullptr));
+  EXPECT_JSON_EQ(kTraits, manager_.GetTraits());
+  EXPECT_EQ(2, count);
+
+  // Loading the same definitions from JSON is a no-op.
+  EXPECT_TRUE(manager_.LoadTraits(kTraits, nullptr));
+  EXPECT_EQ(2, count);
+
+  ErrorPtr error;
+  bundle.pop_back();
+  EXPECT_FALSE(manager_.LoadTraitBundle(bundle.data(), bundle.size(), &error));
+  EXPECT_EQ(errors::kInvalidTraitBundle, error->GetCode());
+  EXPECT_EQ(2, count);
+}
+
+TEST_F(ComponentManagerTest, LoadTraitBundleRedefinition) {
+  EXPECT_TRUE(manager_.LoadTraits(
+      R"({"trait1": {"state": {"property1": {"type": "boolean"}}}})", nullptr));
+  std::vector<uint8_t> bundle;
+  ASSERT_TRUE(EncodeTraitBundle(
+      *CreateDictionaryValue(
+          R"({"trait1": {"state": {"property1": {"type": "string"}}}})"),
+      &bundle, nullptr));
+  ErrorPtr error;
+  EXPECT_FALSE(manager_.LoadTraitBundle(bundle.data(), bundle.size(), &error));
+  EXPECT_EQ(errors::commands::kTypeMismatch, error->GetCode());
+}
+
 TEST_F(ComponentManagerTest, FindTraitDefinition) {
   const char kTraits[] = R"({
     "trait1": {
@@ -1479,6 +1534,267 @@ TEST_F(ComponentManagerTest, GetLegacyState) {
   EXPECT_JSON_EQ(kExpected, manager_.GetLegacyState());
 }
 
+TEST_F(ComponentManagerTest, ComponentTreeReader) {
+  CreateTestComponentTree(&manager_);
+  auto reader = manager_.CreateComponentTreeReader();
+  const ComponentTreeSnapshot& snapshot = reader->Acquire();
+  EXPECT_TRUE(snapshot.GetTraits().Equals(&manager_.GetTraits()));
+  EXPECT_TRUE(snapshot.GetComponents().Equals(&manager_.GetComponents()));
+
+  ASSERT_TRUE(manager_.SetStatePropertiesFromJson(
+      "comp1", R"({"t1": {"p1": 1}})", nullptr));
+  ASSERT_TRUE(manager_.SetStatePropertiesFromJson(
+      "comp1.comp2[1]", R"({"t3": {"p2": 2}})", nullptr));
+  EXPECT_FALSE(snapshot.GetStateProperty("comp1", "t1.p1", nullptr));
+
+  // Both changes are published together, after the current task.
+  EXPECT_FALSE(reader->Acquire().GetStateProperty("comp1", "t1.p1", nullptr));
+  EXPECT_TRUE(task_runner_.RunOnce());
+  const ComponentTreeSnapshot& updated = reader->Acquire();
+  const base::Value* value =
+      updated.GetStateProperty("comp1", "t1.p1", nullptr);
+  ASSERT_NE(nullptr, value);
+  EXPECT_JSON_EQ("1", *value);
+  value = updated.GetStateProperty("comp1.comp2[1]", "t3.p2", nullptr);
+  ASSERT_NE(nullptr, value);
+  EXPECT_JSON_EQ("2", *value);
+
+  ErrorPtr error;
+  EXPECT_FALSE(updated.GetStateProperty("comp1", "t1.p3", &error));
+  EXPECT_EQ(errors::commands::kPropertyMissing, error->GetCode());
+
+  // No readers, no copies.
+  reader.reset();
+  ASSERT_TRUE(manager_.SetStatePropertiesFromJson(
+      "comp1", R"({"t1": {"p1": 3}})", nullptr));
+  EXPECT_FALSE(task_runner_.RunOnce());
+}
+
+TEST_F(ComponentManagerTest, Snapshot) {
+  CreateTestComponentTree(&manager_);
+  ASSERT_TRUE(manager_.LoadTraits(
+      R"({"t7": {"commands": {"c1": {"minimalRole": "user"}}}})", nullptr));
+  ASSERT_TRUE(manager_.AddComponent("", "comp5", {"t7"}, nullptr));
+  ASSERT_TRUE(manager_.SetStatePropertiesFromJson(
+      "comp1.comp2[1]", R"({"t3": {"p1": 1}})", nullptr));
+  // Only cloud commands are saved.
+  auto command = manager_.ParseCommandInstance(
+      *CreateDictionaryValue(
+          R"({"name": "t7.c1", "id": "1234", "component": "comp5"})"),
+      Command::Origin::kCloud, UserRole::kUser, nullptr, nullptr);
+  ASSERT_NE(nullptr, command);
+  manager_.AddCommand(std::move(command));
+  command = manager_.ParseCommandInstance(
+      *CreateDictionaryValue(R"({"name": "t7.c1", "component": "comp5"})"),
+      Command::Origin::kLocal, UserRole::kUser, nullptr, nullptr);
+  ASSERT_NE(nullptr, command);
+  manager_.AddCommand(std::move(command));
+
+  auto snapshot = manager_.CreateSnapshot();
+  const char kCommands[] = R"([{
+    "id": "1234",
+    "name": "t7.c1",
+    "component": "comp5",
+    "parameters": {},
+    "progress": {},
+    "results": {},
+    "state": "queued"
+  }])";
+  const base::ListValue* commands = nullptr;
+  ASSERT_TRUE(snapshot->GetList("commands", &commands));
+  EXPECT_JSON_EQ(kCommands, *commands);
+
+  ComponentManagerImpl restored{&task_runner_, &clock_};
+  EXPECT_TRUE(restored.RestoreSnapshot(*snapshot, nullptr));
+  EXPECT_TRUE(manager_.GetTraits().Equals(&restored.GetTraits()));
+  EXPECT_TRUE(manager_.GetComponents().Equals(&restored.GetComponents()));
+  EXPECT_EQ(manager_.GetLastStateChangeId(), restored.GetLastStateChangeId());
+  EXPECT_EQ(nullptr, restored.FindCommand("1234"));
+
+  // Snapshots are restored only into an empty manager.
+  ErrorPtr error;
+  EXPECT_FALSE(manager_.RestoreSnapshot(*snapshot, &error));
+  EXPECT_EQ(errors::commands::kInvalidState, error->GetCode());
+}
+
+TEST_F(ComponentManagerTest, SnapshotComponentsAddedAgain) {
+  CreateTestComponentTree(&manager_);
+  ASSERT_TRUE(manager_.SetStatePropertiesFromJson(
+      "comp1", R"({"t1": {"p1": 1}})", nullptr));
+  auto snapshot = manager_.CreateSnapshot();
+
+  ComponentManagerImpl restored{&task_runner_, &clock_};
+  ASSERT_TRUE(restored.RestoreSnapshot(*snapshot, nullptr));
+  // Code building the tree at startup works with the restored tree.
+  CreateTestComponentTree(&restored);
+  EXPECT_TRUE(manager_.GetComponents().Equals(&restored.GetComponents()));
+
+  // Each restored component is added again only once.
+  ErrorPtr error;
+  EXPECT_FALSE(restored.AddComponent("", "comp1", {"t1"}, &error));
+  EXPECT_EQ(errors::commands::kInvalidState, error->GetCode());
+  EXPECT_TRUE(
+      restored.AddComponentArrayItem("comp1", "comp2", {"t2"}, nullptr));
+  const base::ListValue* array = nullptr;
+  ASSERT_TRUE(restored.GetComponents().GetList("comp1.components.comp2",
+                                               &array));
+  EXPECT_EQ(3u, array->GetSize());
+}
+
+TEST_F(ComponentManagerTest, SnapshotComponentsChanged) {
+  CreateTestComponentTree(&manager_);
+  auto snapshot = manager_.CreateSnapshot();
+
+  ComponentManagerImpl restored{&task_runner_, &clock_};
+  ASSERT_TRUE(restored.RestoreSnapshot(*snapshot, nullptr));
+  // Restored trait definitions may change once.
+  ASSERT_TRUE(restored.LoadTraits(R"({"t1": {"state": {}}})", nullptr));
+  ErrorPtr error;
+  EXPECT_FALSE(restored.LoadTraits(R"({"t1": {}})", &error));
+  EXPECT_EQ(errors::commands::kTypeMismatch, error->GetCode());
+
+  // A component with other traits replaces the restored one with its
+  // sub-components.
+  EXPECT_TRUE(restored.AddComponent("", "comp1", {"t2"}, nullptr));
+  EXPECT_JSON_EQ(R"({"comp1": {"traits": ["t2"]}})",
+                 restored.GetComponents());
+
+  ComponentManagerImpl restored_array{&task_runner_, &clock_};
+  ASSERT_TRUE(restored_array.RestoreSnapshot(*snapshot, nullptr));
+  // Restored array items after the first changed one are dropped.
+  EXPECT_TRUE(restored_array.AddComponentArrayItem("comp1", "comp2", {"t2"},
+                                                   nullptr));
+  EXPECT_TRUE(restored_array.AddComponentArrayItem("comp1", "comp2", {"t4"},
+                                                   nullptr));
+  const base::ListValue* array = nullptr;
+  ASSERT_TRUE(restored_array.GetComponents().GetList("comp1.components.comp2",
+                                                     &array));
+  EXPECT_JSON_EQ(R"([{"traits": ["t2"]}, {"traits": ["t4"]}])", *array);
+}
+
+TEST_F(ComponentManagerTest, SnapshotComponentsRemoved) {
+  CreateTestComponentTree(&manager_);
+  ASSERT_TRUE(manager_.AddComponent("", "comp5", {"t1"}, nullptr));
+  auto snapshot = manager_.CreateSnapshot();
+
+  // Components which are not added again are removed with their
+  // sub-components.
+  ComponentManagerImpl restored{&task_runner_, &clock_};
+  ASSERT_TRUE(restored.RestoreSnapshot(*snapshot, nullptr));
+  ASSERT_TRUE(restored.AddComponent("", "comp1", {"t1"}, nullptr));
+  ASSERT_TRUE(
+      restored.AddComponentArrayItem("comp1", "comp2", {"t2"}, nullptr));
+  restored.RemoveRestoredComponents();
+  EXPECT_JSON_EQ(R"({
+    "comp1": {
+      "traits": ["t1"],
+      "components": {"comp2": [{"traits": ["t2"]}]}
+    }
+  })", restored.GetComponents());
+  // Removed components may be added as new ones.
+  EXPECT_TRUE(restored.AddComponent("", "comp5", {"t2"}, nullptr));
+
+  // Arrays none of the items of which are added again are removed.
+  ComponentManagerImpl restored_array{&task_runner_, &clock_};
+  ASSERT_TRUE(restored_array.RestoreSnapshot(*snapshot, nullptr));
+  ASSERT_TRUE(restored_array.AddComponent("", "comp1", {"t1"}, nullptr));
+  restored_array.RemoveRestoredComponents();
+  EXPECT_JSON_EQ(R"({"comp1": {"traits": ["t1"], "components": {}}})",
+                 restored_array.GetComponents());
+}
+
+TEST_F(ComponentManagerTest, SnapshotArrayItemRemoved) {
+  CreateTestComponentTree(&manager_);
+  auto snapshot = manager_.CreateSnapshot();
+  EXPECT_TRUE(manager_.RemoveComponentArrayItem("comp1", "comp2", 0, nullptr));
+
+  // Restored sub-components of the following items move with them.
+  ComponentManagerImpl restored{&task_runner_, &clock_};
+  ASSERT_TRUE(restored.RestoreSnapshot(*snapshot, nullptr));
+  EXPECT_TRUE(restored.RemoveComponentArrayItem("comp1", "comp2", 0, nullptr));
+  EXPECT_TRUE(restored.AddComponent("", "comp1", {"t1"}, nullptr));
+  EXPECT_TRUE(
+      restored.AddComponentArrayItem("comp1", "comp2", {"t3"}, nullptr));
+  EXPECT_TRUE(
+      restored.AddComponent("comp1.comp2[0]", "comp3", {"t4"}, nullptr));
+  EXPECT_TRUE(restored.AddComponent("comp1.comp2[0].comp3", "comp4",
+                                    {"t5", "t6"}, nullptr));
+  restored.RemoveRestoredComponents();
+  EXPECT_TRUE(manager_.GetComponents().Equals(&restored.GetComponents()));
+}
+
+TEST_F(ComponentManagerTest, ComponentsMemoryUsage) {
+  // The gauge is shared by all managers, so it's compared with the estimates
+  // of the whole trees of managers of the test.
+  Gauge* gauge = GetMemoryGauge("components");
+  auto estimate = [](const ComponentManagerImpl& manager) {
+    return static_cast<int64_t>(EstimateMemoryUsage(manager.GetComponents()));
+  };
+  int64_t others = gauge->Get() - estimate(manager_);
+
+  CreateTestComponentTree(&manager_);
+  EXPECT_EQ(others + estimate(manager_), gauge->Get());
+  ASSERT_TRUE(manager_.SetStatePropertiesFromJson(
+      "comp1", R"({"t1": {"p1": 1, "p2": "a string longer than inline"}})",
+      nullptr));
+  ASSERT_TRUE(manager_.SetStatePropertiesFromJson(
+      "comp1", R"({"t1": {"p2": "short", "p3": {"a": [1, 2]}}, "t2": {}})",
+      nullptr));
+  EXPECT_EQ(others + estimate(manager_), gauge->Get());
+  EXPECT_TRUE(manager_.AddComponentArrayItem(
+      "comp1", "an_array_with_a_long_name", {"t1"}, nullptr));
+  EXPECT_TRUE(manager_.AddComponent("comp1.comp2[0]", "a_long_component_name",
+                                    {"t2"}, nullptr));
+  EXPECT_EQ(others + estimate(manager_), gauge->Get());
+  EXPECT_TRUE(manager_.RemoveComponentArrayItem("comp1", "comp2", 1, nullptr));
+  EXPECT_TRUE(manager_.RemoveComponent("comp1.comp2[0]",
+                                       "a_long_component_name", nullptr));
+  EXPECT_EQ(others + estimate(manager_), gauge->Get());
+
+  // Restored components which are replaced or dropped.
+  auto snapshot = manager_.CreateSnapshot();
+  ComponentManagerImpl restored{&task_runner_, &clock_};
+  ASSERT_TRUE(restored.RestoreSnapshot(*snapshot, nullptr));
+  EXPECT_TRUE(restored.AddComponentArrayItem("comp1", "comp2", {"t3"},
+                                             nullptr));
+  EXPECT_TRUE(restored.AddComponent("", "comp1", {"t2"}, nullptr));
+  EXPECT_EQ(others + estimate(manager_) + estimate(restored), gauge->Get());
+}
+
+TEST_F(ComponentManagerTest, StateAllocations) {
+  // The mock clock allocates on every call, so use the fake one.
+  ComponentManagerImpl manager{&task_runner_, task_runner_.GetClock()};
+  CreateTestComponentTree(&manager);
+  ASSERT_TRUE(manager.SetStatePropertiesFromJson(
+      "comp1", R"({"t1": {"p1": 0, "p2": "text"}})", nullptr));
+  manager.GetAndClearRecordedStateChanges();
+
+  base::FundamentalValue value{1};
+  EXPECT_ALLOCATION_BUDGET(
+      15, EXPECT_TRUE(manager.SetStateProperty("comp1", "t1.p1", value,
+                                               nullptr)));
+  auto properties = CreateDictionaryValue(R"({"t1": {"p1": 2, "p2": "t"}})");
+  EXPECT_ALLOCATION_BUDGET(
+      9, EXPECT_TRUE(manager.SetStateProperties("comp1", *properties,
+                                                nullptr)));
+  EXPECT_ALLOCATION_BUDGET(
+      1, EXPECT_TRUE(manager.GetStateProperty("comp1", "t1.p1", nullptr)));
+  EXPECT_ALLOCATION_BUDGET(2, manager.GetAndClearRecordedStateChanges());
+}
+
+TEST_F(ComponentManagerTest, ComponentTreeReaderAllocations) {
+  CreateTestComponentTree(&manager_);
+  ASSERT_TRUE(manager_.SetStatePropertiesFromJson(
+      "comp1", R"({"t1": {"p1": 1}})", nullptr));
+  auto reader = manager_.CreateComponentTreeReader();
+  reader->Acquire();
+
+  // Readers of an unchanged tree share the snapshot.
+  EXPECT_ALLOCATION_BUDGET(
+      1, EXPECT_TRUE(reader->Acquire().GetStateProperty("comp1", "t1.p1",
+                                                        nullptr)));
+}
+
 TEST_F(ComponentManagerTest, TestMockComponentManager) {
   // Check that all the virtual methods are mocked out.
   MockComponentManager mock;
@@ -0,0 +1,127 @@
+// Copyright 2016 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "src/component_tree_publisher.h"
+
+#include <algorithm>
+#include <limits>
+
+#include <base/logging.h>
+
+namespace weave {
+
+namespace {
+
+// Slot value of readers which hold no snapshot.
+const uint64_t kNotPinned = 0;
+
+}  // namespace
+
+// Epoch pinned by a single reader.
+struct ComponentTreePublisher::Slot {
+  std::atomic<uint64_t> epoch{kNotPinned};
+  std::atomic<bool> closed{false};
+};
+
+struct ComponentTreePublisher::Domain {
+  ~Domain() {
+    delete current.load();
+    for (const auto& pair : retired)
+      delete pair.second;
+  }
+
+  std::atomic<const ComponentTreeSnapshot*> current{nullptr};
+  std::atomic<uint64_t> epoch{1};
+
+  // Used only on the libweave thread, or by the last owner.
+  std::vector<std::unique_ptr<Slot>> slots;
+  // Snapshots by the epoch they were replaced in, oldest first.
+  std::vector<std::pair<uint64_t, const ComponentTreeSnapshot*>> retired;
+};
+
+class ComponentTreePublisher::Reader : public ComponentTreeReader {
+ public:
+  Reader(const std::shared_ptr<Domain>& domain, Slot* slot)
+      : domain_{domain}, slot_{slot} {}
+
+  ~Reader() override {
+    Release();
+    slot_->closed.store(true);
+  }
+
+  const ComponentTreeSnapshot& Acquire() override {
+    // All operations are sequentially consistent. If the publisher checks
+    // the slot before the store below, the load after it returns the latest
+    // snapshot, which is not retired yet.
+    slot_->epoch.store(domain_->epoch.load());
+    const ComponentTreeSnapshot* snapshot = domain_->current.load();
+    CHECK(snapshot) << "Nothing is published yet";
+    return *snapshot;
+  }
+
+  void Release() override { slot_->epoch.store(kNotPinned); }
+
+ private:
+  std::shared_ptr<Domain> domain_;
+  Slot* slot_{nullptr};
+
+  DISALLOW_COPY_AND_ASSIGN(Reader);
+};
+
+ComponentTreePublisher::ComponentTreePublisher() : domain_{new Domain} {}
+
+ComponentTreePublisher::~ComponentTreePublisher() {
+  Reclaim();
+}
+
+std::unique_ptr<ComponentTreeReader> ComponentTreePublisher::CreateReader() {
+  domain_->slots.emplace_back(new Slot);
+  return std::unique_ptr<ComponentTreeReader>{
+      new Reader{domain_, domain_->slots.back().get()}};
+}
+
+bool ComponentTreePublisher::HasReaders() {
+  auto& slots = domain_->slots;
+  slots.erase(std::remove_if(slots.begin(), slots.end(),
+                             [](const std::unique_ptr<Slot>& slot) {
+                               return slot->closed.load();
+                             }),
+              slots.end());
+  return !slots.empty();
+}
+
+void ComponentTreePublisher::Publish(
+    std::unique_ptr<const ComponentTreeSnapshot> snapshot) {
+  const ComponentTreeSnapshot* old =
+      domain_->current.exchange(snapshot.release());
+  // Readers which pin epochs after this one can't get |old| anymore.
+  uint64_t epoch = domain_->epoch.fetch_add(1);
+  if (old)
+    domain_->retired.emplace_back(epoch, old);
+  Reclaim();
+}
+
+size_t ComponentTreePublisher::GetRetiredCount() const {
+  return domain_->retired.size();
+}
+
+void ComponentTreePublisher::Reclaim() {
+  auto& retired = domain_->retired;
+  if (retired.empty())
+    return;
+
+  uint64_t min_pinned = std::numeric_limits<uint64_t>::max();
+  for (const auto& slot : domain_->slots) {
+    uint64_t epoch = slot->epoch.load();
+    if (epoch != kNotPinned)
+      min_pinned = std::min(min_pinned, epoch);
+  }
+
+  auto end = retired.begin();
+  for (; end != retired.end() && end->first < min_pinned; ++end)
+    delete end->second;
+  retired.erase(retired.begin(), end);
+}
+
+}  // namespace weave
@@ -0,0 +1,57 @@
+// Copyright 2016 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIBWEAVE_SRC_COMPONENT_TREE_PUBLISHER_H_
+#define LIBWEAVE_SRC_COMPONENT_TREE_PUBLISHER_H_
+
+#include <atomic>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include <base/macros.h>
+#include <weave/device.h>
+
+namespace weave {
+
+// Publishes immutable ComponentTreeSnapshots to ComponentTreeReaders on other
+// threads, read-copy-update style. Readers pin the current epoch before
+// loading the snapshot pointer. Replaced snapshots are retired with the epoch
+// they were replaced in and deleted once no reader is pinned at that epoch or
+// earlier. Readers never block or wait for each other or for the libweave
+// thread. All methods must be called on the libweave thread.
+class ComponentTreePublisher final {
+ public:
+  ComponentTreePublisher();
+  ~ComponentTreePublisher();
+
+  // Returns a new reader. Publish() must be called before the reader is used.
+  std::unique_ptr<ComponentTreeReader> CreateReader();
+
+  // Returns true if there are readers which are not destroyed yet.
+  bool HasReaders();
+
+  // Makes |snapshot| the current one.
+  void Publish(std::unique_ptr<const ComponentTreeSnapshot> snapshot);
+
+  // Number of replaced snapshots which may still be in use by readers.
+  size_t GetRetiredCount() const;
+
+ private:
+  class Reader;
+  struct Slot;
+  struct Domain;
+
+  // Deletes retired snapshots which are not in use anymore.
+  void Reclaim();
+
+  // Shared with readers, so it lives until the last of them is destroyed.
+  std::shared_ptr<Domain> domain_;
+
+  DISALLOW_COPY_AND_ASSIGN(ComponentTreePublisher);
+};
+
+}  // namespace weave
+
+#endif  // LIBWEAVE_SRC_COMPONENT_TREE_PUBLISHER_H_
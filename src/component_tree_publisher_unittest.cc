@@ -0,0 +1,140 @@
+// Copyright 2016 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "src/component_tree_publisher.h"
+
+#include <atomic>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+namespace weave {
+
+namespace {
+
+class FakeSnapshot : public ComponentTreeSnapshot {
+ public:
+  FakeSnapshot(int value, std::atomic<int>* deleted) : deleted_{deleted} {
+    components_.SetInteger("a", value);
+    components_.SetInteger("b", value);
+  }
+  ~FakeSnapshot() override { ++*deleted_; }
+
+  const base::DictionaryValue& GetTraits() const override { return traits_; }
+  const base::DictionaryValue& GetComponents() const override {
+    return components_;
+  }
+  const base::Value* GetStateProperty(const std::string& component,
+                                      const std::string& name,
+                                      ErrorPtr* error) const override {
+    return nullptr;
+  }
+
+  int GetValue() const {
+    int a = 0;
+    int b = 0;
+    EXPECT_TRUE(components_.GetInteger("a", &a));
+    EXPECT_TRUE(components_.GetInteger("b", &b));
+    EXPECT_EQ(a, b);
+    return a;
+  }
+
+ private:
+  std::atomic<int>* deleted_{nullptr};
+  base::DictionaryValue traits_;
+  base::DictionaryValue components_;
+};
+
+int GetValue(const ComponentTreeSnapshot& snapshot) {
+  return static_cast<const FakeSnapshot&>(snapshot).GetValue();
+}
+
+}  // namespace
+
+class ComponentTreePublisherTest : public ::testing::Test {
+ protected:
+  void Publish(int value) {
+    publisher_->Publish(std::unique_ptr<const ComponentTreeSnapshot>{
+        new FakeSnapshot{value, &deleted_}});
+  }
+
+  std::atomic<int> deleted_{0};
+  std::unique_ptr<ComponentTreePublisher> publisher_{
+      new ComponentTreePublisher};
+};
+
+TEST_F(ComponentTreePublisherTest, Reclaim) {
+  auto reader = publisher_->CreateReader();
+  Publish(1);
+  const ComponentTreeSnapshot& snapshot1 = reader->Acquire();
+  EXPECT_EQ(1, GetValue(snapshot1));
+
+  Publish(2);
+  EXPECT_EQ(1u, publisher_->GetRetiredCount());
+  // Acquired snapshot is still there.
+  EXPECT_EQ(1, GetValue(snapshot1));
+  EXPECT_EQ(0, deleted_);
+
+  EXPECT_EQ(2, GetValue(reader->Acquire()));
+  Publish(3);
+  EXPECT_EQ(1, deleted_);
+  EXPECT_EQ(1u, publisher_->GetRetiredCount());
+
+  reader->Release();
+  Publish(4);
+  EXPECT_EQ(3, deleted_);
+  EXPECT_EQ(0u, publisher_->GetRetiredCount());
+
+  EXPECT_TRUE(publisher_->HasReaders());
+  reader.reset();
+  EXPECT_FALSE(publisher_->HasReaders());
+  publisher_.reset();
+  EXPECT_EQ(4, deleted_);
+}
+
+TEST_F(ComponentTreePublisherTest, ReaderOutlivesPublisher) {
+  auto reader = publisher_->CreateReader();
+  Publish(1);
+  const ComponentTreeSnapshot& snapshot = reader->Acquire();
+  Publish(2);
+  publisher_.reset();
+  EXPECT_EQ(0, deleted_);
+  EXPECT_EQ(1, GetValue(snapshot));
+  EXPECT_EQ(2, GetValue(reader->Acquire()));
+  reader.reset();
+  EXPECT_EQ(2, deleted_);
+}
+
+TEST_F(ComponentTreePublisherTest, ManyThreads) {
+  const int kThreads = 4;
+  const int kSnapshots = 10000;
+
+  Publish(0);
+  std::atomic<bool> done{false};
+  std::vector<std::thread> threads;
+  for (int i = 0; i < kThreads; ++i) {
+    std::shared_ptr<ComponentTreeReader> reader{publisher_->CreateReader()};
+    threads.emplace_back([reader, &done]() {
+      int last = 0;
+      while (!done.load()) {
+        int value = GetValue(reader->Acquire());
+        EXPECT_LE(last, value);
+        last = value;
+      }
+    });
+  }
+
+  for (int i = 1; i <= kSnapshots; ++i)
+    Publish(i);
+  done.store(true);
+  for (auto& thread : threads)
+    thread.join();
+
+  EXPECT_FALSE(publisher_->HasReaders());
+  Publish(kSnapshots + 1);
+  EXPECT_EQ(0u, publisher_->GetRetiredCount());
+  EXPECT_EQ(kSnapshots + 1, deleted_);
+}
+
+}  // namespace weave
@@ -58,6 +58,9 @@ namespace {
 
 const int kCurrentConfigVersion = 1;
 
+// Maximum time a committed change may wait before it's written.
+const int kSaveDelaySeconds = 1;
+
 void MigrateFromV0(base::DictionaryValue* dict) {
   std::string cloud_id;
   if (dict->GetString(config_keys::kCloudId, &cloud_id) && !cloud_id.empty())
@@ -90,11 +93,18 @@ template <>
 LIBWEAVE_EXPORT EnumToStringMap<RootClientTokenOwner>::EnumToStringMap()
     : EnumToStringMap(kRootClientTokenOwnerMap) {}
 
-Config::Config(provider::ConfigStore* config_store)
-    : settings_{CreateDefaultSettings()}, config_store_{config_store} {
+Config::Config(provider::ConfigStore* config_store,
+               provider::TaskRunner* task_runner)
+    : settings_{CreateDefaultSettings()},
+      config_store_{config_store},
+      task_runner_{task_runner} {
   Load();
 }
 
+Config::~Config() {
+  Flush();
+}
+
 void Config::AddOnChangedCallback(const OnChangedCallback& callback) {
   on_changed_.push_back(callback);
   // Force to read current state.
@@ -249,6 +259,29 @@ void Config::Save() {
   if (!config_store_)
     return;
 
+  if (!task_runner_)
+    return Write();
+
+  if (save_pending_) {
+    // Already scheduled write will include this change as well.
+    ++coalesced_save_count_;
+    return;
+  }
+  save_pending_ = true;
+  task_runner_->PostDelayedTask(
+      FROM_HERE,
+      base::Bind(&Config::Flush, weak_ptr_factory_.GetWeakPtr()),
+      base::TimeDelta::FromSeconds(kSaveDelaySeconds));
+}
+
+void Config::Flush() {
+  if (!save_pending_ && !write_failed_)
+    return;
+  save_pending_ = false;
+  Write();
+}
+
+void Config::Write() {
   base::DictionaryValue dict;
   dict.SetInteger(config_keys::kVersion, kCurrentConfigVersion);
 
@@ -278,12 +311,17 @@ void Config::Save() {
                   settings_.local_pairing_enabled);
 
   std::string json_string;
-  base::JSONWriter::WriteWithOptions(
-      dict, base::JSONWriter::OPTIONS_PRETTY_PRINT, &json_string);
+  base::JSONWriter::Write(dict, &json_string);
 
   config_store_->SaveSettings(
       kConfigName, json_string,
-      base::Bind([](ErrorPtr error) { CHECK(!error); }));
+      base::Bind(&Config::OnWriteDone, weak_ptr_factory_.GetWeakPtr()));
+}
+
+void Config::OnWriteDone(ErrorPtr error) {
+  write_failed_ = !!error;
+  if (error)
+    LOG(ERROR) << "Failed to save settings: " << error->GetMessage();
 }
 
 Config::Transaction::~Transaction() {
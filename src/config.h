@@ -11,8 +11,10 @@
 
 #include <base/callback.h>
 #include <base/gtest_prod_util.h>
+#include <base/memory/weak_ptr.h>
 #include <weave/error.h>
 #include <weave/provider/config_store.h>
+#include <weave/provider/task_runner.h>
 
 #include "src/privet/privet_types.h"
 
@@ -39,13 +41,23 @@ class Config final {
   };
 
   using OnChangedCallback = base::Callback<void(const weave::Settings&)>;
-  ~Config() = default;
+  ~Config();
 
-  explicit Config(provider::ConfigStore* config_store);
+  // If |task_runner| is provided, saves of commits made in quick succession
+  // are coalesced into a single write, delayed by no more than
+  // kSaveDelaySeconds from the first unsaved commit.
+  explicit Config(provider::ConfigStore* config_store,
+                  provider::TaskRunner* task_runner = nullptr);
 
   void AddOnChangedCallback(const OnChangedCallback& callback);
   const Config::Settings& GetSettings() const;
 
+  // Writes pending changes, or changes which failed to be saved, immediately.
+  void Flush();
+
+  // Returns number of writes avoided by coalescing.
+  size_t GetCoalescedSaveCount() const { return coalesced_save_count_; }
+
   // Allows editing of config. Makes sure that callbacks were called and changes
   // were saved.
   // User can commit changes by calling Commit method or by destroying the
@@ -123,10 +135,19 @@ class Config final {
  private:
   void Load();
   void Save();
+  void Write();
+  void OnWriteDone(ErrorPtr error);
 
   Settings settings_;
   provider::ConfigStore* config_store_{nullptr};
+  provider::TaskRunner* task_runner_{nullptr};
   std::vector<OnChangedCallback> on_changed_;
+  bool save_pending_{false};
+  // The last write failed, so settings are written again on the next save.
+  bool write_failed_{false};
+  size_t coalesced_save_count_{0};
+
+  base::WeakPtrFactory<Config> weak_ptr_factory_{this};
 
   DISALLOW_COPY_AND_ASSIGN(Config);
 };
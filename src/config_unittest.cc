@@ -9,6 +9,7 @@
 #include <base/bind.h>
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
+#include <weave/provider/test/fake_task_runner.h>
 #include <weave/provider/test/mock_config_store.h>
 #include <weave/test/unittest_utils.h>
 
@@ -293,4 +294,71 @@ TEST_F(ConfigTest, Setters) {
   change.Commit();
 }
 
+TEST_F(ConfigTest, CoalesceSaves) {
+  provider::test::FakeTaskRunner task_runner;
+  Config config{&config_store_, &task_runner};
+
+  EXPECT_CALL(config_store_, SaveSettings(_, _, _)).Times(0);
+  for (const char* name : {"name1", "name2", "name3"}) {
+    Config::Transaction change{&config};
+    change.set_name(name);
+  }
+  EXPECT_EQ(2u, config.GetCoalescedSaveCount());
+
+  EXPECT_CALL(config_store_, SaveSettings(kConfigName, _, _))
+      .WillOnce(WithArgs<1>(Invoke([](const std::string& json) {
+        // Compact encoding.
+        EXPECT_EQ(std::string::npos, json.find('\n'));
+        auto value = test::CreateValue(json);
+        const base::DictionaryValue* dict = nullptr;
+        ASSERT_TRUE(value->GetAsDictionary(&dict));
+        std::string name;
+        EXPECT_TRUE(dict->GetString("name", &name));
+        EXPECT_EQ("name3", name);
+      })));
+  task_runner.RunOnce();
+  testing::Mock::VerifyAndClearExpectations(&config_store_);
+
+  {
+    Config::Transaction change{&config};
+    change.set_name("name4");
+  }
+  EXPECT_EQ(2u, config.GetCoalescedSaveCount());
+
+  // Pending changes are written on destruction.
+  EXPECT_CALL(config_store_, SaveSettings(kConfigName, _, _)).Times(1);
+}
+
+TEST_F(ConfigTest, RetryFailedSave) {
+  provider::test::FakeTaskRunner task_runner;
+  Config config{&config_store_, &task_runner};
+  {
+    Config::Transaction change{&config};
+    change.set_name("name1");
+  }
+
+  // A failed write doesn't crash, and is retried on the next save.
+  EXPECT_CALL(config_store_, SaveSettings(kConfigName, _, _))
+      .WillOnce(WithArgs<2>(
+          Invoke([](const DoneCallback& callback) {
+            ErrorPtr error;
+            Error::AddTo(&error, FROM_HERE, "write_failed", "Disk full");
+            callback.Run(std::move(error));
+          })));
+  task_runner.RunOnce();
+  testing::Mock::VerifyAndClearExpectations(&config_store_);
+
+  EXPECT_CALL(config_store_, SaveSettings(kConfigName, _, _))
+      .WillOnce(WithArgs<2>(
+          Invoke([](const DoneCallback& callback) {
+            callback.Run(nullptr);
+          })));
+  config.Flush();
+  testing::Mock::VerifyAndClearExpectations(&config_store_);
+
+  // Nothing left to save.
+  EXPECT_CALL(config_store_, SaveSettings(_, _, _)).Times(0);
+  config.Flush();
+}
+
 }  // namespace weave
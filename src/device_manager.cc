@@ -4,20 +4,31 @@
 
 #include "src/device_manager.h"
 
+#include <algorithm>
 #include <string>
+#include <thread>
 
 #include <base/bind.h>
+#include <base/json/json_writer.h>
 
 #include "src/access_api_handler.h"
 #include "src/access_black_list_manager_impl.h"
 #include "src/base_api_handler.h"
+#include "src/commands/command_worker_pool.h"
 #include "src/commands/schema_constants.h"
 #include "src/component_manager_impl.h"
 #include "src/config.h"
 #include "src/device_registration_info.h"
+#include "src/memory_usage.h"
+#include "src/metrics.h"
 #include "src/privet/auth_manager.h"
 #include "src/privet/privet_manager.h"
+#include "src/snapshot_manager.h"
+#include "src/startup_profiler.h"
+#include "src/states/state_producer_hub.h"
 #include "src/string_utils.h"
+#include "src/trace_log.h"
+#include "src/tracing_task_runner.h"
 #include "src/utils.h"
 
 namespace weave {
@@ -30,29 +41,63 @@ DeviceManager::DeviceManager(provider::ConfigStore* config_store,
                              provider::HttpServer* http_server,
                              provider::Wifi* wifi,
                              provider::Bluetooth* bluetooth)
-    : config_{new Config{config_store}},
-      component_manager_{new ComponentManagerImpl{task_runner}} {
+    : startup_profiler_{new StartupProfiler},
+      task_runner_{
+          new TracingTaskRunner{task_runner, TraceLog::GetInstance()}},
+      component_manager_{new ComponentManagerImpl{task_runner_.get()}},
+      state_producer_hub_{
+          new StateProducerHub{component_manager_.get(), task_runner_.get()}},
+      command_worker_pool_{new CommandWorkerPool{
+          task_runner_.get(),
+          std::max(2u, std::thread::hardware_concurrency())}} {
+  startup_profiler_->EndPhase("init");
+
+  config_.reset(new Config{config_store, task_runner_.get()});
+  startup_profiler_->EndPhase("config_load");
+
+  black_list_manager_.reset(
+      new AccessBlackListManagerImpl{config_store, task_runner_.get()});
+  startup_profiler_->EndPhase("black_list_load");
+
   if (http_server) {
     auth_manager_.reset(new privet::AuthManager(
-        config_.get(), http_server->GetHttpsCertificateFingerprint()));
+        config_.get(), black_list_manager_.get(),
+        http_server->GetHttpsCertificateFingerprint()));
   }
+  startup_profiler_->EndPhase("auth_setup");
 
   device_info_.reset(new DeviceRegistrationInfo(
-      config_.get(), component_manager_.get(), task_runner, http_client,
+      config_.get(), component_manager_.get(), task_runner_.get(), http_client,
       network, auth_manager_.get()));
+  device_info_->AddGcdStateChangedCallback(base::Bind(
+      &DeviceManager::OnGcdStateChanged, weak_ptr_factory_.GetWeakPtr()));
+  startup_profiler_->EndPhase("device_info");
+
+  if (config_->GetSettings().warm_restart_enabled) {
+    snapshot_manager_.reset(new SnapshotManager{
+        config_store, task_runner_.get(), component_manager_.get(),
+        device_info_.get()});
+    snapshot_manager_->Restore();
+  }
+  startup_profiler_->EndPhase("snapshot_restore");
+
   base_api_handler_.reset(new BaseApiHandler{device_info_.get(), this});
+  startup_profiler_->EndPhase("base_traits");
 
-  black_list_manager_.reset(new AccessBlackListManagerImpl{config_store});
   access_api_handler_.reset(
       new AccessApiHandler{this, black_list_manager_.get()});
+  startup_profiler_->EndPhase("access_traits");
 
   device_info_->Start();
+  startup_profiler_->EndPhase("cloud_start");
 
   if (http_server) {
-    StartPrivet(task_runner, network, dns_sd, http_server, wifi, bluetooth);
+    StartPrivet(task_runner_.get(), network, dns_sd, http_server, wifi,
+                bluetooth);
   } else {
     CHECK(!dns_sd);
   }
+  startup_profiler_->EndPhase("privet_start");
 }
 
 DeviceManager::~DeviceManager() {}
@@ -79,6 +124,14 @@ void DeviceManager::StartPrivet(provider::TaskRunner* task_runner,
   privet_.reset(new privet::Manager{task_runner});
   privet_->Start(network, dns_sd, http_server, wifi, auth_manager_.get(),
                  device_info_.get(), component_manager_.get());
+  privet_->AddOnReplySentCallback(
+      base::Bind(&StartupProfiler::OnPrivetReplySent,
+                 base::Unretained(startup_profiler_.get())));
+}
+
+void DeviceManager::OnGcdStateChanged(GcdState state) {
+  if (state == GcdState::kConnected)
+    startup_profiler_->OnCloudConnected();
 }
 
 GcdState DeviceManager::GetGcdState() const {
@@ -98,6 +151,11 @@ void DeviceManager::AddTraitDefinitions(const base::DictionaryValue& dict) {
   CHECK(component_manager_->LoadTraits(dict, nullptr));
 }
 
+void DeviceManager::AddTraitDefinitionsFromBundle(const uint8_t* data,
+                                                  size_t size) {
+  CHECK(component_manager_->LoadTraitBundle(data, size, nullptr));
+}
+
 const base::DictionaryValue& DeviceManager::GetTraits() const {
   return component_manager_->GetTraits();
 }
@@ -150,12 +208,29 @@ bool DeviceManager::SetStateProperty(const std::string& component,
   return component_manager_->SetStateProperty(component, name, value, error);
 }
 
+std::unique_ptr<StateProducer> DeviceManager::CreateStateProducer() {
+  return state_producer_hub_->CreateProducer();
+}
+
+std::unique_ptr<ComponentTreeReader>
+DeviceManager::CreateComponentTreeReader() {
+  return component_manager_->CreateComponentTreeReader();
+}
+
 void DeviceManager::AddCommandHandler(const std::string& component,
                                       const std::string& command_name,
                                       const CommandHandlerCallback& callback) {
   component_manager_->AddCommandHandler(component, command_name, callback);
 }
 
+void DeviceManager::AddWorkerCommandHandler(
+    const std::string& component,
+    const std::string& command_name,
+    const CommandHandlerCallback& callback) {
+  component_manager_->AddCommandHandler(
+      component, command_name, command_worker_pool_->Wrap(callback));
+}
+
 void DeviceManager::AddCommandDefinitionsFromJson(const std::string& json) {
   auto dict = LoadJsonDict(json, nullptr);
   CHECK(dict);
@@ -274,6 +349,24 @@ void DeviceManager::AddPairingChangedCallbacks(
     privet_->AddOnPairingChangedCallbacks(begin_callback, end_callback);
 }
 
+std::string DeviceManager::GetMetrics() const {
+  return MetricsRegistry::GetInstance()->GetSnapshot();
+}
+
+std::string DeviceManager::GetMemoryUsage() const {
+  std::string json;
+  base::JSONWriter::Write(*GetMemoryUsageReport(), &json);
+  return json;
+}
+
+void DeviceManager::SetTraceBufferSize(size_t max_events) {
+  TraceLog::GetInstance()->SetBufferSize(max_events);
+}
+
+std::string DeviceManager::GetTrace() const {
+  return TraceLog::GetInstance()->GetJson();
+}
+
 std::unique_ptr<Device> Device::Create(provider::ConfigStore* config_store,
                                        provider::TaskRunner* task_runner,
                                        provider::HttpClient* http_client,
@@ -13,9 +13,14 @@ namespace weave {
 class AccessApiHandler;
 class AccessBlackListManager;
 class BaseApiHandler;
+class CommandWorkerPool;
 class Config;
 class ComponentManager;
 class DeviceRegistrationInfo;
+class SnapshotManager;
+class StartupProfiler;
+class StateProducerHub;
+class TracingTaskRunner;
 
 namespace privet {
 class AuthManager;
@@ -40,6 +45,7 @@ class DeviceManager final : public Device {
       const SettingsChangedCallback& callback) override;
   void AddTraitDefinitionsFromJson(const std::string& json) override;
   void AddTraitDefinitions(const base::DictionaryValue& dict) override;
+  void AddTraitDefinitionsFromBundle(const uint8_t* data, size_t size) override;
   const base::DictionaryValue& GetTraits() const override;
   void AddTraitDefsChangedCallback(const base::Closure& callback) override;
   bool AddComponent(const std::string& name,
@@ -61,9 +67,14 @@ class DeviceManager final : public Device {
                         const std::string& name,
                         const base::Value& value,
                         ErrorPtr* error) override;
+  std::unique_ptr<StateProducer> CreateStateProducer() override;
+  std::unique_ptr<ComponentTreeReader> CreateComponentTreeReader() override;
   void AddCommandHandler(const std::string& component,
                          const std::string& command_name,
                          const CommandHandlerCallback& callback) override;
+  void AddWorkerCommandHandler(const std::string& component,
+                               const std::string& command_name,
+                               const CommandHandlerCallback& callback) override;
   bool AddCommand(const base::DictionaryValue& command,
                   std::string* id,
                   ErrorPtr* error) override;
@@ -77,6 +88,10 @@ class DeviceManager final : public Device {
   void AddPairingChangedCallbacks(
       const PairingBeginCallback& begin_callback,
       const PairingEndCallback& end_callback) override;
+  std::string GetMetrics() const override;
+  std::string GetMemoryUsage() const override;
+  void SetTraceBufferSize(size_t max_events) override;
+  std::string GetTrace() const override;
 
   void AddCommandDefinitionsFromJson(const std::string& json) override;
   void AddCommandDefinitions(const base::DictionaryValue& dict) override;
@@ -103,15 +118,24 @@ class DeviceManager final : public Device {
                    provider::HttpServer* http_server,
                    provider::Wifi* wifi,
                    provider::Bluetooth* bluetooth);
+  void OnGcdStateChanged(GcdState state);
 
+  // Created first, so that it measures construction of everything else.
+  std::unique_ptr<StartupProfiler> startup_profiler_;
+  // Wraps the provider's task runner, so tasks of all subsystems are traced.
+  std::unique_ptr<TracingTaskRunner> task_runner_;
   std::unique_ptr<Config> config_;
+  std::unique_ptr<AccessBlackListManager> black_list_manager_;
   std::unique_ptr<privet::AuthManager> auth_manager_;
   std::unique_ptr<ComponentManager> component_manager_;
+  std::unique_ptr<StateProducerHub> state_producer_hub_;
+  std::unique_ptr<CommandWorkerPool> command_worker_pool_;
   std::unique_ptr<DeviceRegistrationInfo> device_info_;
   std::unique_ptr<BaseApiHandler> base_api_handler_;
-  std::unique_ptr<AccessBlackListManager> black_list_manager_;
   std::unique_ptr<AccessApiHandler> access_api_handler_;
   std::unique_ptr<privet::Manager> privet_;
+  // Saves the snapshot on destruction, so it goes before the managers above.
+  std::unique_ptr<SnapshotManager> snapshot_manager_;
 
   base::WeakPtrFactory<DeviceManager> weak_ptr_factory_{this};
   DISALLOW_COPY_AND_ASSIGN(DeviceManager);
@@ -26,10 +26,13 @@
 #include "src/data_encoding.h"
 #include "src/http_constants.h"
 #include "src/json_error_codes.h"
+#include "src/metrics.h"
 #include "src/notification/xmpp_channel.h"
 #include "src/privet/auth_manager.h"
 #include "src/string_utils.h"
+#include "src/trace_log.h"
 #include "src/utils.h"
+#include "third_party/chromium/crypto/sha2.h"
 
 namespace weave {
 
@@ -116,6 +119,30 @@ void IgnoreCloudResultWithCallback(const DoneCallback& cb,
   cb.Run(std::move(error));
 }
 
+// Removes state of components in |components| and their sub-components.
+void RemoveComponentState(base::DictionaryValue* components) {
+  for (base::DictionaryValue::Iterator it(*components); !it.IsAtEnd();
+       it.Advance()) {
+    std::vector<base::DictionaryValue*> items;
+    base::DictionaryValue* component = nullptr;
+    base::ListValue* array = nullptr;
+    if (components->GetDictionaryWithoutPathExpansion(it.key(), &component)) {
+      items.push_back(component);
+    } else if (components->GetListWithoutPathExpansion(it.key(), &array)) {
+      for (size_t i = 0; i < array->GetSize(); ++i) {
+        if (array->GetDictionary(i, &component))
+          items.push_back(component);
+      }
+    }
+    for (base::DictionaryValue* item : items) {
+      item->RemoveWithoutPathExpansion("state", nullptr);
+      base::DictionaryValue* children = nullptr;
+      if (item->GetDictionary("components", &children))
+        RemoveComponentState(children);
+    }
+  }
+}
+
 class RequestSender final {
  public:
   RequestSender(HttpClient::Method method,
@@ -224,6 +251,45 @@ std::unique_ptr<base::DictionaryValue> ParseJsonResponse(
   return std::unique_ptr<base::DictionaryValue>(dict_value);
 }
 
+struct Metrics {
+  Counter* requests{
+      MetricsRegistry::GetInstance()->GetCounter("cloud.requests")};
+  Counter* retries{
+      MetricsRegistry::GetInstance()->GetCounter("cloud.request_retries")};
+  Counter* failures{
+      MetricsRegistry::GetInstance()->GetCounter("cloud.request_failures")};
+  Histogram* request_time{
+      MetricsRegistry::GetInstance()->GetHistogram("cloud.request_ms")};
+  Counter* commands{
+      MetricsRegistry::GetInstance()->GetCounter("cloud.commands_received")};
+  Histogram* state_patches{MetricsRegistry::GetInstance()->GetHistogram(
+      "cloud.state_patches_per_request")};
+  Counter* resource_uploads_skipped{MetricsRegistry::GetInstance()->GetCounter(
+      "cloud.resource_uploads_skipped")};
+  Gauge* request_memory{GetMemoryGauge("cloud_requests")};
+};
+
+const Metrics& GetMetrics() {
+  static const Metrics metrics;
+  return metrics;
+}
+
+const char kTraceCategory[] = "cloud";
+const char kCloudRequestSpan[] = "CloudRequest";
+
+void EndCloudRequestSpan(
+    uint64_t span_id,
+    const DeviceRegistrationInfo::CloudRequestDoneCallback& callback,
+    const base::DictionaryValue& response,
+    ErrorPtr error) {
+  std::unique_ptr<base::DictionaryValue> args{new base::DictionaryValue};
+  if (error)
+    args->SetString("error", error->GetCode());
+  TraceLog::GetInstance()->EndSpan(kTraceCategory, kCloudRequestSpan, span_id,
+                                   std::move(args));
+  callback.Run(response, std::move(error));
+}
+
 bool IsSuccessful(const HttpClient::Response& response) {
   int code = response.GetStatusCode();
   return code >= http::kContinue && code < http::kBadRequest;
@@ -293,17 +359,60 @@ std::string DeviceRegistrationInfo::GetOAuthURL(
 
 void DeviceRegistrationInfo::Start() {
   if (HaveRegistrationCredentials()) {
-    StartNotificationChannel();
     // Wait a significant amount of time for local daemons to publish their
     // state to Buffet before publishing it to the cloud.
     // TODO(wiley) We could do a lot of things here to either expose this
     //             timeout as a configurable knob or allow local
     //             daemons to signal that their state is up to date so that
     //             we need not wait for them.
+    // The notification channel is started when ConnectToCloud() gets an
+    // access token. Without one, the XMPP server would reject the device after
+    // the TLS handshake, and the channel would be restarted anyway.
     ScheduleCloudConnection(base::TimeDelta::FromSeconds(5));
   }
 }
 
+std::unique_ptr<base::DictionaryValue>
+DeviceRegistrationInfo::GetCloudSyncState() const {
+  std::unique_ptr<base::DictionaryValue> state;
+  if (!connected_to_cloud_ || !in_progress_resource_update_callbacks_.empty() ||
+      !queued_resource_update_callbacks_.empty() ||
+      device_state_update_pending_ ||
+      last_acknowledged_update_id_ !=
+          component_manager_->GetLastStateChangeId() ||
+      last_device_resource_updated_timestamp_.empty()) {
+    return state;
+  }
+  state.reset(new base::DictionaryValue);
+  state->SetString("resourceFingerprint", GetDeviceResourceFingerprint());
+  state->SetString("lastUpdateTimeMs", last_device_resource_updated_timestamp_);
+  state->SetString("lastUpdateId",
+                   std::to_string(last_acknowledged_update_id_));
+  return state;
+}
+
+void DeviceRegistrationInfo::RestoreCloudSyncState(
+    const base::DictionaryValue& state) {
+  std::string fingerprint;
+  std::string timestamp;
+  std::string update_id;
+  uint64_t id = 0;
+  if (!state.GetString("resourceFingerprint", &fingerprint) ||
+      !state.GetString("lastUpdateTimeMs", &timestamp) ||
+      !state.GetString("lastUpdateId", &update_id) ||
+      !base::StringToUint64(update_id, &id)) {
+    LOG(WARNING) << "Invalid cloud sync state: " << state;
+    return;
+  }
+  restored_resource_fingerprint_ = fingerprint;
+  last_device_resource_updated_timestamp_ = timestamp;
+  last_acknowledged_update_id_ = id;
+}
+
+void DeviceRegistrationInfo::RestoreCommands(const base::ListValue& commands) {
+  PublishCommands(CommandInstance::Arrival::kOther, commands, nullptr);
+}
+
 void DeviceRegistrationInfo::ScheduleCloudConnection(
     const base::TimeDelta& delay) {
   SetGcdState(GcdState::kConnecting);
@@ -417,10 +526,11 @@ void DeviceRegistrationInfo::OnRefreshAccessTokenDone(
   LOG(INFO) << "Access token is refreshed for additional " << expires_in
             << " seconds.";
 
-  if (primary_notification_channel_ &&
+  if (!primary_notification_channel_ ||
       !primary_notification_channel_->IsConnected()) {
-    // If we have disconnected channel, it is due to failed credentials.
-    // Now that we have a new access token, retry the connection.
+    // The channel is started with the first access token. If we have
+    // disconnected channel, it is due to failed credentials. Now that we have
+    // a new access token, retry the connection.
     StartNotificationChannel();
   }
 
@@ -501,6 +611,17 @@ DeviceRegistrationInfo::BuildDeviceResource() const {
   return resource;
 }
 
+std::string DeviceRegistrationInfo::GetDeviceResourceFingerprint() const {
+  std::unique_ptr<base::DictionaryValue> resource = BuildDeviceResource();
+  resource->RemoveWithoutPathExpansion("channel", nullptr);
+  base::DictionaryValue* components = nullptr;
+  if (resource->GetDictionary("components", &components))
+    RemoveComponentState(components);
+  std::string json;
+  base::JSONWriter::Write(*resource, &json);
+  return Base64Encode(crypto::SHA256HashString(json));
+}
+
 void DeviceRegistrationInfo::GetDeviceInfo(
     const CloudRequestDoneCallback& callback) {
   ErrorPtr error;
@@ -646,6 +767,9 @@ void DeviceRegistrationInfo::RegisterDeviceOnAuthCodeSent(
   ScheduleCloudConnection({});
 }
 
+DeviceRegistrationInfo::CloudRequestData::CloudRequestData()
+    : memory_usage{GetMetrics().request_memory} {}
+
 void DeviceRegistrationInfo::DoCloudRequest(
     HttpClient::Method method,
     const std::string& url,
@@ -661,6 +785,18 @@ void DeviceRegistrationInfo::DoCloudRequest(
   if (body)
     base::JSONWriter::Write(*body, &data->body);
   data->callback = callback;
+  data->memory_usage.Set(sizeof(CloudRequestData) +
+                         EstimateMemoryUsage(data->url) +
+                         EstimateMemoryUsage(data->body));
+
+  TraceLog* trace_log = TraceLog::GetInstance();
+  if (trace_log->IsEnabled()) {
+    std::unique_ptr<base::DictionaryValue> args{new base::DictionaryValue};
+    args->SetString("url", url);
+    uint64_t span_id = trace_log->BeginSpan(kTraceCategory, kCloudRequestSpan,
+                                            std::move(args));
+    data->callback = base::Bind(&EndCloudRequestSpan, span_id, callback);
+  }
   SendCloudRequest(data);
 }
 
@@ -687,14 +823,17 @@ void DeviceRegistrationInfo::SendCloudRequest(
   RequestSender sender{data->method, data->url, http_client_};
   sender.SetData(data->body, http::kJsonUtf8);
   sender.SetAccessToken(access_token_);
+  GetMetrics().requests->Increment();
   sender.Send(base::Bind(&DeviceRegistrationInfo::OnCloudRequestDone,
-                         AsWeakPtr(), data));
+                         AsWeakPtr(), data, base::Time::Now()));
 }
 
 void DeviceRegistrationInfo::OnCloudRequestDone(
     const std::shared_ptr<const CloudRequestData>& data,
+    base::Time sent_time,
     std::unique_ptr<provider::HttpClient::Response> response,
     ErrorPtr error) {
+  GetMetrics().request_time->AddTime(base::Time::Now() - sent_time);
   if (error)
     return RetryCloudRequest(data);
   int status_code = response->GetStatusCode();
@@ -723,6 +862,7 @@ void DeviceRegistrationInfo::OnCloudRequestDone(
   auto json_resp = ParseJsonResponse(*response, &error);
   if (!json_resp) {
     cloud_backoff_entry_->InformOfRequest(false);
+    GetMetrics().failures->Increment();
     return data->callback.Run({}, std::move(error));
   }
 
@@ -735,6 +875,7 @@ void DeviceRegistrationInfo::OnCloudRequestDone(
     }
 
     cloud_backoff_entry_->InformOfRequest(false);
+    GetMetrics().failures->Increment();
     return data->callback.Run({}, std::move(error));
   }
 
@@ -748,6 +889,7 @@ void DeviceRegistrationInfo::RetryCloudRequest(
   // TODO(avakulenko): Tie connecting/connected status to XMPP channel instead.
   SetGcdState(GcdState::kConnecting);
   cloud_backoff_entry_->InformOfRequest(false);
+  GetMetrics().retries->Increment();
   SendCloudRequest(data);
 }
 
@@ -788,6 +930,18 @@ void DeviceRegistrationInfo::ConnectToCloud(ErrorPtr error) {
   //   2) fetch an initial set of outstanding commands
   //   3) abort any commands that we've previously marked as "in progress"
   //      or as being in an error state; publish queued commands
+  // After a restart, the server may have the device resource already.
+  // Restored components which the application didn't add again by now are
+  // gone, and are not uploaded.
+  component_manager_->RemoveRestoredComponents();
+  std::string fingerprint;
+  fingerprint.swap(restored_resource_fingerprint_);
+  if (!fingerprint.empty() && fingerprint == GetDeviceResourceFingerprint()) {
+    VLOG(1) << "Device resource did not change since restart";
+    GetMetrics().resource_uploads_skipped->Increment();
+    OnConnectedToCloud(nullptr);
+    return;
+  }
   UpdateDeviceResource(
       base::Bind(&DeviceRegistrationInfo::OnConnectedToCloud, AsWeakPtr()));
 }
@@ -1073,7 +1227,8 @@ void DeviceRegistrationInfo::FetchAndPublishCommands(
   }
 
   FetchCommands(base::Bind(&DeviceRegistrationInfo::PublishCommands,
-                           weak_factory_.GetWeakPtr()),
+                           weak_factory_.GetWeakPtr(),
+                           CommandInstance::Arrival::kFetch),
                 reason);
 }
 
@@ -1110,13 +1265,15 @@ void DeviceRegistrationInfo::ProcessInitialCommandList(
                      base::Bind(&IgnoreCloudResult));
     } else {
       // Normal command, publish it to local clients.
-      PublishCommand(*command_dict);
+      PublishCommand(CommandInstance::Arrival::kFetch, *command_dict);
     }
   }
 }
 
-void DeviceRegistrationInfo::PublishCommands(const base::ListValue& commands,
-                                             ErrorPtr error) {
+void DeviceRegistrationInfo::PublishCommands(
+    CommandInstance::Arrival arrival,
+    const base::ListValue& commands,
+    ErrorPtr error) {
   if (error)
     return;
   for (const base::Value* command : commands) {
@@ -1125,11 +1282,12 @@ void DeviceRegistrationInfo::PublishCommands(const base::ListValue& commands,
       LOG(WARNING) << "Not a command dictionary: " << *command;
       continue;
     }
-    PublishCommand(*command_dict);
+    PublishCommand(arrival, *command_dict);
   }
 }
 
 void DeviceRegistrationInfo::PublishCommand(
+    CommandInstance::Arrival arrival,
     const base::DictionaryValue& command) {
   std::string command_id;
   ErrorPtr error;
@@ -1146,6 +1304,7 @@ void DeviceRegistrationInfo::PublishCommand(
   if (!component_manager_->FindCommand(command_instance->GetID())) {
     LOG(INFO) << "New command '" << command_instance->GetName()
               << "' arrived, ID: " << command_instance->GetID();
+    GetMetrics().commands->Increment();
     std::unique_ptr<BackoffEntry> backoff_entry{
         new BackoffEntry{cloud_backoff_policy_.get()}};
     std::unique_ptr<CloudCommandProxy> cloud_proxy{
@@ -1155,6 +1314,7 @@ void DeviceRegistrationInfo::PublishCommand(
     // notifications. When Command is being destroyed it sends
     // ::OnCommandDestroyed() and CloudCommandProxy deletes itself.
     cloud_proxy.release();
+    command_instance->SetArrival(arrival);
     component_manager_->AddCommand(std::move(command_instance));
   }
 }
@@ -1183,6 +1343,7 @@ void DeviceRegistrationInfo::PublishStateUpdates() {
                  std::to_string(base::Time::Now().ToJavaTime()));
   body.Set("patches", patches.release());
 
+  GetMetrics().state_patches->Add(snapshot.state_changes.size());
   device_state_update_pending_ = true;
   DoCloudRequest(HttpClient::Method::kPost, GetDeviceURL("patchState"), &body,
                  base::Bind(&DeviceRegistrationInfo::OnPublishStateDone,
@@ -1198,6 +1359,7 @@ void DeviceRegistrationInfo::OnPublishStateDone(
     LOG(ERROR) << "Permanent failure while trying to update device state";
     return;
   }
+  last_acknowledged_update_id_ = update_id;
   component_manager_->NotifyStateUpdatedOnServer(update_id);
   // See if there were more pending state updates since the previous request
   // had been sent out.
@@ -1292,7 +1454,7 @@ void DeviceRegistrationInfo::OnCommandCreated(
   if (!command.empty()) {
     // GCD spec indicates that the command parameter in notification object
     // "may be empty if command size is too big".
-    PublishCommand(command);
+    PublishCommand(CommandInstance::Arrival::kPush, command);
     return;
   }
 
@@ -21,9 +21,11 @@
 
 #include "src/backoff_entry.h"
 #include "src/commands/cloud_command_update_interface.h"
+#include "src/commands/command_instance.h"
 #include "src/component_manager.h"
 #include "src/config.h"
 #include "src/data_encoding.h"
+#include "src/memory_usage.h"
 #include "src/notification/notification_channel.h"
 #include "src/notification/notification_delegate.h"
 #include "src/notification/pull_channel.h"
@@ -110,6 +112,19 @@ class DeviceRegistrationInfo : public NotificationDelegate,
   // Starts GCD device if credentials available.
   void Start();
 
+  // Returns what is needed to resume syncing with the cloud after a restart,
+  // or nullptr if the cloud has not acknowledged all changes of the device.
+  std::unique_ptr<base::DictionaryValue> GetCloudSyncState() const;
+
+  // Restores the state returned by GetCloudSyncState() before a restart. Must
+  // be called after the component tree is restored and before Start(). The
+  // device resource is not uploaded when connecting to the cloud if only
+  // component state changed since, state changes are published as usual.
+  void RestoreCloudSyncState(const base::DictionaryValue& state);
+
+  // Publishes cloud commands which were pending before a restart.
+  void RestoreCommands(const base::ListValue& commands);
+
   // Updates a command (override from CloudCommandUpdateInterface).
   void UpdateCommand(const std::string& command_id,
                      const base::DictionaryValue& command_patch,
@@ -176,14 +191,19 @@ class DeviceRegistrationInfo : public NotificationDelegate,
 
   // Helper for DoCloudRequest().
   struct CloudRequestData {
+    CloudRequestData();
+
     provider::HttpClient::Method method;
     std::string url;
     std::string body;
     CloudRequestDoneCallback callback;
+    // Approximate memory held until the request is done, including retries.
+    TrackedMemory memory_usage;
   };
   void SendCloudRequest(const std::shared_ptr<const CloudRequestData>& data);
   void OnCloudRequestDone(
       const std::shared_ptr<const CloudRequestData>& data,
+      base::Time sent_time,
       std::unique_ptr<provider::HttpClient::Response> response,
       ErrorPtr error);
   void RetryCloudRequest(const std::shared_ptr<const CloudRequestData>& data);
@@ -231,8 +251,12 @@ class DeviceRegistrationInfo : public NotificationDelegate,
   void ProcessInitialCommandList(const base::ListValue& commands,
                                  ErrorPtr error);
 
-  void PublishCommands(const base::ListValue& commands, ErrorPtr error);
-  void PublishCommand(const base::DictionaryValue& command);
+  // |arrival| tells how the commands reached the device.
+  void PublishCommands(CommandInstance::Arrival arrival,
+                       const base::ListValue& commands,
+                       ErrorPtr error);
+  void PublishCommand(CommandInstance::Arrival arrival,
+                      const base::DictionaryValue& command);
 
   // Helper function to pull the pending command list from the server using
   // FetchCommands() and make them available on D-Bus with PublishCommands().
@@ -255,6 +279,10 @@ class DeviceRegistrationInfo : public NotificationDelegate,
   // for all supported commands and current device state.
   std::unique_ptr<base::DictionaryValue> BuildDeviceResource() const;
 
+  // Returns a hash of the device resource without the notification channel
+  // and component state, which are updated separately.
+  std::string GetDeviceResourceFingerprint() const;
+
   void SetGcdState(GcdState new_state);
   void SetDeviceId(const std::string& cloud_id);
 
@@ -319,6 +347,11 @@ class DeviceRegistrationInfo : public NotificationDelegate,
   // Flag set to true while a device state update patch request is in flight
   // to the cloud server.
   bool device_state_update_pending_{false};
+  // ID of the last state change acknowledged by the cloud server.
+  ComponentManager::UpdateID last_acknowledged_update_id_{0};
+  // Fingerprint of the device resource on the server, restored after a
+  // restart. Cleared on the first connection to the cloud.
+  std::string restored_resource_fingerprint_;
 
   // Set to true when command queue fetch request is in flight to the server.
   bool fetch_commands_request_sent_{false};
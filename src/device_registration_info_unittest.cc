@@ -11,11 +11,13 @@
 #include <weave/provider/test/fake_task_runner.h>
 #include <weave/provider/test/mock_config_store.h>
 #include <weave/provider/test/mock_http_client.h>
+#include <weave/provider/test/mock_network.h>
 #include <weave/test/unittest_utils.h>
 
 #include "src/bind_lambda.h"
 #include "src/component_manager_impl.h"
 #include "src/http_constants.h"
+#include "src/metrics.h"
 #include "src/privet/auth_manager.h"
 #include "src/test/mock_clock.h"
 
@@ -172,7 +174,15 @@ class DeviceRegistrationInfoTest : public ::testing::Test {
   }
 
   void PublishCommands(const base::ListValue& commands) {
-    dev_reg_->PublishCommands(commands, nullptr);
+    dev_reg_->PublishCommands(CommandInstance::Arrival::kFetch, commands,
+                              nullptr);
+  }
+
+  // Delivers |command| the way a notification channel of a connected device
+  // does.
+  void PushCommand(const base::DictionaryValue& command) {
+    dev_reg_->connected_to_cloud_ = true;
+    dev_reg_->OnCommandCreated(command, "xmpp");
   }
 
   bool RefreshAccessToken(ErrorPtr* error) const {
@@ -192,6 +202,30 @@ class DeviceRegistrationInfoTest : public ::testing::Test {
 
   GcdState GetGcdState() const { return dev_reg_->GetGcdState(); }
 
+  void ConnectToCloud() { dev_reg_->ConnectToCloud(nullptr); }
+
+  std::string GetDeviceResourceFingerprint() const {
+    return dev_reg_->GetDeviceResourceFingerprint();
+  }
+
+  // Loads a trait and a component, and restores the cloud sync state with
+  // |fingerprint| of the device resource.
+  void RestoreCloudSyncState(const std::string& fingerprint) {
+    ReloadSettings();
+    SetAccessToken();
+    EXPECT_TRUE(component_manager_.LoadTraits(
+        *CreateDictionaryValue("{'lock': {'state': {'locked': 'boolean'}}}"),
+        nullptr));
+    EXPECT_TRUE(component_manager_.AddComponent("", "lock", {"lock"}, nullptr));
+    base::DictionaryValue state;
+    state.SetString("resourceFingerprint",
+                    fingerprint.empty() ? GetDeviceResourceFingerprint()
+                                        : fingerprint);
+    state.SetString("lastUpdateTimeMs", "1450000000000");
+    state.SetString("lastUpdateId", "0");
+    dev_reg_->RestoreCloudSyncState(state);
+  }
+
   bool HaveRegistrationCredentials() const {
     return dev_reg_->HaveRegistrationCredentials();
   }
@@ -286,6 +320,42 @@ TEST_F(DeviceRegistrationInfoTest, HaveRegistrationCredentials) {
   EXPECT_TRUE(HaveRegistrationCredentials());
 }
 
+TEST_F(DeviceRegistrationInfoTest, NotificationChannelWaitsForAccessToken) {
+  ReloadSettings();
+  StrictMock<provider::test::MockNetwork> network;
+  dev_reg_.reset(new DeviceRegistrationInfo{config_.get(), &component_manager_,
+                                            &task_runner_, &http_client_,
+                                            &network, &auth_});
+  // Nothing to authenticate the XMPP connection with yet.
+  dev_reg_->Start();
+  Mock::VerifyAndClearExpectations(&network);
+
+  EXPECT_CALL(
+      http_client_,
+      SendRequest(HttpClient::Method::kPost, dev_reg_->GetOAuthURL("token"),
+                  HttpClient::Headers{GetFormHeader()}, _, _))
+      .WillOnce(WithArgs<4>(
+          Invoke([](const HttpClient::SendRequestCallback& callback) {
+            base::DictionaryValue json;
+            json.SetString("access_token", test_data::kAccessToken);
+            json.SetInteger("expires_in", 3600);
+            callback.Run(ReplyWithJson(200, json), nullptr);
+          })));
+  EXPECT_CALL(
+      http_client_,
+      SendRequest(HttpClient::Method::kPost, HasSubstr("upsertLocalAuthInfo"),
+                  _, _, _))
+      .WillOnce(WithArgs<4>(
+          Invoke([](const HttpClient::SendRequestCallback& callback) {
+            callback.Run(ReplyWithJson(200, base::DictionaryValue{}), nullptr);
+          })));
+  EXPECT_CALL(network, AddConnectionChangedCallback(_));
+  EXPECT_CALL(network, OpenSslSocket("xmpp.server.com", 1234, _))
+      .WillOnce(Return());
+
+  EXPECT_TRUE(RefreshAccessToken(nullptr));
+}
+
 TEST_F(DeviceRegistrationInfoTest, CheckAuthenticationFailure) {
   ReloadSettings();
   EXPECT_EQ(GcdState::kConnecting, GetGcdState());
@@ -594,6 +664,66 @@ TEST_F(DeviceRegistrationInfoTest, OOBRegistrationStatus) {
   EXPECT_EQ(GcdState::kConnecting, GetGcdState());
 }
 
+TEST_F(DeviceRegistrationInfoTest, SkipResourceUploadAfterRestart) {
+  RestoreCloudSyncState("");
+  EXPECT_CALL(http_client_, SendRequest(HttpClient::Method::kGet,
+                                        HasSubstr("commands/queue"), _, _, _))
+      .Times(1);
+  ConnectToCloud();
+  auto state = dev_reg_->GetCloudSyncState();
+  ASSERT_NE(nullptr, state);
+  std::string fingerprint;
+  EXPECT_TRUE(state->GetString("resourceFingerprint", &fingerprint));
+  EXPECT_EQ(GetDeviceResourceFingerprint(), fingerprint);
+
+  // State is excluded from the fingerprint, changes are patched.
+  EXPECT_CALL(http_client_, SendRequest(HttpClient::Method::kPost,
+                                        HasSubstr("patchState"), _, _, _))
+      .Times(1);
+  EXPECT_TRUE(component_manager_.SetStateProperty(
+      "lock", "lock.locked", base::FundamentalValue{true}, nullptr));
+  EXPECT_EQ(fingerprint, GetDeviceResourceFingerprint());
+  EXPECT_EQ(nullptr, dev_reg_->GetCloudSyncState());
+}
+
+TEST_F(DeviceRegistrationInfoTest, UploadChangedResourceAfterRestart) {
+  RestoreCloudSyncState("changed");
+  EXPECT_CALL(http_client_,
+              SendRequest(HttpClient::Method::kPut,
+                          HasSubstr("lastUpdateTimeMs=1450000000000"), _, _, _))
+      .Times(1);
+  ConnectToCloud();
+}
+
+TEST_F(DeviceRegistrationInfoTest, RemoveRestoredComponentsOnConnect) {
+  ReloadSettings();
+  SetAccessToken();
+  auto snapshot = CreateDictionaryValue(R"({
+    'traits': {'lock': {'state': {'locked': 'boolean'}}},
+    'components': {'gone': {'traits': ['lock']}, 'lock': {'traits': ['lock']}},
+    'lastUpdateId': '0'
+  })");
+  ASSERT_TRUE(component_manager_.RestoreSnapshot(*snapshot, nullptr));
+  base::DictionaryValue state;
+  state.SetString("resourceFingerprint", GetDeviceResourceFingerprint());
+  state.SetString("lastUpdateTimeMs", "1450000000000");
+  state.SetString("lastUpdateId", "0");
+  dev_reg_->RestoreCloudSyncState(state);
+  // The application adds only one of the restored components again.
+  EXPECT_TRUE(component_manager_.AddComponent("", "lock", {"lock"}, nullptr));
+
+  std::string data;
+  EXPECT_CALL(http_client_,
+              SendRequest(HttpClient::Method::kPut,
+                          HasSubstr("lastUpdateTimeMs=1450000000000"), _, _, _))
+      .WillOnce(SaveArg<3>(&data));
+  ConnectToCloud();
+  auto device = CreateDictionaryValue(data);
+  EXPECT_TRUE(device->Get("components.lock", nullptr));
+  EXPECT_FALSE(device->Get("components.gone", nullptr));
+  EXPECT_FALSE(component_manager_.GetComponents().HasKey("gone"));
+}
+
 class DeviceRegistrationInfoUpdateCommandTest
     : public DeviceRegistrationInfoTest {
  protected:
@@ -695,4 +825,33 @@ TEST_F(DeviceRegistrationInfoUpdateCommandTest, Cancel) {
   EXPECT_TRUE(command_->Cancel(nullptr));
 }
 
+TEST_F(DeviceRegistrationInfoUpdateCommandTest, StagesByArrival) {
+  // Metrics are process-wide, so the test checks how many samples are added.
+  Histogram* fetched = MetricsRegistry::GetInstance()->GetHistogram(
+      "commands.dispatch_ms{origin=cloud,arrival=fetch,name=robot._jump}");
+  Histogram* pushed = MetricsRegistry::GetInstance()->GetHistogram(
+      "commands.dispatch_ms{origin=cloud,arrival=push,name=robot._jump}");
+  int64_t fetched_count = fetched->GetCount();
+  int64_t pushed_count = pushed->GetCount();
+
+  // The new command changes the component tree, so the device starts to update
+  // its cloud resource.
+  EXPECT_CALL(http_client_, SendRequest(HttpClient::Method::kGet, _, _, _, _));
+  PushCommand(*CreateDictionaryValue(R"({
+    'name':'robot._jump',
+    'component': 'comp',
+    'id':'5678',
+    'parameters': {'_height': 100},
+    'minimalRole': 'user'
+  })"));
+  CommandInstance* pushed_command = component_manager_.FindCommand("5678");
+  ASSERT_NE(nullptr, pushed_command);
+  pushed_command->RecordStage(CommandInstance::Stage::kDispatched);
+  component_manager_.FindCommand("1234")->RecordStage(
+      CommandInstance::Stage::kDispatched);
+
+  EXPECT_EQ(fetched_count + 1, fetched->GetCount());
+  EXPECT_EQ(pushed_count + 1, pushed->GetCount());
+}
+
 }  // namespace weave
@@ -0,0 +1,159 @@
+// Copyright 2016 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "src/memory_usage.h"
+
+#include <map>
+#include <utility>
+
+#include <base/logging.h>
+
+namespace weave {
+
+namespace {
+
+const char kGaugePrefix[] = "memory.";
+const char kGaugeSuffix[] = "_bytes";
+
+// Bookkeeping of a heap block in common allocators.
+const size_t kAllocationOverhead = 2 * sizeof(void*);
+
+// Node of a red-black tree, as used by std::map: color and three links.
+const size_t kMapNodeOverhead = 4 * sizeof(void*) + kAllocationOverhead;
+
+// Keys are measured by size rather than capacity, so the entry of a key is
+// the same before it is copied into a dictionary and after.
+size_t EstimateKeyUsage(const std::string& key) {
+  static const size_t kInlineCapacity = std::string{}.capacity();
+  if (key.size() <= kInlineCapacity)
+    return 0;
+  return key.size() + 1 + kAllocationOverhead;
+}
+
+size_t EstimateDictionaryUsage(const base::DictionaryValue& dict) {
+  size_t size = sizeof(base::DictionaryValue);
+  for (base::DictionaryValue::Iterator it(dict); !it.IsAtEnd(); it.Advance())
+    size += EstimateDictionaryEntryUsage(it.key(), it.value());
+  return size;
+}
+
+size_t EstimateListUsage(const base::ListValue& list) {
+  size_t size = sizeof(base::ListValue);
+  size_t list_size = 0;
+  for (const base::Value* item : list)
+    size += EstimateListItemUsage(++list_size, *item);
+  return size;
+}
+
+}  // namespace
+
+size_t EstimateMemoryUsage(const base::Value& value) {
+  size_t size = kAllocationOverhead;
+  switch (value.GetType()) {
+    case base::Value::TYPE_NULL:
+      return size + sizeof(base::Value);
+    case base::Value::TYPE_BOOLEAN:
+    case base::Value::TYPE_INTEGER:
+    case base::Value::TYPE_DOUBLE:
+      return size + sizeof(base::FundamentalValue);
+    case base::Value::TYPE_STRING: {
+      size += sizeof(base::StringValue);
+      // Strings of trees returned by the JSON parser point into the parsed
+      // text, which is not accounted here.
+      const base::StringValue* string_value = nullptr;
+      if (value.GetAsString(&string_value))
+        size += EstimateMemoryUsage(string_value->GetString());
+      return size;
+    }
+    case base::Value::TYPE_BINARY: {
+      const base::BinaryValue* binary = nullptr;
+      CHECK(value.GetAsBinary(&binary));
+      return size + sizeof(base::BinaryValue) + binary->GetSize() +
+             kAllocationOverhead;
+    }
+    case base::Value::TYPE_DICTIONARY: {
+      const base::DictionaryValue* dict = nullptr;
+      CHECK(value.GetAsDictionary(&dict));
+      return size + EstimateDictionaryUsage(*dict);
+    }
+    case base::Value::TYPE_LIST: {
+      const base::ListValue* list = nullptr;
+      CHECK(value.GetAsList(&list));
+      return size + EstimateListUsage(*list);
+    }
+  }
+  NOTREACHED();
+  return size;
+}
+
+size_t EstimateMemoryUsage(const std::string& str) {
+  static const size_t kInlineCapacity = std::string{}.capacity();
+  if (str.capacity() <= kInlineCapacity)
+    return 0;
+  return str.capacity() + 1 + kAllocationOverhead;
+}
+
+size_t EstimateDictionaryEntryUsage(const std::string& key,
+                                    const base::Value& value) {
+  return kMapNodeOverhead + sizeof(std::pair<const std::string, void*>) +
+         EstimateKeyUsage(key) + EstimateMemoryUsage(value);
+}
+
+size_t EstimateListItemUsage(size_t list_size, const base::Value& item) {
+  // The first item allocates the array of pointers.
+  size_t size = sizeof(base::Value*) + EstimateMemoryUsage(item);
+  if (list_size == 1)
+    size += kAllocationOverhead;
+  return size;
+}
+
+int64_t MergeDictionaryAndEstimate(const base::DictionaryValue& source,
+                                   base::DictionaryValue* target) {
+  int64_t size_change = 0;
+  for (base::DictionaryValue::Iterator it(source); !it.IsAtEnd();
+       it.Advance()) {
+    const base::DictionaryValue* source_dict = nullptr;
+    base::DictionaryValue* target_dict = nullptr;
+    if (it.value().GetAsDictionary(&source_dict) &&
+        target->GetDictionaryWithoutPathExpansion(it.key(), &target_dict)) {
+      size_change += MergeDictionaryAndEstimate(*source_dict, target_dict);
+      continue;
+    }
+    const base::Value* old_value = nullptr;
+    if (target->GetWithoutPathExpansion(it.key(), &old_value))
+      size_change -= EstimateDictionaryEntryUsage(it.key(), *old_value);
+    base::Value* value = it.value().DeepCopy();
+    target->SetWithoutPathExpansion(it.key(), value);
+    size_change += EstimateDictionaryEntryUsage(it.key(), *value);
+  }
+  return size_change;
+}
+
+Gauge* GetMemoryGauge(const std::string& area) {
+  return MetricsRegistry::GetInstance()->GetGauge(kGaugePrefix + area +
+                                                  kGaugeSuffix);
+}
+
+std::unique_ptr<base::DictionaryValue> GetMemoryUsageReport() {
+  std::unique_ptr<base::DictionaryValue> report{new base::DictionaryValue};
+  const size_t kPrefixSize = sizeof(kGaugePrefix) - 1;
+  const size_t kSuffixSize = sizeof(kGaugeSuffix) - 1;
+  for (const auto& pair :
+       MetricsRegistry::GetInstance()->GetGauges(kGaugePrefix)) {
+    const std::string& name = pair.first;
+    if (name.size() <= kPrefixSize + kSuffixSize ||
+        name.compare(name.size() - kSuffixSize, kSuffixSize, kGaugeSuffix)) {
+      continue;
+    }
+    std::unique_ptr<base::DictionaryValue> usage{new base::DictionaryValue};
+    usage->SetInteger("bytes", static_cast<int>(pair.second->Get()));
+    usage->SetInteger("maxBytes", static_cast<int>(pair.second->GetMax()));
+    report->SetWithoutPathExpansion(
+        name.substr(kPrefixSize, name.size() - kPrefixSize - kSuffixSize),
+        usage.release());
+  }
+  return report;
+}
+
+}  // namespace weave
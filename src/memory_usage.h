@@ -0,0 +1,77 @@
+// Copyright 2016 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIBWEAVE_SRC_MEMORY_USAGE_H_
+#define LIBWEAVE_SRC_MEMORY_USAGE_H_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include <base/macros.h>
+#include <base/values.h>
+
+#include "src/metrics.h"
+
+namespace weave {
+
+// Approximate heap usage of |value|, including the value itself. Estimates
+// assume typical allocator and standard library overheads, so they are meant
+// for comparing subsystems and spotting growth rather than for exact numbers.
+size_t EstimateMemoryUsage(const base::Value& value);
+
+// Heap usage of the contents of |str|. Short strings are stored inline.
+size_t EstimateMemoryUsage(const std::string& str);
+
+// Change of the estimate of a dictionary when the entry |key| with |value| is
+// added to it or removed from it.
+size_t EstimateDictionaryEntryUsage(const std::string& key,
+                                    const base::Value& value);
+
+// Change of the estimate of a list when |item| is added to it or removed from
+// it. |list_size| is the size of the list with |item|.
+size_t EstimateListItemUsage(size_t list_size, const base::Value& item);
+
+// Merges |source| into |target| like DictionaryValue::MergeDictionary() and
+// returns the change of the estimate of |target|. Only the merged values and
+// the values they replace are measured, so large trees can be kept up to date.
+int64_t MergeDictionaryAndEstimate(const base::DictionaryValue& source,
+                                   base::DictionaryValue* target);
+
+// Returns the gauge "memory.<area>_bytes" of MetricsRegistry::GetInstance(),
+// which holds the memory used by the |area| of all devices in the process.
+Gauge* GetMemoryGauge(const std::string& area);
+
+// Returns memory usage of all areas as a JSON object:
+//   {"<area>": {"bytes": <current>, "maxBytes": <high-water mark>}, ...}
+std::unique_ptr<base::DictionaryValue> GetMemoryUsageReport();
+
+// Memory held by one object, e.g. a command, which is added to the gauge of
+// all objects of the same kind until the object is destroyed.
+class TrackedMemory final {
+ public:
+  explicit TrackedMemory(Gauge* gauge) : gauge_{gauge} {}
+  ~TrackedMemory() { gauge_->Add(-bytes_); }
+
+  void Set(size_t bytes) {
+    gauge_->Add(static_cast<int64_t>(bytes) - bytes_);
+    bytes_ = bytes;
+  }
+  // Adjusts by the change of an estimate, e.g. of a part of a large tree.
+  void Add(int64_t bytes) {
+    gauge_->Add(bytes);
+    bytes_ += bytes;
+  }
+  size_t Get() const { return bytes_; }
+
+ private:
+  Gauge* gauge_;
+  int64_t bytes_{0};
+
+  DISALLOW_COPY_AND_ASSIGN(TrackedMemory);
+};
+
+}  // namespace weave
+
+#endif  // LIBWEAVE_SRC_MEMORY_USAGE_H_
@@ -0,0 +1,101 @@
+// Copyright 2016 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "src/memory_usage.h"
+
+#include <gtest/gtest.h>
+#include <weave/test/unittest_utils.h>
+
+namespace weave {
+
+using test::CreateDictionaryValue;
+
+TEST(MemoryUsageTest, String) {
+  EXPECT_EQ(0u, EstimateMemoryUsage(std::string{}));
+  EXPECT_EQ(0u, EstimateMemoryUsage(std::string{"a"}));
+  std::string long_string(1000, 'a');
+  EXPECT_LT(1000u, EstimateMemoryUsage(long_string));
+  EXPECT_GT(1100u, EstimateMemoryUsage(long_string));
+}
+
+TEST(MemoryUsageTest, Value) {
+  base::FundamentalValue number{1};
+  base::StringValue long_string{std::string(1000, 'a')};
+  EXPECT_LT(sizeof(number), EstimateMemoryUsage(number));
+  EXPECT_LT(1000u + sizeof(long_string), EstimateMemoryUsage(long_string));
+
+  auto small = CreateDictionaryValue("{'a': 1}");
+  auto large = CreateDictionaryValue(
+      "{'a': 1, 'b': {'c': [1, 2, 3], 'd': 'some string value'}}");
+  EXPECT_LT(EstimateMemoryUsage(number), EstimateMemoryUsage(*small));
+  EXPECT_LT(EstimateMemoryUsage(*small), EstimateMemoryUsage(*large));
+  // Parsed strings are not owned by the tree, unlike copied ones.
+  std::unique_ptr<base::DictionaryValue> copy{large->DeepCopy()};
+  EXPECT_LT(EstimateMemoryUsage(*large), EstimateMemoryUsage(*copy));
+  std::unique_ptr<base::DictionaryValue> copy2{copy->DeepCopy()};
+  EXPECT_EQ(EstimateMemoryUsage(*copy), EstimateMemoryUsage(*copy2));
+
+  // Each added value adds at least its own size.
+  size_t size = EstimateMemoryUsage(*copy);
+  copy->Set("e", long_string.DeepCopy());
+  EXPECT_LT(size + EstimateMemoryUsage(long_string),
+            EstimateMemoryUsage(*copy));
+}
+
+TEST(MemoryUsageTest, Changes) {
+  auto dict = CreateDictionaryValue(
+      "{'a': {'b': 1, 'c': 'a string longer than inline'}, 'd': [1]}");
+  size_t size = EstimateMemoryUsage(*dict);
+
+  auto merged = CreateDictionaryValue(
+      "{'a': {'c': 'short', 'e': {'f': 2}}, 'd': 'replaced list'}");
+  int64_t change = MergeDictionaryAndEstimate(*merged, dict.get());
+  EXPECT_EQ(size + change, EstimateMemoryUsage(*dict));
+  size = EstimateMemoryUsage(*dict);
+
+  base::ListValue* list = new base::ListValue;
+  dict->SetWithoutPathExpansion("a key longer than inline", list);
+  size += EstimateDictionaryEntryUsage("a key longer than inline", *list);
+  EXPECT_EQ(size, EstimateMemoryUsage(*dict));
+  for (int i = 0; i < 3; ++i) {
+    list->AppendString("a string longer than inline");
+    const base::Value* item = nullptr;
+    ASSERT_TRUE(list->Get(list->GetSize() - 1, &item));
+    size += EstimateListItemUsage(list->GetSize(), *item);
+    EXPECT_EQ(size, EstimateMemoryUsage(*dict));
+  }
+}
+
+TEST(MemoryUsageTest, TrackedMemory) {
+  Gauge gauge;
+  {
+    TrackedMemory first{&gauge};
+    TrackedMemory second{&gauge};
+    first.Set(100);
+    second.Set(50);
+    EXPECT_EQ(150, gauge.Get());
+    first.Set(10);
+    EXPECT_EQ(10u, first.Get());
+    EXPECT_EQ(60, gauge.Get());
+  }
+  EXPECT_EQ(0, gauge.Get());
+  EXPECT_EQ(150, gauge.GetMax());
+}
+
+TEST(MemoryUsageTest, Report) {
+  Gauge* gauge = GetMemoryGauge("test_area");
+  TrackedMemory memory{gauge};
+  memory.Set(1000);
+  memory.Set(10);
+
+  auto report = GetMemoryUsageReport();
+  const base::DictionaryValue* usage = nullptr;
+  ASSERT_TRUE(report->GetDictionary("test_area", &usage));
+  EXPECT_JSON_EQ("{'bytes': " + std::to_string(gauge->Get()) +
+                     ", 'maxBytes': " + std::to_string(gauge->GetMax()) + "}",
+                 *usage);
+  EXPECT_LE(1000, gauge->GetMax());
+}
+
+}  // namespace weave
@@ -0,0 +1,181 @@
+// Copyright 2016 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "src/metrics.h"
+
+#include <algorithm>
+
+#include <base/logging.h>
+
+namespace weave {
+
+const int Histogram::kSubBucketBits;
+const int64_t Histogram::kSubBuckets;
+const size_t Histogram::kBucketCount;
+
+int64_t Histogram::GetCount() const {
+  int64_t count = 0;
+  for (const auto& bucket : buckets_)
+    count += bucket.load(std::memory_order_relaxed);
+  return count;
+}
+
+int64_t Histogram::GetPercentile(double fraction) const {
+  int64_t counts[kBucketCount];
+  int64_t total = 0;
+  for (size_t i = 0; i < kBucketCount; ++i) {
+    counts[i] = GetBucketCount(i);
+    total += counts[i];
+  }
+  if (total == 0)
+    return 0;
+
+  int64_t rank = static_cast<int64_t>(fraction * total);
+  if (rank >= total)
+    rank = total - 1;
+  for (size_t i = 0; i < kBucketCount; ++i) {
+    if (rank < counts[i])
+      return GetBucketMin(i);
+    rank -= counts[i];
+  }
+  NOTREACHED();
+  return 0;
+}
+
+int64_t Histogram::GetBucketMin(size_t index) {
+  CHECK_LT(index, kBucketCount);
+  if (index < static_cast<size_t>(kSubBuckets))
+    return index;
+  int exponent = index / kSubBuckets + kSubBucketBits - 1;
+  int64_t sub_bucket = index % kSubBuckets;
+  return (kSubBuckets + sub_bucket) << (exponent - kSubBucketBits);
+}
+
+const size_t WorstSamples::kWindowSize;
+const size_t WorstSamples::kWorstCount;
+
+void WorstSamples::Add(int64_t value, const std::string& details) {
+  DCHECK_EQ(std::string::npos, details.find(' '));
+  std::lock_guard<std::mutex> lock{mutex_};
+  if (samples_.size() < kWindowSize) {
+    samples_.emplace_back(value, details);
+    return;
+  }
+  samples_[next_sample_] = Sample{value, details};
+  next_sample_ = (next_sample_ + 1) % kWindowSize;
+}
+
+std::vector<WorstSamples::Sample> WorstSamples::GetWorst() const {
+  std::vector<Sample> worst;
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    worst = samples_;
+  }
+  size_t count = std::min(kWorstCount, worst.size());
+  std::partial_sort(
+      worst.begin(), worst.begin() + count, worst.end(),
+      [](const Sample& a, const Sample& b) { return a.first > b.first; });
+  worst.resize(count);
+  return worst;
+}
+
+MetricsRegistry::MetricsRegistry() {}
+
+MetricsRegistry::~MetricsRegistry() {}
+
+MetricsRegistry* MetricsRegistry::GetInstance() {
+  static MetricsRegistry* instance = new MetricsRegistry;
+  return instance;
+}
+
+template <typename T>
+T* MetricsRegistry::GetMetric(
+    const std::string& name,
+    char kind,
+    std::map<std::string, std::unique_ptr<T>>* metrics) {
+  std::lock_guard<std::mutex> lock{mutex_};
+  auto it = kinds_.insert(std::make_pair(name, kind)).first;
+  CHECK_EQ(kind, it->second) << "Metric '" << name
+                             << "' is registered with another kind";
+  auto& metric = (*metrics)[name];
+  if (!metric)
+    metric.reset(new T);
+  return metric.get();
+}
+
+Counter* MetricsRegistry::GetCounter(const std::string& name) {
+  return GetMetric(name, 'c', &counters_);
+}
+
+Gauge* MetricsRegistry::GetGauge(const std::string& name) {
+  return GetMetric(name, 'g', &gauges_);
+}
+
+Histogram* MetricsRegistry::GetHistogram(const std::string& name) {
+  return GetMetric(name, 'h', &histograms_);
+}
+
+WorstSamples* MetricsRegistry::GetWorstSamples(const std::string& name) {
+  return GetMetric(name, 'w', &worst_samples_);
+}
+
+std::map<std::string, const Gauge*> MetricsRegistry::GetGauges(
+    const std::string& prefix) const {
+  std::lock_guard<std::mutex> lock{mutex_};
+  std::map<std::string, const Gauge*> result;
+  for (auto it = gauges_.lower_bound(prefix);
+       it != gauges_.end() && it->first.compare(0, prefix.size(), prefix) == 0;
+       ++it) {
+    result.emplace(it->first, it->second.get());
+  }
+  return result;
+}
+
+std::string MetricsRegistry::GetSnapshot() const {
+  std::lock_guard<std::mutex> lock{mutex_};
+  std::string result;
+  for (const auto& pair : kinds_) {
+    const std::string& name = pair.first;
+    result += pair.second;
+    result += ' ';
+    result += name;
+    switch (pair.second) {
+      case 'c':
+        result += ' ' + std::to_string(counters_.at(name)->Get());
+        break;
+      case 'g': {
+        const Gauge& gauge = *gauges_.at(name);
+        result += ' ' + std::to_string(gauge.Get()) + ' ' +
+                  std::to_string(gauge.GetMax());
+        break;
+      }
+      case 'h': {
+        const Histogram& histogram = *histograms_.at(name);
+        // Buckets are read first, so the count matches them even if samples
+        // are added concurrently.
+        std::string buckets;
+        int64_t count = 0;
+        for (size_t i = 0; i < Histogram::kBucketCount; ++i) {
+          int64_t bucket_count = histogram.GetBucketCount(i);
+          if (bucket_count == 0)
+            continue;
+          count += bucket_count;
+          buckets += ' ' + std::to_string(Histogram::GetBucketMin(i)) + ':' +
+                     std::to_string(bucket_count);
+        }
+        result += ' ' + std::to_string(count) + ' ' +
+                  std::to_string(histogram.GetSum()) + buckets;
+        break;
+      }
+      case 'w':
+        for (const auto& sample : worst_samples_.at(name)->GetWorst())
+          result += ' ' + std::to_string(sample.first) + ':' + sample.second;
+        break;
+    }
+    result += '\n';
+  }
+  return result;
+}
+
+}  // namespace weave
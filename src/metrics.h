@@ -0,0 +1,200 @@
+// Copyright 2016 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIBWEAVE_SRC_METRICS_H_
+#define LIBWEAVE_SRC_METRICS_H_
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <base/macros.h>
+#include <base/time/time.h>
+
+namespace weave {
+
+// Monotonically increasing count of events.
+class Counter final {
+ public:
+  Counter() = default;
+
+  void Increment(int64_t delta = 1) {
+    value_.fetch_add(delta, std::memory_order_relaxed);
+  }
+  int64_t Get() const { return value_.load(std::memory_order_relaxed); }
+
+ private:
+  std::atomic<int64_t> value_{0};
+
+  DISALLOW_COPY_AND_ASSIGN(Counter);
+};
+
+// Current value of some quantity, e.g. a queue size, and its high-water mark.
+// Instances of the same class usually share a gauge, so they should update it
+// with Add() rather than with Set().
+class Gauge final {
+ public:
+  Gauge() = default;
+
+  void Set(int64_t value) {
+    value_.store(value, std::memory_order_relaxed);
+    UpdateMax(value);
+  }
+  void Add(int64_t delta) {
+    UpdateMax(value_.fetch_add(delta, std::memory_order_relaxed) + delta);
+  }
+  int64_t Get() const { return value_.load(std::memory_order_relaxed); }
+  // Largest value the gauge has had.
+  int64_t GetMax() const { return max_.load(std::memory_order_relaxed); }
+
+ private:
+  void UpdateMax(int64_t value) {
+    int64_t max = max_.load(std::memory_order_relaxed);
+    while (value > max &&
+           !max_.compare_exchange_weak(max, value, std::memory_order_relaxed)) {
+    }
+  }
+
+  std::atomic<int64_t> value_{0};
+  std::atomic<int64_t> max_{0};
+
+  DISALLOW_COPY_AND_ASSIGN(Gauge);
+};
+
+// Distribution of non-negative samples in fixed log-linear buckets: values
+// below kSubBuckets get a bucket each, and every following power of two is
+// split into kSubBuckets equal buckets. Relative error of a bucket is at most
+// 1 / kSubBuckets. Negative samples are recorded as zero.
+class Histogram final {
+ public:
+  static const int kSubBucketBits = 2;
+  static const int64_t kSubBuckets = 1 << kSubBucketBits;
+  static const size_t kBucketCount = kSubBuckets * (64 - kSubBucketBits);
+
+  Histogram() = default;
+
+  void Add(int64_t sample) {
+    if (sample < 0)
+      sample = 0;
+    buckets_[GetBucketIndex(sample)].fetch_add(1, std::memory_order_relaxed);
+    sum_.fetch_add(sample, std::memory_order_relaxed);
+  }
+
+  // Records |time| in milliseconds.
+  void AddTime(base::TimeDelta time) { Add(time.InMilliseconds()); }
+
+  int64_t GetCount() const;
+  int64_t GetSum() const { return sum_.load(std::memory_order_relaxed); }
+  int64_t GetBucketCount(size_t index) const {
+    return buckets_[index].load(std::memory_order_relaxed);
+  }
+
+  // Returns the smallest sample which is at least as large as |fraction| of
+  // all samples, rounded down to the bucket minimum.
+  int64_t GetPercentile(double fraction) const;
+
+  static size_t GetBucketIndex(int64_t sample) {
+    if (sample < kSubBuckets)
+      return sample;
+    int exponent = 63 - __builtin_clzll(sample);
+    int64_t sub_bucket =
+        (sample >> (exponent - kSubBucketBits)) & (kSubBuckets - 1);
+    return kSubBuckets * (exponent - kSubBucketBits + 1) + sub_bucket;
+  }
+
+  // Smallest sample which falls into bucket |index|.
+  static int64_t GetBucketMin(size_t index);
+
+ private:
+  std::atomic<int64_t> buckets_[kBucketCount] = {};
+  std::atomic<int64_t> sum_{0};
+
+  DISALLOW_COPY_AND_ASSIGN(Histogram);
+};
+
+// Largest of the recent samples, with a short description of each, to find
+// outliers which histograms hide. Unlike other metrics, updates take a lock, so
+// this is meant for infrequent events.
+class WorstSamples final {
+ public:
+  using Sample = std::pair<int64_t, std::string>;
+
+  // Number of the latest samples which are considered.
+  static const size_t kWindowSize = 64;
+  // Number of samples returned by GetWorst().
+  static const size_t kWorstCount = 5;
+
+  WorstSamples() = default;
+
+  // |details| must not contain spaces.
+  void Add(int64_t value, const std::string& details);
+
+  // Returns up to kWorstCount largest samples, largest first.
+  std::vector<Sample> GetWorst() const;
+
+ private:
+  mutable std::mutex mutex_;
+  std::vector<Sample> samples_;
+  // Index of the oldest sample if |samples_| is full.
+  size_t next_sample_{0};
+
+  DISALLOW_COPY_AND_ASSIGN(WorstSamples);
+};
+
+// Named metrics of the library. Lookup takes a lock, so callers should keep
+// the returned pointers, which stay valid for the lifetime of the registry.
+// Updates of metrics never lock.
+class MetricsRegistry final {
+ public:
+  MetricsRegistry();
+  ~MetricsRegistry();
+
+  // Registry used by libweave. Metrics of all devices in the process are
+  // shared. It is never destroyed.
+  static MetricsRegistry* GetInstance();
+
+  // Return metric registered under |name|, registering it on first use.
+  // The same name can't be used for metrics of different kinds.
+  Counter* GetCounter(const std::string& name);
+  Gauge* GetGauge(const std::string& name);
+  Histogram* GetHistogram(const std::string& name);
+  WorstSamples* GetWorstSamples(const std::string& name);
+
+  // Returns gauges whose names start with |prefix|, sorted by name.
+  std::map<std::string, const Gauge*> GetGauges(
+      const std::string& prefix) const;
+
+  // Returns all metrics sorted by name, one per line:
+  //   c <name> <value>
+  //   g <name> <value> <max>
+  //   h <name> <count> <sum> <bucket min>:<count>...
+  //   w <name> <value>:<details>...
+  // Histograms list non-empty buckets only.
+  std::string GetSnapshot() const;
+
+ private:
+  template <typename T>
+  T* GetMetric(const std::string& name,
+               char kind,
+               std::map<std::string, std::unique_ptr<T>>* metrics);
+
+  mutable std::mutex mutex_;
+  // Kind of each registered name, as used by GetSnapshot().
+  std::map<std::string, char> kinds_;
+  std::map<std::string, std::unique_ptr<Counter>> counters_;
+  std::map<std::string, std::unique_ptr<Gauge>> gauges_;
+  std::map<std::string, std::unique_ptr<Histogram>> histograms_;
+  std::map<std::string, std::unique_ptr<WorstSamples>> worst_samples_;
+
+  DISALLOW_COPY_AND_ASSIGN(MetricsRegistry);
+};
+
+}  // namespace weave
+
+#endif  // LIBWEAVE_SRC_METRICS_H_
@@ -0,0 +1,166 @@
+// Copyright 2016 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "src/metrics.h"
+
+#include <limits>
+#include <map>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "src/test/allocation_counter.h"
+
+namespace weave {
+
+TEST(HistogramTest, Buckets) {
+  for (int64_t sample : {0, 1, 3}) {
+    EXPECT_EQ(static_cast<size_t>(sample), Histogram::GetBucketIndex(sample));
+    EXPECT_EQ(sample, Histogram::GetBucketMin(sample));
+  }
+  EXPECT_EQ(4u, Histogram::GetBucketIndex(4));
+  EXPECT_EQ(7u, Histogram::GetBucketIndex(7));
+  EXPECT_EQ(8u, Histogram::GetBucketIndex(8));
+  EXPECT_EQ(8u, Histogram::GetBucketIndex(9));
+  EXPECT_EQ(9u, Histogram::GetBucketIndex(10));
+  EXPECT_EQ(10, Histogram::GetBucketMin(9));
+  EXPECT_EQ(Histogram::kBucketCount - 1,
+            Histogram::GetBucketIndex(std::numeric_limits<int64_t>::max()));
+
+  // Bucket minimums are increasing and map back to their buckets.
+  for (size_t i = 1; i < Histogram::kBucketCount; ++i) {
+    int64_t min = Histogram::GetBucketMin(i);
+    EXPECT_LT(Histogram::GetBucketMin(i - 1), min);
+    EXPECT_EQ(i, Histogram::GetBucketIndex(min));
+    EXPECT_EQ(i - 1, Histogram::GetBucketIndex(min - 1));
+  }
+}
+
+TEST(HistogramTest, Add) {
+  Histogram histogram;
+  EXPECT_EQ(0, histogram.GetPercentile(0.5));
+  for (int i = 1; i <= 100; ++i)
+    histogram.Add(i);
+  histogram.Add(-5);
+  histogram.AddTime(base::TimeDelta::FromSeconds(2));
+
+  EXPECT_EQ(102, histogram.GetCount());
+  EXPECT_EQ(5050 + 2000, histogram.GetSum());
+  EXPECT_EQ(1, histogram.GetBucketCount(0));
+  EXPECT_EQ(48, histogram.GetPercentile(0.5));
+  EXPECT_EQ(96, histogram.GetPercentile(0.95));
+  EXPECT_EQ(1792, histogram.GetPercentile(1));
+}
+
+TEST(GaugeTest, Max) {
+  Gauge gauge;
+  gauge.Add(5);
+  gauge.Add(-3);
+  EXPECT_EQ(2, gauge.Get());
+  EXPECT_EQ(5, gauge.GetMax());
+  gauge.Set(7);
+  gauge.Set(1);
+  EXPECT_EQ(1, gauge.Get());
+  EXPECT_EQ(7, gauge.GetMax());
+}
+
+TEST(MetricsTest, UpdateAllocations) {
+  Counter counter;
+  Gauge gauge;
+  Histogram histogram;
+  EXPECT_MAX_ALLOCATIONS(0, counter.Increment());
+  EXPECT_MAX_ALLOCATIONS(0, gauge.Add(5));
+  EXPECT_MAX_ALLOCATIONS(0, histogram.Add(1000));
+}
+
+TEST(MetricsRegistryTest, Snapshot) {
+  MetricsRegistry registry;
+  EXPECT_EQ("", registry.GetSnapshot());
+
+  Counter* counter = registry.GetCounter("b.counter");
+  EXPECT_EQ(counter, registry.GetCounter("b.counter"));
+  counter->Increment();
+  counter->Increment(2);
+  Gauge* gauge = registry.GetGauge("c.gauge");
+  gauge->Add(5);
+  gauge->Add(-2);
+  Histogram* histogram = registry.GetHistogram("a.histogram");
+  histogram->Add(1);
+  histogram->Add(1);
+  histogram->Add(9);
+  WorstSamples* worst = registry.GetWorstSamples("d.worst");
+  worst->Add(3, "x=1");
+  worst->Add(7, "x=2");
+
+  EXPECT_EQ(
+      "h a.histogram 3 11 1:2 8:1\n"
+      "c b.counter 3\n"
+      "g c.gauge 3 5\n"
+      "w d.worst 7:x=2 3:x=1\n",
+      registry.GetSnapshot());
+}
+
+TEST(WorstSamplesTest, Window) {
+  WorstSamples samples;
+  EXPECT_TRUE(samples.GetWorst().empty());
+  samples.Add(1000, "first");
+  for (size_t i = 0; i < WorstSamples::kWindowSize - 1; ++i)
+    samples.Add(i, "sample" + std::to_string(i));
+  auto worst = samples.GetWorst();
+  ASSERT_EQ(WorstSamples::kWorstCount, worst.size());
+  EXPECT_EQ((WorstSamples::Sample{1000, "first"}), worst[0]);
+  EXPECT_EQ(static_cast<int64_t>(WorstSamples::kWindowSize - 2),
+            worst[1].first);
+
+  // The first sample is out of the window now.
+  samples.Add(5, "last");
+  worst = samples.GetWorst();
+  EXPECT_EQ(static_cast<int64_t>(WorstSamples::kWindowSize - 2),
+            worst[0].first);
+}
+
+TEST(MetricsRegistryTest, GetGauges) {
+  MetricsRegistry registry;
+  Gauge* b = registry.GetGauge("a.b");
+  Gauge* c = registry.GetGauge("a.c");
+  registry.GetGauge("a");
+  registry.GetGauge("b.a");
+  registry.GetCounter("a.d");
+
+  std::map<std::string, const Gauge*> expected{{"a.b", b}, {"a.c", c}};
+  EXPECT_EQ(expected, registry.GetGauges("a."));
+  EXPECT_TRUE(registry.GetGauges("c").empty());
+}
+
+TEST(MetricsRegistryTest, KindMismatch) {
+  MetricsRegistry registry;
+  registry.GetCounter("metric");
+  EXPECT_DEATH(registry.GetGauge("metric"), "another kind");
+}
+
+TEST(MetricsRegistryTest, ManyThreads) {
+  const int kThreads = 4;
+  const int kIterations = 10000;
+  MetricsRegistry registry;
+  std::vector<std::thread> threads;
+  for (int i = 0; i < kThreads; ++i) {
+    threads.emplace_back([&registry]() {
+      Counter* counter = registry.GetCounter("counter");
+      Histogram* histogram = registry.GetHistogram("histogram");
+      for (int j = 0; j < kIterations; ++j) {
+        counter->Increment();
+        histogram->Add(j);
+      }
+    });
+  }
+  for (auto& thread : threads)
+    thread.join();
+
+  EXPECT_EQ(kThreads * kIterations, registry.GetCounter("counter")->Get());
+  EXPECT_EQ(kThreads * kIterations,
+            registry.GetHistogram("histogram")->GetCount());
+}
+
+}  // namespace weave
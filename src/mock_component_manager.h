@@ -17,6 +17,8 @@ class MockComponentManager : public ComponentManager {
   MOCK_METHOD2(LoadTraits,
                bool(const base::DictionaryValue& dict, ErrorPtr* error));
   MOCK_METHOD2(LoadTraits, bool(const std::string& json, ErrorPtr* error));
+  MOCK_METHOD3(LoadTraitBundle,
+               bool(const uint8_t* data, size_t size, ErrorPtr* error));
   MOCK_METHOD1(AddTraitDefChangedCallback, void(const base::Closure& callback));
   MOCK_METHOD4(AddComponent,
                bool(const std::string& path,
@@ -87,12 +89,17 @@ class MockComponentManager : public ComponentManager {
                     const base::Value& value,
                     ErrorPtr* error));
   MOCK_METHOD1(AddStateChangedCallback, void(const base::Closure& callback));
+  MOCK_METHOD0(MockCreateComponentTreeReader, ComponentTreeReader*());
   MOCK_METHOD0(MockGetAndClearRecordedStateChanges, StateSnapshot&());
   MOCK_METHOD1(NotifyStateUpdatedOnServer, void(UpdateID id));
   MOCK_CONST_METHOD0(GetLastStateChangeId, UpdateID());
   MOCK_METHOD1(MockAddServerStateUpdatedCallback,
                base::CallbackList<void(UpdateID)>::Subscription*(
                    const base::Callback<void(UpdateID)>& callback));
+  MOCK_CONST_METHOD0(MockCreateSnapshot, base::DictionaryValue*());
+  MOCK_METHOD2(RestoreSnapshot,
+               bool(const base::DictionaryValue& snapshot, ErrorPtr* error));
+  MOCK_METHOD0(RemoveRestoredComponents, void());
   MOCK_CONST_METHOD1(FindComponentWithTrait,
                      std::string(const std::string& trait));
   MOCK_METHOD2(AddLegacyCommandDefinitions,
@@ -116,6 +123,10 @@ class MockComponentManager : public ComponentManager {
     return std::unique_ptr<CommandInstance>{
         MockParseCommandInstance(command, command_origin, role, id, error)};
   }
+  std::unique_ptr<ComponentTreeReader> CreateComponentTreeReader() override {
+    return std::unique_ptr<ComponentTreeReader>{
+        MockCreateComponentTreeReader()};
+  }
   StateSnapshot GetAndClearRecordedStateChanges() override {
     return std::move(MockGetAndClearRecordedStateChanges());
   }
@@ -123,6 +134,9 @@ class MockComponentManager : public ComponentManager {
       const base::Callback<void(UpdateID)>& callback) override {
     return Token{MockAddServerStateUpdatedCallback(callback)};
   }
+  std::unique_ptr<base::DictionaryValue> CreateSnapshot() const override {
+    return std::unique_ptr<base::DictionaryValue>{MockCreateSnapshot()};
+  }
 };
 
 }  // namespace weave
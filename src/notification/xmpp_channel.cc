@@ -13,6 +13,8 @@
 
 #include "src/backoff_entry.h"
 #include "src/data_encoding.h"
+#include "src/memory_usage.h"
+#include "src/metrics.h"
 #include "src/notification/notification_delegate.h"
 #include "src/notification/notification_parser.h"
 #include "src/notification/xml_node.h"
@@ -86,6 +88,31 @@ const int kAgressivePingTimeoutSeconds = 10;
 
 const int kConnectingTimeoutAfterNetChangeSeconds = 30;
 
+struct Metrics {
+  Counter* connects{
+      MetricsRegistry::GetInstance()->GetCounter("xmpp.connects")};
+  Counter* connect_failures{
+      MetricsRegistry::GetInstance()->GetCounter("xmpp.connect_failures")};
+  Counter* restarts{
+      MetricsRegistry::GetInstance()->GetCounter("xmpp.restarts")};
+  Counter* bytes_read{
+      MetricsRegistry::GetInstance()->GetCounter("xmpp.bytes_read")};
+  Counter* bytes_written{
+      MetricsRegistry::GetInstance()->GetCounter("xmpp.bytes_written")};
+  Counter* stanzas{
+      MetricsRegistry::GetInstance()->GetCounter("xmpp.stanzas_received")};
+  Histogram* ping_time{
+      MetricsRegistry::GetInstance()->GetHistogram("xmpp.ping_ms")};
+  Counter* ping_timeouts{
+      MetricsRegistry::GetInstance()->GetCounter("xmpp.ping_timeouts")};
+  Gauge* buffers_memory{GetMemoryGauge("xmpp_buffers")};
+};
+
+const Metrics& GetMetrics() {
+  static const Metrics metrics;
+  return metrics;
+}
+
 }  // namespace
 
 XmppChannel::XmppChannel(const std::string& account,
@@ -99,8 +126,10 @@ XmppChannel::XmppChannel(const std::string& account,
       network_{network},
       backoff_entry_{&kDefaultBackoffPolicy},
       task_runner_{task_runner},
-      iq_stanza_handler_{new IqStanzaHandler{this, task_runner}} {
+      iq_stanza_handler_{new IqStanzaHandler{this, task_runner}},
+      buffers_memory_usage_{GetMetrics().buffers_memory} {
   read_socket_data_.resize(4096);
+  UpdateBuffersMemoryUsage();
   if (network) {
     network->AddConnectionChangedCallback(base::Bind(
         &XmppChannel::OnConnectivityChanged, weak_ptr_factory_.GetWeakPtr()));
@@ -117,6 +146,7 @@ void XmppChannel::OnMessageRead(size_t size, ErrorPtr error) {
   if (!size)
     return Restart();
 
+  GetMetrics().bytes_read->Increment(size);
   stream_parser_.ParseData(msg);
   WaitForMessage();
 }
@@ -156,6 +186,7 @@ void XmppChannel::OnStanza(std::unique_ptr<XmlNode> stanza) {
 
 void XmppChannel::HandleStanza(std::unique_ptr<XmlNode> stanza) {
   VLOG(2) << "XMPP stanza received: " << stanza->ToString();
+  GetMetrics().stanzas->Increment();
 
   switch (state_) {
     case XmppState::kConnected:
@@ -304,6 +335,7 @@ void XmppChannel::OnSslSocketReady(std::unique_ptr<Stream> stream,
                                    ErrorPtr error) {
   if (error) {
     LOG(ERROR) << "TLS handshake failed. Restarting XMPP connection";
+    GetMetrics().connect_failures->Increment();
     backoff_entry_.InformOfRequest(false);
 
     LOG(INFO) << "Delaying connection to XMPP server for "
@@ -315,6 +347,7 @@ void XmppChannel::OnSslSocketReady(std::unique_ptr<Stream> stream,
   }
   CHECK(XmppState::kConnecting == state_);
   backoff_entry_.InformOfRequest(true);
+  GetMetrics().connects->Increment();
   stream_ = std::move(stream);
   state_ = XmppState::kConnected;
   RestartXmppStream();
@@ -325,13 +358,16 @@ void XmppChannel::SendMessage(const std::string& message) {
   CHECK(stream_) << "No XMPP socket stream available";
   if (write_pending_) {
     queued_write_data_ += message;
+    UpdateBuffersMemoryUsage();
     return;
   }
   write_socket_data_ = queued_write_data_ + message;
   queued_write_data_.clear();
+  UpdateBuffersMemoryUsage();
   VLOG(2) << "Sending XMPP message: " << message;
 
   write_pending_ = true;
+  GetMetrics().bytes_written->Increment(write_socket_data_.size());
   stream_->Write(
       write_socket_data_.data(), write_socket_data_.size(),
       base::Bind(&XmppChannel::OnMessageSent, task_ptr_factory_.GetWeakPtr()));
@@ -348,6 +384,12 @@ void XmppChannel::OnMessageSent(ErrorPtr error) {
   }
 }
 
+void XmppChannel::UpdateBuffersMemoryUsage() {
+  buffers_memory_usage_.Set(read_socket_data_.capacity() +
+                            EstimateMemoryUsage(write_socket_data_) +
+                            EstimateMemoryUsage(queued_write_data_));
+}
+
 void XmppChannel::WaitForMessage() {
   if (read_pending_ || !stream_)
     return;
@@ -372,6 +414,7 @@ void XmppChannel::AddChannelParameters(base::DictionaryValue* channel_json) {
 
 void XmppChannel::Restart() {
   LOG(INFO) << "Restarting XMPP";
+  GetMetrics().restarts->Increment();
   Stop();
   Start(delegate_);
 }
@@ -442,7 +485,9 @@ void XmppChannel::PingServer(base::TimeDelta timeout) {
 
 void XmppChannel::OnPingResponse(base::Time sent_time,
                                  std::unique_ptr<XmlNode> reply) {
-  VLOG(1) << "XMPP response received after " << (base::Time::Now() - sent_time);
+  base::TimeDelta ping_time = base::Time::Now() - sent_time;
+  VLOG(1) << "XMPP response received after " << ping_time;
+  GetMetrics().ping_time->AddTime(ping_time);
   // Ping response received from server. Everything seems to be in order.
   // Reschedule with default intervals.
   ScheduleRegularPing();
@@ -451,6 +496,7 @@ void XmppChannel::OnPingResponse(base::Time sent_time,
 void XmppChannel::OnPingTimeout(base::Time sent_time) {
   LOG(WARNING) << "XMPP channel seems to be disconnected. Ping timed out after "
                << (base::Time::Now() - sent_time);
+  GetMetrics().ping_timeouts->Increment();
   Restart();
 }
 
@@ -16,6 +16,7 @@
 #include <weave/stream.h>
 
 #include "src/backoff_entry.h"
+#include "src/memory_usage.h"
 #include "src/notification/notification_channel.h"
 #include "src/notification/xmpp_iq_stanza_handler.h"
 #include "src/notification/xmpp_stream_parser.h"
@@ -101,6 +102,7 @@ class XmppChannel : public NotificationChannel,
   void OnSslSocketReady(std::unique_ptr<Stream> stream, ErrorPtr error);
 
   void WaitForMessage();
+  void UpdateBuffersMemoryUsage();
 
   void OnMessageRead(size_t size, ErrorPtr error);
   void OnMessageSent(ErrorPtr error);
@@ -154,6 +156,8 @@ class XmppChannel : public NotificationChannel,
   bool read_pending_{false};
   bool write_pending_{false};
   std::unique_ptr<IqStanzaHandler> iq_stanza_handler_;
+  // Approximate memory held by the read and write buffers.
+  TrackedMemory buffers_memory_usage_;
 
   base::WeakPtrFactory<XmppChannel> ping_ptr_factory_{this};
   base::WeakPtrFactory<XmppChannel> task_ptr_factory_{this};
@@ -10,6 +10,7 @@
 #include <base/rand_util.h>
 #include <base/strings/string_number_conversions.h>
 
+#include "src/access_black_list_manager.h"
 #include "src/config.h"
 #include "src/data_encoding.h"
 #include "src/privet/constants.h"
@@ -273,8 +274,10 @@ AuthScope FromMacaroonScope(uint32_t scope) {
 }  // namespace
 
 AuthManager::AuthManager(Config* config,
+                         AccessBlackListManager* black_list,
                          const std::vector<uint8_t>& certificate_fingerprint)
     : config_{config},
+      black_list_{black_list},
       certificate_fingerprint_{certificate_fingerprint},
       access_secret_{CreateSecret()} {
   if (config_) {
@@ -289,7 +292,7 @@ AuthManager::AuthManager(const std::vector<uint8_t>& auth_secret,
                          const std::vector<uint8_t>& certificate_fingerprint,
                          const std::vector<uint8_t>& access_secret,
                          base::Clock* clock)
-    : AuthManager(nullptr, certificate_fingerprint) {
+    : AuthManager(nullptr, nullptr, certificate_fingerprint) {
   access_secret_ = access_secret.size() == kSha256OutputSize ? access_secret
                                                              : CreateSecret();
   SetAuthSecret(auth_secret, RootClientTokenOwner::kNone);
@@ -378,6 +381,14 @@ bool AuthManager::ParseAccessToken(const std::vector<uint8_t>& token,
   std::vector<uint8_t> app_id{
       result.delegatees[1].id,
       result.delegatees[1].id + result.delegatees[1].id_len};
+
+  // Black list contains only ids of local users.
+  if (type == AuthType::kLocal && black_list_ &&
+      black_list_->IsBlocked(user_id, app_id)) {
+    return Error::AddTo(error, FROM_HERE, errors::kInvalidAuthorization,
+                        "Token is revoked");
+  }
+
   if (user_info)
     *user_info = UserInfo{auth_scope, UserAppId{type, user_id, app_id}};
 
@@ -399,7 +410,7 @@ std::vector<uint8_t> AuthManager::ClaimRootClientAuthToken(
   };
 
   pending_claims_.push_back(std::make_pair(
-      std::unique_ptr<AuthManager>{new AuthManager{nullptr, {}}}, owner));
+      std::unique_ptr<AuthManager>{new AuthManager{nullptr, nullptr, {}}}, owner));
   if (pending_claims_.size() > kMaxPendingClaims)
     pending_claims_.pop_front();
   return pending_claims_.back().first->GetRootClientAuthToken(owner);
@@ -481,7 +492,6 @@ bool AuthManager::CreateAccessTokenFromAuth(
                         "Invalid token data");
   }
 
-  // TODO: Integrate black list checks.
   auto delegates_rbegin = std::reverse_iterator<const UwMacaroonDelegateeInfo*>(
       result.delegatees + result.num_delegatees);
   auto delegates_rend =
@@ -508,17 +518,22 @@ bool AuthManager::CreateAccessTokenFromAuth(
                         "Invalid session id");
   }
 
-  CHECK_GE(FromJ2000Time(result.expiration_time), now);
-
-  if (!access_token)
-    return true;
-
   std::vector<uint8_t> user_id{last_user_id->id,
                                last_user_id->id + last_user_id->id_len};
   std::vector<uint8_t> app_id;
   if (last_app_id != delegates_rend)
     app_id.assign(last_app_id->id, last_app_id->id + last_app_id->id_len);
 
+  if (black_list_ && black_list_->IsBlocked(user_id, app_id)) {
+    return Error::AddTo(error, FROM_HERE, errors::kInvalidAuthCode,
+                        "Auth token is revoked");
+  }
+
+  CHECK_GE(FromJ2000Time(result.expiration_time), now);
+
+  if (!access_token)
+    return true;
+
   UserInfo info{auth_scope, {AuthType::kLocal, user_id, app_id}};
 
   ttl = std::min(ttl, FromJ2000Time(result.expiration_time) - now);
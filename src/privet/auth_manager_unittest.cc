@@ -11,9 +11,11 @@
 #include "src/config.h"
 #include "src/data_encoding.h"
 #include "src/privet/mock_delegates.h"
+#include "src/test/mock_black_list_manager.h"
 #include "src/test/mock_clock.h"
 
 using testing::Return;
+using testing::StrictMock;
 
 namespace weave {
 namespace privet {
@@ -35,6 +37,9 @@ class AuthManagerTest : public testing::Test {
                                       const UserInfo& user_info) const {
     return auth_.DelegateToUser(token, ttl, user_info);
   }
+  void SetBlackList(AccessBlackListManager* black_list) {
+    auth_.black_list_ = black_list;
+  }
   const std::vector<uint8_t> kSecret1{
       78, 40, 39, 68, 29, 19, 70, 86, 38, 61, 13, 55, 33, 32, 51, 52,
       34, 43, 97, 48, 8,  56, 11, 99, 50, 59, 24, 26, 31, 71, 76, 28};
@@ -152,7 +157,7 @@ TEST_F(AuthManagerTest, CreateTokenDifferentTime) {
 TEST_F(AuthManagerTest, CreateTokenDifferentInstance) {
   EXPECT_NE(auth_.CreateAccessToken(
                 UserInfo{AuthScope::kUser, TestUserId{"123"}}, {}),
-            AuthManager({}, {}).CreateAccessToken(
+            AuthManager(nullptr, nullptr, {}).CreateAccessToken(
                 UserInfo{AuthScope::kUser, TestUserId{"123"}}, {}));
 }
 
@@ -189,6 +194,30 @@ TEST_F(AuthManagerTest, ParseAccessToken) {
   }
 }
 
+TEST_F(AuthManagerTest, ParseAccessTokenBlocked) {
+  StrictMock<test::MockAccessBlackListManager> black_list;
+  SetBlackList(&black_list);
+
+  auto token = auth_.CreateAccessToken(
+      UserInfo{AuthScope::kUser, {AuthType::kLocal, {1, 2, 3}, {4, 5, 6}}},
+      base::TimeDelta::FromSeconds(100));
+  EXPECT_CALL(black_list, IsBlocked(std::vector<uint8_t>{1, 2, 3},
+                                    std::vector<uint8_t>{4, 5, 6}))
+      .WillOnce(Return(false))
+      .WillOnce(Return(true));
+  UserInfo user_info;
+  EXPECT_TRUE(auth_.ParseAccessToken(token, &user_info, nullptr));
+  ErrorPtr error;
+  EXPECT_FALSE(auth_.ParseAccessToken(token, &user_info, &error));
+  EXPECT_TRUE(error->HasError("invalidAuthorization"));
+
+  // Only local users can be blocked.
+  token = auth_.CreateAccessToken(
+      UserInfo{AuthScope::kUser, TestUserId{"234"}},
+      base::TimeDelta::FromSeconds(100));
+  EXPECT_TRUE(auth_.ParseAccessToken(token, &user_info, nullptr));
+}
+
 TEST_F(AuthManagerTest, GetRootClientAuthToken) {
   EXPECT_EQ("WCCDQxkgAUYIGhudoQBCDEBQZgRhYq78I8GtFUZHNBbfGw==",
             Base64Encode(
@@ -267,6 +296,23 @@ TEST_F(AuthManagerTest, CreateAccessTokenFromAuth) {
   EXPECT_EQ(TestUserId{"234"}, user_info.id());
 }
 
+TEST_F(AuthManagerTest, CreateAccessTokenFromAuthBlocked) {
+  StrictMock<test::MockAccessBlackListManager> black_list;
+  SetBlackList(&black_list);
+
+  auto root = auth_.GetRootClientAuthToken(RootClientTokenOwner::kCloud);
+  auto extended = DelegateToUser(root, base::TimeDelta::FromSeconds(1000),
+                                 UserInfo{AuthScope::kUser, TestUserId{"234"}});
+  EXPECT_CALL(black_list, IsBlocked(std::vector<uint8_t>{'2', '3', '4'},
+                                    std::vector<uint8_t>{}))
+      .WillOnce(Return(true));
+  ErrorPtr error;
+  EXPECT_FALSE(
+      auth_.CreateAccessTokenFromAuth(extended, base::TimeDelta::FromDays(1),
+                                      nullptr, nullptr, nullptr, &error));
+  EXPECT_TRUE(error->HasError("invalidAuthCode"));
+}
+
 TEST_F(AuthManagerTest, CreateAccessTokenFromAuthNotMinted) {
   std::vector<uint8_t> access_token;
   auto root = auth_.GetRootClientAuthToken(RootClientTokenOwner::kClient);
@@ -332,7 +378,7 @@ class AuthManagerClaimTest : public testing::Test {
 
  protected:
   Config config_{nullptr};
-  AuthManager auth_{&config_, {}};
+  AuthManager auth_{&config_, nullptr, {}};
 };
 
 TEST_F(AuthManagerClaimTest, WithPreviosOwner) {
@@ -181,6 +181,7 @@ class CloudDelegateImpl : public CloudDelegate {
         command, Command::Origin::kLocal, role, &id, &error);
     if (!command_instance)
       return callback.Run({}, std::move(error));
+    command_instance->SetArrival(CommandInstance::Arrival::kPrivet);
     component_manager_->AddCommand(std::move(command_instance));
     command_owners_[id] = user_info.id();
     callback.Run(*component_manager_->FindCommand(id)->ToJson(), nullptr);
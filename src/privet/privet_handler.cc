@@ -19,6 +19,7 @@
 
 #include "src/config.h"
 #include "src/http_constants.h"
+#include "src/metrics.h"
 #include "src/privet/cloud_delegate.h"
 #include "src/privet/constants.h"
 #include "src/privet/device_delegate.h"
@@ -26,6 +27,7 @@
 #include "src/privet/security_delegate.h"
 #include "src/privet/wifi_delegate.h"
 #include "src/string_utils.h"
+#include "src/trace_log.h"
 #include "src/utils.h"
 
 namespace weave {
@@ -181,6 +183,47 @@ void SetStateProperties(const T& state, base::DictionaryValue* parent) {
   parent->Set(kErrorKey, ErrorToJson(*state.error()).release());
 }
 
+struct Metrics {
+  Counter* requests{
+      MetricsRegistry::GetInstance()->GetCounter("privet.requests")};
+  Counter* errors{
+      MetricsRegistry::GetInstance()->GetCounter("privet.request_errors")};
+  Histogram* request_time{
+      MetricsRegistry::GetInstance()->GetHistogram("privet.request_ms")};
+  // Time from a state change until the /checkForUpdates long polls which
+  // waited for it are answered.
+  Histogram* update_wakeup_time{
+      MetricsRegistry::GetInstance()->GetHistogram("privet.update_wakeup_us")};
+};
+
+const Metrics& GetMetrics() {
+  static const Metrics metrics;
+  return metrics;
+}
+
+const char kTraceCategory[] = "privet";
+
+void OnRequestDone(base::Time start_time,
+                   const std::string& api,
+                   uint64_t span_id,
+                   const PrivetHandler::RequestCallback& callback,
+                   int status,
+                   const base::DictionaryValue& output) {
+  const Metrics& metrics = GetMetrics();
+  metrics.request_time->AddTime(base::Time::Now() - start_time);
+  if (status != http::kOk)
+    metrics.errors->Increment();
+
+  // Zero |span_id| means tracing was off when the request started.
+  if (span_id) {
+    std::unique_ptr<base::DictionaryValue> args{new base::DictionaryValue};
+    args->SetInteger("status", status);
+    TraceLog::GetInstance()->EndSpan(kTraceCategory, api, span_id,
+                                     std::move(args));
+  }
+  callback.Run(status, output);
+}
+
 void ReturnError(const Error& error,
                  const PrivetHandler::RequestCallback& callback) {
   int code = http::kInternalServerError;
@@ -438,6 +481,7 @@ void PrivetHandler::OnTraitDefsChanged() {
 }
 
 void PrivetHandler::OnStateChanged() {
+  base::TimeTicks start = base::TimeTicks::Now();
   // State updates also change the component tree, so update both fingerprints.
   ++state_fingerprint_;
   ++components_fingerprint_;
@@ -446,9 +490,13 @@ void PrivetHandler::OnStateChanged() {
   };
   auto last =
       std::partition(update_requests_.begin(), update_requests_.end(), pred);
+  if (last == update_requests_.end())
+    return;
   for (auto p = last; p != update_requests_.end(); ++p)
     ReplyToUpdateRequest(p->callback);
   update_requests_.erase(last, update_requests_.end());
+  GetMetrics().update_wakeup_time->Add(
+      (base::TimeTicks::Now() - start).InMicroseconds());
 }
 
 void PrivetHandler::OnComponentTreeChanged() {
@@ -467,40 +515,45 @@ void PrivetHandler::HandleRequest(const std::string& api,
                                   const std::string& auth_header,
                                   const base::DictionaryValue* input,
                                   const RequestCallback& callback) {
+  GetMetrics().requests->Increment();
+  uint64_t span_id =
+      TraceLog::GetInstance()->BeginSpan(kTraceCategory, api, nullptr);
+  RequestCallback reply =
+      base::Bind(&OnRequestDone, base::Time::Now(), api, span_id, callback);
   ErrorPtr error;
   if (!input) {
     Error::AddTo(&error, FROM_HERE, errors::kInvalidFormat, "Malformed JSON");
-    return ReturnError(*error, callback);
+    return ReturnError(*error, reply);
   }
   auto handler = handlers_.find(api);
   if (handler == handlers_.end()) {
     Error::AddTo(&error, FROM_HERE, errors::kNotFound, "Path not found");
-    return ReturnError(*error, callback);
+    return ReturnError(*error, reply);
   }
   if (auth_header.empty()) {
     Error::AddTo(&error, FROM_HERE, errors::kMissingAuthorization,
                  "Authorization header must not be empty");
-    return ReturnError(*error, callback);
+    return ReturnError(*error, reply);
   }
   std::string token = GetAuthTokenFromAuthHeader(auth_header);
   if (token.empty()) {
     Error::AddToPrintf(&error, FROM_HERE, errors::kInvalidAuthorization,
                        "Invalid authorization header: %s", auth_header.c_str());
-    return ReturnError(*error, callback);
+    return ReturnError(*error, reply);
   }
   UserInfo user_info;
   if (token != EnumToString(AuthType::kAnonymous)) {
     if (!security_->ParseAccessToken(token, &user_info, &error))
-      return ReturnError(*error, callback);
+      return ReturnError(*error, reply);
   }
 
   if (handler->second.scope > user_info.scope()) {
     Error::AddToPrintf(&error, FROM_HERE, errors::kInvalidAuthorizationScope,
                        "Scope '%s' does not allow '%s'",
                        EnumToString(user_info.scope()).c_str(), api.c_str());
-    return ReturnError(*error, callback);
+    return ReturnError(*error, reply);
   }
-  (this->*handler->second.handler)(*input, user_info, callback);
+  (this->*handler->second.handler)(*input, user_info, reply);
 }
 
 void PrivetHandler::AddHandler(const std::string& path,
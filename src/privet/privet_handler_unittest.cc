@@ -17,8 +17,11 @@
 #include <gtest/gtest.h>
 #include <weave/test/unittest_utils.h>
 
+#include "src/http_constants.h"
+#include "src/metrics.h"
 #include "src/privet/constants.h"
 #include "src/privet/mock_delegates.h"
+#include "src/test/allocation_counter.h"
 #include "src/test/mock_clock.h"
 
 using testing::_;
@@ -85,6 +88,36 @@ std::unique_ptr<base::DictionaryValue> StripDebugErrorDetails(
   return result;
 }
 
+// Delegates on the path of /privet/v3/state which don't go through gmock,
+// whose calls allocate, so allocation budgets cover the handler only.
+class PlainSecurityDelegate : public MockSecurityDelegate {
+ public:
+  bool ParseAccessToken(const std::string& token,
+                        UserInfo* user_info,
+                        ErrorPtr* error) const override {
+    *user_info = UserInfo{AuthScope::kOwner, TestUserId{"1"}};
+    return true;
+  }
+};
+
+class PlainCloudDelegate : public MockCloudDelegate {
+ public:
+  PlainCloudDelegate() { state_.SetInteger("test.value", 1); }
+
+  const base::DictionaryValue& GetLegacyState() const override {
+    return state_;
+  }
+
+ private:
+  base::DictionaryValue state_;
+};
+
+void SaveStatus(int* status_out,
+                int status,
+                const base::DictionaryValue& output) {
+  *status_out = status;
+}
+
 }  // namespace
 
 class PrivetHandlerTest : public testing::Test {
@@ -693,6 +726,23 @@ TEST_F(PrivetHandlerTestWithAuth, State) {
                  HandleRequest("/privet/v3/state", "{}"));
 }
 
+TEST(PrivetHandlerAllocationsTest, State) {
+  PlainCloudDelegate cloud;
+  testing::StrictMock<MockDeviceDelegate> device;
+  PlainSecurityDelegate security;
+  PrivetHandler handler{&cloud, &device, &security, nullptr, nullptr};
+
+  const std::string api = "/privet/v3/state";
+  const std::string auth_header = "Privet 123";
+  base::DictionaryValue input;
+  int status = 0;
+  PrivetHandler::RequestCallback callback = base::Bind(&SaveStatus, &status);
+  handler.HandleRequest(api, auth_header, &input, callback);
+  EXPECT_EQ(http::kOk, status);
+  EXPECT_ALLOCATION_BUDGET(
+      13, handler.HandleRequest(api, auth_header, &input, callback));
+}
+
 TEST_F(PrivetHandlerTestWithAuth, CommandsDefs) {
   EXPECT_JSON_EQ("{'commands': {'test':{}}, 'fingerprint': '1'}",
                  HandleRequest("/privet/v3/commandDefs", "{}"));
@@ -951,7 +1001,15 @@ TEST_F(PrivetHandlerTestWithAuth, CommandsList) {
   EXPECT_JSON_EQ(kExpected, HandleRequest("/privet/v3/commands/list", "{}"));
 }
 
-class PrivetHandlerCheckForUpdatesTest : public PrivetHandlerTestWithAuth {};
+class PrivetHandlerCheckForUpdatesTest : public PrivetHandlerTestWithAuth {
+ protected:
+  // Metrics are process-wide, so tests check how many samples are added.
+  int64_t GetWakeUpCount() const {
+    return MetricsRegistry::GetInstance()
+        ->GetHistogram("privet.update_wakeup_us")
+        ->GetCount();
+  }
+};
 
 TEST_F(PrivetHandlerCheckForUpdatesTest, NoInput) {
   EXPECT_CALL(device_, GetHttpRequestTimeout())
@@ -1047,10 +1105,15 @@ TEST_F(PrivetHandlerCheckForUpdatesTest, LongPollState) {
    'traitsFingerprint': '1',
    'componentsFingerprint': '1'
   })";
+  int64_t wake_ups = GetWakeUpCount();
   EXPECT_JSON_EQ("{}", HandleRequest("/privet/v3/checkForUpdates", kInput));
   EXPECT_EQ(0, GetResponseCount());
   cloud_.NotifyOnStateChanged();
   EXPECT_EQ(1, GetResponseCount());
+  EXPECT_EQ(wake_ups + 1, GetWakeUpCount());
+  // Without a waiting request there is nothing to measure.
+  cloud_.NotifyOnStateChanged();
+  EXPECT_EQ(wake_ups + 1, GetWakeUpCount());
   const char kExpected[] = R"({
    'commandsFingerprint': '1',
    'stateFingerprint': '2',
@@ -1111,10 +1174,12 @@ TEST_F(PrivetHandlerCheckForUpdatesTest, LongPollIgnoreState) {
    'commandsFingerprint': '1',
    'traitsFingerprint': '1'
   })";
+  int64_t wake_ups = GetWakeUpCount();
   EXPECT_JSON_EQ("{}", HandleRequest("/privet/v3/checkForUpdates", kInput));
   EXPECT_EQ(0, GetResponseCount());
   cloud_.NotifyOnStateChanged();
   EXPECT_EQ(0, GetResponseCount());
+  EXPECT_EQ(wake_ups, GetWakeUpCount());
   cloud_.NotifyOnComponentTreeChanged();
   EXPECT_EQ(0, GetResponseCount());
   cloud_.NotifyOnTraitDefsChanged();
@@ -106,6 +106,10 @@ void Manager::AddOnPairingChangedCallbacks(
   security_->RegisterPairingListeners(on_start, on_end);
 }
 
+void Manager::AddOnReplySentCallback(const base::Closure& callback) {
+  on_reply_sent_.push_back(callback);
+}
+
 void Manager::OnDeviceInfoChanged() {
   OnChanged();
 }
@@ -149,7 +153,9 @@ void Manager::PrivetResponseHandler(
   std::string data;
   base::JSONWriter::WriteWithOptions(
       output, base::JSONWriter::OPTIONS_PRETTY_PRINT, &data);
-  request->SendReply(status, data, http::kJson);
+  request->SendReply(status, std::move(data), http::kJson);
+  for (const auto& callback : on_reply_sent_)
+    callback.Run();
 }
 
 void Manager::OnChanged() {
@@ -60,6 +60,9 @@ class Manager : public CloudDelegate::Observer {
       const Device::PairingBeginCallback& begin_callback,
       const Device::PairingEndCallback& end_callback);
 
+  // |callback| is run after each reply to a Privet request is sent.
+  void AddOnReplySentCallback(const base::Closure& callback);
+
  private:
   // CloudDelegate::Observer
   void OnDeviceInfoChanged() override;
@@ -86,6 +89,7 @@ class Manager : public CloudDelegate::Observer {
   std::unique_ptr<WifiBootstrapManager> wifi_bootstrap_manager_;
   std::unique_ptr<Publisher> publisher_;
   std::unique_ptr<PrivetHandler> privet_handler_;
+  std::vector<base::Closure> on_reply_sent_;
 
   ScopedObserver<CloudDelegate, CloudDelegate::Observer> cloud_observer_{this};
 
@@ -0,0 +1,155 @@
+// Copyright 2016 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "src/snapshot_manager.h"
+
+#include <base/bind.h>
+#include <base/json/json_writer.h>
+#include <base/values.h>
+
+#include "src/bind_lambda.h"
+#include "src/device_registration_info.h"
+#include "src/metrics.h"
+#include "src/utils.h"
+#include "third_party/chromium/crypto/sha2.h"
+
+namespace weave {
+
+namespace {
+
+const char kSnapshotName[] = "snapshot";
+const int kSnapshotVersion = 1;
+
+const char kVersion[] = "version";
+const char kFirmwareVersion[] = "firmwareVersion";
+const char kCloudId[] = "cloudId";
+const char kCloud[] = "cloud";
+const char kCommands[] = "commands";
+
+// Changes are batched, so frequent state updates don't wear out the storage.
+const int kSaveDelaySeconds = 30;
+
+struct SnapshotMetrics {
+  Counter* saves{MetricsRegistry::GetInstance()->GetCounter("snapshot.saves")};
+  Histogram* sizes{
+      MetricsRegistry::GetInstance()->GetHistogram("snapshot.size_bytes")};
+  Counter* restores{
+      MetricsRegistry::GetInstance()->GetCounter("snapshot.restores")};
+};
+
+SnapshotMetrics& GetMetrics() {
+  static SnapshotMetrics metrics;
+  return metrics;
+}
+
+}  // namespace
+
+SnapshotManager::SnapshotManager(provider::ConfigStore* config_store,
+                                 provider::TaskRunner* task_runner,
+                                 ComponentManager* component_manager,
+                                 DeviceRegistrationInfo* device_info)
+    : config_store_{config_store},
+      task_runner_{task_runner},
+      component_manager_{component_manager},
+      device_info_{device_info} {}
+
+SnapshotManager::~SnapshotManager() {
+  Save();
+}
+
+void SnapshotManager::Restore() {
+  const Settings& settings = device_info_->GetSettings();
+  std::string json = config_store_->LoadSettings(kSnapshotName);
+  std::unique_ptr<base::DictionaryValue> snapshot;
+  if (!json.empty())
+    snapshot = LoadJsonDict(json, nullptr);
+
+  int version = 0;
+  std::string firmware_version;
+  if (!snapshot || !snapshot->GetInteger(kVersion, &version) ||
+      version != kSnapshotVersion ||
+      !snapshot->GetString(kFirmwareVersion, &firmware_version) ||
+      firmware_version != settings.firmware_version) {
+    LOG_IF(INFO, !json.empty()) << "Ignoring incompatible snapshot";
+  } else {
+    ErrorPtr error;
+    if (component_manager_->RestoreSnapshot(*snapshot, &error)) {
+      GetMetrics().restores->Increment();
+      saved_hash_ = crypto::SHA256HashString(json);
+      // Cloud state and commands are valid only for the same registration.
+      std::string cloud_id;
+      const base::DictionaryValue* cloud = nullptr;
+      const base::ListValue* commands = nullptr;
+      if (snapshot->GetString(kCloudId, &cloud_id) && !cloud_id.empty() &&
+          cloud_id == settings.cloud_id) {
+        if (snapshot->GetDictionary(kCloud, &cloud))
+          device_info_->RestoreCloudSyncState(*cloud);
+        if (snapshot->GetList(kCommands, &commands))
+          device_info_->RestoreCommands(*commands);
+      }
+    } else {
+      LOG(ERROR) << "Failed to restore snapshot: " << error->GetMessage();
+    }
+  }
+
+  base::Closure schedule_save = base::Bind(&SnapshotManager::ScheduleSave,
+                                           weak_ptr_factory_.GetWeakPtr());
+  component_manager_->AddTraitDefChangedCallback(schedule_save);
+  component_manager_->AddComponentTreeChangedCallback(schedule_save);
+  component_manager_->AddStateChangedCallback(schedule_save);
+  auto on_command = [schedule_save](Command*) { schedule_save.Run(); };
+  component_manager_->AddCommandAddedCallback(base::Bind(on_command));
+  component_manager_->AddCommandRemovedCallback(base::Bind(on_command));
+  server_state_updated_token_ =
+      component_manager_->AddServerStateUpdatedCallback(
+          base::Bind([schedule_save](ComponentManager::UpdateID) {
+            schedule_save.Run();
+          }));
+  device_info_->AddGcdStateChangedCallback(base::Bind(
+      &SnapshotManager::OnGcdStateChanged, weak_ptr_factory_.GetWeakPtr()));
+}
+
+void SnapshotManager::Save() {
+  const Settings& settings = device_info_->GetSettings();
+  std::unique_ptr<base::DictionaryValue> snapshot =
+      component_manager_->CreateSnapshot();
+  snapshot->SetInteger(kVersion, kSnapshotVersion);
+  snapshot->SetString(kFirmwareVersion, settings.firmware_version);
+  snapshot->SetString(kCloudId, settings.cloud_id);
+  std::unique_ptr<base::DictionaryValue> cloud =
+      device_info_->GetCloudSyncState();
+  if (cloud)
+    snapshot->Set(kCloud, cloud.release());
+
+  std::string json;
+  base::JSONWriter::Write(*snapshot, &json);
+  std::string hash = crypto::SHA256HashString(json);
+  if (hash == saved_hash_)
+    return;
+  saved_hash_ = hash;
+  config_store_->SaveSettings(kSnapshotName, json, {});
+  GetMetrics().saves->Increment();
+  GetMetrics().sizes->Add(json.size());
+}
+
+void SnapshotManager::ScheduleSave() {
+  if (save_scheduled_)
+    return;
+  save_scheduled_ = true;
+  task_runner_->PostDelayedTask(
+      FROM_HERE, base::Bind(&SnapshotManager::OnSaveTimer,
+                            weak_ptr_factory_.GetWeakPtr()),
+      base::TimeDelta::FromSeconds(kSaveDelaySeconds));
+}
+
+void SnapshotManager::OnSaveTimer() {
+  save_scheduled_ = false;
+  Save();
+}
+
+void SnapshotManager::OnGcdStateChanged(GcdState state) {
+  ScheduleSave();
+}
+
+}  // namespace weave
@@ -0,0 +1,62 @@
+// Copyright 2016 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIBWEAVE_SRC_SNAPSHOT_MANAGER_H_
+#define LIBWEAVE_SRC_SNAPSHOT_MANAGER_H_
+
+#include <string>
+
+#include <base/macros.h>
+#include <base/memory/weak_ptr.h>
+#include <weave/device.h>
+#include <weave/provider/config_store.h>
+#include <weave/provider/task_runner.h>
+
+#include "src/component_manager.h"
+
+namespace weave {
+
+class DeviceRegistrationInfo;
+
+// Saves a snapshot of the component manager and the cloud sync state of the
+// device, and restores it after a restart before the application adds its
+// traits and components. Changes are saved in batches after a delay, and on
+// destruction, i.e. on a clean shutdown.
+class SnapshotManager final {
+ public:
+  SnapshotManager(provider::ConfigStore* config_store,
+                  provider::TaskRunner* task_runner,
+                  ComponentManager* component_manager,
+                  DeviceRegistrationInfo* device_info);
+  ~SnapshotManager();
+
+  // Restores the snapshot saved by the same firmware, if there is one, and
+  // starts tracking changes. Must be called before traits are loaded.
+  void Restore();
+
+  // Saves the snapshot now if it changed since the last save.
+  void Save();
+
+ private:
+  void ScheduleSave();
+  void OnSaveTimer();
+  void OnGcdStateChanged(GcdState state);
+
+  provider::ConfigStore* config_store_{nullptr};
+  provider::TaskRunner* task_runner_{nullptr};
+  ComponentManager* component_manager_{nullptr};
+  DeviceRegistrationInfo* device_info_{nullptr};
+
+  // Hash of the last saved or restored snapshot.
+  std::string saved_hash_;
+  bool save_scheduled_{false};
+  ComponentManager::Token server_state_updated_token_;
+
+  base::WeakPtrFactory<SnapshotManager> weak_ptr_factory_{this};
+  DISALLOW_COPY_AND_ASSIGN(SnapshotManager);
+};
+
+}  // namespace weave
+
+#endif  // LIBWEAVE_SRC_SNAPSHOT_MANAGER_H_
@@ -0,0 +1,127 @@
+// Copyright 2016 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "src/snapshot_manager.h"
+
+#include <base/json/json_writer.h>
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include <weave/provider/test/fake_task_runner.h>
+#include <weave/provider/test/mock_config_store.h>
+#include <weave/provider/test/mock_http_client.h>
+#include <weave/test/unittest_utils.h>
+
+#include "src/component_manager_impl.h"
+#include "src/config.h"
+#include "src/device_registration_info.h"
+
+namespace weave {
+
+using testing::_;
+using testing::Return;
+using testing::SaveArg;
+using testing::StrictMock;
+using test::CreateDictionaryValue;
+
+namespace {
+
+const char kTraits[] = R"({"lock": {"state": {"locked": "boolean"}}})";
+const char kComponents[] = R"({
+  "lock": {"traits": ["lock"], "state": {"lock": {"locked": true}}}
+})";
+
+// A device restarted by recreating its managers on the same providers.
+class SnapshotManagerTest : public testing::Test {
+ protected:
+  void SetUp() override { Start(); }
+
+  void Start() {
+    snapshot_manager_.reset();
+    device_info_.reset();
+    component_manager_.reset(new ComponentManagerImpl{&task_runner_});
+    config_.reset(new Config{&config_store_});
+    device_info_.reset(new DeviceRegistrationInfo{
+        config_.get(), component_manager_.get(), &task_runner_, &http_client_,
+        nullptr, nullptr});
+    snapshot_manager_.reset(new SnapshotManager{
+        &config_store_, &task_runner_, component_manager_.get(),
+        device_info_.get()});
+    snapshot_manager_->Restore();
+  }
+
+  // Adds the traits and components as an application would at startup.
+  void AddComponents() {
+    EXPECT_TRUE(component_manager_->LoadTraits(kTraits, nullptr));
+    EXPECT_TRUE(
+        component_manager_->AddComponent("", "lock", {"lock"}, nullptr));
+  }
+
+  provider::test::FakeTaskRunner task_runner_;
+  provider::test::MockConfigStore config_store_;
+  StrictMock<provider::test::MockHttpClient> http_client_;
+  std::unique_ptr<Config> config_;
+  std::unique_ptr<ComponentManagerImpl> component_manager_;
+  std::unique_ptr<DeviceRegistrationInfo> device_info_;
+  std::unique_ptr<SnapshotManager> snapshot_manager_;
+};
+
+}  // anonymous namespace
+
+TEST_F(SnapshotManagerTest, SaveAndRestore) {
+  std::string snapshot;
+  EXPECT_CALL(config_store_, SaveSettings("snapshot", _, _))
+      .WillOnce(SaveArg<1>(&snapshot));
+  AddComponents();
+  EXPECT_TRUE(component_manager_->SetStatePropertiesFromJson(
+      "lock", R"({"lock": {"locked": true}})", nullptr));
+  task_runner_.Run();
+
+  auto json = CreateDictionaryValue(snapshot);
+  std::string firmware_version;
+  EXPECT_TRUE(json->GetString("firmwareVersion", &firmware_version));
+  EXPECT_EQ("TEST_FIRMWARE", firmware_version);
+  const base::DictionaryValue* value = nullptr;
+  ASSERT_TRUE(json->GetDictionary("traits", &value));
+  EXPECT_JSON_EQ(kTraits, *value);
+  ASSERT_TRUE(json->GetDictionary("components", &value));
+  EXPECT_JSON_EQ(kComponents, *value);
+
+  // Nothing changed, so nothing is saved on shutdown.
+  EXPECT_CALL(config_store_, LoadSettings("snapshot"))
+      .WillOnce(Return(snapshot));
+  Start();
+  EXPECT_JSON_EQ(kComponents, component_manager_->GetComponents());
+  AddComponents();
+  task_runner_.Run();
+
+  // Changes are saved on shutdown.
+  EXPECT_CALL(config_store_, SaveSettings("snapshot", _, _)).Times(1);
+  EXPECT_TRUE(component_manager_->SetStatePropertiesFromJson(
+      "lock", R"({"lock": {"locked": false}})", nullptr));
+  snapshot_manager_.reset();
+}
+
+TEST_F(SnapshotManagerTest, IgnoreOtherFirmware) {
+  std::string snapshot;
+  EXPECT_CALL(config_store_, SaveSettings("snapshot", _, _))
+      .WillOnce(SaveArg<1>(&snapshot));
+  AddComponents();
+  task_runner_.Run();
+
+  auto json = CreateDictionaryValue(snapshot);
+  json->SetString("firmwareVersion", "OLD_FIRMWARE");
+  std::string old_snapshot;
+  base::JSONWriter::Write(*json, &old_snapshot);
+  EXPECT_CALL(config_store_, LoadSettings("snapshot"))
+      .WillOnce(Return(old_snapshot));
+  Start();
+  EXPECT_TRUE(component_manager_->GetTraits().empty());
+  EXPECT_TRUE(component_manager_->GetComponents().empty());
+
+  // The old snapshot is overwritten.
+  EXPECT_CALL(config_store_, SaveSettings("snapshot", _, _)).Times(1);
+  snapshot_manager_.reset();
+}
+
+}  // namespace weave
@@ -0,0 +1,574 @@
+// Copyright 2016 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Long-running simulation of a registered device on virtual time.
+// kSimulatedDays of operation of a device with many components, continuous
+// state changes and floods of cloud commands run in seconds against simulated
+// cloud and XMPP servers, and the test checks that memory, task queue and
+// latencies of the device stay bounded. Built as a separate binary, see
+// "make soak-test".
+
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <base/bind.h>
+#include <base/logging.h>
+#include <base/memory/weak_ptr.h>
+#include <base/values.h>
+#include <gtest/gtest.h>
+#include <weave/provider/network.h>
+#include <weave/provider/test/fake_task_runner.h>
+#include <weave/stream.h>
+
+#include "src/component_manager_impl.h"
+#include "src/config.h"
+#include "src/data_encoding.h"
+#include "src/device_registration_info.h"
+#include "src/memory_usage.h"
+#include "src/metrics.h"
+#include "src/string_utils.h"
+#include "src/test/simulated_cloud.h"
+
+namespace weave {
+
+namespace {
+
+using test::SimulatedCloud;
+using test::SimulatedConfigStore;
+using test::ToJson;
+
+const char kXmppHost[] = "xmpp.test";
+const uint16_t kXmppPort = 5223;
+
+const char kTraits[] = R"({
+  "soak": {
+    "commands": {
+      "work": {
+        "minimalRole": "user",
+        "parameters": {"amount": {"type": "integer"}}
+      }
+    },
+    "state": {
+      "value": {"type": "integer"},
+      "text": {"type": "string"}
+    }
+  }
+})";
+
+// Simulated load.
+const int kComponentCount = 1000;
+const int kSimulatedDays = 2;
+const int kMeanStateChangeIntervalMs = 300;
+const int kMaxStateTextSize = 64;
+const int kCommandFloodIntervalMinutes = 10;
+const int kCommandsPerFlood = 200;
+// Every n-th command is pushed without its body, so the device fetches the
+// command queue, as it does for large commands.
+const int kFetchedCommandPeriod = 10;
+const int kMaxCommandDurationMs = 2000;
+const int kSamplePeriodMinutes = 10;
+
+// Simulated servers.
+const int kMinCloudLatencyMs = 20;
+const int kMaxCloudLatencyMs = 200;
+const int kXmppLatencyMs = 10;
+
+// Bounds checked by the test.
+const double kMaxMemoryGrowth = 1.5;
+const int64_t kMemorySlackBytes = 64 * 1024;
+const size_t kMaxTaskQueueSize = 2 * kCommandsPerFlood;
+const int64_t kMaxStateLatencyMs = 1000;
+const int64_t kMaxCommandLatencyMs = 5000;
+
+std::string GetJid() {
+  return std::string{test::kSimulatedRobotAccount} + "/soak";
+}
+
+class SimulatedXmppServer;
+
+// Connection of the device to SimulatedXmppServer.
+class SimulatedXmppStream : public Stream {
+ public:
+  SimulatedXmppStream(SimulatedXmppServer* server,
+                      provider::TaskRunner* task_runner)
+      : server_{server}, task_runner_{task_runner} {}
+  ~SimulatedXmppStream() override;
+
+  void Read(void* buffer,
+            size_t size_to_read,
+            const ReadCallback& callback) override {
+    CHECK(read_callback_.is_null());
+    read_buffer_ = static_cast<char*>(buffer);
+    read_size_ = size_to_read;
+    read_callback_ = callback;
+    ScheduleRead();
+  }
+
+  void Write(const void* buffer,
+             size_t size_to_write,
+             const WriteCallback& callback) override;
+
+  void CancelPendingOperations() override {
+    read_callback_.Reset();
+    read_scheduled_ = false;
+    weak_ptr_factory_.InvalidateWeakPtrs();
+  }
+
+  // Sends |data| from the server to the device.
+  void Send(const std::string& data) {
+    unread_data_ += data;
+    ScheduleRead();
+  }
+
+ private:
+  void ScheduleRead() {
+    if (read_scheduled_ || read_callback_.is_null() || unread_data_.empty())
+      return;
+    read_scheduled_ = true;
+    task_runner_->PostDelayedTask(
+        FROM_HERE, base::Bind(&SimulatedXmppStream::CompleteRead,
+                              weak_ptr_factory_.GetWeakPtr()),
+        base::TimeDelta::FromMilliseconds(kXmppLatencyMs));
+  }
+
+  void CompleteRead() {
+    read_scheduled_ = false;
+    size_t size = std::min(read_size_, unread_data_.size());
+    std::copy(unread_data_.begin(), unread_data_.begin() + size, read_buffer_);
+    unread_data_.erase(0, size);
+    ReadCallback callback = read_callback_;
+    read_callback_.Reset();
+    callback.Run(size, nullptr);
+  }
+
+  void CompleteWrite(const WriteCallback& callback) { callback.Run(nullptr); }
+
+  SimulatedXmppServer* server_;
+  provider::TaskRunner* task_runner_;
+  std::string unread_data_;
+  char* read_buffer_{nullptr};
+  size_t read_size_{0};
+  ReadCallback read_callback_;
+  bool read_scheduled_{false};
+
+  base::WeakPtrFactory<SimulatedXmppStream> weak_ptr_factory_{this};
+};
+
+// XMPP server which authenticates the device with tokens of SimulatedCloud,
+// answers its requests and pushes command notifications.
+class SimulatedXmppServer : public provider::Network {
+ public:
+  SimulatedXmppServer(provider::TaskRunner* task_runner,
+                      const SimulatedCloud* cloud)
+      : task_runner_{task_runner}, cloud_{cloud} {}
+
+  void AddConnectionChangedCallback(
+      const ConnectionChangedCallback& callback) override {}
+
+  State GetConnectionState() const override { return State::kOnline; }
+
+  void OpenSslSocket(const std::string& host,
+                     uint16_t port,
+                     const OpenSslSocketCallback& callback) override {
+    EXPECT_EQ(kXmppHost, host);
+    EXPECT_EQ(kXmppPort, port);
+    CHECK(!stream_);
+    ++connection_count_;
+    stream_ = new SimulatedXmppStream{this, task_runner_};
+    authenticated_ = false;
+    subscribed_ = false;
+    received_data_.clear();
+    task_runner_->PostDelayedTask(
+        FROM_HERE, base::Bind(callback, base::Passed(std::unique_ptr<Stream>{
+                                            stream_}),
+                              nullptr),
+        base::TimeDelta::FromMilliseconds(kXmppLatencyMs));
+  }
+
+  void OnStreamDestroyed(SimulatedXmppStream* stream) {
+    if (stream_ != stream)
+      return;
+    stream_ = nullptr;
+    subscribed_ = false;
+  }
+
+  void OnDataReceived(const std::string& data) {
+    received_data_ += data;
+    while (!received_data_.empty() && HandleStanza()) {
+    }
+  }
+
+  // Pushes a COMMAND_CREATED notification. Returns false if the device is not
+  // subscribed to notifications.
+  bool PushCommand(const base::DictionaryValue& command) {
+    if (!subscribed_)
+      return false;
+    base::DictionaryValue notification;
+    notification.SetString("kind", "weave#notification");
+    notification.SetString("type", "COMMAND_CREATED");
+    notification.Set("command", command.DeepCopy());
+    stream_->Send("<message to=\"" + GetJid() +
+                  "\"><push:push channel=\"cloud_devices\" "
+                  "xmlns:push=\"google:push\"><push:data>" +
+                  Base64Encode(ToJson(notification)) +
+                  "</push:data></push:push></message>");
+    return true;
+  }
+
+  bool IsSubscribed() const { return subscribed_; }
+  int GetConnectionCount() const { return connection_count_; }
+  int GetPingCount() const { return ping_count_; }
+
+ private:
+  // Handles the first complete stanza from the device. Returns false if more
+  // data is needed.
+  bool HandleStanza() {
+    std::string end_tag;
+    if (StartsWith("<stream:stream")) {
+      end_tag = ">";
+    } else if (StartsWith("<auth")) {
+      end_tag = "</auth>";
+    } else if (StartsWith("<iq")) {
+      end_tag = "</iq>";
+    } else if (StartsWith("</stream:stream>")) {
+      end_tag = "</stream:stream>";
+    } else if (received_data_.size() >= strlen("</stream:stream>")) {
+      ADD_FAILURE() << "Unexpected XMPP data: " << received_data_;
+      received_data_.clear();
+      return false;
+    }
+    size_t end = received_data_.find(end_tag);
+    if (end_tag.empty() || end == std::string::npos)
+      return false;
+    std::string stanza = received_data_.substr(0, end + end_tag.size());
+    received_data_.erase(0, stanza.size());
+
+    if (end_tag == ">") {
+      stream_->Send(
+          "<stream:stream from=\"clouddevices.gserviceaccount.com\" "
+          "id=\"0CCF520913ABA04B\" version=\"1.0\" "
+          "xmlns:stream=\"http://etherx.jabber.org/streams\" "
+          "xmlns=\"jabber:client\">");
+      stream_->Send(authenticated_
+                        ? "<stream:features>"
+                          "<bind xmlns=\"urn:ietf:params:xml:ns:xmpp-bind\"/>"
+                          "<session "
+                          "xmlns=\"urn:ietf:params:xml:ns:xmpp-session\"/>"
+                          "</stream:features>"
+                        : "<stream:features><mechanisms "
+                          "xmlns=\"urn:ietf:params:xml:ns:xmpp-sasl\">"
+                          "<mechanism>X-OAUTH2</mechanism></mechanisms>"
+                          "</stream:features>");
+    } else if (end_tag == "</auth>") {
+      HandleAuth(stanza);
+    } else if (end_tag == "</iq>") {
+      HandleIq(stanza);
+    } else {
+      stream_->Send("</stream:stream>");
+    }
+    return true;
+  }
+
+  void HandleAuth(const std::string& stanza) {
+    size_t begin = stanza.find('>') + 1;
+    std::string credentials;
+    EXPECT_TRUE(Base64Decode(
+        stanza.substr(begin, stanza.size() - begin - strlen("</auth>")),
+        &credentials));
+    // Credentials are "\0<account>\0<token>".
+    auto account_token =
+        SplitAtFirst(credentials.substr(1), std::string(1, '\0'), false);
+    EXPECT_EQ(test::kSimulatedRobotAccount, account_token.first);
+    if (cloud_->IsTokenValid(account_token.second)) {
+      authenticated_ = true;
+      stream_->Send("<success xmlns=\"urn:ietf:params:xml:ns:xmpp-sasl\"/>");
+      return;
+    }
+    stream_->Send(
+        "<failure xmlns=\"urn:ietf:params:xml:ns:xmpp-sasl\">"
+        "<not-authorized/></failure></stream:stream>");
+  }
+
+  void HandleIq(const std::string& stanza) {
+    size_t id_begin = stanza.find("id='") + 4;
+    std::string id =
+        stanza.substr(id_begin, stanza.find('\'', id_begin) - id_begin);
+    if (stanza.find("<bind") != std::string::npos) {
+      stream_->Send("<iq id=\"" + id +
+                    "\" type=\"result\">"
+                    "<bind xmlns=\"urn:ietf:params:xml:ns:xmpp-bind\"><jid>" +
+                    GetJid() + "</jid></bind></iq>");
+      return;
+    }
+    if (stanza.find("<subscribe") != std::string::npos)
+      subscribed_ = true;
+    if (stanza.find("<ping") != std::string::npos)
+      ++ping_count_;
+    stream_->Send("<iq type=\"result\" id=\"" + id + "\"/>");
+  }
+
+  bool StartsWith(const char* prefix) const {
+    return received_data_.compare(0, strlen(prefix), prefix) == 0;
+  }
+
+  provider::TaskRunner* task_runner_;
+  const SimulatedCloud* cloud_;
+  // Owned by the device.
+  SimulatedXmppStream* stream_{nullptr};
+  std::string received_data_;
+  bool authenticated_{false};
+  bool subscribed_{false};
+  int connection_count_{0};
+  int ping_count_{0};
+};
+
+SimulatedXmppStream::~SimulatedXmppStream() {
+  server_->OnStreamDestroyed(this);
+}
+
+void SimulatedXmppStream::Write(const void* buffer,
+                                size_t size_to_write,
+                                const WriteCallback& callback) {
+  server_->OnDataReceived(
+      std::string(static_cast<const char*>(buffer), size_to_write));
+  task_runner_->PostDelayedTask(
+      FROM_HERE, base::Bind(&SimulatedXmppStream::CompleteWrite,
+                            weak_ptr_factory_.GetWeakPtr(), callback),
+      {});
+}
+
+int64_t GetTotalMemoryUsage() {
+  int64_t total = 0;
+  auto report = GetMemoryUsageReport();
+  for (base::DictionaryValue::Iterator it(*report); !it.IsAtEnd();
+       it.Advance()) {
+    const base::DictionaryValue* area = nullptr;
+    int bytes = 0;
+    CHECK(it.value().GetAsDictionary(&area));
+    CHECK(area->GetInteger("bytes", &bytes));
+    total += bytes;
+  }
+  return total;
+}
+
+}  // namespace
+
+class SoakTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    // Routine events, e.g. every received command, are logged at INFO level.
+    logging::SetMinLogLevel(logging::LOG_WARNING);
+
+    cloud_.SetLatency(base::TimeDelta::FromMilliseconds(kMinCloudLatencyMs),
+                      base::TimeDelta::FromMilliseconds(kMaxCloudLatencyMs),
+                      &random_);
+    ASSERT_TRUE(component_manager_.LoadTraits(kTraits, nullptr));
+    for (int i = 0; i < kComponentCount; ++i) {
+      ASSERT_TRUE(component_manager_.AddComponent("", GetComponent(i),
+                                                  {"soak"}, nullptr));
+    }
+    component_manager_.AddCommandHandler(
+        "", "", base::Bind(&SoakTest::OnCommand, base::Unretained(this)));
+
+    device_.reset(new DeviceRegistrationInfo{&config_, &component_manager_,
+                                             &task_runner_, &cloud_,
+                                             &xmpp_server_, nullptr});
+    device_->Start();
+  }
+
+  void TearDown() override {
+    device_.reset();
+    logging::SetMinLogLevel(logging::LOG_INFO);
+  }
+
+  static std::string GetComponent(int index) {
+    return "node" + std::to_string(index);
+  }
+
+  base::Time Now() { return task_runner_.GetClock()->Now(); }
+
+  int RandomInt(int min, int max) {
+    return std::uniform_int_distribution<int>{min, max}(random_);
+  }
+
+  void StartLoad() {
+    ChangeState();
+    task_runner_.PostDelayedTask(
+        FROM_HERE,
+        base::Bind(&SoakTest::SendCommands, base::Unretained(this)),
+        base::TimeDelta::FromMinutes(kCommandFloodIntervalMinutes));
+  }
+
+  void ChangeState() {
+    if (stopped_)
+      return;
+    std::string component = GetComponent(RandomInt(0, kComponentCount - 1));
+    base::DictionaryValue state;
+    state.SetInteger("soak.value", RandomInt(0, 1000000));
+    if (RandomInt(0, 9) == 0) {
+      state.SetString("soak.text",
+                      std::string(RandomInt(0, kMaxStateTextSize), 'x'));
+    }
+    EXPECT_TRUE(component_manager_.SetStateProperties(component, state,
+                                                      nullptr));
+    task_runner_.PostDelayedTask(
+        FROM_HERE,
+        base::Bind(&SoakTest::ChangeState, base::Unretained(this)),
+        base::TimeDelta::FromMilliseconds(
+            RandomInt(0, 2 * kMeanStateChangeIntervalMs)));
+  }
+
+  void SendCommands() {
+    if (stopped_)
+      return;
+    for (int i = 0; i < kCommandsPerFlood; ++i) {
+      auto command = cloud_.CreateCommand(
+          GetComponent(RandomInt(0, kComponentCount - 1)), i);
+      if (++command_count_ % kFetchedCommandPeriod == 0)
+        command->Clear();
+      xmpp_server_.PushCommand(*command);
+    }
+    task_runner_.PostDelayedTask(
+        FROM_HERE,
+        base::Bind(&SoakTest::SendCommands, base::Unretained(this)),
+        base::TimeDelta::FromMinutes(kCommandFloodIntervalMinutes));
+  }
+
+  void OnCommand(const std::weak_ptr<Command>& command) {
+    task_runner_.PostDelayedTask(
+        FROM_HERE,
+        base::Bind(&SoakTest::CompleteCommand, base::Unretained(this),
+                   command),
+        base::TimeDelta::FromMilliseconds(
+            RandomInt(0, kMaxCommandDurationMs)));
+  }
+
+  void CompleteCommand(const std::weak_ptr<Command>& command) {
+    auto instance = command.lock();
+    ASSERT_TRUE(instance);
+    int amount = 0;
+    EXPECT_TRUE(instance->GetParameters().GetInteger("amount", &amount));
+    base::DictionaryValue results;
+    results.SetInteger("amount", amount);
+    EXPECT_TRUE(instance->Complete(results, nullptr));
+  }
+
+  // Runs the simulation until |end|, recording the task queue size every
+  // second and a sample of memory usage every kSamplePeriodMinutes.
+  void RunUntil(base::Time end) {
+    const base::TimeDelta period =
+        base::TimeDelta::FromMinutes(kSamplePeriodMinutes);
+    while (Now() < end) {
+      base::Time sample_time = std::min(Now() + period, end);
+      while (Now() < sample_time) {
+        task_count_ += task_runner_.RunUntil(
+            std::min(Now() + base::TimeDelta::FromSeconds(1), sample_time));
+        max_task_queue_size_ =
+            std::max(max_task_queue_size_, task_runner_.GetTaskQueueSize());
+      }
+      memory_samples_.push_back(GetTotalMemoryUsage());
+    }
+  }
+
+  // Returns the largest of |samples| taken during the hour which starts at
+  // sample |begin|.
+  static int64_t GetHourlyMax(const std::vector<int64_t>& samples,
+                              size_t begin) {
+    const size_t kSamplesPerHour = 60 / kSamplePeriodMinutes;
+    CHECK_LE(begin + kSamplesPerHour, samples.size());
+    return *std::max_element(samples.begin() + begin,
+                             samples.begin() + begin + kSamplesPerHour);
+  }
+
+  std::mt19937 random_{20160301};
+  provider::test::FakeTaskRunner task_runner_;
+  SimulatedConfigStore config_store_{std::string{kXmppHost} + ":" +
+                                     std::to_string(kXmppPort)};
+  Config config_{&config_store_, &task_runner_};
+  ComponentManagerImpl component_manager_{&task_runner_,
+                                          task_runner_.GetClock()};
+  SimulatedCloud cloud_{&task_runner_};
+  SimulatedXmppServer xmpp_server_{&task_runner_, &cloud_};
+  std::unique_ptr<DeviceRegistrationInfo> device_;
+
+  bool stopped_{false};
+  int command_count_{0};
+  size_t task_count_{0};
+  std::vector<int64_t> memory_samples_;
+  size_t max_task_queue_size_{0};
+};
+
+TEST_F(SoakTest, Run) {
+  const base::Time start = Now();
+  StartLoad();
+  RunUntil(start + base::TimeDelta::FromDays(kSimulatedDays));
+
+  // Stop the load and let the device catch up.
+  stopped_ = true;
+  RunUntil(Now() + base::TimeDelta::FromMinutes(kCommandFloodIntervalMinutes));
+
+  const Histogram& state_latency = cloud_.GetStateLatency();
+  const Histogram& command_latency = cloud_.GetCommandLatency();
+  const size_t kSamplesPerHour = 60 / kSamplePeriodMinutes;
+  // The first hour includes the startup, so growth is measured from the
+  // second one.
+  const size_t second_hour = kSamplesPerHour;
+  const size_t last_hour = (kSimulatedDays * 24 - 1) * kSamplesPerHour;
+  LOG(WARNING) << "Simulated " << (Now() - start) << " in " << task_count_
+               << " tasks, " << cloud_.GetRequestCount() << " cloud requests, "
+               << xmpp_server_.GetPingCount() << " XMPP pings\n"
+               << "State changes: " << state_latency.GetCount()
+               << ", p50 " << state_latency.GetPercentile(0.5) << " ms, p99 "
+               << state_latency.GetPercentile(0.99) << " ms\n"
+               << "Commands: " << command_latency.GetCount() << ", p50 "
+               << command_latency.GetPercentile(0.5) << " ms, p99 "
+               << command_latency.GetPercentile(0.99) << " ms\n"
+               << "Memory: " << GetHourlyMax(memory_samples_, second_hour)
+               << " bytes in the second hour, "
+               << GetHourlyMax(memory_samples_, last_hour)
+               << " bytes in the last one\n"
+               << "Task queue: " << max_task_queue_size_ << " tasks at most\n"
+               << ToJson(*GetMemoryUsageReport());
+
+  EXPECT_EQ(0, cloud_.GetUnexpectedCount());
+  EXPECT_EQ(0, cloud_.GetFailedCommandCount());
+
+  // Memory and the task queue don't grow over time.
+  EXPECT_LE(GetHourlyMax(memory_samples_, last_hour),
+            GetHourlyMax(memory_samples_, second_hour) * kMaxMemoryGrowth +
+                kMemorySlackBytes);
+  EXPECT_LE(max_task_queue_size_, kMaxTaskQueueSize);
+
+  EXPECT_LE(state_latency.GetPercentile(0.99), kMaxStateLatencyMs);
+  EXPECT_LE(command_latency.GetPercentile(0.99), kMaxCommandLatencyMs);
+  EXPECT_EQ(command_count_, command_latency.GetCount());
+
+  // All commands are done and removed, and the cloud has the latest state.
+  EXPECT_EQ(0u, cloud_.GetPendingCommandCount());
+  EXPECT_EQ(0, GetMemoryGauge("commands")->Get());
+  for (int i = 0; i < kComponentCount; ++i) {
+    const base::DictionaryValue* component =
+        component_manager_.FindComponent(GetComponent(i), nullptr);
+    ASSERT_TRUE(component);
+    const base::DictionaryValue* state = nullptr;
+    base::DictionaryValue empty;
+    if (!component->GetDictionary("state", &state))
+      state = &empty;
+    const base::DictionaryValue* cloud_state = cloud_.GetState(GetComponent(i));
+    EXPECT_TRUE(state->Equals(cloud_state ? cloud_state : &empty))
+        << GetComponent(i);
+  }
+
+  // Access tokens expired and were refreshed, and the XMPP connection
+  // survived.
+  EXPECT_GE(cloud_.GetTokenCount(), kSimulatedDays * 24);
+  EXPECT_GE(cloud_.GetUnauthorizedCount(), kSimulatedDays * 24 - 1);
+  EXPECT_TRUE(xmpp_server_.IsSubscribed());
+  EXPECT_LE(xmpp_server_.GetConnectionCount(), 2);
+}
+
+}  // namespace weave
@@ -0,0 +1,191 @@
+// Copyright 2016 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Cold start of a registered device with fake providers on virtual time.
+// Each iteration creates a device, adds components as an application would,
+// sends a Privet request and waits until the device connects to the cloud.
+// Network and cloud latencies, as well as deliberate delays, take no time, so
+// the results are the work done by the device. Phases of Device::Create() and
+// milestones are measured by StartupProfiler and printed at the end. Built as a
+// separate binary, see "make startup-benchmark". Traits are loaded from a trait
+// bundle, like a device with traits compiled at build time would.
+
+#include <map>
+#include <memory>
+#include <string>
+
+#include <base/bind.h>
+#include <base/logging.h>
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include <weave/device.h>
+#include <weave/provider/http_server.h>
+#include <weave/provider/test/fake_task_runner.h>
+#include <weave/provider/test/mock_dns_service_discovery.h>
+#include <weave/provider/test/mock_network.h>
+
+#include "src/bind_lambda.h"
+#include "src/http_constants.h"
+#include "src/metrics.h"
+#include "src/test/simulated_cloud.h"
+
+// Compiled from startup_benchmark_traits.json at build time.
+extern const uint8_t kStartupBenchmarkTraitsBundle[];
+extern const size_t kStartupBenchmarkTraitsBundleSize;
+
+namespace weave {
+
+namespace {
+
+using provider::HttpServer;
+using testing::_;
+using testing::Invoke;
+using testing::Return;
+using testing::WithArgs;
+
+const int kIterations = 200;
+const int kComponentCount = 8;
+// Enough for the delayed cloud connection and the requests after it.
+const int kCloudConnectTimeoutSeconds = 60;
+
+// Phases and milestones recorded by StartupProfiler, in order.
+const char* const kPhases[] = {
+    "init",          "config_load",      "black_list_load",
+    "auth_setup",    "device_info",      "snapshot_restore",
+    "base_traits",   "access_traits",    "cloud_start",
+    "privet_start"};
+const char* const kMilestones[] = {"first_privet_reply", "cloud_online"};
+
+void FailConnection(const provider::Network::OpenSslSocketCallback& callback) {
+  ErrorPtr error;
+  Error::AddTo(&error, FROM_HERE, "connection_refused", "Unreachable");
+  callback.Run({}, std::move(error));
+}
+
+class FakeRequest : public HttpServer::Request {
+ public:
+  FakeRequest(const std::string& path, int* status)
+      : path_{path}, status_{status} {}
+
+  std::string GetPath() const override { return path_; }
+  std::string GetFirstHeader(const std::string& name) const override {
+    return name == http::kAuthorization ? "Privet anonymous" : "";
+  }
+  std::string GetData() override { return {}; }
+  void SendReply(int status_code,
+                 const std::string& data,
+                 const std::string& mime_type) override {
+    *status_ = status_code;
+  }
+
+ private:
+  std::string path_;
+  int* status_;
+};
+
+class FakeHttpServer : public HttpServer {
+ public:
+  void AddHttpRequestHandler(const std::string& path,
+                             const RequestHandlerCallback& callback) override {
+    handlers_[path] = callback;
+  }
+  void AddHttpsRequestHandler(
+      const std::string& path,
+      const RequestHandlerCallback& callback) override {}
+  uint16_t GetHttpPort() const override { return 80; }
+  uint16_t GetHttpsPort() const override { return 443; }
+  std::vector<uint8_t> GetHttpsCertificateFingerprint() const override {
+    return {1, 2, 3};
+  }
+  base::TimeDelta GetRequestTimeout() const override {
+    return base::TimeDelta::FromSeconds(30);
+  }
+
+  // Sets |status| to the HTTP status of the reply once it is sent.
+  void HandleRequest(const std::string& path, int* status) {
+    auto it = handlers_.find(path);
+    ASSERT_NE(handlers_.end(), it);
+    it->second.Run(
+        std::unique_ptr<HttpServer::Request>{new FakeRequest{path, status}});
+  }
+
+ private:
+  std::map<std::string, RequestHandlerCallback> handlers_;
+};
+
+void PrintHistogram(const std::string& name) {
+  const Histogram* histogram =
+      MetricsRegistry::GetInstance()->GetHistogram("startup." + name + "_us");
+  int64_t count = histogram->GetCount();
+  LOG(WARNING) << name << ": mean " << (count ? histogram->GetSum() / count : 0)
+               << " us, p50 " << histogram->GetPercentile(0.5) << " us, p90 "
+               << histogram->GetPercentile(0.9) << " us";
+}
+
+}  // namespace
+
+TEST(StartupBenchmark, Run) {
+  for (int i = 0; i < kIterations; ++i) {
+    provider::test::FakeTaskRunner task_runner;
+    test::SimulatedConfigStore config_store;
+    test::SimulatedCloud cloud{&task_runner};
+    // Online, but the XMPP server can't be reached, so the device polls.
+    testing::NiceMock<provider::test::MockNetwork> network;
+    ON_CALL(network, GetConnectionState())
+        .WillByDefault(Return(provider::Network::State::kOnline));
+    ON_CALL(network, OpenSslSocket(_, _, _))
+        .WillByDefault(WithArgs<2>(Invoke(
+            [&task_runner](
+                const provider::Network::OpenSslSocketCallback& callback) {
+              task_runner.PostDelayedTask(
+                  FROM_HERE, base::Bind(&FailConnection, callback), {});
+            })));
+    testing::NiceMock<provider::test::MockDnsServiceDiscovery> dns_sd;
+    FakeHttpServer http_server;
+
+    std::unique_ptr<Device> device =
+        Device::Create(&config_store, &task_runner, &cloud, &network, &dns_sd,
+                       &http_server, nullptr, nullptr);
+    bool online = false;
+    device->AddGcdStateChangedCallback(base::Bind([&online](GcdState state) {
+      online = online || state == GcdState::kConnected;
+    }));
+
+    device->AddTraitDefinitionsFromBundle(kStartupBenchmarkTraitsBundle,
+                                          kStartupBenchmarkTraitsBundleSize);
+    for (int j = 0; j < kComponentCount; ++j) {
+      std::string component = "light" + std::to_string(j);
+      ASSERT_TRUE(
+          device->AddComponent(component, {"onOff", "brightness"}, nullptr));
+      ASSERT_TRUE(device->SetStatePropertiesFromJson(
+          component, R"({"onOff": {"state": "off"},
+                         "brightness": {"brightness": 0}})",
+          nullptr));
+    }
+
+    int status = 0;
+    http_server.HandleRequest("/privet/info", &status);
+    while (!status && task_runner.RunOnce()) {
+    }
+    EXPECT_EQ(http::kOk, status);
+
+    base::Time deadline = task_runner.GetClock()->Now() +
+                          base::TimeDelta::FromSeconds(
+                              kCloudConnectTimeoutSeconds);
+    while (!online && task_runner.GetClock()->Now() < deadline &&
+           task_runner.RunOnce()) {
+    }
+    EXPECT_TRUE(online);
+    EXPECT_EQ(0, cloud.GetUnexpectedCount());
+  }
+
+  LOG(WARNING) << kIterations << " starts with " << kComponentCount
+               << " components";
+  for (const char* phase : kPhases)
+    PrintHistogram(phase);
+  for (const char* milestone : kMilestones)
+    PrintHistogram(milestone);
+}
+
+}  // namespace weave
@@ -0,0 +1,56 @@
+// Copyright 2016 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "src/startup_profiler.h"
+
+#include "src/metrics.h"
+#include "src/trace_log.h"
+
+namespace weave {
+
+namespace {
+
+const char kTraceCategory[] = "startup";
+
+Histogram* GetHistogram(const std::string& name) {
+  return MetricsRegistry::GetInstance()->GetHistogram("startup." + name +
+                                                      "_us");
+}
+
+}  // namespace
+
+StartupProfiler::StartupProfiler()
+    : start_{base::TimeTicks::Now()}, phase_start_{start_} {}
+
+void StartupProfiler::EndPhase(const std::string& phase) {
+  base::TimeTicks now = base::TimeTicks::Now();
+  base::TimeDelta duration = now - phase_start_;
+  GetHistogram(phase)->Add(duration.InMicroseconds());
+  TraceLog::GetInstance()->AddCompleteEvent(kTraceCategory, phase,
+                                            phase_start_, duration, nullptr);
+  phase_start_ = now;
+}
+
+void StartupProfiler::OnPrivetReplySent() {
+  if (privet_replied_)
+    return;
+  privet_replied_ = true;
+  RecordMilestone("first_privet_reply");
+}
+
+void StartupProfiler::OnCloudConnected() {
+  if (cloud_connected_)
+    return;
+  cloud_connected_ = true;
+  RecordMilestone("cloud_online");
+}
+
+void StartupProfiler::RecordMilestone(const std::string& milestone) {
+  base::TimeDelta elapsed = base::TimeTicks::Now() - start_;
+  GetHistogram(milestone)->Add(elapsed.InMicroseconds());
+  TraceLog::GetInstance()->AddCompleteEvent(kTraceCategory, milestone, start_,
+                                            elapsed, nullptr);
+}
+
+}  // namespace weave
@@ -0,0 +1,44 @@
+// Copyright 2016 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIBWEAVE_SRC_STARTUP_PROFILER_H_
+#define LIBWEAVE_SRC_STARTUP_PROFILER_H_
+
+#include <string>
+
+#include <base/macros.h>
+#include <base/time/time.h>
+
+namespace weave {
+
+// Measures how long a device takes to start. Device::Create() is split into
+// consecutive phases, each recorded in the histogram "startup.<phase>_us".
+// Milestones after it, the first Privet reply and the first successful cloud
+// request, are recorded once, as the time since the profiler was created, in
+// "startup.<milestone>_us". Phases and milestones are also traced.
+class StartupProfiler final {
+ public:
+  StartupProfiler();
+
+  // Ends the phase which started when the previous phase ended, or when the
+  // profiler was created.
+  void EndPhase(const std::string& phase);
+
+  void OnPrivetReplySent();
+  void OnCloudConnected();
+
+ private:
+  void RecordMilestone(const std::string& milestone);
+
+  base::TimeTicks start_;
+  base::TimeTicks phase_start_;
+  bool privet_replied_{false};
+  bool cloud_connected_{false};
+
+  DISALLOW_COPY_AND_ASSIGN(StartupProfiler);
+};
+
+}  // namespace weave
+
+#endif  // LIBWEAVE_SRC_STARTUP_PROFILER_H_
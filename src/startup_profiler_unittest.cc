@@ -0,0 +1,45 @@
+// Copyright 2016 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "src/startup_profiler.h"
+
+#include <gtest/gtest.h>
+
+#include "src/metrics.h"
+
+namespace weave {
+
+namespace {
+
+int64_t GetCount(const std::string& name) {
+  return MetricsRegistry::GetInstance()->GetHistogram(name)->GetCount();
+}
+
+}  // namespace
+
+TEST(StartupProfilerTest, Phases) {
+  int64_t first = GetCount("startup.test_first_us");
+  int64_t second = GetCount("startup.test_second_us");
+
+  StartupProfiler profiler;
+  profiler.EndPhase("test_first");
+  profiler.EndPhase("test_second");
+  EXPECT_EQ(first + 1, GetCount("startup.test_first_us"));
+  EXPECT_EQ(second + 1, GetCount("startup.test_second_us"));
+}
+
+TEST(StartupProfilerTest, MilestonesAreRecordedOnce) {
+  int64_t privet = GetCount("startup.first_privet_reply_us");
+  int64_t cloud = GetCount("startup.cloud_online_us");
+
+  StartupProfiler profiler;
+  profiler.OnPrivetReplySent();
+  profiler.OnPrivetReplySent();
+  profiler.OnCloudConnected();
+  profiler.OnCloudConnected();
+  EXPECT_EQ(privet + 1, GetCount("startup.first_privet_reply_us"));
+  EXPECT_EQ(cloud + 1, GetCount("startup.cloud_online_us"));
+}
+
+}  // namespace weave
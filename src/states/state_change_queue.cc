@@ -6,22 +6,58 @@
 
 #include <base/logging.h>
 
+#include "src/memory_usage.h"
+#include "src/metrics.h"
+
 namespace weave {
 
+namespace {
+
+struct Metrics {
+  Counter* recorded{
+      MetricsRegistry::GetInstance()->GetCounter("state.changes_recorded")};
+  Counter* merged{
+      MetricsRegistry::GetInstance()->GetCounter("state.changes_merged")};
+  Gauge* pending{
+      MetricsRegistry::GetInstance()->GetGauge("state.changes_pending")};
+  Histogram* batch_size{
+      MetricsRegistry::GetInstance()->GetHistogram("state.changes_per_batch")};
+  Gauge* memory{GetMemoryGauge("state_changes")};
+};
+
+const Metrics& GetMetrics() {
+  static const Metrics metrics;
+  return metrics;
+}
+
+}  // namespace
+
 StateChangeQueue::StateChangeQueue(size_t max_queue_size)
-    : max_queue_size_(max_queue_size) {
+    : max_queue_size_(max_queue_size), memory_usage_{GetMetrics().memory} {
   CHECK_GT(max_queue_size_, 0U) << "Max queue size must not be zero";
 }
 
+StateChangeQueue::~StateChangeQueue() {
+  GetMetrics().pending->Add(-static_cast<int64_t>(state_changes_.size()));
+}
+
 bool StateChangeQueue::NotifyPropertiesUpdated(
     base::Time timestamp,
     const base::DictionaryValue& changed_properties) {
+  const Metrics& metrics = GetMetrics();
+  metrics.recorded->Increment();
+  // Only the records which change are measured.
+  size_t memory_usage = memory_usage_.Get();
   auto& stored_changes = state_changes_[timestamp];
   // Merge the old property set.
-  if (stored_changes)
+  if (stored_changes) {
+    memory_usage -= EstimateMemoryUsage(*stored_changes);
     stored_changes->MergeDictionary(&changed_properties);
-  else
+  } else {
     stored_changes.reset(changed_properties.DeepCopy());
+    metrics.pending->Add(1);
+  }
+  memory_usage += EstimateMemoryUsage(*stored_changes);
 
   while (state_changes_.size() > max_queue_size_) {
     // Queue is full.
@@ -32,21 +68,33 @@ bool StateChangeQueue::NotifyPropertiesUpdated(
     //  - Keep the timestamp of [new].
     auto element_old = state_changes_.begin();
     auto element_new = std::next(element_old);
+    memory_usage -= EstimateMemoryUsage(*element_old->second) +
+                    EstimateMemoryUsage(*element_new->second);
     // This will skip elements that exist in both [old] and [new].
     element_old->second->MergeDictionary(element_new->second.get());
     std::swap(element_old->second, element_new->second);
     state_changes_.erase(element_old);
+    memory_usage += EstimateMemoryUsage(*element_new->second);
+    metrics.merged->Increment();
+    metrics.pending->Add(-1);
   }
+  memory_usage_.Set(memory_usage);
   return true;
 }
 
 std::vector<StateChange> StateChangeQueue::GetAndClearRecordedStateChanges() {
+  if (!state_changes_.empty()) {
+    const Metrics& metrics = GetMetrics();
+    metrics.batch_size->Add(state_changes_.size());
+    metrics.pending->Add(-static_cast<int64_t>(state_changes_.size()));
+  }
   std::vector<StateChange> changes;
   changes.reserve(state_changes_.size());
   for (auto& pair : state_changes_) {
     changes.push_back(StateChange{pair.first, std::move(pair.second)});
   }
   state_changes_.clear();
+  memory_usage_.Set(0);
   return changes;
 }
 
@@ -13,6 +13,8 @@
 #include <base/time/time.h>
 #include <base/values.h>
 
+#include "src/memory_usage.h"
+
 namespace weave {
 
 // A simple notification record event to track device state changes.
@@ -31,6 +33,7 @@ struct StateChange {
 class StateChangeQueue {
  public:
   explicit StateChangeQueue(size_t max_queue_size);
+  ~StateChangeQueue();
 
   bool NotifyPropertiesUpdated(base::Time timestamp,
                                const base::DictionaryValue& changed_properties);
@@ -44,6 +47,9 @@ class StateChangeQueue {
   // Accumulated list of device state change notifications.
   std::map<base::Time, std::unique_ptr<base::DictionaryValue>> state_changes_;
 
+  // Approximate memory held by |state_changes_|.
+  TrackedMemory memory_usage_;
+
   DISALLOW_COPY_AND_ASSIGN(StateChangeQueue);
 };
 
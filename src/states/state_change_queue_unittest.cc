@@ -8,6 +8,8 @@
 #include <weave/test/unittest_utils.h>
 
 #include "src/bind_lambda.h"
+#include "src/memory_usage.h"
+#include "src/test/allocation_counter.h"
 
 namespace weave {
 
@@ -37,6 +39,18 @@ TEST_F(StateChangeQueueTest, UpdateOne) {
   EXPECT_TRUE(queue_->GetAndClearRecordedStateChanges().empty());
 }
 
+TEST_F(StateChangeQueueTest, UpdateAllocations) {
+  auto timestamp = base::Time::Now();
+  ASSERT_TRUE(queue_->NotifyPropertiesUpdated(
+      timestamp, *CreateDictionaryValue("{'prop': {'name': 1}}")));
+  auto changes = CreateDictionaryValue("{'prop': {'name': 2}}");
+  EXPECT_ALLOCATION_BUDGET(
+      2, EXPECT_TRUE(queue_->NotifyPropertiesUpdated(timestamp, *changes)));
+  EXPECT_ALLOCATION_BUDGET(
+      6, EXPECT_TRUE(queue_->NotifyPropertiesUpdated(
+             timestamp + base::TimeDelta::FromSeconds(1), *changes)));
+}
+
 TEST_F(StateChangeQueueTest, UpdateMany) {
   auto timestamp1 = base::Time::Now();
   const std::string state1 = "{'prop': {'name1': 23}}";
@@ -116,4 +130,24 @@ TEST_F(StateChangeQueueTest, MaxQueueSize) {
   EXPECT_JSON_EQ(expected2, *changes[1].changed_properties);
 }
 
+TEST_F(StateChangeQueueTest, MemoryUsage) {
+  queue_.reset(new StateChangeQueue(2));
+  Gauge* gauge = GetMemoryGauge("state_changes");
+  int64_t initial_usage = gauge->Get();
+  base::Time start_time = base::Time::Now();
+  for (int i = 0; i < 5; i++) {
+    ASSERT_TRUE(queue_->NotifyPropertiesUpdated(
+        start_time + base::TimeDelta::FromMinutes(i / 2),
+        *CreateDictionaryValue("{'prop': {'name" + std::to_string(i) +
+                               "': 'some string value'}}")));
+  }
+  int64_t usage = gauge->Get() - initial_usage;
+
+  size_t expected_usage = 0;
+  for (const auto& change : queue_->GetAndClearRecordedStateChanges())
+    expected_usage += EstimateMemoryUsage(*change.changed_properties);
+  EXPECT_EQ(static_cast<int64_t>(expected_usage), usage);
+  EXPECT_EQ(initial_usage, gauge->Get());
+}
+
 }  // namespace weave
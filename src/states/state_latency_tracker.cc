@@ -0,0 +1,80 @@
+// Copyright 2016 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "src/states/state_latency_tracker.h"
+
+#include <algorithm>
+#include <string>
+
+#include "src/metrics.h"
+
+namespace weave {
+
+namespace {
+
+// Changes beyond this limit are merged into the newest entry, so while the
+// device is offline latencies of the newest changes are overestimated rather
+// than memory growing.
+const size_t kMaxPendingChanges = 64;
+
+}  // namespace
+
+StateLatencyTracker::StateLatencyTracker() {
+  MetricsRegistry* registry = MetricsRegistry::GetInstance();
+  send_time_ = registry->GetHistogram("state.send_ms");
+  upload_time_ = registry->GetHistogram("state.upload_ms");
+  ack_time_ = registry->GetHistogram("state.ack_ms");
+  worst_ = registry->GetWorstSamples("state.worst_ack_ms");
+}
+
+void StateLatencyTracker::OnStateChanged(UpdateID id) {
+  if (changes_.size() < kMaxPendingChanges) {
+    changes_.push_back(Change{id, base::TimeTicks::Now(), {}});
+    return;
+  }
+  changes_.back().id = id;
+}
+
+void StateLatencyTracker::OnUpdateSent(UpdateID id) {
+  base::TimeTicks now = base::TimeTicks::Now();
+  bool first = true;
+  for (auto& change : changes_) {
+    if (change.id > id)
+      break;
+    if (change.id <= last_sent_id_)
+      continue;
+    if (first)
+      send_time_->AddTime(now - change.changed);
+    first = false;
+    change.sent = now;
+  }
+  last_sent_id_ = std::max(last_sent_id_, id);
+}
+
+void StateLatencyTracker::OnUpdateAcknowledged(UpdateID id) {
+  if (id <= last_acknowledged_id_)
+    return;
+  last_acknowledged_id_ = id;
+  if (changes_.empty() || changes_.front().id > id)
+    return;
+
+  const Change& oldest = changes_.front();
+  base::TimeTicks now = base::TimeTicks::Now();
+  base::TimeDelta ack_time = now - oldest.changed;
+  ack_time_->AddTime(ack_time);
+  std::string details = "update=" + std::to_string(oldest.id);
+  if (!oldest.sent.is_null()) {
+    base::TimeDelta upload_time = now - oldest.sent;
+    upload_time_->AddTime(upload_time);
+    details += ",send_ms=" +
+               std::to_string((oldest.sent - oldest.changed).InMilliseconds()) +
+               ",upload_ms=" + std::to_string(upload_time.InMilliseconds());
+  }
+  worst_->Add(ack_time.InMilliseconds(), details);
+
+  while (!changes_.empty() && changes_.front().id <= id)
+    changes_.pop_front();
+}
+
+}  // namespace weave
@@ -0,0 +1,61 @@
+// Copyright 2016 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIBWEAVE_SRC_STATES_STATE_LATENCY_TRACKER_H_
+#define LIBWEAVE_SRC_STATES_STATE_LATENCY_TRACKER_H_
+
+#include <cstdint>
+#include <deque>
+
+#include <base/macros.h>
+#include <base/time/time.h>
+
+namespace weave {
+
+class Histogram;
+class WorstSamples;
+
+// Measures how long state changes take to be sent to the cloud in a patchState
+// request, and to be acknowledged by the cloud. Changes are identified by the update ID of the
+// component manager; a sent or acknowledged ID covers all earlier changes.
+// For each batch only the oldest change is measured, as it waited longest.
+class StateLatencyTracker final {
+ public:
+  using UpdateID = uint64_t;
+
+  StateLatencyTracker();
+
+  // Called when the change |id| is applied.
+  void OnStateChanged(UpdateID id);
+  // Called when changes up to |id| are taken for a patchState request.
+  void OnUpdateSent(UpdateID id);
+  // Called when the cloud acknowledged changes up to |id|.
+  void OnUpdateAcknowledged(UpdateID id);
+
+  // Changes which aren't acknowledged yet.
+  size_t GetPendingCount() const { return changes_.size(); }
+
+ private:
+  // Range of changes which happened after the previous entry, up to |id|.
+  struct Change {
+    UpdateID id;
+    base::TimeTicks changed;
+    base::TimeTicks sent;
+  };
+
+  Histogram* send_time_{nullptr};
+  Histogram* upload_time_{nullptr};
+  Histogram* ack_time_{nullptr};
+  WorstSamples* worst_{nullptr};
+
+  std::deque<Change> changes_;
+  UpdateID last_sent_id_{0};
+  UpdateID last_acknowledged_id_{0};
+
+  DISALLOW_COPY_AND_ASSIGN(StateLatencyTracker);
+};
+
+}  // namespace weave
+
+#endif  // LIBWEAVE_SRC_STATES_STATE_LATENCY_TRACKER_H_
@@ -0,0 +1,70 @@
+// Copyright 2016 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "src/states/state_latency_tracker.h"
+
+#include <gtest/gtest.h>
+
+#include "src/metrics.h"
+
+namespace weave {
+
+class StateLatencyTrackerTest : public ::testing::Test {
+ protected:
+  // Metrics are process-wide, so tests check how many samples are added.
+  int64_t GetCount(const std::string& name) {
+    return MetricsRegistry::GetInstance()->GetHistogram(name)->GetCount();
+  }
+
+  StateLatencyTracker tracker_;
+};
+
+TEST_F(StateLatencyTrackerTest, Stages) {
+  int64_t send = GetCount("state.send_ms");
+  int64_t upload = GetCount("state.upload_ms");
+  int64_t ack = GetCount("state.ack_ms");
+
+  tracker_.OnStateChanged(1);
+  tracker_.OnStateChanged(2);
+
+  // One sample per batch.
+  tracker_.OnUpdateSent(2);
+  EXPECT_EQ(send + 1, GetCount("state.send_ms"));
+  tracker_.OnStateChanged(3);
+  tracker_.OnUpdateAcknowledged(2);
+  EXPECT_EQ(upload + 1, GetCount("state.upload_ms"));
+  EXPECT_EQ(ack + 1, GetCount("state.ack_ms"));
+  EXPECT_EQ(1u, tracker_.GetPendingCount());
+
+  // Acknowledged without being sent, e.g. if there were no changes to send.
+  tracker_.OnUpdateAcknowledged(3);
+  EXPECT_EQ(upload + 1, GetCount("state.upload_ms"));
+  EXPECT_EQ(ack + 2, GetCount("state.ack_ms"));
+  EXPECT_EQ(0u, tracker_.GetPendingCount());
+
+  // Old IDs are ignored.
+  tracker_.OnUpdateAcknowledged(3);
+  EXPECT_EQ(ack + 2, GetCount("state.ack_ms"));
+}
+
+TEST_F(StateLatencyTrackerTest, WorstSamples) {
+  tracker_.OnStateChanged(1);
+  tracker_.OnUpdateSent(1);
+  tracker_.OnUpdateAcknowledged(1);
+  auto worst = MetricsRegistry::GetInstance()
+                   ->GetWorstSamples("state.worst_ack_ms")
+                   ->GetWorst();
+  ASSERT_FALSE(worst.empty());
+  EXPECT_NE(std::string::npos, worst.front().second.find("send_ms="));
+}
+
+TEST_F(StateLatencyTrackerTest, PendingLimit) {
+  for (StateLatencyTracker::UpdateID id = 1; id <= 1000; ++id)
+    tracker_.OnStateChanged(id);
+  EXPECT_EQ(64u, tracker_.GetPendingCount());
+  tracker_.OnUpdateAcknowledged(1000);
+  EXPECT_EQ(0u, tracker_.GetPendingCount());
+}
+
+}  // namespace weave
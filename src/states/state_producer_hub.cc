@@ -0,0 +1,161 @@
+// Copyright 2016 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "src/states/state_producer_hub.h"
+
+#include <base/bind.h>
+#include <base/logging.h>
+
+#include "src/component_manager.h"
+
+namespace weave {
+
+class StateProducerHub::Producer : public StateProducer {
+ public:
+  explicit Producer(const std::shared_ptr<Channel>& channel)
+      : channel_{channel} {}
+
+  ~Producer() override {
+    channel_->closed.store(true, std::memory_order_release);
+  }
+
+  void SetStateProperty(const std::string& component,
+                        const std::string& name,
+                        const base::Value& value) override {
+    // Take the batch back unless the hub already took it. Only this thread
+    // stores into |pending|, so nothing can appear there until store below.
+    std::unique_ptr<Batch> batch{
+        channel_->pending.exchange(nullptr, std::memory_order_acq_rel)};
+    if (!batch)
+      batch.reset(channel_->spare.exchange(nullptr, std::memory_order_acq_rel));
+    if (!batch)
+      batch.reset(new Batch);
+
+    auto& properties = batch->components[component];
+    if (!properties)
+      properties.reset(new base::DictionaryValue);
+    if (properties->Get(name, nullptr))
+      ++batch->coalesced_update_count;
+    properties->Set(name, value.DeepCopy());
+
+    channel_->pending.store(batch.release(), std::memory_order_release);
+    // Requested after every store, as the hub may have finished a drain
+    // between the exchange above and the store. A drain which is requested
+    // already costs a single exchange.
+    channel_->wake_up->Request();
+  }
+
+ private:
+  std::shared_ptr<Channel> channel_;
+
+  DISALLOW_COPY_AND_ASSIGN(Producer);
+};
+
+bool StateProducerHub::WakeUp::Request() {
+  if (requested.exchange(true, std::memory_order_acq_rel))
+    return true;
+  std::lock_guard<std::mutex> lock{mutex};
+  if (task_runner && task_runner->PostTaskFromAnyThread(FROM_HERE, drain))
+    return true;
+  requested.store(false, std::memory_order_release);
+  return false;
+}
+
+StateProducerHub::Channel::Channel(const std::shared_ptr<WakeUp>& wake_up)
+    : wake_up{wake_up} {}
+
+StateProducerHub::Channel::~Channel() {
+  delete pending.load();
+  delete spare.load();
+}
+
+StateProducerHub::StateProducerHub(ComponentManager* component_manager,
+                                   provider::TaskRunner* task_runner,
+                                   base::TimeDelta drain_interval)
+    : component_manager_{component_manager},
+      task_runner_{task_runner},
+      drain_interval_{drain_interval} {
+  wake_up_->task_runner = task_runner_;
+  wake_up_->drain =
+      base::Bind(&StateProducerHub::OnWakeUp, weak_ptr_factory_.GetWeakPtr());
+}
+
+StateProducerHub::~StateProducerHub() {
+  std::lock_guard<std::mutex> lock{wake_up_->mutex};
+  wake_up_->task_runner = nullptr;
+  wake_up_->drain.Reset();
+}
+
+std::unique_ptr<StateProducer> StateProducerHub::CreateProducer() {
+  std::shared_ptr<Channel> channel{new Channel{wake_up_}};
+  channels_.push_back(channel);
+  // Falls back to polling if the task runner can't be woken up.
+  if (!wake_up_->Request())
+    ScheduleDrain();
+  return std::unique_ptr<StateProducer>{new Producer{channel}};
+}
+
+void StateProducerHub::ScheduleDrain() {
+  if (drain_scheduled_ || channels_.empty())
+    return;
+  drain_scheduled_ = true;
+  task_runner_->PostDelayedTask(
+      FROM_HERE, base::Bind(&StateProducerHub::OnDrainTimer,
+                            weak_ptr_factory_.GetWeakPtr()),
+      drain_interval_);
+}
+
+void StateProducerHub::OnDrainTimer() {
+  drain_scheduled_ = false;
+  Drain();
+  ScheduleDrain();
+}
+
+void StateProducerHub::OnWakeUp() {
+  // Reset before draining, so updates after the drain request a new wake up.
+  // Acquires updates of producers which found the request already set.
+  wake_up_->requested.exchange(false, std::memory_order_acq_rel);
+  Drain();
+}
+
+void StateProducerHub::Drain() {
+  for (auto it = channels_.begin(); it != channels_.end();) {
+    // Check before taking the batch, so the last batch of a closed producer
+    // is never missed.
+    bool closed = (*it)->closed.load(std::memory_order_acquire);
+    Batch* batch = (*it)->pending.exchange(nullptr, std::memory_order_acq_rel);
+    if (batch) {
+      ApplyBatch(batch);
+      // Keep one empty batch for the producer and drop the other.
+      Batch* expected = nullptr;
+      if (closed || !(*it)->spare.compare_exchange_strong(
+                        expected, batch, std::memory_order_acq_rel)) {
+        delete batch;
+      }
+    }
+    if (closed) {
+      it = channels_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+void StateProducerHub::ApplyBatch(Batch* batch) {
+  coalesced_update_count_ += batch->coalesced_update_count;
+  batch->coalesced_update_count = 0;
+  for (const auto& pair : batch->components) {
+    if (pair.second->empty())
+      continue;
+    ErrorPtr error;
+    if (!component_manager_->SetStateProperties(pair.first, *pair.second,
+                                                &error)) {
+      LOG(ERROR) << "Failed to apply state of " << pair.first << ": "
+                 << error->GetMessage();
+    }
+    pair.second->Clear();
+  }
+}
+
+}  // namespace weave
@@ -0,0 +1,109 @@
+// Copyright 2016 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIBWEAVE_SRC_STATES_STATE_PRODUCER_HUB_H_
+#define LIBWEAVE_SRC_STATES_STATE_PRODUCER_HUB_H_
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <base/macros.h>
+#include <base/memory/weak_ptr.h>
+#include <base/time/time.h>
+#include <base/values.h>
+#include <weave/device.h>
+#include <weave/provider/task_runner.h>
+
+namespace weave {
+
+class ComponentManager;
+
+// Collects state updates of StateProducers running on other threads and
+// applies them to ComponentManager on the libweave thread.
+// Every producer owns a single pending batch, exchanged through an atomic
+// pointer, so producers never block and never wait for each other. Repeated
+// updates of the same property are merged in the batch. Drained batches are
+// cleared and handed back to the producer, so steady updates of the same
+// properties don't allocate batches, maps or dictionaries.
+// Updates wake up the libweave thread with
+// provider::TaskRunner::PostTaskFromAnyThread, unless a drain is requested
+// already. If the task runner doesn't
+// support that, batches are drained every |drain_interval| while there are
+// live producers.
+class StateProducerHub final {
+ public:
+  StateProducerHub(ComponentManager* component_manager,
+                   provider::TaskRunner* task_runner,
+                   base::TimeDelta drain_interval =
+                       base::TimeDelta::FromMilliseconds(100));
+  ~StateProducerHub();
+
+  std::unique_ptr<StateProducer> CreateProducer();
+
+  // Applies all pending updates now.
+  void Drain();
+
+  // Number of updates which were replaced by later updates of the same
+  // property before they reached ComponentManager.
+  size_t GetCoalescedUpdateCount() const { return coalesced_update_count_; }
+
+ private:
+  class Producer;
+
+  struct Batch {
+    // Properties by component. Dictionaries are kept empty after a drain to
+    // be reused.
+    std::map<std::string, std::unique_ptr<base::DictionaryValue>> components;
+    size_t coalesced_update_count{0};
+  };
+
+  // Wakes up the hub from producer threads. Outlives the hub if producers do.
+  struct WakeUp {
+    // Returns true if a drain is posted or already pending.
+    bool Request();
+
+    std::atomic<bool> requested{false};
+    // Guards |task_runner| and |drain|, which are reset when the hub goes.
+    std::mutex mutex;
+    provider::TaskRunner* task_runner{nullptr};
+    base::Closure drain;
+  };
+
+  // State shared between a producer and the hub.
+  struct Channel {
+    explicit Channel(const std::shared_ptr<WakeUp>& wake_up);
+    ~Channel();
+
+    std::atomic<Batch*> pending{nullptr};
+    // Empty batch returned by the hub for reuse.
+    std::atomic<Batch*> spare{nullptr};
+    std::atomic<bool> closed{false};
+    const std::shared_ptr<WakeUp> wake_up;
+  };
+
+  void ScheduleDrain();
+  void OnDrainTimer();
+  void OnWakeUp();
+  // Applies |batch| and returns it cleared.
+  void ApplyBatch(Batch* batch);
+
+  ComponentManager* component_manager_{nullptr};
+  provider::TaskRunner* task_runner_{nullptr};
+  const base::TimeDelta drain_interval_;
+  std::vector<std::shared_ptr<Channel>> channels_;
+  std::shared_ptr<WakeUp> wake_up_{new WakeUp};
+  bool drain_scheduled_{false};
+  size_t coalesced_update_count_{0};
+
+  base::WeakPtrFactory<StateProducerHub> weak_ptr_factory_{this};
+  DISALLOW_COPY_AND_ASSIGN(StateProducerHub);
+};
+
+}  // namespace weave
+
+#endif  // LIBWEAVE_SRC_STATES_STATE_PRODUCER_HUB_H_
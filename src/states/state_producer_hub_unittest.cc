@@ -0,0 +1,219 @@
+// Copyright 2016 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "src/states/state_producer_hub.h"
+
+#include <atomic>
+#include <thread>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include <weave/provider/test/fake_task_runner.h>
+#include <weave/test/unittest_utils.h>
+
+#include "src/mock_component_manager.h"
+#include "src/test/allocation_counter.h"
+
+namespace weave {
+
+using testing::_;
+using testing::Invoke;
+using testing::Return;
+using testing::StrictMock;
+
+namespace {
+
+// Task runner which can't be woken up from other threads.
+class PollingTaskRunner : public provider::test::FakeTaskRunner {
+ public:
+  bool PostTaskFromAnyThread(const tracked_objects::Location& from_here,
+                             const base::Closure& task) override {
+    return false;
+  }
+};
+
+}  // namespace
+
+class StateProducerHubTest : public ::testing::Test {
+ protected:
+  void ExpectState(const std::string& component, const std::string& json) {
+    EXPECT_CALL(component_manager_, SetStateProperties(component, _, _))
+        .WillOnce(Invoke([json](const std::string& component,
+                                const base::DictionaryValue& dict,
+                                ErrorPtr* error) {
+          EXPECT_JSON_EQ(json, dict);
+          return true;
+        }));
+  }
+
+  StrictMock<MockComponentManager> component_manager_;
+  provider::test::FakeTaskRunner task_runner_;
+  StateProducerHub hub_{&component_manager_, &task_runner_};
+};
+
+TEST_F(StateProducerHubTest, Coalesce) {
+  auto producer = hub_.CreateProducer();
+  producer->SetStateProperty("comp", "t.a", base::FundamentalValue{1});
+  producer->SetStateProperty("comp", "t.b", base::FundamentalValue{2});
+  producer->SetStateProperty("comp", "t.a", base::FundamentalValue{3});
+  producer->SetStateProperty("comp", "t.a", base::FundamentalValue{4});
+  producer->SetStateProperty("other", "t.a", base::FundamentalValue{5});
+
+  ExpectState("comp", "{'t': {'a': 4, 'b': 2}}");
+  ExpectState("other", "{'t': {'a': 5}}");
+  EXPECT_TRUE(task_runner_.RunOnce());
+  EXPECT_EQ(2u, hub_.GetCoalescedUpdateCount());
+
+  // Nothing pending, so nothing is scheduled.
+  EXPECT_FALSE(task_runner_.RunOnce());
+
+  // A single drain is posted for updates until it runs.
+  producer->SetStateProperty("comp", "t.b", base::FundamentalValue{6});
+  producer->SetStateProperty("comp", "t.c", base::FundamentalValue{7});
+  ExpectState("comp", "{'t': {'b': 6, 'c': 7}}");
+  EXPECT_TRUE(task_runner_.RunOnce());
+  EXPECT_FALSE(task_runner_.RunOnce());
+}
+
+TEST_F(StateProducerHubTest, PollWithoutWakeUp) {
+  PollingTaskRunner task_runner;
+  StateProducerHub hub{&component_manager_, &task_runner};
+  auto producer = hub.CreateProducer();
+  producer->SetStateProperty("comp", "t.a", base::FundamentalValue{1});
+  ExpectState("comp", "{'t': {'a': 1}}");
+  EXPECT_TRUE(task_runner.RunOnce());
+
+  // Nothing pending, the timer just keeps going.
+  EXPECT_TRUE(task_runner.RunOnce());
+
+  producer->SetStateProperty("comp", "t.b", base::FundamentalValue{2});
+  ExpectState("comp", "{'t': {'b': 2}}");
+  EXPECT_TRUE(task_runner.RunOnce());
+
+  // No more producers, so no more timers.
+  producer.reset();
+  EXPECT_TRUE(task_runner.RunOnce());
+  EXPECT_FALSE(task_runner.RunOnce());
+}
+
+TEST_F(StateProducerHubTest, ReuseBatches) {
+  auto producer = hub_.CreateProducer();
+  EXPECT_CALL(component_manager_, SetStateProperties("comp", _, _))
+      .WillRepeatedly(Return(true));
+  base::FundamentalValue value{1};
+
+  test::AllocationCounter first_counter;
+  producer->SetStateProperty("comp", "t.a", value);
+  size_t first_allocations = first_counter.GetCount();
+  hub_.Drain();
+
+  // The batch and the dictionary of the component are reused, only the value
+  // and the entries for it are allocated.
+  for (int i = 0; i < 3; ++i) {
+    test::AllocationCounter counter;
+    producer->SetStateProperty("comp", "t.a", value);
+    EXPECT_LT(counter.GetCount(), first_allocations);
+    hub_.Drain();
+  }
+}
+
+TEST_F(StateProducerHubTest, DestroyedProducer) {
+  auto producer = hub_.CreateProducer();
+  producer->SetStateProperty("comp", "t.a", base::FundamentalValue{1});
+  producer.reset();
+
+  // Last updates are still applied.
+  ExpectState("comp", "{'t': {'a': 1}}");
+  EXPECT_TRUE(task_runner_.RunOnce());
+
+  // No more producers, so no more timers.
+  EXPECT_FALSE(task_runner_.RunOnce());
+}
+
+TEST_F(StateProducerHubTest, ManyThreads) {
+  const int kThreads = 8;
+  const int kUpdates = 10000;
+
+  std::vector<std::unique_ptr<StateProducer>> producers;
+  for (int i = 0; i < kThreads; ++i)
+    producers.push_back(hub_.CreateProducer());
+
+  base::DictionaryValue state;
+  EXPECT_CALL(component_manager_, SetStateProperties("comp", _, _))
+      .WillRepeatedly(Invoke([&state](const std::string& component,
+                                      const base::DictionaryValue& dict,
+                                      ErrorPtr* error) {
+        state.MergeDictionary(&dict);
+        return true;
+      }));
+
+  std::vector<std::thread> threads;
+  for (int i = 0; i < kThreads; ++i) {
+    StateProducer* producer = producers[i].get();
+    std::string name = "t.p" + std::to_string(i);
+    threads.emplace_back([producer, name]() {
+      for (int j = 1; j <= kUpdates; ++j)
+        producer->SetStateProperty("comp", name, base::FundamentalValue{j});
+    });
+  }
+  // Drain concurrently with producers.
+  for (int i = 0; i < 100; ++i) {
+    hub_.Drain();
+    std::this_thread::yield();
+  }
+  for (auto& thread : threads)
+    thread.join();
+  hub_.Drain();
+
+  for (int i = 0; i < kThreads; ++i) {
+    int value = 0;
+    EXPECT_TRUE(state.GetInteger("t.p" + std::to_string(i), &value));
+    EXPECT_EQ(kUpdates, value);
+  }
+}
+
+TEST_F(StateProducerHubTest, ManyThreadsWakeUp) {
+  const int kThreads = 8;
+  const int kUpdates = 10000;
+
+  std::vector<std::unique_ptr<StateProducer>> producers;
+  for (int i = 0; i < kThreads; ++i)
+    producers.push_back(hub_.CreateProducer());
+
+  base::DictionaryValue state;
+  EXPECT_CALL(component_manager_, SetStateProperties("comp", _, _))
+      .WillRepeatedly(Invoke([&state](const std::string& component,
+                                      const base::DictionaryValue& dict,
+                                      ErrorPtr* error) {
+        state.MergeDictionary(&dict);
+        return true;
+      }));
+
+  std::atomic<int> running{kThreads};
+  std::vector<std::thread> threads;
+  for (int i = 0; i < kThreads; ++i) {
+    StateProducer* producer = producers[i].get();
+    std::string name = "t.p" + std::to_string(i);
+    threads.emplace_back([producer, name, &running]() {
+      for (int j = 1; j <= kUpdates; ++j)
+        producer->SetStateProperty("comp", name, base::FundamentalValue{j});
+      --running;
+    });
+  }
+  // Only wake-ups drain the producers, so a lost one leaves updates behind.
+  while (running > 0)
+    task_runner_.RunOnce();
+  for (auto& thread : threads)
+    thread.join();
+  while (task_runner_.RunOnce()) {
+  }
+
+  for (int i = 0; i < kThreads; ++i) {
+    int value = 0;
+    EXPECT_TRUE(state.GetInteger("t.p" + std::to_string(i), &value));
+    EXPECT_EQ(kUpdates, value);
+  }
+}
+
+}  // namespace weave
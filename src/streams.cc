@@ -11,7 +11,31 @@
 
 namespace weave {
 
-namespace {}  // namespace
+namespace {
+
+void OnGatheredWriteDone(const std::vector<uint8_t>* data,
+                         const OutputStream::WriteCallback& callback,
+                         ErrorPtr error) {
+  callback.Run(std::move(error));
+}
+
+}  // namespace
+
+void OutputStream::WriteV(const std::vector<Buffer>& buffers,
+                          const WriteCallback& callback) {
+  size_t size = 0;
+  for (const auto& buffer : buffers)
+    size += buffer.size;
+  std::unique_ptr<std::vector<uint8_t>> data{new std::vector<uint8_t>};
+  data->reserve(size);
+  for (const auto& buffer : buffers) {
+    const uint8_t* begin = static_cast<const uint8_t*>(buffer.data);
+    data->insert(data->end(), begin, begin + buffer.size);
+  }
+  const uint8_t* gathered = data->data();
+  Write(gathered, size, base::Bind(&OnGatheredWriteDone,
+                                   base::Owned(data.release()), callback));
+}
 
 MemoryStream::MemoryStream(const std::vector<uint8_t>& data,
                            provider::TaskRunner* task_runner)
@@ -29,6 +53,17 @@ void MemoryStream::Read(void* buffer,
                                 base::Bind(callback, size_read, nullptr), {});
 }
 
+bool MemoryStream::ReadAvailable(size_t max_size,
+                                 const void** data,
+                                 size_t* size,
+                                 ErrorPtr* error) {
+  CHECK_LE(read_position_, data_.size());
+  *size = std::min(max_size, data_.size() - read_position_);
+  *data = data_.data() + read_position_;
+  read_position_ += *size;
+  return true;
+}
+
 void MemoryStream::Write(const void* buffer,
                          size_t size_to_write,
                          const WriteCallback& callback) {
@@ -37,10 +72,30 @@ void MemoryStream::Write(const void* buffer,
   task_runner_->PostDelayedTask(FROM_HERE, base::Bind(callback, nullptr), {});
 }
 
+void MemoryStream::WriteV(const std::vector<Buffer>& buffers,
+                          const WriteCallback& callback) {
+  for (const auto& buffer : buffers) {
+    data_.insert(data_.end(), static_cast<const char*>(buffer.data),
+                 static_cast<const char*>(buffer.data) + buffer.size);
+  }
+  task_runner_->PostDelayedTask(FROM_HERE, base::Bind(callback, nullptr), {});
+}
+
 StreamCopier::StreamCopier(InputStream* source, OutputStream* destination)
     : source_{source}, destination_{destination}, buffer_(4096) {}
 
 void StreamCopier::Copy(const InputStream::ReadCallback& callback) {
+  const void* data = nullptr;
+  size_t size = 0;
+  ErrorPtr error;
+  // Only lent data is handled here. The end of the stream and errors are
+  // left to Read(), which reports them again without running |callback|
+  // synchronously.
+  if (source_->ReadAvailable(buffer_.size(), &data, &size, &error) && !error &&
+      size > 0) {
+    return OnDataRead(callback, data, size, nullptr);
+  }
+
   source_->Read(buffer_.data(), buffer_.size(),
                 base::Bind(&StreamCopier::OnReadDone,
                            weak_ptr_factory_.GetWeakPtr(), callback));
@@ -49,13 +104,21 @@ void StreamCopier::Copy(const InputStream::ReadCallback& callback) {
 void StreamCopier::OnReadDone(const InputStream::ReadCallback& callback,
                               size_t size,
                               ErrorPtr error) {
+  OnDataRead(callback, buffer_.data(), size, std::move(error));
+}
+
+void StreamCopier::OnDataRead(const InputStream::ReadCallback& callback,
+                              const void* data,
+                              size_t size,
+                              ErrorPtr error) {
   if (error)
     return callback.Run(0, std::move(error));
 
   size_done_ += size;
   if (size) {
+    // Lent |data| stays valid, |source_| is not used until the write is done.
     return destination_->Write(
-        buffer_.data(), size,
+        data, size,
         base::Bind(&StreamCopier::OnWriteDone, weak_ptr_factory_.GetWeakPtr(),
                    callback));
   }
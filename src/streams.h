@@ -22,10 +22,16 @@ class MemoryStream : public InputStream, public OutputStream {
   void Read(void* buffer,
             size_t size_to_read,
             const ReadCallback& callback) override;
+  bool ReadAvailable(size_t max_size,
+                     const void** data,
+                     size_t* size,
+                     ErrorPtr* error) override;
 
   void Write(const void* buffer,
              size_t size_to_write,
              const WriteCallback& callback) override;
+  void WriteV(const std::vector<Buffer>& buffers,
+              const WriteCallback& callback) override;
 
   const std::vector<uint8_t>& GetData() const { return data_; }
 
@@ -35,6 +41,8 @@ class MemoryStream : public InputStream, public OutputStream {
   size_t read_position_{0};
 };
 
+// Copies |source| into |destination|. Data which |source| can lend is written
+// directly from its buffer, the rest is read into an intermediate buffer.
 class StreamCopier {
  public:
   StreamCopier(InputStream* source, OutputStream* destination);
@@ -46,6 +54,10 @@ class StreamCopier {
   void OnReadDone(const InputStream::ReadCallback& callback,
                   size_t size,
                   ErrorPtr error);
+  void OnDataRead(const InputStream::ReadCallback& callback,
+                  const void* data,
+                  size_t size,
+                  ErrorPtr error);
 
   InputStream* source_{nullptr};
   OutputStream* destination_{nullptr};
@@ -9,6 +9,7 @@
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 #include <weave/provider/test/fake_task_runner.h>
+#include <weave/test/fake_stream.h>
 
 #include <src/bind_lambda.h>
 
@@ -37,4 +38,78 @@ TEST(Stream, CopyStreams) {
   EXPECT_TRUE(done);
 }
 
+TEST(Stream, CopyThenWaitForData) {
+  provider::test::FakeTaskRunner task_runner;
+  test::FakeStream source{&task_runner};
+  MemoryStream destination{{}, &task_runner};
+  std::string data(10000, 'x');
+  source.AddReadPacketString({}, data);
+
+  StreamCopier copier{&source, &destination};
+  copier.Copy(base::Bind([](size_t size, ErrorPtr error) { ADD_FAILURE(); }));
+  // Lent data is copied, then copier falls back to Read(), which waits for
+  // more data instead of reporting the end of stream.
+  task_runner.Run(10);
+  EXPECT_EQ(data, std::string(destination.GetData().begin(),
+                              destination.GetData().end()));
+}
+
+TEST(Stream, CopyEmptyIsAsync) {
+  provider::test::FakeTaskRunner task_runner;
+  MemoryStream source{{}, &task_runner};
+  MemoryStream destination{{}, &task_runner};
+
+  bool done = false;
+  StreamCopier copier{&source, &destination};
+  copier.Copy(base::Bind([&done](size_t size, ErrorPtr error) {
+    EXPECT_FALSE(error);
+    EXPECT_EQ(0u, size);
+    done = true;
+  }));
+  // Callers may rely on the callback not running before Copy() returns.
+  EXPECT_FALSE(done);
+  task_runner.Run(10);
+  EXPECT_TRUE(done);
+}
+
+TEST(Stream, MemoryStreamReadAvailable) {
+  provider::test::FakeTaskRunner task_runner;
+  MemoryStream stream{{1, 2, 3}, &task_runner};
+  const void* data = nullptr;
+  size_t size = 0;
+  EXPECT_TRUE(stream.ReadAvailable(2, &data, &size, nullptr));
+  ASSERT_EQ(2u, size);
+  EXPECT_EQ(2, static_cast<const uint8_t*>(data)[1]);
+  EXPECT_TRUE(stream.ReadAvailable(2, &data, &size, nullptr));
+  ASSERT_EQ(1u, size);
+  EXPECT_EQ(3, static_cast<const uint8_t*>(data)[0]);
+  EXPECT_TRUE(stream.ReadAvailable(2, &data, &size, nullptr));
+  EXPECT_EQ(0u, size);
+}
+
+TEST(Stream, WriteV) {
+  provider::test::FakeTaskRunner task_runner;
+  MemoryStream memory_stream{{}, &task_runner};
+  test::FakeStream fake_stream{&task_runner};
+  fake_stream.ExpectWritePacketString({}, "header body");
+
+  const std::string header{"header "};
+  const std::string body{"body"};
+  std::vector<OutputStream::Buffer> buffers{{header.data(), header.size()},
+                                            {body.data(), body.size()}};
+  int done = 0;
+  auto callback = base::Bind([&done](ErrorPtr error) {
+    EXPECT_FALSE(error);
+    ++done;
+  });
+  // MemoryStream appends buffers, FakeStream gets them gathered.
+  memory_stream.WriteV(buffers, callback);
+  fake_stream.WriteV(buffers, callback);
+  task_runner.RunOnce();
+  task_runner.RunOnce();
+  EXPECT_EQ(2, done);
+  EXPECT_EQ("header body", std::string(memory_stream.GetData().begin(),
+                                       memory_stream.GetData().end()));
+}
+
 }  // namespace weave
@@ -0,0 +1,92 @@
+// Copyright 2016 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "src/test/allocation_counter.h"
+
+#include <cstdlib>
+#include <new>
+
+#include <base/logging.h>
+
+namespace {
+
+// Plain data, so it needs no initialization and can be used before main()
+// and while threads start.
+thread_local size_t allocation_count = 0;
+
+void* Allocate(size_t size) {
+  ++allocation_count;
+  void* ptr = malloc(size ? size : 1);
+  if (!ptr)
+    abort();
+  return ptr;
+}
+
+// Keeps the probe allocation from being optimized out.
+void* volatile probe = nullptr;
+
+}  // namespace
+
+void* operator new(size_t size) {
+  return Allocate(size);
+}
+
+void* operator new[](size_t size) {
+  return Allocate(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+  ++allocation_count;
+  return malloc(size ? size : 1);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+  ++allocation_count;
+  return malloc(size ? size : 1);
+}
+
+void operator delete(void* ptr) noexcept {
+  free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+  free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+  free(ptr);
+}
+
+void operator delete[](void* ptr, size_t) noexcept {
+  free(ptr);
+}
+
+void operator delete(void* ptr, const std::nothrow_t&) noexcept {
+  free(ptr);
+}
+
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept {
+  free(ptr);
+}
+
+namespace weave {
+namespace test {
+
+AllocationCounter::AllocationCounter() {
+  // Budgets would pass silently if the replacement operator new was not
+  // linked in.
+  size_t before = allocation_count;
+  probe = new char;
+  delete static_cast<char*>(probe);
+  CHECK_EQ(before + 1, allocation_count)
+      << "operator new is not replaced, link allocation_counter.o";
+  start_count_ = allocation_count;
+}
+
+size_t AllocationCounter::GetCount() const {
+  return allocation_count - start_count_;
+}
+
+}  // namespace test
+}  // namespace weave
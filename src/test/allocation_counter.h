@@ -0,0 +1,62 @@
+// Copyright 2016 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIBWEAVE_SRC_TEST_ALLOCATION_COUNTER_H_
+#define LIBWEAVE_SRC_TEST_ALLOCATION_COUNTER_H_
+
+#include <cstddef>
+
+#include <base/macros.h>
+#include <gtest/gtest.h>
+
+namespace weave {
+namespace test {
+
+// Counts heap allocations made with operator new by the current thread since
+// the counter was created. Test binaries which link allocation_counter.cc
+// replace the global operator new to maintain the count.
+class AllocationCounter final {
+ public:
+  AllocationCounter();
+
+  size_t GetCount() const;
+
+ private:
+  size_t start_count_;
+
+  DISALLOW_COPY_AND_ASSIGN(AllocationCounter);
+};
+
+// Allocation budget of a path which allocates by design, for |measured|
+// allocations counted with libstdc++ when the budget was set. Counts differ
+// between standard libraries, compilers and build modes, so budgets get
+// headroom of half the measured count, and at least two allocations. That is
+// still too little for allocations added per element or per nested call.
+constexpr size_t GetAllocationBudget(size_t measured) {
+  return measured + (measured / 2 > 2 ? measured / 2 : 2);
+}
+
+}  // namespace test
+}  // namespace weave
+
+// Expects that the statement passed after |max_count| makes at most
+// |max_count| heap allocations. Exact budgets are meant for allocation-free
+// paths, i.e. zero; paths which allocate by design use
+// EXPECT_ALLOCATION_BUDGET.
+#define EXPECT_MAX_ALLOCATIONS(max_count, ...)                                 \
+  do {                                                                         \
+    ::weave::test::AllocationCounter allocation_counter;                       \
+    __VA_ARGS__;                                                               \
+    size_t allocation_count = allocation_counter.GetCount();                   \
+    EXPECT_LE(allocation_count, static_cast<size_t>(max_count))                \
+        << "Heap allocations made by: " #__VA_ARGS__;                          \
+  } while (false)
+
+// Expects that the statement passed after |measured| stays within
+// GetAllocationBudget(|measured|) heap allocations.
+#define EXPECT_ALLOCATION_BUDGET(measured, ...)                                \
+  EXPECT_MAX_ALLOCATIONS(::weave::test::GetAllocationBudget(measured),         \
+                         __VA_ARGS__)
+
+#endif  // LIBWEAVE_SRC_TEST_ALLOCATION_COUNTER_H_
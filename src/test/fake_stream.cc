@@ -45,6 +45,19 @@ void FakeStream::Read(void* buffer,
                                 base::TimeDelta::FromSeconds(0));
 }
 
+bool FakeStream::ReadAvailable(size_t max_size,
+                               const void** data,
+                               size_t* size,
+                               ErrorPtr* error) {
+  if (read_data_.empty())
+    return false;
+  *size = std::min(max_size, read_data_.size());
+  lent_data_ = read_data_.substr(0, *size);
+  read_data_ = read_data_.substr(*size);
+  *data = lent_data_.data();
+  return true;
+}
+
 void FakeStream::Write(const void* buffer,
                        size_t size_to_write,
                        const WriteCallback& callback) {
@@ -23,10 +23,12 @@ FakeTaskRunner::FakeTaskRunner() : test_clock_{new TestClock} {}
 FakeTaskRunner::~FakeTaskRunner() {}
 
 bool FakeTaskRunner::RunOnce() {
+  TakeTasksFromOtherThreads();
   if (queue_.empty())
     return false;
-  auto top = queue_.top();
-  queue_.pop();
+  std::pop_heap(queue_.begin(), queue_.end(), Greater{});
+  QueueItem top = std::move(queue_.back());
+  queue_.pop_back();
   test_clock_->SetNow(std::max(test_clock_->Now(), top.first.first));
   top.second.Run();
   return true;
@@ -38,6 +40,17 @@ void FakeTaskRunner::Run(size_t number_of_iterations) {
   }
 }
 
+size_t FakeTaskRunner::RunUntil(base::Time time) {
+  size_t count = 0;
+  TakeTasksFromOtherThreads();
+  while (!queue_.empty() && queue_.front().first.first <= time) {
+    RunOnce();
+    ++count;
+  }
+  test_clock_->SetNow(std::max(test_clock_->Now(), time));
+  return count;
+}
+
 void FakeTaskRunner::Break() {
   break_ = true;
 }
@@ -49,7 +62,27 @@ base::Clock* FakeTaskRunner::GetClock() {
 void FakeTaskRunner::PostDelayedTask(const tracked_objects::Location& from_here,
                                      const base::Closure& task,
                                      base::TimeDelta delay) {
-  queue_.emplace(std::make_pair(test_clock_->Now() + delay, ++counter_), task);
+  queue_.emplace_back(std::make_pair(test_clock_->Now() + delay, ++counter_),
+                      task);
+  std::push_heap(queue_.begin(), queue_.end(), Greater{});
+}
+
+bool FakeTaskRunner::PostTaskFromAnyThread(
+    const tracked_objects::Location& from_here,
+    const base::Closure& task) {
+  std::lock_guard<std::mutex> lock{other_threads_mutex_};
+  other_threads_tasks_.push_back(task);
+  return true;
+}
+
+void FakeTaskRunner::TakeTasksFromOtherThreads() {
+  std::vector<base::Closure> tasks;
+  {
+    std::lock_guard<std::mutex> lock{other_threads_mutex_};
+    tasks.swap(other_threads_tasks_);
+  }
+  for (const auto& task : tasks)
+    PostDelayedTask(FROM_HERE, task, {});
 }
 
 size_t FakeTaskRunner::GetTaskQueueSize() const {
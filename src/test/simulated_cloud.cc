@@ -0,0 +1,358 @@
+// Copyright 2016 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "src/test/simulated_cloud.h"
+
+#include <cstring>
+
+#include <base/bind.h>
+#include <base/json/json_writer.h>
+#include <gtest/gtest.h>
+
+#include "src/data_encoding.h"
+#include "src/http_constants.h"
+#include "src/string_utils.h"
+#include "src/utils.h"
+
+namespace weave {
+namespace test {
+
+const char kSimulatedServiceUrl[] = "https://cloud.test/";
+const char kSimulatedOAuthUrl[] = "https://oauth.test/";
+const char kSimulatedCloudId[] = "simulated-cloud-id";
+const char kSimulatedRefreshToken[] = "simulated-refresh-token";
+const char kSimulatedRobotAccount[] =
+    "simulated@clouddevices.gserviceaccount.com";
+
+namespace {
+
+using provider::HttpClient;
+
+const int kTokenLifetimeSeconds = 3600;
+
+void SendResponse(const HttpClient::SendRequestCallback& callback,
+                  int status_code,
+                  const std::string& data) {
+  callback.Run(std::unique_ptr<HttpClient::Response>{
+                   new SimulatedResponse{status_code, data}},
+               nullptr);
+}
+
+}  // namespace
+
+std::string ToJson(const base::Value& value) {
+  std::string json;
+  base::JSONWriter::Write(value, &json);
+  return json;
+}
+
+SimulatedResponse::SimulatedResponse(int status_code, const std::string& data)
+    : status_code_{status_code}, data_{data} {}
+
+int SimulatedResponse::GetStatusCode() const {
+  return status_code_;
+}
+
+std::string SimulatedResponse::GetContentType() const {
+  return data_.empty() ? std::string{} : http::kJsonUtf8;
+}
+
+std::string SimulatedResponse::GetData() const {
+  return data_;
+}
+
+SimulatedCloud::SimulatedCloud(provider::test::FakeTaskRunner* task_runner)
+    : task_runner_{task_runner} {}
+
+SimulatedCloud::~SimulatedCloud() {}
+
+void SimulatedCloud::SetLatency(base::TimeDelta min,
+                                base::TimeDelta max,
+                                std::mt19937* random) {
+  min_latency_ = min;
+  max_latency_ = max;
+  random_ = random;
+}
+
+void SimulatedCloud::SendRequest(Method method,
+                                 const std::string& url,
+                                 const Headers& headers,
+                                 const std::string& data,
+                                 const SendRequestCallback& callback) {
+  ++request_count_;
+  // Half of the latency is spent before the request reaches the server.
+  task_runner_->PostDelayedTask(
+      FROM_HERE,
+      base::Bind(&SimulatedCloud::ReceiveRequest, base::Unretained(this),
+                 method, url, headers, data, callback),
+      GetLatency() / 2);
+}
+
+std::unique_ptr<base::DictionaryValue> SimulatedCloud::CreateCommand(
+    const std::string& component,
+    int amount) {
+  std::unique_ptr<base::DictionaryValue> command{new base::DictionaryValue};
+  std::string id = "cmd" + std::to_string(++last_command_id_);
+  command->SetString("id", id);
+  command->SetString("name", "soak.work");
+  command->SetString("component", component);
+  command->SetInteger("parameters.amount", amount);
+  command->SetString("state", "queued");
+  PendingCommand& pending = commands_[id];
+  pending.creation_time = Now();
+  pending.resource.reset(command->DeepCopy());
+  return command;
+}
+
+bool SimulatedCloud::IsTokenValid(const std::string& token) const {
+  auto it = tokens_.find(token);
+  return it != tokens_.end() && Now() < it->second;
+}
+
+const base::DictionaryValue* SimulatedCloud::GetState(
+    const std::string& component) const {
+  auto it = state_.find(component);
+  return it != state_.end() ? it->second.get() : nullptr;
+}
+
+base::Time SimulatedCloud::Now() const {
+  return task_runner_->GetClock()->Now();
+}
+
+base::TimeDelta SimulatedCloud::GetLatency() {
+  if (!random_)
+    return {};
+  return base::TimeDelta::FromMilliseconds(
+      std::uniform_int_distribution<int64_t>{min_latency_.InMilliseconds(),
+                                             max_latency_.InMilliseconds()}(
+          *random_));
+}
+
+void SimulatedCloud::ReceiveRequest(Method method,
+                                    const std::string& url,
+                                    const Headers& headers,
+                                    const std::string& data,
+                                    const SendRequestCallback& callback) {
+  int status_code = http::kOk;
+  std::string reply;
+  HandleRequest(method, url, headers, data, &status_code, &reply);
+  task_runner_->PostDelayedTask(
+      FROM_HERE, base::Bind(&SendResponse, callback, status_code, reply),
+      GetLatency() / 2);
+}
+
+void SimulatedCloud::HandleRequest(Method method,
+                                   const std::string& url,
+                                   const Headers& headers,
+                                   const std::string& data,
+                                   int* status_code,
+                                   std::string* reply) {
+  if (url == std::string{kSimulatedOAuthUrl} + "token" &&
+      method == Method::kPost) {
+    HandleTokenRequest(data, status_code, reply);
+    return;
+  }
+  if (url.compare(0, strlen(kSimulatedServiceUrl), kSimulatedServiceUrl) !=
+      0) {
+    ReplyUnexpected(url, status_code);
+    return;
+  }
+  std::string token;
+  for (const auto& header : headers) {
+    if (header.first == http::kAuthorization)
+      token = SplitAtFirst(header.second, " ", true).second;
+  }
+  if (!IsTokenValid(token)) {
+    ++unauthorized_count_;
+    *status_code = http::kDenied;
+    return;
+  }
+
+  auto path_query =
+      SplitAtFirst(url.substr(strlen(kSimulatedServiceUrl)), "?", true);
+  const std::string& path = path_query.first;
+  std::string device_path = std::string{"devices/"} + kSimulatedCloudId + "/";
+  std::unique_ptr<base::DictionaryValue> body;
+  if (!data.empty()) {
+    body = LoadJsonDict(data, nullptr);
+    CHECK(body) << data;
+  }
+  base::DictionaryValue result;
+  if (path == device_path && method == Method::kGet) {
+    result.SetString("id", kSimulatedCloudId);
+    result.SetString("lastUpdateTimeMs",
+                     std::to_string(last_device_update_ms_));
+  } else if (path == device_path && method == Method::kPut) {
+    UpdateDevice(*body, path_query.second, &result);
+  } else if (path == device_path + "patchState" && method == Method::kPost) {
+    PatchState(*body);
+  } else if (path == device_path + "upsertLocalAuthInfo" &&
+             method == Method::kPost) {
+    ++local_auth_info_count_;
+  } else if (path == "commands/queue" && method == Method::kGet) {
+    std::unique_ptr<base::ListValue> queue{new base::ListValue};
+    for (const auto& pair : commands_) {
+      std::string state;
+      pair.second.resource->GetString("state", &state);
+      if (state == "queued")
+        queue->Append(pair.second.resource->DeepCopy());
+    }
+    result.Set("commands", queue.release());
+  } else if (path.compare(0, 9, "commands/") == 0 &&
+             method == Method::kPatch) {
+    if (!PatchCommand(path.substr(9), *body))
+      return ReplyUnexpected(url, status_code);
+  } else {
+    return ReplyUnexpected(url, status_code);
+  }
+  *reply = ToJson(result);
+}
+
+void SimulatedCloud::HandleTokenRequest(const std::string& data,
+                                        int* status_code,
+                                        std::string* reply) {
+  std::map<std::string, std::string> form;
+  for (const auto& pair : WebParamsDecode(data))
+    form.insert(pair);
+  if (form["grant_type"] != "refresh_token" ||
+      form["refresh_token"] != kSimulatedRefreshToken) {
+    return ReplyUnexpected("token request: " + data, status_code);
+  }
+  // Expired tokens are never used again.
+  for (auto it = tokens_.begin(); it != tokens_.end();) {
+    if (it->second <= Now())
+      it = tokens_.erase(it);
+    else
+      ++it;
+  }
+  std::string token = "token" + std::to_string(++token_count_);
+  tokens_[token] = Now() + base::TimeDelta::FromSeconds(kTokenLifetimeSeconds);
+  base::DictionaryValue result;
+  result.SetString("access_token", token);
+  result.SetInteger("expires_in", kTokenLifetimeSeconds);
+  result.SetString("token_type", "Bearer");
+  *reply = ToJson(result);
+}
+
+void SimulatedCloud::UpdateDevice(const base::DictionaryValue& device,
+                                  const std::string& query,
+                                  base::DictionaryValue* result) {
+  std::string last_update_ms;
+  for (const auto& pair : WebParamsDecode(query)) {
+    if (pair.first == "lastUpdateTimeMs")
+      last_update_ms = pair.second;
+  }
+  EXPECT_EQ(std::to_string(last_device_update_ms_), last_update_ms);
+  const base::DictionaryValue* components = nullptr;
+  ASSERT_TRUE(device.GetDictionary("components", &components));
+  for (base::DictionaryValue::Iterator it(*components); !it.IsAtEnd();
+       it.Advance()) {
+    const base::DictionaryValue* component = nullptr;
+    const base::DictionaryValue* state = nullptr;
+    if (it.value().GetAsDictionary(&component) &&
+        component->GetDictionary("state", &state)) {
+      state_[it.key()].reset(state->DeepCopy());
+    }
+  }
+  last_device_update_ms_ = Now().ToJavaTime();
+  result->SetString("lastUpdateTimeMs",
+                    std::to_string(last_device_update_ms_));
+}
+
+void SimulatedCloud::PatchState(const base::DictionaryValue& body) {
+  const base::ListValue* patches = nullptr;
+  ASSERT_TRUE(body.GetList("patches", &patches));
+  for (const base::Value* value : *patches) {
+    const base::DictionaryValue* patch = nullptr;
+    std::string time_ms;
+    std::string component;
+    const base::DictionaryValue* properties = nullptr;
+    ASSERT_TRUE(value->GetAsDictionary(&patch));
+    ASSERT_TRUE(patch->GetString("timeMs", &time_ms));
+    ASSERT_TRUE(patch->GetString("component", &component));
+    ASSERT_TRUE(patch->GetDictionary("patch", &properties));
+    state_latency_.Add(Now().ToJavaTime() - std::stoll(time_ms));
+    auto& state = state_[component];
+    if (!state)
+      state.reset(new base::DictionaryValue);
+    state->MergeDictionary(properties);
+  }
+}
+
+bool SimulatedCloud::PatchCommand(const std::string& id,
+                                  const base::DictionaryValue& patch) {
+  auto it = commands_.find(id);
+  if (it == commands_.end())
+    return false;
+  it->second.resource->MergeDictionary(&patch);
+  std::string state;
+  it->second.resource->GetString("state", &state);
+  if (state == "done") {
+    command_latency_.AddTime(Now() - it->second.creation_time);
+  } else if (state == "aborted" || state == "error" || state == "cancelled") {
+    ++failed_command_count_;
+  } else {
+    return true;
+  }
+  commands_.erase(it);
+  return true;
+}
+
+void SimulatedCloud::ReplyUnexpected(const std::string& request,
+                                     int* status_code) {
+  ADD_FAILURE() << "Unexpected cloud request: " << request;
+  ++unexpected_count_;
+  *status_code = http::kNotFound;
+}
+
+SimulatedConfigStore::SimulatedConfigStore(const std::string& xmpp_endpoint)
+    : xmpp_endpoint_{xmpp_endpoint} {}
+
+SimulatedConfigStore::~SimulatedConfigStore() {}
+
+bool SimulatedConfigStore::LoadDefaults(Settings* settings) {
+  settings->firmware_version = "SIMULATED_FIRMWARE";
+  settings->oem_name = "SIMULATED_OEM";
+  settings->model_name = "SIMULATED_MODEL";
+  settings->model_id = "AASIM";
+  settings->name = "SIMULATED_NAME";
+  settings->client_id = "SIMULATED_CLIENT_ID";
+  settings->client_secret = "SIMULATED_CLIENT_SECRET";
+  settings->api_key = "SIMULATED_API_KEY";
+  settings->oauth_url = kSimulatedOAuthUrl;
+  settings->service_url = kSimulatedServiceUrl;
+  if (!xmpp_endpoint_.empty())
+    settings->xmpp_endpoint = xmpp_endpoint_;
+  return true;
+}
+
+std::string SimulatedConfigStore::LoadSettings(const std::string& name) {
+  auto it = settings_.find(name);
+  if (it != settings_.end())
+    return it->second;
+  if (name != "config")
+    return {};
+  base::DictionaryValue dict;
+  dict.SetInteger("version", 1);
+  dict.SetString("device_id", "SIMULATED_DEVICE_ID");
+  dict.SetString("refresh_token", kSimulatedRefreshToken);
+  dict.SetString("cloud_id", kSimulatedCloudId);
+  dict.SetString("robot_account", kSimulatedRobotAccount);
+  return ToJson(dict);
+}
+
+void SimulatedConfigStore::SaveSettings(const std::string& name,
+                                        const std::string& settings,
+                                        const DoneCallback& callback) {
+  settings_[name] = settings;
+  if (!callback.is_null())
+    callback.Run(nullptr);
+}
+
+std::string SimulatedConfigStore::LoadSettings() {
+  return {};
+}
+
+}  // namespace test
+}  // namespace weave
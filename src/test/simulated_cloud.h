@@ -0,0 +1,173 @@
+// Copyright 2016 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIBWEAVE_SRC_TEST_SIMULATED_CLOUD_H_
+#define LIBWEAVE_SRC_TEST_SIMULATED_CLOUD_H_
+
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+
+#include <base/macros.h>
+#include <base/time/time.h>
+#include <base/values.h>
+#include <weave/provider/config_store.h>
+#include <weave/provider/http_client.h>
+#include <weave/provider/test/fake_task_runner.h>
+
+#include "src/metrics.h"
+
+namespace weave {
+namespace test {
+
+// Registration of the simulated device. SimulatedConfigStore loads it and
+// SimulatedCloud accepts it.
+extern const char kSimulatedServiceUrl[];
+extern const char kSimulatedOAuthUrl[];
+extern const char kSimulatedCloudId[];
+extern const char kSimulatedRefreshToken[];
+extern const char kSimulatedRobotAccount[];
+
+std::string ToJson(const base::Value& value);
+
+class SimulatedResponse : public provider::HttpClient::Response {
+ public:
+  SimulatedResponse(int status_code, const std::string& data);
+
+  int GetStatusCode() const override;
+  std::string GetContentType() const override;
+  std::string GetData() const override;
+
+ private:
+  int status_code_;
+  std::string data_;
+
+  DISALLOW_COPY_AND_ASSIGN(SimulatedResponse);
+};
+
+// Cloud server which keeps commands and state of a single registered device
+// and issues access tokens which expire after an hour. Requests it doesn't
+// expect fail the test. Replies take no time unless SetLatency() is called.
+class SimulatedCloud : public provider::HttpClient {
+ public:
+  explicit SimulatedCloud(provider::test::FakeTaskRunner* task_runner);
+  ~SimulatedCloud() override;
+
+  // Delays every request and every reply by half of a latency picked from
+  // [min, max] with |random|.
+  void SetLatency(base::TimeDelta min,
+                  base::TimeDelta max,
+                  std::mt19937* random);
+
+  // Creates a queued command and returns its cloud resource.
+  std::unique_ptr<base::DictionaryValue> CreateCommand(
+      const std::string& component,
+      int amount);
+
+  bool IsTokenValid(const std::string& token) const;
+
+  // State of |component| as known to the cloud.
+  const base::DictionaryValue* GetState(const std::string& component) const;
+
+  size_t GetPendingCommandCount() const { return commands_.size(); }
+  int GetRequestCount() const { return request_count_; }
+  int GetTokenCount() const { return token_count_; }
+  int GetUnauthorizedCount() const { return unauthorized_count_; }
+  int GetUnexpectedCount() const { return unexpected_count_; }
+  int GetFailedCommandCount() const { return failed_command_count_; }
+  // Number of times the device sent its local auth info.
+  int GetLocalAuthInfoCount() const { return local_auth_info_count_; }
+  // Time from a state change on the device until the cloud receives it.
+  const Histogram& GetStateLatency() const { return state_latency_; }
+  // Time from creation of a command until the cloud learns it is done.
+  const Histogram& GetCommandLatency() const { return command_latency_; }
+
+  // HttpClient implementation.
+  void SendRequest(Method method,
+                   const std::string& url,
+                   const Headers& headers,
+                   const std::string& data,
+                   const SendRequestCallback& callback) override;
+
+ private:
+  struct PendingCommand {
+    base::Time creation_time;
+    std::unique_ptr<base::DictionaryValue> resource;
+  };
+
+  base::Time Now() const;
+  base::TimeDelta GetLatency();
+
+  void ReceiveRequest(Method method,
+                      const std::string& url,
+                      const Headers& headers,
+                      const std::string& data,
+                      const SendRequestCallback& callback);
+  void HandleRequest(Method method,
+                     const std::string& url,
+                     const Headers& headers,
+                     const std::string& data,
+                     int* status_code,
+                     std::string* reply);
+  void HandleTokenRequest(const std::string& data,
+                          int* status_code,
+                          std::string* reply);
+  void UpdateDevice(const base::DictionaryValue& device,
+                    const std::string& query,
+                    base::DictionaryValue* result);
+  void PatchState(const base::DictionaryValue& body);
+  bool PatchCommand(const std::string& id, const base::DictionaryValue& patch);
+  void ReplyUnexpected(const std::string& request, int* status_code);
+
+  provider::test::FakeTaskRunner* task_runner_;
+  base::TimeDelta min_latency_;
+  base::TimeDelta max_latency_;
+  std::mt19937* random_{nullptr};
+
+  std::map<std::string, base::Time> tokens_;
+  int token_count_{0};
+  int64_t last_device_update_ms_{0};
+  int last_command_id_{0};
+  std::map<std::string, PendingCommand> commands_;
+  std::map<std::string, std::unique_ptr<base::DictionaryValue>> state_;
+
+  int request_count_{0};
+  int unauthorized_count_{0};
+  int unexpected_count_{0};
+  int failed_command_count_{0};
+  int local_auth_info_count_{0};
+  Histogram state_latency_;
+  Histogram command_latency_;
+
+  DISALLOW_COPY_AND_ASSIGN(SimulatedCloud);
+};
+
+// Settings of the device registered with SimulatedCloud, kept in memory.
+class SimulatedConfigStore : public provider::ConfigStore {
+ public:
+  // |xmpp_endpoint| is "host:port" of the XMPP server, or empty for the
+  // default one.
+  explicit SimulatedConfigStore(const std::string& xmpp_endpoint = {});
+  ~SimulatedConfigStore() override;
+
+  // ConfigStore implementation.
+  bool LoadDefaults(Settings* settings) override;
+  std::string LoadSettings(const std::string& name) override;
+  void SaveSettings(const std::string& name,
+                    const std::string& settings,
+                    const DoneCallback& callback) override;
+  std::string LoadSettings() override;
+
+ private:
+  const std::string xmpp_endpoint_;
+  std::map<std::string, std::string> settings_;
+
+  DISALLOW_COPY_AND_ASSIGN(SimulatedConfigStore);
+};
+
+}  // namespace test
+}  // namespace weave
+
+#endif  // LIBWEAVE_SRC_TEST_SIMULATED_CLOUD_H_
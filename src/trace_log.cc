@@ -0,0 +1,147 @@
+// Copyright 2016 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "src/trace_log.h"
+
+#include <base/json/json_writer.h>
+
+namespace weave {
+
+namespace {
+
+// Small sequential ID of the current thread, which reads better in the trace
+// viewer than hashes of std::thread::id.
+int GetThreadId() {
+  static std::atomic<int> last_thread_id{0};
+  thread_local int thread_id = ++last_thread_id;
+  return thread_id;
+}
+
+double ToMicroseconds(base::TimeTicks time) {
+  return (time - base::TimeTicks()).InMicroseconds();
+}
+
+}  // namespace
+
+struct TraceLog::Event {
+  // Chrome trace event phase: 'X' for complete events, 'i' for instant ones,
+  // 'b' and 'e' for the beginning and the end of spans.
+  char phase;
+  const char* category;
+  std::string name;
+  base::TimeTicks timestamp;
+  base::TimeDelta duration;
+  uint64_t id;
+  int thread_id;
+  std::unique_ptr<base::DictionaryValue> args;
+};
+
+TraceLog::TraceLog() {}
+
+TraceLog::~TraceLog() {}
+
+TraceLog* TraceLog::GetInstance() {
+  static TraceLog* instance = new TraceLog;
+  return instance;
+}
+
+void TraceLog::SetBufferSize(size_t max_events) {
+  std::lock_guard<std::mutex> lock{mutex_};
+  events_.clear();
+  events_.shrink_to_fit();
+  events_.reserve(max_events);
+  max_events_ = max_events;
+  next_event_ = 0;
+  enabled_.store(max_events > 0, std::memory_order_relaxed);
+}
+
+void TraceLog::AddCompleteEvent(const char* category,
+                                const std::string& name,
+                                base::TimeTicks start,
+                                base::TimeDelta duration,
+                                std::unique_ptr<base::DictionaryValue> args) {
+  if (!IsEnabled())
+    return;
+  AddEvent(
+      Event{'X', category, name, start, duration, 0, 0, std::move(args)});
+}
+
+void TraceLog::AddInstantEvent(const char* category,
+                               const std::string& name,
+                               std::unique_ptr<base::DictionaryValue> args) {
+  if (!IsEnabled())
+    return;
+  AddEvent(Event{'i', category, name, base::TimeTicks::Now(), {}, 0, 0,
+                 std::move(args)});
+}
+
+uint64_t TraceLog::BeginSpan(const char* category,
+                             const std::string& name,
+                             std::unique_ptr<base::DictionaryValue> args) {
+  if (!IsEnabled())
+    return 0;
+  uint64_t id = ++last_span_id_;
+  AddEvent(Event{'b', category, name, base::TimeTicks::Now(), {}, id, 0,
+                 std::move(args)});
+  return id;
+}
+
+void TraceLog::EndSpan(const char* category,
+                       const std::string& name,
+                       uint64_t id,
+                       std::unique_ptr<base::DictionaryValue> args) {
+  if (!id || !IsEnabled())
+    return;
+  AddEvent(Event{'e', category, name, base::TimeTicks::Now(), {}, id, 0,
+                 std::move(args)});
+}
+
+void TraceLog::AddEvent(Event event) {
+  event.thread_id = GetThreadId();
+  std::lock_guard<std::mutex> lock{mutex_};
+  if (max_events_ == 0)
+    return;
+  if (events_.size() < max_events_) {
+    events_.push_back(std::move(event));
+    return;
+  }
+  events_[next_event_] = std::move(event);
+  next_event_ = (next_event_ + 1) % max_events_;
+}
+
+std::string TraceLog::GetJson() const {
+  std::unique_ptr<base::ListValue> list{new base::ListValue};
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    for (size_t i = 0; i < events_.size(); ++i) {
+      const Event& event = events_[(next_event_ + i) % events_.size()];
+      std::unique_ptr<base::DictionaryValue> json{new base::DictionaryValue};
+      json->SetString("ph", std::string(1, event.phase));
+      json->SetString("cat", event.category);
+      json->SetString("name", event.name);
+      json->SetDouble("ts", ToMicroseconds(event.timestamp));
+      json->SetInteger("pid", 0);
+      json->SetInteger("tid", event.thread_id);
+      if (event.phase == 'X')
+        json->SetDouble("dur", event.duration.InMicroseconds());
+      if (event.phase == 'i')
+        json->SetString("s", "t");
+      if (event.id)
+        json->SetString("id", std::to_string(event.id));
+      if (event.args)
+        json->Set("args", event.args->DeepCopy());
+      list->Append(json.release());
+    }
+  }
+
+  base::DictionaryValue trace;
+  trace.Set("traceEvents", list.release());
+  trace.SetString("displayTimeUnit", "ms");
+  std::string result;
+  base::JSONWriter::WriteWithOptions(
+      trace, base::JSONWriter::OPTIONS_OMIT_DOUBLE_TYPE_PRESERVATION, &result);
+  return result;
+}
+
+}  // namespace weave
@@ -0,0 +1,87 @@
+// Copyright 2016 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIBWEAVE_SRC_TRACE_LOG_H_
+#define LIBWEAVE_SRC_TRACE_LOG_H_
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <base/macros.h>
+#include <base/time/time.h>
+#include <base/values.h>
+
+namespace weave {
+
+// Ring buffer of the most recent trace events, which can be dumped in Chrome
+// trace event format. Recording is off until SetBufferSize() is called with a
+// non-zero size; while it is off, recording methods return after a single
+// atomic load. Methods can be called from any thread.
+class TraceLog final {
+ public:
+  TraceLog();
+  ~TraceLog();
+
+  // Log used by libweave. Events of all devices in the process are shared.
+  // It is never destroyed.
+  static TraceLog* GetInstance();
+
+  // Starts keeping the last |max_events| events. Zero stops recording.
+  // Recorded events are dropped.
+  void SetBufferSize(size_t max_events);
+
+  bool IsEnabled() const { return enabled_.load(std::memory_order_relaxed); }
+
+  // Records an event which started at |start| and took |duration|.
+  void AddCompleteEvent(const char* category,
+                        const std::string& name,
+                        base::TimeTicks start,
+                        base::TimeDelta duration,
+                        std::unique_ptr<base::DictionaryValue> args);
+
+  // Records an event without duration which happened now.
+  void AddInstantEvent(const char* category,
+                       const std::string& name,
+                       std::unique_ptr<base::DictionaryValue> args);
+
+  // Starts an asynchronous span which may end in another task. Returns the
+  // ID to pass to EndSpan(), or zero if recording is off.
+  uint64_t BeginSpan(const char* category,
+                     const std::string& name,
+                     std::unique_ptr<base::DictionaryValue> args);
+  // Ends the span started by BeginSpan(). Ignores zero |id|.
+  void EndSpan(const char* category,
+               const std::string& name,
+               uint64_t id,
+               std::unique_ptr<base::DictionaryValue> args);
+
+  // Returns recorded events, oldest first, as a JSON object with the
+  // "traceEvents" list, which can be loaded into chrome://tracing.
+  std::string GetJson() const;
+
+ private:
+  struct Event;
+
+  void AddEvent(Event event);
+
+  std::atomic<bool> enabled_{false};
+  std::atomic<uint64_t> last_span_id_{0};
+
+  // Guards everything below.
+  mutable std::mutex mutex_;
+  std::vector<Event> events_;
+  size_t max_events_{0};
+  // Index of the oldest event if |events_| is full.
+  size_t next_event_{0};
+
+  DISALLOW_COPY_AND_ASSIGN(TraceLog);
+};
+
+}  // namespace weave
+
+#endif  // LIBWEAVE_SRC_TRACE_LOG_H_
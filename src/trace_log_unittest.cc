@@ -0,0 +1,110 @@
+// Copyright 2016 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "src/trace_log.h"
+
+#include <base/json/json_reader.h>
+#include <gtest/gtest.h>
+#include <weave/test/unittest_utils.h>
+
+#include "src/test/allocation_counter.h"
+
+namespace weave {
+
+namespace {
+
+std::unique_ptr<base::ListValue> GetEvents(const TraceLog& trace_log) {
+  std::unique_ptr<base::DictionaryValue> trace =
+      test::CreateDictionaryValue(trace_log.GetJson().c_str());
+  base::ListValue* events = nullptr;
+  EXPECT_TRUE(trace->GetList("traceEvents", &events));
+  return std::unique_ptr<base::ListValue>{events->DeepCopy()};
+}
+
+std::string GetNames(const TraceLog& trace_log) {
+  std::string names;
+  auto events = GetEvents(trace_log);
+  for (const base::Value* value : *events) {
+    const base::DictionaryValue* event = nullptr;
+    EXPECT_TRUE(value->GetAsDictionary(&event));
+    std::string name;
+    EXPECT_TRUE(event->GetString("name", &name));
+    names += name;
+  }
+  return names;
+}
+
+}  // namespace
+
+TEST(TraceLogTest, Disabled) {
+  TraceLog trace_log;
+  EXPECT_FALSE(trace_log.IsEnabled());
+  EXPECT_EQ(0u, trace_log.BeginSpan("cat", "span", nullptr));
+  trace_log.AddInstantEvent("cat", "event", nullptr);
+  EXPECT_JSON_EQ("{'traceEvents': [], 'displayTimeUnit': 'ms'}",
+                 *test::CreateDictionaryValue(trace_log.GetJson().c_str()));
+}
+
+TEST(TraceLogTest, DisabledAllocations) {
+  TraceLog trace_log;
+  EXPECT_MAX_ALLOCATIONS(0, trace_log.AddInstantEvent("test", "event", {}));
+  EXPECT_MAX_ALLOCATIONS(0, trace_log.BeginSpan("test", "span", {}));
+}
+
+TEST(TraceLogTest, Events) {
+  TraceLog trace_log;
+  trace_log.SetBufferSize(10);
+  EXPECT_TRUE(trace_log.IsEnabled());
+
+  std::unique_ptr<base::DictionaryValue> args{new base::DictionaryValue};
+  args->SetString("key", "value");
+  trace_log.AddCompleteEvent(
+      "cat", "task", base::TimeTicks() + base::TimeDelta::FromSeconds(1),
+      base::TimeDelta::FromMilliseconds(3), std::move(args));
+  uint64_t id = trace_log.BeginSpan("cat", "span", nullptr);
+  EXPECT_NE(0u, id);
+  trace_log.EndSpan("cat", "span", id, nullptr);
+  trace_log.AddInstantEvent("cat", "event", nullptr);
+
+  auto events = GetEvents(trace_log);
+  ASSERT_EQ(4u, events->GetSize());
+  base::DictionaryValue* event = nullptr;
+  ASSERT_TRUE(events->GetDictionary(0, &event));
+  event->Remove("tid", nullptr);
+  EXPECT_JSON_EQ(
+      "{'ph': 'X', 'cat': 'cat', 'name': 'task', 'ts': 1000000, "
+      "'dur': 3000, 'pid': 0, 'args': {'key': 'value'}}",
+      *event);
+
+  std::string phase;
+  std::string span_id;
+  ASSERT_TRUE(events->GetDictionary(1, &event));
+  EXPECT_TRUE(event->GetString("ph", &phase));
+  EXPECT_EQ("b", phase);
+  EXPECT_TRUE(event->GetString("id", &span_id));
+  ASSERT_TRUE(events->GetDictionary(2, &event));
+  EXPECT_TRUE(event->GetString("ph", &phase));
+  EXPECT_EQ("e", phase);
+  EXPECT_TRUE(event->GetString("id", &phase));
+  EXPECT_EQ(span_id, phase);
+  ASSERT_TRUE(events->GetDictionary(3, &event));
+  EXPECT_TRUE(event->GetString("ph", &phase));
+  EXPECT_EQ("i", phase);
+
+  trace_log.SetBufferSize(0);
+  EXPECT_FALSE(trace_log.IsEnabled());
+  EXPECT_EQ(0u, GetEvents(trace_log)->GetSize());
+}
+
+TEST(TraceLogTest, RingBuffer) {
+  TraceLog trace_log;
+  trace_log.SetBufferSize(3);
+  for (char name = 'a'; name <= 'e'; ++name)
+    trace_log.AddInstantEvent("cat", std::string(1, name), nullptr);
+  EXPECT_EQ("cde", GetNames(trace_log));
+  trace_log.AddInstantEvent("cat", "f", nullptr);
+  EXPECT_EQ("def", GetNames(trace_log));
+}
+
+}  // namespace weave
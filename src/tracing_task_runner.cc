@@ -0,0 +1,80 @@
+// Copyright 2016 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "src/tracing_task_runner.h"
+
+#include <base/bind.h>
+
+#include "src/trace_log.h"
+
+namespace weave {
+
+namespace {
+
+const char kCategory[] = "task";
+
+std::string GetLocationString(const tracked_objects::Location& location) {
+  return std::string{location.file_name()} + ":" +
+         std::to_string(location.line_number());
+}
+
+void RunTask(TraceLog* trace_log,
+             const tracked_objects::Location& from_here,
+             const base::Closure& task,
+             base::TimeTicks due_time) {
+  base::TimeTicks start = base::TimeTicks::Now();
+  task.Run();
+  base::TimeDelta duration = base::TimeTicks::Now() - start;
+
+  std::unique_ptr<base::DictionaryValue> args{new base::DictionaryValue};
+  args->SetString("posted_from", GetLocationString(from_here));
+  args->SetDouble("queue_delay_us", (start - due_time).InMicroseconds());
+  trace_log->AddCompleteEvent(kCategory, from_here.function_name(), start,
+                              duration, std::move(args));
+}
+
+}  // namespace
+
+TracingTaskRunner::TracingTaskRunner(provider::TaskRunner* task_runner,
+                                     TraceLog* trace_log)
+    : task_runner_{task_runner}, trace_log_{trace_log} {}
+
+TracingTaskRunner::~TracingTaskRunner() {}
+
+void TracingTaskRunner::PostDelayedTask(
+    const tracked_objects::Location& from_here,
+    const base::Closure& task,
+    base::TimeDelta delay) {
+  if (!trace_log_->IsEnabled())
+    return task_runner_->PostDelayedTask(from_here, task, delay);
+
+  std::unique_ptr<base::DictionaryValue> args{new base::DictionaryValue};
+  args->SetString("posted_from", GetLocationString(from_here));
+  args->SetDouble("delay_us", delay.InMicroseconds());
+  trace_log_->AddInstantEvent(kCategory, "PostTask", std::move(args));
+
+  task_runner_->PostDelayedTask(
+      from_here, base::Bind(&RunTask, trace_log_, from_here, task,
+                            base::TimeTicks::Now() + delay),
+      delay);
+}
+
+bool TracingTaskRunner::PostTaskFromAnyThread(
+    const tracked_objects::Location& from_here,
+    const base::Closure& task) {
+  // TraceLog can be used from any thread.
+  if (!trace_log_->IsEnabled())
+    return task_runner_->PostTaskFromAnyThread(from_here, task);
+
+  std::unique_ptr<base::DictionaryValue> args{new base::DictionaryValue};
+  args->SetString("posted_from", GetLocationString(from_here));
+  trace_log_->AddInstantEvent(kCategory, "PostTaskFromAnyThread",
+                              std::move(args));
+
+  return task_runner_->PostTaskFromAnyThread(
+      from_here, base::Bind(&RunTask, trace_log_, from_here, task,
+                            base::TimeTicks::Now()));
+}
+
+}  // namespace weave
@@ -0,0 +1,40 @@
+// Copyright 2016 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIBWEAVE_SRC_TRACING_TASK_RUNNER_H_
+#define LIBWEAVE_SRC_TRACING_TASK_RUNNER_H_
+
+#include <base/macros.h>
+#include <weave/provider/task_runner.h>
+
+namespace weave {
+
+class TraceLog;
+
+// Decorator of any provider::TaskRunner which records posted tasks into
+// |trace_log| while it is enabled: an instant event when a task is posted and
+// a complete event when it runs. Events are named after the function of the
+// FROM_HERE location and have the posting location and the queue delay, i.e.
+// the time the task waited after its delay had passed, in their arguments.
+class TracingTaskRunner final : public provider::TaskRunner {
+ public:
+  TracingTaskRunner(provider::TaskRunner* task_runner, TraceLog* trace_log);
+  ~TracingTaskRunner() override;
+
+  void PostDelayedTask(const tracked_objects::Location& from_here,
+                       const base::Closure& task,
+                       base::TimeDelta delay) override;
+  bool PostTaskFromAnyThread(const tracked_objects::Location& from_here,
+                             const base::Closure& task) override;
+
+ private:
+  provider::TaskRunner* task_runner_{nullptr};
+  TraceLog* trace_log_{nullptr};
+
+  DISALLOW_COPY_AND_ASSIGN(TracingTaskRunner);
+};
+
+}  // namespace weave
+
+#endif  // LIBWEAVE_SRC_TRACING_TASK_RUNNER_H_
@@ -0,0 +1,95 @@
+// Copyright 2016 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "src/tracing_task_runner.h"
+
+#include <base/bind.h>
+#include <gtest/gtest.h>
+#include <weave/provider/test/fake_task_runner.h>
+#include <weave/test/unittest_utils.h>
+
+#include "src/test/allocation_counter.h"
+#include "src/trace_log.h"
+
+namespace weave {
+
+namespace {
+
+void Increment(int* counter) {
+  ++*counter;
+}
+
+}  // namespace
+
+class TracingTaskRunnerTest : public ::testing::Test {
+ protected:
+  provider::test::FakeTaskRunner fake_task_runner_;
+  TraceLog trace_log_;
+  TracingTaskRunner task_runner_{&fake_task_runner_, &trace_log_};
+};
+
+TEST_F(TracingTaskRunnerTest, Disabled) {
+  int counter = 0;
+  task_runner_.PostDelayedTask(FROM_HERE, base::Bind(&Increment, &counter),
+                               {});
+  fake_task_runner_.RunOnce();
+  EXPECT_EQ(1, counter);
+
+  trace_log_.SetBufferSize(10);
+  EXPECT_JSON_EQ("{'traceEvents': [], 'displayTimeUnit': 'ms'}",
+                 *test::CreateDictionaryValue(trace_log_.GetJson().c_str()));
+}
+
+TEST_F(TracingTaskRunnerTest, DisabledAllocations) {
+  int counter = 0;
+  base::Closure task = base::Bind(&Increment, &counter);
+  task_runner_.PostDelayedTask(FROM_HERE, task, {});
+  fake_task_runner_.RunOnce();
+
+  // Tasks are posted as they are, without wrapping.
+  EXPECT_MAX_ALLOCATIONS(0, task_runner_.PostDelayedTask(FROM_HERE, task, {}));
+  EXPECT_MAX_ALLOCATIONS(0, fake_task_runner_.RunOnce());
+  EXPECT_EQ(2, counter);
+}
+
+TEST_F(TracingTaskRunnerTest, Enabled) {
+  trace_log_.SetBufferSize(10);
+  int counter = 0;
+  tracked_objects::Location location{"PostIncrement", "file.cc", 12, nullptr};
+  task_runner_.PostDelayedTask(location, base::Bind(&Increment, &counter),
+                               base::TimeDelta::FromSeconds(1));
+  fake_task_runner_.RunOnce();
+  EXPECT_EQ(1, counter);
+
+  auto trace = test::CreateDictionaryValue(trace_log_.GetJson().c_str());
+  base::ListValue* events = nullptr;
+  ASSERT_TRUE(trace->GetList("traceEvents", &events));
+  ASSERT_EQ(2u, events->GetSize());
+
+  base::DictionaryValue* post = nullptr;
+  ASSERT_TRUE(events->GetDictionary(0, &post));
+  std::string value;
+  EXPECT_TRUE(post->GetString("ph", &value));
+  EXPECT_EQ("i", value);
+  EXPECT_TRUE(post->GetString("args.posted_from", &value));
+  EXPECT_EQ("file.cc:12", value);
+  int delay = 0;
+  EXPECT_TRUE(post->GetInteger("args.delay_us", &delay));
+  EXPECT_EQ(1000000, delay);
+
+  base::DictionaryValue* run = nullptr;
+  ASSERT_TRUE(events->GetDictionary(1, &run));
+  EXPECT_TRUE(run->GetString("ph", &value));
+  EXPECT_EQ("X", value);
+  EXPECT_TRUE(run->GetString("name", &value));
+  EXPECT_EQ("PostIncrement", value);
+  EXPECT_TRUE(run->GetString("args.posted_from", &value));
+  EXPECT_EQ("file.cc:12", value);
+  // FakeTaskRunner doesn't wait for delays in real time, so the value is not
+  // checked.
+  double queue_delay = 0;
+  EXPECT_TRUE(run->GetDouble("args.queue_delay_us", &queue_delay));
+}
+
+}  // namespace weave
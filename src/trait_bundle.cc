@@ -0,0 +1,320 @@
+// Copyright 2016 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "src/trait_bundle.h"
+
+#include <cstring>
+#include <limits>
+
+#include <base/logging.h>
+
+namespace weave {
+
+namespace errors {
+const char kInvalidTraitBundle[] = "invalid_trait_bundle";
+}  // namespace errors
+
+namespace {
+
+const uint8_t kMagic[] = {'W', 'T', 'B'};
+const uint8_t kVersion = 1;
+
+// Same as the JSON reader.
+const int kMaxDepth = 100;
+
+enum Tag : uint8_t {
+  kNull = 0,
+  kFalse,
+  kTrue,
+  kInteger,
+  kDouble,
+  kString,
+  kList,
+  kDictionary,
+};
+
+void WriteVarint(uint64_t value, std::vector<uint8_t>* out) {
+  while (value >= 0x80) {
+    out->push_back(static_cast<uint8_t>(value) | 0x80);
+    value >>= 7;
+  }
+  out->push_back(static_cast<uint8_t>(value));
+}
+
+void WriteString(const std::string& value, std::vector<uint8_t>* out) {
+  WriteVarint(value.size(), out);
+  out->insert(out->end(), value.begin(), value.end());
+}
+
+bool WriteValue(const base::Value& value,
+                std::vector<uint8_t>* out,
+                ErrorPtr* error) {
+  switch (value.GetType()) {
+    case base::Value::TYPE_NULL:
+      out->push_back(kNull);
+      return true;
+    case base::Value::TYPE_BOOLEAN: {
+      bool flag = false;
+      CHECK(value.GetAsBoolean(&flag));
+      out->push_back(flag ? kTrue : kFalse);
+      return true;
+    }
+    case base::Value::TYPE_INTEGER: {
+      int number = 0;
+      CHECK(value.GetAsInteger(&number));
+      out->push_back(kInteger);
+      int64_t wide = number;
+      WriteVarint((static_cast<uint64_t>(wide) << 1) ^ (wide >> 63), out);
+      return true;
+    }
+    case base::Value::TYPE_DOUBLE: {
+      double number = 0;
+      CHECK(value.GetAsDouble(&number));
+      uint64_t bits = 0;
+      static_assert(sizeof(bits) == sizeof(number), "Unexpected double size");
+      memcpy(&bits, &number, sizeof(bits));
+      out->push_back(kDouble);
+      for (size_t i = 0; i < sizeof(bits); ++i)
+        out->push_back(static_cast<uint8_t>(bits >> (8 * i)));
+      return true;
+    }
+    case base::Value::TYPE_STRING: {
+      std::string str;
+      CHECK(value.GetAsString(&str));
+      out->push_back(kString);
+      WriteString(str, out);
+      return true;
+    }
+    case base::Value::TYPE_LIST: {
+      const base::ListValue* list = nullptr;
+      CHECK(value.GetAsList(&list));
+      out->push_back(kList);
+      WriteVarint(list->GetSize(), out);
+      for (const base::Value* item : *list) {
+        if (!WriteValue(*item, out, error))
+          return false;
+      }
+      return true;
+    }
+    case base::Value::TYPE_DICTIONARY: {
+      const base::DictionaryValue* dict = nullptr;
+      CHECK(value.GetAsDictionary(&dict));
+      out->push_back(kDictionary);
+      WriteVarint(dict->size(), out);
+      for (base::DictionaryValue::Iterator it(*dict); !it.IsAtEnd();
+           it.Advance()) {
+        WriteString(it.key(), out);
+        if (!WriteValue(it.value(), out, error))
+          return false;
+      }
+      return true;
+    }
+    case base::Value::TYPE_BINARY:
+      break;
+  }
+  Error::AddTo(error, FROM_HERE, errors::kInvalidTraitBundle,
+               "Trait definitions can't contain binary values");
+  return false;
+}
+
+// Reads values from a bundle. Every read checks the remaining size, so a
+// corrupted bundle is reported as an error instead of being read past the end.
+class Reader {
+ public:
+  Reader(const uint8_t* data, size_t size) : data_{data}, end_{data + size} {}
+
+  bool ReadHeader(ErrorPtr* error) {
+    if (static_cast<size_t>(end_ - data_) < sizeof(kMagic) + 1 ||
+        memcmp(data_, kMagic, sizeof(kMagic)) != 0) {
+      return Fail("Not a trait bundle", error);
+    }
+    data_ += sizeof(kMagic);
+    if (*data_ != kVersion) {
+      Error::AddToPrintf(error, FROM_HERE, errors::kInvalidTraitBundle,
+                         "Unsupported trait bundle version %d", *data_);
+      return false;
+    }
+    ++data_;
+    return true;
+  }
+
+  std::unique_ptr<base::DictionaryValue> ReadDictionary(int depth,
+                                                        ErrorPtr* error) {
+    std::unique_ptr<base::DictionaryValue> dict;
+    uint64_t count = 0;
+    if (!ReadCount(&count, error))
+      return dict;
+    dict.reset(new base::DictionaryValue);
+    std::string key;
+    for (uint64_t i = 0; i < count; ++i) {
+      std::unique_ptr<base::Value> value;
+      if (!ReadString(&key, error) || !(value = ReadValue(depth, error))) {
+        dict.reset();
+        return dict;
+      }
+      dict->SetWithoutPathExpansion(key, value.release());
+    }
+    return dict;
+  }
+
+  std::unique_ptr<base::Value> ReadValue(int depth, ErrorPtr* error) {
+    std::unique_ptr<base::Value> value;
+    if (data_ == end_) {
+      Fail("Trait bundle is truncated", error);
+      return value;
+    }
+    switch (*data_++) {
+      case kNull:
+        value.reset(base::Value::CreateNullValue().release());
+        break;
+      case kFalse:
+        value.reset(new base::FundamentalValue(false));
+        break;
+      case kTrue:
+        value.reset(new base::FundamentalValue(true));
+        break;
+      case kInteger: {
+        uint64_t zigzag = 0;
+        if (!ReadVarint(&zigzag, error))
+          break;
+        int64_t number = static_cast<int64_t>(zigzag >> 1) ^
+                         -static_cast<int64_t>(zigzag & 1);
+        if (number < std::numeric_limits<int>::min() ||
+            number > std::numeric_limits<int>::max()) {
+          Fail("Integer is out of range", error);
+          break;
+        }
+        value.reset(new base::FundamentalValue(static_cast<int>(number)));
+        break;
+      }
+      case kDouble: {
+        uint64_t bits = 0;
+        if (static_cast<size_t>(end_ - data_) < sizeof(bits)) {
+          Fail("Trait bundle is truncated", error);
+          break;
+        }
+        for (size_t i = 0; i < sizeof(bits); ++i)
+          bits |= static_cast<uint64_t>(*data_++) << (8 * i);
+        double number = 0;
+        memcpy(&number, &bits, sizeof(number));
+        value.reset(new base::FundamentalValue(number));
+        break;
+      }
+      case kString: {
+        std::string str;
+        if (ReadString(&str, error))
+          value.reset(new base::StringValue(str));
+        break;
+      }
+      case kList: {
+        uint64_t count = 0;
+        if (!CheckDepth(depth, error) || !ReadCount(&count, error))
+          break;
+        std::unique_ptr<base::ListValue> list{new base::ListValue};
+        for (uint64_t i = 0; i < count; ++i) {
+          std::unique_ptr<base::Value> item = ReadValue(depth + 1, error);
+          if (!item)
+            return value;
+          list->Append(item.release());
+        }
+        value = std::move(list);
+        break;
+      }
+      case kDictionary:
+        if (CheckDepth(depth, error))
+          value = ReadDictionary(depth + 1, error);
+        break;
+      default:
+        Error::AddToPrintf(error, FROM_HERE, errors::kInvalidTraitBundle,
+                           "Unknown value tag %d", data_[-1]);
+        break;
+    }
+    return value;
+  }
+
+  bool ReadTag(Tag expected, ErrorPtr* error) {
+    if (data_ == end_ || *data_ != expected)
+      return Fail("Unexpected value type", error);
+    ++data_;
+    return true;
+  }
+
+  bool AtEnd() const { return data_ == end_; }
+
+ private:
+  bool ReadVarint(uint64_t* value, ErrorPtr* error) {
+    *value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+      if (data_ == end_)
+        return Fail("Trait bundle is truncated", error);
+      uint8_t byte = *data_++;
+      *value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+      if (!(byte & 0x80))
+        return true;
+    }
+    return Fail("Varint is too long", error);
+  }
+
+  bool CheckDepth(int depth, ErrorPtr* error) {
+    return depth < kMaxDepth || Fail("Trait bundle is nested too deep", error);
+  }
+
+  // Every element takes at least one byte, so a count larger than the rest of
+  // the bundle is corrupted.
+  bool ReadCount(uint64_t* count, ErrorPtr* error) {
+    if (!ReadVarint(count, error))
+      return false;
+    if (*count > static_cast<uint64_t>(end_ - data_))
+      return Fail("Trait bundle is truncated", error);
+    return true;
+  }
+
+  bool ReadString(std::string* str, ErrorPtr* error) {
+    uint64_t size = 0;
+    if (!ReadCount(&size, error))
+      return false;
+    str->assign(reinterpret_cast<const char*>(data_), size);
+    data_ += size;
+    return true;
+  }
+
+  bool Fail(const char* message, ErrorPtr* error) {
+    Error::AddTo(error, FROM_HERE, errors::kInvalidTraitBundle, message);
+    return false;
+  }
+
+  const uint8_t* data_;
+  const uint8_t* end_;
+};
+
+}  // anonymous namespace
+
+bool EncodeTraitBundle(const base::DictionaryValue& dict,
+                       std::vector<uint8_t>* bundle,
+                       ErrorPtr* error) {
+  bundle->assign(std::begin(kMagic), std::end(kMagic));
+  bundle->push_back(kVersion);
+  if (WriteValue(dict, bundle, error))
+    return true;
+  bundle->clear();
+  return false;
+}
+
+std::unique_ptr<base::DictionaryValue> DecodeTraitBundle(const uint8_t* data,
+                                                         size_t size,
+                                                         ErrorPtr* error) {
+  std::unique_ptr<base::DictionaryValue> dict;
+  Reader reader{data, size};
+  if (!reader.ReadHeader(error) || !reader.ReadTag(kDictionary, error))
+    return dict;
+  dict = reader.ReadDictionary(1, error);
+  if (dict && !reader.AtEnd()) {
+    Error::AddTo(error, FROM_HERE, errors::kInvalidTraitBundle,
+                 "Unexpected data after the trait definitions");
+    dict.reset();
+  }
+  return dict;
+}
+
+}  // namespace weave
@@ -0,0 +1,44 @@
+// Copyright 2016 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIBWEAVE_SRC_TRAIT_BUNDLE_H_
+#define LIBWEAVE_SRC_TRAIT_BUNDLE_H_
+
+#include <memory>
+#include <vector>
+
+#include <base/values.h>
+#include <weave/error.h>
+
+namespace weave {
+
+namespace errors {
+extern const char kInvalidTraitBundle[];
+}  // namespace errors
+
+// A trait bundle is a trait definition dictionary serialized into a flat byte
+// array, so it can be compiled into the binary as a constant or mapped from a
+// file and loaded without parsing JSON. Bundles are generated at build time by
+// trait_bundle_compiler.
+//
+// Layout: the magic "WTB" and a version byte, followed by the dictionary.
+// Each value is a type tag followed by its payload. Integers are zigzag
+// varints, doubles are 8 little-endian bytes, strings are a varint length and
+// the bytes, lists are a varint count and the values, dictionaries are a
+// varint count and the key strings each followed by the value.
+
+// Serializes |dict| into |bundle|. Fails if |dict| contains binary values.
+bool EncodeTraitBundle(const base::DictionaryValue& dict,
+                       std::vector<uint8_t>* bundle,
+                       ErrorPtr* error);
+
+// Deserializes |size| bytes of a bundle at |data|. Returns nullptr if the
+// bundle is truncated, malformed or has an unsupported version.
+std::unique_ptr<base::DictionaryValue> DecodeTraitBundle(const uint8_t* data,
+                                                         size_t size,
+                                                         ErrorPtr* error);
+
+}  // namespace weave
+
+#endif  // LIBWEAVE_SRC_TRAIT_BUNDLE_H_
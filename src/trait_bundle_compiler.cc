@@ -0,0 +1,96 @@
+// Copyright 2016 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Compiles a JSON file with trait definitions into a C++ source file with the
+// trait bundle, see trait_bundle.h, as a constant array:
+//
+//   extern const uint8_t kLampTraitsBundle[] = {...};
+//   extern const size_t kLampTraitsBundleSize = sizeof(kLampTraitsBundle);
+//
+// which can be passed to Device::AddTraitDefinitionsFromBundle(). The array is
+// named after the file name, e.g. lamp_traits.json, or the second argument.
+//
+// Usage: trait_bundle_compiler <traits.json> [<array name>] > <bundle.cc>
+
+#include <cctype>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <base/values.h>
+
+#include "src/trait_bundle.h"
+#include "src/utils.h"
+
+namespace weave {
+
+namespace {
+
+const size_t kBytesPerLine = 12;
+
+// lamp_traits.json -> kLampTraitsBundle.
+std::string GetArrayName(const std::string& path) {
+  size_t begin = path.find_last_of('/');
+  begin = begin == std::string::npos ? 0 : begin + 1;
+  size_t end = path.find('.', begin);
+  if (end == std::string::npos)
+    end = path.size();
+  std::string name = "k";
+  bool upper = true;
+  for (size_t i = begin; i < end; ++i) {
+    if (!isalnum(path[i])) {
+      upper = true;
+      continue;
+    }
+    name += upper ? static_cast<char>(toupper(path[i])) : path[i];
+    upper = false;
+  }
+  return name + "Bundle";
+}
+
+int Compile(const std::string& path, const std::string& name) {
+  std::ifstream file{path};
+  if (!file) {
+    fprintf(stderr, "Can't read %s\n", path.c_str());
+    return 1;
+  }
+  std::ostringstream json;
+  json << file.rdbuf();
+
+  ErrorPtr error;
+  std::vector<uint8_t> bundle;
+  std::unique_ptr<base::DictionaryValue> traits =
+      LoadJsonDict(json.str(), &error);
+  if (!traits || !EncodeTraitBundle(*traits, &bundle, &error)) {
+    fprintf(stderr, "%s: %s\n", path.c_str(), error->GetMessage().c_str());
+    return 1;
+  }
+
+  printf("// Generated by trait_bundle_compiler from %s. Do not edit.\n\n",
+         path.c_str());
+  printf("#include <stddef.h>\n#include <stdint.h>\n\n");
+  printf("extern const uint8_t %s[] = {", name.c_str());
+  for (size_t i = 0; i < bundle.size(); ++i)
+    printf("%s0x%02x,", i % kBytesPerLine ? " " : "\n    ", bundle[i]);
+  printf("\n};\n");
+  printf("extern const size_t %sSize = sizeof(%s);\n", name.c_str(),
+         name.c_str());
+  return 0;
+}
+
+}  // namespace
+
+}  // namespace weave
+
+int main(int argc, char** argv) {
+  if (argc != 2 && argc != 3) {
+    fprintf(stderr, "Usage: %s <traits.json> [<array name>] > <bundle.cc>\n",
+            argv[0]);
+    return 1;
+  }
+  std::string path = argv[1];
+  return weave::Compile(path, argc == 3 ? argv[2] : weave::GetArrayName(path));
+}
@@ -0,0 +1,169 @@
+// Copyright 2016 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "src/trait_bundle.h"
+
+#include <fstream>
+#include <limits>
+#include <sstream>
+
+#include <gtest/gtest.h>
+#include <weave/test/unittest_utils.h>
+
+#include "src/builtin_traits.h"
+
+namespace weave {
+
+using test::CreateDictionaryValue;
+
+namespace {
+
+const char kTraits[] = R"({
+  "lock": {
+    "commands": {
+      "setConfig": {
+        "minimalRole": "user",
+        "parameters": {
+          "lockedState": {"type": "string", "enum": ["locked", "unlocked"]}
+        }
+      }
+    },
+    "state": {
+      "lockedState": {"type": "string", "isRequired": true},
+      "isLockingSupported": {"type": "boolean", "default": false}
+    }
+  },
+  "temperature": {
+    "state": {
+      "value": {"type": "number", "minimum": -40.5, "maximum": 1e6},
+      "offset": {"type": "integer", "minimum": -2147483648,
+                 "maximum": 2147483647},
+      "unit": {"type": "string", "default": "°C"},
+      "history": {"type": "array", "items": [[], {}, null, true, 0]}
+    }
+  },
+  "": {}
+})";
+
+std::vector<uint8_t> Encode(const std::string& json) {
+  std::vector<uint8_t> bundle;
+  EXPECT_TRUE(EncodeTraitBundle(*CreateDictionaryValue(json), &bundle,
+                                nullptr));
+  return bundle;
+}
+
+// Checks that a checked in bundle decodes to the definitions of |path|, which
+// is relative to the source root where tests run.
+void ExpectBundleOf(const std::string& path,
+                    const uint8_t* data,
+                    size_t size) {
+  std::ifstream file{path};
+  ASSERT_TRUE(file) << "Can't read " << path;
+  std::ostringstream json;
+  json << file.rdbuf();
+  auto expected = CreateDictionaryValue(json.str());
+
+  ErrorPtr error;
+  auto traits = DecodeTraitBundle(data, size, &error);
+  ASSERT_NE(nullptr, traits) << error->GetMessage();
+  EXPECT_TRUE(traits->Equals(expected.get()))
+      << path << " changed, run make update-trait-bundles";
+}
+
+}  // namespace
+
+TEST(TraitBundleTest, RoundTrip) {
+  std::vector<uint8_t> bundle = Encode(kTraits);
+  ErrorPtr error;
+  auto traits = DecodeTraitBundle(bundle.data(), bundle.size(), &error);
+  ASSERT_NE(nullptr, traits);
+  EXPECT_JSON_EQ(kTraits, *traits);
+
+  // Integers and doubles stay different types.
+  int offset = 0;
+  EXPECT_TRUE(traits->GetInteger("temperature.state.offset.minimum", &offset));
+  EXPECT_EQ(std::numeric_limits<int>::min(), offset);
+  const base::Value* value = nullptr;
+  ASSERT_TRUE(traits->Get("temperature.state.value.maximum", &value));
+  EXPECT_EQ(base::Value::TYPE_DOUBLE, value->GetType());
+
+  EXPECT_EQ(bundle, Encode(kTraits));
+}
+
+TEST(TraitBundleTest, Empty) {
+  std::vector<uint8_t> bundle = Encode("{}");
+  EXPECT_EQ((std::vector<uint8_t>{'W', 'T', 'B', 1, 7, 0}), bundle);
+  auto traits = DecodeTraitBundle(bundle.data(), bundle.size(), nullptr);
+  ASSERT_NE(nullptr, traits);
+  EXPECT_TRUE(traits->empty());
+}
+
+TEST(TraitBundleTest, BinaryValue) {
+  base::DictionaryValue dict;
+  dict.Set("trait", base::BinaryValue::CreateWithCopiedBuffer("x", 1));
+  std::vector<uint8_t> bundle;
+  ErrorPtr error;
+  EXPECT_FALSE(EncodeTraitBundle(dict, &bundle, &error));
+  EXPECT_EQ(errors::kInvalidTraitBundle, error->GetCode());
+  EXPECT_TRUE(bundle.empty());
+}
+
+TEST(TraitBundleTest, Truncated) {
+  std::vector<uint8_t> bundle = Encode(kTraits);
+  for (size_t size = 0; size < bundle.size(); ++size) {
+    ErrorPtr error;
+    EXPECT_EQ(nullptr, DecodeTraitBundle(bundle.data(), size, &error))
+        << size;
+    ASSERT_NE(nullptr, error) << size;
+    EXPECT_EQ(errors::kInvalidTraitBundle, error->GetCode());
+  }
+}
+
+TEST(TraitBundleTest, Malformed) {
+  const std::vector<std::vector<uint8_t>> kBundles = {
+      // Wrong magic.
+      {'W', 'T', 'X', 1, 7, 0},
+      // Unsupported version.
+      {'W', 'T', 'B', 2, 7, 0},
+      // Not a dictionary.
+      {'W', 'T', 'B', 1, 6, 0},
+      // Unknown tag.
+      {'W', 'T', 'B', 1, 7, 1, 1, 'a', 8},
+      // Count larger than the bundle.
+      {'W', 'T', 'B', 1, 7, 0xff, 0xff, 0xff, 0xff, 0x0f},
+      // Integer out of range.
+      {'W', 'T', 'B', 1, 7, 1, 1, 'a', 3, 0x80, 0x80, 0x80, 0x80, 0x10},
+      // Varint too long.
+      {'W', 'T', 'B', 1, 7, 1, 1, 'a', 3, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+       0xff, 0xff, 0xff, 0xff, 0x01},
+      // Trailing data.
+      {'W', 'T', 'B', 1, 7, 0, 0},
+  };
+  for (const auto& bundle : kBundles) {
+    ErrorPtr error;
+    EXPECT_EQ(nullptr, DecodeTraitBundle(bundle.data(), bundle.size(), &error));
+    ASSERT_NE(nullptr, error);
+    EXPECT_EQ(errors::kInvalidTraitBundle, error->GetCode());
+  }
+}
+
+TEST(TraitBundleTest, TooDeep) {
+  std::vector<uint8_t> bundle{'W', 'T', 'B', 1, 7, 1, 1, 'a'};
+  for (int i = 0; i < 200; ++i)
+    bundle.insert(bundle.end(), {6, 1});
+  bundle.push_back(0);
+  ErrorPtr error;
+  EXPECT_EQ(nullptr, DecodeTraitBundle(bundle.data(), bundle.size(), &error));
+  ASSERT_NE(nullptr, error);
+  EXPECT_EQ(errors::kInvalidTraitBundle, error->GetCode());
+}
+
+TEST(TraitBundleTest, BuiltinTraits) {
+  ExpectBundleOf("src/base_traits.json", kBaseTraitsBundle,
+                 kBaseTraitsBundleSize);
+  ExpectBundleOf("src/access_traits.json", kAccessTraitsBundle,
+                 kAccessTraitsBundleSize);
+}
+
+}  // namespace weave
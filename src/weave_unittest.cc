@@ -392,6 +392,48 @@ TEST_F(WeaveBasicTest, Start) {
   StartDevice();
 }
 
+namespace {
+
+// Request which expects the reply body to be handed over.
+class MovedReplyRequest : public provider::HttpServer::Request {
+ public:
+  MovedReplyRequest(const std::string& path, int* status)
+      : path_{path}, status_{status} {}
+
+  std::string GetPath() const override { return path_; }
+  std::string GetFirstHeader(const std::string& name) const override {
+    return name == "Authorization" ? "Privet anonymous" : "";
+  }
+  std::string GetData() override { return {}; }
+  void SendReply(int status_code,
+                 const std::string& data,
+                 const std::string& mime_type) override {
+    ADD_FAILURE() << "Reply body is copied";
+  }
+  void SendReply(int status_code,
+                 std::string&& data,
+                 const std::string& mime_type) override {
+    EXPECT_NE(nullptr, CreateDictionaryValue(data));
+    *status_ = status_code;
+  }
+
+ private:
+  std::string path_;
+  int* status_;
+};
+
+}  // namespace
+
+TEST_F(WeaveBasicTest, PrivetReplyBodyIsMoved) {
+  StartDevice();
+  int status = 0;
+  http_handlers_["/privet/info"].Run(
+      std::unique_ptr<provider::HttpServer::Request>{
+          new MovedReplyRequest{"/privet/info", &status}});
+  task_runner_.Run();
+  EXPECT_EQ(200, status);
+}
+
 TEST_F(WeaveBasicTest, Register) {
   EXPECT_CALL(network_, OpenSslSocket(_, _, _)).WillRepeatedly(Return());
   StartDevice();
@@ -62,7 +62,57 @@ out/$(BUILD_MODE)/libweave_exports_testrunner : \
 export-test : out/$(BUILD_MODE)/libweave_exports_testrunner
 	$(TEST_ENV) $< $(TEST_FLAGS)
 
+###
+# soak test
+
+weave_soaktest_obj_files := $(WEAVE_SOAKTEST_SRC_FILES:%.cc=out/$(BUILD_MODE)/%.o)
+
+$(weave_soaktest_obj_files) : out/$(BUILD_MODE)/%.o : %.cc third_party/include/gtest/gtest.h
+	mkdir -p $(dir $@)
+	$(CXX) $(DEFS_TEST) $(INCLUDES) $(CFLAGS) $(CFLAGS_$(BUILD_MODE)) $(CFLAGS_CC) -c -o $@ $<
+
+out/$(BUILD_MODE)/libweave_soaktest : \
+	$(weave_soaktest_obj_files) \
+	out/$(BUILD_MODE)/libweave_common.a \
+	out/$(BUILD_MODE)/libweave-test.a \
+	out/$(BUILD_MODE)/src/test/weave_testrunner.o \
+	third_party/lib/gmock.a \
+	third_party/lib/gtest.a
+	$(CXX) -o $@ $^ $(CFLAGS) -lcrypto -lexpat -lpthread -lrt -Lthird_party/lib
+
+# Simulates days of device operation on virtual time, as many as kSimulatedDays
+# in src/soak_test.cc. Takes much longer than the unit tests, so it is not a
+# part of testall.
+soak-test : out/$(BUILD_MODE)/libweave_soaktest
+	$(TEST_ENV) $< $(TEST_FLAGS)
+
+###
+# startup benchmark
+
+weave_startup_benchmark_obj_files := $(WEAVE_STARTUP_BENCHMARK_SRC_FILES:%.cc=out/$(BUILD_MODE)/%.o)
+
+$(weave_startup_benchmark_obj_files) : out/$(BUILD_MODE)/%.o : %.cc third_party/include/gtest/gtest.h
+	mkdir -p $(dir $@)
+	$(CXX) $(DEFS_TEST) $(INCLUDES) $(CFLAGS) $(CFLAGS_$(BUILD_MODE)) $(CFLAGS_CC) -c -o $@ $<
+
+weave_startup_benchmark_bundle_obj_files := $(WEAVE_STARTUP_BENCHMARK_TRAIT_FILES:%.json=out/$(BUILD_MODE)/gen/%_bundle.o)
+
+out/$(BUILD_MODE)/libweave_startup_benchmark : \
+	$(weave_startup_benchmark_obj_files) \
+	$(weave_startup_benchmark_bundle_obj_files) \
+	out/$(BUILD_MODE)/libweave_common.a \
+	out/$(BUILD_MODE)/libweave-test.a \
+	out/$(BUILD_MODE)/src/test/weave_testrunner.o \
+	third_party/lib/gmock.a \
+	third_party/lib/gtest.a
+	$(CXX) -o $@ $^ $(CFLAGS) -lcrypto -lexpat -lpthread -lrt -Lthird_party/lib
+
+# Measures the phases of a cold start of a device. Prints results rather than
+# checking them, so it is not a part of testall.
+startup-benchmark : out/$(BUILD_MODE)/libweave_startup_benchmark
+	$(TEST_ENV) $< $(TEST_FLAGS)
+
 testall : test export-test
 
-.PHONY : test export-test testall
+.PHONY : test export-test soak-test startup-benchmark testall
 